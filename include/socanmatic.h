@@ -43,6 +43,7 @@
 
 #include <stdio.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include <sys/socket.h>
 #include <linux/can.h>
@@ -62,11 +63,24 @@
 #include "socanmatic/ds301.h"
 #include "socanmatic/dict.h"
 #include "socanmatic/dict_fun.h"
+#include "socanmatic/dict_image.h"
 #include "socanmatic/nmt.h"
 #include "socanmatic/emcy.h"
 #include "socanmatic/sdo.h"
 #include "socanmatic/pdo.h"
 #include "socanmatic/probe.h"
+#include "socanmatic/hist.h"
+#include "socanmatic/dispatch.h"
+#include "socanmatic/sdo_client.h"
+#include "socanmatic/sdo_server.h"
+#include "socanmatic/pdo_slave.h"
+#include "socanmatic/sync.h"
+#include "socanmatic/nmt_master.h"
+#include "socanmatic/lss.h"
+#include "socanmatic/snapshot.h"
+#include "socanmatic/cdcf.h"
+#include "socanmatic/fanout.h"
+#include "socanmatic/flash.h"
 #include "socanmatic/ds402.h"
 
 #endif //SOCANMATIC_H
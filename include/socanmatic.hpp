@@ -0,0 +1,272 @@
+/* -*- mode: C++; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SOCANMATIC_HPP
+#define SOCANMATIC_HPP
+
+/**
+ * \file socanmatic.hpp
+ *
+ * \brief C++17 typed access to dictionary objects and PDOs.
+ *
+ * Each object is a type carrying its index, subindex, and C type, so
+ * SDO transfers and PDO layouts are checked when compiled and need no
+ * run-time dispatch on the data type.  Object types for a dictionary
+ * are written by `canmatc --cxx'.
+ *
+ * \author Neil Dantam
+ */
+
+#include <array>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "socanmatic.h"
+
+namespace socanmatic {
+
+/** C type of a CiA data type */
+template<enum canmat_data_type DT> struct data_type;
+
+template<> struct data_type<CANMAT_DATA_TYPE_UNSIGNED8>  { typedef CANMAT_UNSIGNED8 type; };
+template<> struct data_type<CANMAT_DATA_TYPE_UNSIGNED16> { typedef CANMAT_UNSIGNED16 type; };
+template<> struct data_type<CANMAT_DATA_TYPE_UNSIGNED32> { typedef CANMAT_UNSIGNED32 type; };
+template<> struct data_type<CANMAT_DATA_TYPE_INTEGER8>   { typedef CANMAT_INTEGER8 type; };
+template<> struct data_type<CANMAT_DATA_TYPE_INTEGER16>  { typedef CANMAT_INTEGER16 type; };
+template<> struct data_type<CANMAT_DATA_TYPE_INTEGER32>  { typedef CANMAT_INTEGER32 type; };
+template<> struct data_type<CANMAT_DATA_TYPE_REAL32>     { typedef CANMAT_REAL32 type; };
+
+/** A dictionary object known at compile time */
+template<uint16_t Index, uint8_t Subindex, enum canmat_data_type DT>
+struct object {
+    typedef typename data_type<DT>::type type;
+    static constexpr uint16_t index = Index;
+    static constexpr uint8_t subindex = Subindex;
+    static constexpr enum canmat_data_type data = DT;
+    static constexpr size_t size = sizeof(type);
+
+    /** Description for the C API, e.g. canmat_pdo_remap() */
+    static canmat_obj_t c_obj() {
+        return canmat_obj_t{ Index, Subindex, NULL, 0, CANMAT_ACCESS_RW,
+                             CANMAT_OBJECT_TYPE_VAR, DT, 1, NULL, NULL };
+    }
+};
+
+/** Value from an SDO upload */
+template<typename T>
+struct result {
+    canmat_status_t status;
+    uint32_t abort;         ///< abort code when status is CANMAT_ERR_ABORT
+    T value;
+
+    explicit operator bool() const { return CANMAT_OK == status; }
+};
+
+/** Outcome of an SDO download */
+template<>
+struct result<void> {
+    canmat_status_t status;
+    uint32_t abort;         ///< abort code when status is CANMAT_ERR_ABORT
+
+    explicit operator bool() const { return CANMAT_OK == status; }
+};
+
+namespace detail {
+
+/* True when From converts to To without narrowing */
+template<typename To, typename From, typename = void>
+struct non_narrowing : std::false_type {};
+
+template<typename To, typename From>
+struct non_narrowing<To, From, std::void_t<decltype(To{std::declval<From>()})> >
+    : std::true_type {};
+
+template<typename T>
+inline void store( uint8_t *p, T val ) {
+    if constexpr ( 1 == sizeof(T) ) {
+        p[0] = (uint8_t)val;
+    } else if constexpr ( 2 == sizeof(T) ) {
+        canmat_byte_stle16( p, (uint16_t)val );
+    } else {
+        static_assert( 4 == sizeof(T), "unsupported PDO object size" );
+        uint32_t u;
+        std::memcpy( &u, &val, sizeof(u) );
+        canmat_byte_stle32( p, u );
+    }
+}
+
+template<typename T>
+inline T load( const uint8_t *p ) {
+    if constexpr ( 1 == sizeof(T) ) {
+        return (T)p[0];
+    } else if constexpr ( 2 == sizeof(T) ) {
+        return (T)canmat_byte_ldle16( p );
+    } else {
+        static_assert( 4 == sizeof(T), "unsupported PDO object size" );
+        uint32_t u = canmat_byte_ldle32( p );
+        T val;
+        std::memcpy( &val, &u, sizeof(val) );
+        return val;
+    }
+}
+
+} // namespace detail
+
+/** SDO transfers of typed objects */
+class sdo {
+public:
+    explicit sdo( canmat_iface_t *cif ) : cif_(cif) {}
+
+    template<typename Obj>
+    result<typename Obj::type> upload( uint8_t node ) const {
+        canmat_sdo_msg_t req = {}, resp = {};
+        req.index = Obj::index;
+        req.subindex = Obj::subindex;
+        req.node = node;
+        req.data_type = Obj::data;
+        result<typename Obj::type> r = {};
+        r.status = canmat_sdo_ul( cif_, &req, &resp );
+        if( CANMAT_OK == r.status ) {
+            // all union members start at the same address
+            std::memcpy( &r.value, &resp.data, sizeof(r.value) );
+        } else if( CANMAT_ERR_ABORT == r.status ) {
+            r.abort = resp.data.u32;
+        }
+        return r;
+    }
+
+    template<typename Obj, typename V>
+    canmat_status_t download( uint8_t node, V val, uint32_t *err = NULL ) const {
+        static_assert( detail::non_narrowing<typename Obj::type, V>::value,
+                       "value does not fit the object's data type" );
+        canmat_sdo_msg_t req = {}, resp = {};
+        req.index = Obj::index;
+        req.subindex = Obj::subindex;
+        req.node = node;
+        req.data_type = Obj::data;
+        typename Obj::type v = val;
+        std::memcpy( &req.data, &v, sizeof(v) );
+        canmat_status_t r = canmat_sdo_dl( cif_, &req, &resp );
+        if( CANMAT_ERR_ABORT == r && NULL != err ) *err = resp.data.u32;
+        return r;
+    }
+
+private:
+    canmat_iface_t *cif_;
+};
+
+/** A PDO mapping the objects Objs, in order */
+template<typename... Objs>
+struct pdo {
+    static_assert( sizeof...(Objs) > 0, "empty PDO" );
+
+    typedef std::tuple<typename Objs::type...> tuple;
+
+    static constexpr size_t count = sizeof...(Objs);
+    static constexpr size_t length = (0 + ... + Objs::size);
+    static_assert( length <= 8, "PDO is longer than 8 bytes" );
+
+    /** Byte offset of the i'th object */
+    static constexpr size_t offset( size_t i ) {
+        constexpr size_t sizes[] = { Objs::size... };
+        size_t o = 0;
+        for( size_t j = 0; j < i; j++ ) o += sizes[j];
+        return o;
+    }
+
+    static void pack( const tuple &val, uint8_t *data ) {
+        pack( val, data, std::index_sequence_for<Objs...>() );
+    }
+
+    static tuple unpack( const uint8_t *data ) {
+        return unpack( data, std::index_sequence_for<Objs...>() );
+    }
+
+    /** Descriptions of Objs for the C API */
+    static std::array<canmat_obj_t, count> c_objs() {
+        return {{ Objs::c_obj()... }};
+    }
+
+    /** Map Objs into the node's PDO */
+    static canmat_status_t remap( canmat_iface_t *cif, uint8_t node, uint8_t pdo_num,
+                                  enum canmat_direction dir, int transmission_type,
+                                  int inhibit_time, int event_timer, uint32_t *err ) {
+        const std::array<canmat_obj_t, count> obj = c_objs();
+        const canmat_obj_t *objs[count];
+        for( size_t i = 0; i < count; i++ ) objs[i] = &obj[i];
+        return canmat_pdo_remap( cif, node, pdo_num, dir, transmission_type,
+                                 inhibit_time, event_timer, (uint8_t)count, objs, err );
+    }
+
+    /** Send as an RPDO */
+    static canmat_status_t send( canmat_iface_t *cif, uint8_t node, uint8_t pdo_num,
+                                 const tuple &val ) {
+        uint8_t data[length];
+        pack( val, data );
+        return canmat_rpdo_send( cif, node, pdo_num, (uint8_t)length, data );
+    }
+
+private:
+    template<size_t... I>
+    static void pack( const tuple &val, uint8_t *data, std::index_sequence<I...> ) {
+        ( detail::store( data + offset(I), std::get<I>(val) ), ... );
+    }
+
+    template<size_t... I>
+    static tuple unpack( const uint8_t *data, std::index_sequence<I...> ) {
+        return tuple( detail::load<typename Objs::type>( data + offset(I) )... );
+    }
+};
+
+} // namespace socanmatic
+
+#endif //SOCANMATIC_HPP
+
+
+/* Local Variables:                          */
+/* mode: c++                                 */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -99,10 +99,6 @@ static inline uint16_t canmat_byte_ldle16( const void *p ) {
                        (uint16_t)(q[1] << 8) );
 }
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
 static inline uint8_t canmat_byte_ldle8( const void *p ) {
     return ((uint8_t*)p)[0];
 }
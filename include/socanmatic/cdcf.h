@@ -0,0 +1,132 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOCANMATIC_CDCF_H
+#define SOCANMATIC_CDCF_H
+
+/**
+ * \file cdcf.h
+ *
+ * \brief Concise device configuration files, CiA 302.
+ *
+ * A concise DCF packs many object values into one DOMAIN.  It holds
+ * the number of entries, and each entry as index, subindex, size, and
+ * data, all little-endian.  Writing it to 1F22h needs a single block
+ * transfer, instead of one SDO round trip per object.  The node
+ * holding 1F22h applies the entries in order.  This is usually the
+ * NMT master, where the subindex is the node-ID to configure, or a
+ * node that configures itself.
+ *
+ * A concise DCF is built from object values or from the
+ * ParameterValue keys of DCF files.  Any step-driven client can send
+ * it with canmat_sdo_client_dl() and block set.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Object of concise DCFs, subindexed by node-ID
+#define CANMAT_CDCF_INDEX 0x1F22
+
+/** A concise DCF under construction */
+struct canmat_cdcf {
+    uint8_t *data;                 ///< entry count then entries, the DOMAIN to write
+    size_t size;                   ///< bytes in data
+    size_t capacity;               ///< room in data
+    uint32_t n;                    ///< entries
+};
+
+/** Initialize with no entries */
+void canmat_cdcf_init( struct canmat_cdcf *c );
+
+/** Free the entries of c */
+void canmat_cdcf_destroy( struct canmat_cdcf *c );
+
+/** Append n bytes of data for index/subindex, CANMAT_ERR_OS if out of memory */
+canmat_status_t canmat_cdcf_add( struct canmat_cdcf *c, uint16_t index, uint8_t subindex,
+                                 const void *data, size_t n );
+
+/** Append the numeric value of obj, CANMAT_ERR_PARAM if obj is not numeric */
+canmat_status_t canmat_cdcf_add_obj( struct canmat_cdcf *c, const canmat_obj_t *obj,
+                                     const canmat_scalar_t *val );
+
+/** Append the ParameterValue keys of DCF files.
+ *
+ * Files are layers as in canmat_dict_load_eds(), and $NODEID in
+ * values is node.  Values of read-only objects are skipped.  DataType
+ * and AccessType come from the files, or from dict when the files
+ * leave them out.  When PDO mappings (1600h-17FFh, 1A00h-1BFFh) are
+ * given, a mapping is cleared first, then its entries and number of
+ * entries are written, as DS301 requires.  A PDO's mapping follows
+ * its communication parameters, and when the files give its COB-ID,
+ * that is first written with bit 31 set, making the PDO invalid
+ * while it changes, and written as given last.
+ *
+ * @param err If not NULL, set to the location of a failure
+ */
+canmat_status_t canmat_cdcf_load_dcf( struct canmat_cdcf *c, size_t n_files, const char *const *files,
+                                      const canmat_dict_t *dict, uint8_t node,
+                                      struct canmat_eds_error *err );
+
+/** Block download c to index/subindex of node and wait for the result.
+ *
+ * \param abort set to the abort code when the node aborts
+ */
+canmat_status_t canmat_cdcf_dl( canmat_iface_t *cif, uint8_t node, uint16_t index, uint8_t subindex,
+                                const struct canmat_cdcf *c, uint32_t *abort );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_CDCF_H
+
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
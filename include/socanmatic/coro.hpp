@@ -0,0 +1,356 @@
+/* -*- mode: C++; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SOCANMATIC_CORO_HPP
+#define SOCANMATIC_CORO_HPP
+
+/**
+ * \file coro.hpp
+ *
+ * \brief C++20 coroutines over the SDO dispatcher.
+ *
+ * `co_await sdo_ul<Obj>(d, node)' queues the upload on dispatcher d
+ * and suspends until canmat_dispatch_frame() routes the response,
+ * so configuration code reads sequentially while many nodes are
+ * configured at once on one thread:
+ *
+ *     task<canmat_status_t> init( canmat_dispatch &d, uint8_t node ) {
+ *         auto s = co_await sdo_ul<canmat_402::statusword>( d, node );
+ *         if( !s ) co_return s.status;
+ *         ...
+ *     }
+ *
+ *     std::vector< task<canmat_status_t> > t;
+ *     for( uint8_t node : nodes ) t.push_back( init(d, node) );
+ *     run( d, t );
+ *
+ * Tasks start at once and run until their first suspension.  A task
+ * must outlive its pending requests, which live in its frame.
+ *
+ * \author Neil Dantam
+ */
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "socanmatic.hpp"
+
+namespace socanmatic {
+
+template<typename T = void> class task;
+
+namespace detail {
+
+struct promise_base {
+    std::coroutine_handle<> continuation;
+
+    std::suspend_never initial_suspend() noexcept { return {}; }
+
+    /* Keep the frame for the result and resume whoever awaits it */
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template<typename P>
+        std::coroutine_handle<> await_suspend( std::coroutine_handle<P> h ) noexcept {
+            std::coroutine_handle<> c = h.promise().continuation;
+            return c ? c : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    // the C layer reports errors by status
+    void unhandled_exception() { std::terminate(); }
+};
+
+template<typename T>
+struct promise : promise_base {
+    std::optional<T> value;
+    task<T> get_return_object();
+    void return_value( T v ) { value = std::move(v); }
+    T result() { return std::move(*value); }
+};
+
+template<>
+struct promise<void> : promise_base {
+    task<void> get_return_object();
+    void return_void() {}
+    void result() {}
+};
+
+} // namespace detail
+
+/** An eagerly started coroutine that may be awaited once */
+template<typename T>
+class task {
+public:
+    typedef detail::promise<T> promise_type;
+
+    task( task &&o ) noexcept : h_( std::exchange(o.h_, nullptr) ) {}
+    task &operator=( task &&o ) noexcept {
+        if( h_ ) h_.destroy();
+        h_ = std::exchange( o.h_, nullptr );
+        return *this;
+    }
+    task( const task & ) = delete;
+    task &operator=( const task & ) = delete;
+    ~task() { if( h_ ) h_.destroy(); }
+
+    bool done() const { return h_.done(); }
+
+    /** Result of a finished task */
+    T get() { return h_.promise().result(); }
+
+    bool await_ready() const { return h_.done(); }
+    void await_suspend( std::coroutine_handle<> c ) { h_.promise().continuation = c; }
+    T await_resume() { return h_.promise().result(); }
+
+private:
+    friend promise_type;
+    explicit task( std::coroutine_handle<promise_type> h ) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+namespace detail {
+
+template<typename T>
+inline task<T> promise<T>::get_return_object() {
+    return task<T>( std::coroutine_handle< promise<T> >::from_promise(*this) );
+}
+
+inline task<void> promise<void>::get_return_object() {
+    return task<void>( std::coroutine_handle< promise<void> >::from_promise(*this) );
+}
+
+/* Awaits one dispatched SDO request */
+class sdo_awaiter {
+public:
+    sdo_awaiter( canmat_dispatch &d, bool is_ul, uint8_t node, uint16_t index,
+                 uint8_t subindex, enum canmat_data_type data_type ) : d_(d), is_ul_(is_ul) {
+        req_ = {};
+        req_.msg.index = index;
+        req_.msg.subindex = subindex;
+        req_.msg.node = node;
+        req_.msg.data_type = data_type;
+        req_.done = &sdo_awaiter::done;
+    }
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend( std::coroutine_handle<> h ) {
+        h_ = h;
+        req_.cx = this;
+        req_.status = is_ul_ ? canmat_dispatch_sdo_ul( &d_, &req_ )
+                             : canmat_dispatch_sdo_dl( &d_, &req_ );
+        // not queued, resume now with the error
+        return CANMAT_OK == req_.status;
+    }
+
+protected:
+    uint32_t abort() const {
+        return CANMAT_ERR_ABORT == req_.status ? req_.resp.data.u32 : 0;
+    }
+
+    canmat_dispatch &d_;
+    bool is_ul_;
+    canmat_sdo_req req_;
+    std::coroutine_handle<> h_;
+
+private:
+    static void done( canmat_sdo_req *req ) {
+        static_cast<sdo_awaiter*>(req->cx)->h_.resume();
+    }
+};
+
+template<typename T>
+class sdo_ul_awaiter : public sdo_awaiter {
+public:
+    using sdo_awaiter::sdo_awaiter;
+
+    result<T> await_resume() {
+        result<T> r = {};
+        r.status = req_.status;
+        r.abort = abort();
+        // all union members start at the same address
+        if( CANMAT_OK == r.status ) std::memcpy( &r.value, &req_.resp.data, sizeof(r.value) );
+        return r;
+    }
+};
+
+class sdo_dl_awaiter : public sdo_awaiter {
+public:
+    template<typename T>
+    sdo_dl_awaiter( canmat_dispatch &d, uint8_t node, uint16_t index, uint8_t subindex,
+                    enum canmat_data_type data_type, T val )
+        : sdo_awaiter( d, false, node, index, subindex, data_type ) {
+        std::memcpy( &req_.msg.data, &val, sizeof(val) );
+    }
+
+    result<void> await_resume() {
+        result<void> r = {};
+        r.status = req_.status;
+        r.abort = abort();
+        return r;
+    }
+};
+
+} // namespace detail
+
+/** Upload object Obj from node */
+template<typename Obj>
+detail::sdo_ul_awaiter<typename Obj::type> sdo_ul( canmat_dispatch &d, uint8_t node ) {
+    return { d, true, node, Obj::index, Obj::subindex, Obj::data };
+}
+
+/** Upload a dictionary object from node */
+inline detail::sdo_ul_awaiter<canmat_scalar_t>
+sdo_ul( canmat_dispatch &d, uint8_t node, const canmat_obj_t *obj ) {
+    return { d, true, node, obj->index, obj->subindex, obj->data_type };
+}
+
+/** Download val to object Obj on node */
+template<typename Obj, typename V>
+detail::sdo_dl_awaiter sdo_dl( canmat_dispatch &d, uint8_t node, V val ) {
+    static_assert( detail::non_narrowing<typename Obj::type, V>::value,
+                   "value does not fit the object's data type" );
+    return { d, node, Obj::index, Obj::subindex, Obj::data, typename Obj::type(val) };
+}
+
+/** Download val to a dictionary object on node */
+inline detail::sdo_dl_awaiter
+sdo_dl( canmat_dispatch &d, uint8_t node, const canmat_obj_t *obj, canmat_scalar_t val ) {
+    return { d, node, obj->index, obj->subindex, obj->data_type, val };
+}
+
+/** Coroutine form of canmat_pdo_remap().  objs must outlive the task. */
+inline task<canmat_status_t>
+pdo_remap( canmat_dispatch &d, uint8_t node, uint8_t pdo, enum canmat_direction dir,
+           int transmission_type, int inhibit_time, int event_timer,
+           uint8_t cnt, const canmat_obj_t *const objs[], uint32_t *err ) {
+    if( transmission_type > 0xFF || inhibit_time > 0xFFFF || event_timer > 0xFFFF ) {
+        co_return CANMAT_ERR_PARAM;
+    }
+    uint16_t idx_com, idx_map;
+    if( CANMAT_DL == dir ) {
+        idx_com = (uint16_t)( CANMAT_RPDO_COM_BASE + pdo );
+        idx_map = (uint16_t)( CANMAT_RPDO_MAP_BASE + pdo );
+    } else if( CANMAT_UL == dir ) {
+        idx_com = (uint16_t)( CANMAT_TPDO_COM_BASE + pdo );
+        idx_map = (uint16_t)( CANMAT_TPDO_MAP_BASE + pdo );
+    } else {
+        co_return CANMAT_ERR_PARAM;
+    }
+
+    result<void> r = {};
+#define CANMAT_CO_DL( IDX, SUB, T, VAL )                                \
+    r = co_await detail::sdo_dl_awaiter( d, node, IDX, SUB, CANMAT_DATA_TYPE_##T, \
+                                         (CANMAT_##T)(VAL) );            \
+    if( !r ) { if( err ) *err = r.abort; co_return r.status; }
+
+    auto comm = co_await detail::sdo_ul_awaiter<uint32_t>( d, true, node, idx_com, 1,
+                                                          CANMAT_DATA_TYPE_UNSIGNED32 );
+    if( !comm ) { if( err ) *err = comm.abort; co_return comm.status; }
+
+    // invalidate, clear, map, set options, then count and validate
+    if( 0 == (comm.value & CANMAT_COBID_PDO_MASK_VALID) ) {
+        CANMAT_CO_DL( idx_com, 1, UNSIGNED32, comm.value | CANMAT_COBID_PDO_MASK_VALID );
+    }
+    CANMAT_CO_DL( idx_map, 0, UNSIGNED8, 0 );
+    for( uint8_t i = 1; i <= cnt; i++ ) {
+        const canmat_obj_t *obj = objs[i-1];
+        int objsize = canmat_obj_bitsize( obj );
+        if( objsize < 1 || 0 != objsize % 8 ) co_return CANMAT_ERR_PARAM;
+        CANMAT_CO_DL( idx_map, i, UNSIGNED32,
+                      ( (uint32_t)obj->index << 16) | ((uint32_t)obj->subindex << 8) |
+                      (uint32_t)(objsize & 0xFF) );
+    }
+    if( transmission_type >= 0 ) { CANMAT_CO_DL( idx_com, 2, UNSIGNED8, transmission_type ); }
+    if( inhibit_time >= 0 )      { CANMAT_CO_DL( idx_com, 3, UNSIGNED16, inhibit_time ); }
+    if( event_timer >= 0 )       { CANMAT_CO_DL( idx_com, 5, UNSIGNED16, event_timer ); }
+    CANMAT_CO_DL( idx_map, 0, UNSIGNED8, cnt );
+    CANMAT_CO_DL( idx_com, 1, UNSIGNED32, comm.value & ~(uint32_t)CANMAT_COBID_PDO_MASK_VALID );
+#undef CANMAT_CO_DL
+
+    co_return CANMAT_OK;
+}
+
+/** Map the objects of Pdo, a socanmatic::pdo<>, into node's PDO */
+template<typename Pdo>
+task<canmat_status_t>
+pdo_remap( canmat_dispatch &d, uint8_t node, uint8_t pdo, enum canmat_direction dir,
+           int transmission_type, int inhibit_time, int event_timer, uint32_t *err ) {
+    const auto obj = Pdo::c_objs();
+    const canmat_obj_t *objs[Pdo::count];
+    for( size_t i = 0; i < Pdo::count; i++ ) objs[i] = &obj[i];
+    co_return co_await pdo_remap( d, node, pdo, dir, transmission_type, inhibit_time,
+                                  event_timer, (uint8_t)Pdo::count, objs, err );
+}
+
+/** Step the dispatcher until every task is done.
+ *
+ * \return CANMAT_OK, the interface error, or CANMAT_ERR_PARAM if
+ * tasks wait on something other than the dispatcher
+ */
+template<typename Tasks>
+canmat_status_t run( canmat_dispatch &d, Tasks &tasks ) {
+    for( ;; ) {
+        bool done = true;
+        for( auto &t : tasks ) done = done && t.done();
+        if( done ) return CANMAT_OK;
+        if( 0 == d.pending ) return CANMAT_ERR_PARAM;
+        canmat_status_t r = canmat_dispatch_step( &d );
+        if( CANMAT_OK != r ) return r;
+    }
+}
+
+} // namespace socanmatic
+
+#endif //SOCANMATIC_CORO_HPP
+
+
+/* Local Variables:                          */
+/* mode: c++                                 */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -103,11 +103,75 @@ typedef struct canmat_obj {
     struct canmat_code_descriptor *mask_descriptor;
 } canmat_obj_t;
 
+/** Minimal perfect hash from (index, subindex) to object position.
+ *
+ * A key hashes (seed 0) to a bucket, and the bucket's seed hashes
+ * its keys to distinct slots.  Lookup is two table loads and one
+ * compare.  Generated by canmatc or built by canmat_dict_hash_build().
+ */
+typedef struct canmat_dict_hash {
+    uint32_t bucket_mask;     ///< number of buckets - 1
+    uint32_t slot_mask;       ///< number of slots - 1
+    const uint32_t *seed;     ///< seed for each bucket
+    const uint32_t *slot;     ///< object position for each slot, empty slots are 0
+} canmat_dict_hash_t;
+
+/** Hash key for perfect hash tables */
+static inline uint32_t canmat_dict_hash( uint32_t key, uint32_t seed ) {
+    uint32_t h = key ^ seed;
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return h;
+}
+
+/** Position of key in a perfect hash table.
+ *
+ * Only meaningful if key is in the table.  Callers must compare.
+ */
+static inline uint32_t canmat_dict_hash_lookup( const struct canmat_dict_hash *h, uint32_t key ) {
+    uint32_t seed = h->seed[ canmat_dict_hash(key, 0) & h->bucket_mask ];
+    return h->slot[ canmat_dict_hash(key, seed) & h->slot_mask ];
+}
+
+/** Key for object lookup by index and subindex */
+#define CANMAT_DICT_INDEX_KEY( index, subindex ) ( ((uint32_t)(index) << 8) | (uint32_t)(subindex) )
+
 typedef struct canmat_dict_name_tree {
     const char *parameter_name;
     size_t i;
 } canmat_dict_name_tree_t ;
 
+/** Case-folded FNV-1a hash of an object name */
+static inline uint32_t canmat_dict_name_hash( const char *name ) {
+    uint32_t h = 0x811c9dc5U;
+    for( const unsigned char *p = (const unsigned char*)name; *p; p++ ) {
+        unsigned char c = *p;
+        if( c >= 'a' && c <= 'z' ) c = (unsigned char)(c - 'a' + 'A');
+        h = (h ^ c) * 0x01000193U;
+    }
+    return h;
+}
+
+/** Slot in the name hash table */
+typedef struct canmat_dict_name_slot {
+    uint32_t hash;    ///< canmat_dict_name_hash() of the name
+    uint32_t i;       ///< object position + 1, 0 for an empty slot
+} canmat_dict_name_slot_t;
+
+/** Open addressed hash of object names.
+ *
+ * Linear probing from hash & mask; at most half full, so a probe
+ * always ends at an empty slot.  Names are only compared when the
+ * hashes match.
+ */
+typedef struct canmat_dict_name_hash {
+    uint32_t mask;                              ///< number of slots - 1
+    const struct canmat_dict_name_slot *slot;
+} canmat_dict_name_hash_t;
+
 /** Description of a CiA Dictionary */
 typedef struct canmat_dict {
     size_t length;
@@ -118,6 +182,12 @@ typedef struct canmat_dict {
      * sorted in ascending order by index
      */
     struct canmat_obj *obj;
+
+    /** Hash of index and subindex, or NULL to use binary search */
+    const struct canmat_dict_hash *index_hash;
+
+    /** Hash of names, or NULL to use binary search */
+    const struct canmat_dict_name_hash *name_hash;
 } canmat_dict_t;
 
 typedef union canmat_scalar {
@@ -64,6 +64,31 @@ canmat_obj_t *canmat_dict_search_name( const struct canmat_dict *dict, const cha
 canmat_obj_t *canmat_dict_search_index (
     const struct canmat_dict *dict, uint16_t idx, uint8_t subindex );
 
+/** Build perfect hash over keys, CANMAT_DICT_INDEX_KEY for object lookup.
+ *
+ * Keys must be distinct.  Returns NULL on failure.  Free the result
+ * with free().
+ */
+struct canmat_dict_hash *canmat_dict_hash_build( const uint32_t *keys, size_t n );
+
+/** Where canmat_dict_load_eds() failed */
+struct canmat_eds_error {
+    const char *file;   ///< file that failed, NULL if none
+    unsigned line;      ///< line in file, 0 if not at a line
+};
+
+/** Load EDS or DCF files into a dictionary.
+ *
+ * Reads the same sections as canmatc.  Files are layers: keys of an
+ * object in a later file replace the same keys from earlier files.
+ * The dictionary, with its names, descriptors, and hash tables, is
+ * one allocation; free it with free().
+ *
+ * @param err If not NULL, set to the location of a failure
+ */
+canmat_status_t canmat_dict_load_eds( size_t n_files, const char *const *files,
+                                      struct canmat_dict **dict, struct canmat_eds_error *err );
+
 /* canmat_status_t canmat_dict_ul ( */
 /*     canmat_iface_t *cif, const struct canmat_dict *dict, */
 /*     uint8_t node, const char *name, */
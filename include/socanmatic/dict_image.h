@@ -0,0 +1,174 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SOCANMATIC_DICT_IMAGE_H
+#define SOCANMATIC_DICT_IMAGE_H
+
+/**
+ * \file dict_image.h
+ *
+ * \brief Binary dictionary images used in place.
+ *
+ * An image holds a dictionary with offsets instead of pointers, so a
+ * file can be mapped read-only and shared by every process that uses
+ * it.  Opening an image checks its bounds but allocates and parses
+ * nothing.  Images are written by `canmatc --binary' or by
+ * canmat_dict_image_build().
+ *
+ * All fields are little-endian.  Offsets are from the start of the
+ * image, and string references are offsets into the string pool,
+ * where 0 is the empty string.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CANMAT_DICT_IMAGE_MAGIC "CANMATDI"
+#define CANMAT_DICT_IMAGE_VERSION 1
+
+/** Image header, at offset 0 */
+struct canmat_dict_image_header {
+    char magic[8];                  ///< CANMAT_DICT_IMAGE_MAGIC, not terminated
+    uint32_t version;               ///< CANMAT_DICT_IMAGE_VERSION
+    uint32_t size;                  ///< bytes in the image
+    uint32_t n_obj;                 ///< number of objects
+    uint32_t obj;                   ///< offset of objects, in index order
+    uint32_t n_desc;                ///< number of code descriptors
+    uint32_t desc;                  ///< offset of code descriptors
+    uint32_t index_bucket_mask;     ///< index hash buckets - 1
+    uint32_t index_slot_mask;       ///< index hash slots - 1
+    uint32_t index_seed;            ///< offset of index hash seeds
+    uint32_t index_slot;            ///< offset of index hash slots
+    uint32_t name_mask;             ///< name hash slots - 1
+    uint32_t name_slot;             ///< offset of name hash slots, as canmat_dict_name_slot_t
+    uint32_t str;                   ///< offset of string pool
+    uint32_t str_size;              ///< bytes in string pool
+};
+
+/** Object in an image */
+struct canmat_dict_image_obj {
+    uint16_t index;
+    uint8_t subindex;
+    uint8_t sub_number;
+    uint8_t access_type;            ///< enum canmat_access_type
+    uint8_t object_type;            ///< enum canmat_object_type
+    uint8_t pdo_mapping;
+    uint8_t reserved;
+    uint32_t data_type;             ///< enum canmat_data_type
+    uint32_t name;                  ///< string
+    uint32_t mask_desc;             ///< first mask descriptor + 1, or 0
+    uint32_t value_desc;            ///< first value descriptor + 1, or 0
+};
+
+/** Code descriptor in an image, a list ends at name 0 */
+struct canmat_dict_image_desc {
+    uint32_t name;                  ///< string
+    uint32_t description;           ///< string
+    int32_t value;
+};
+
+/** An image in memory */
+typedef struct canmat_dict_image {
+    const uint8_t *base;
+    size_t size;
+    int mapped;                     ///< base was mapped by canmat_dict_image_open()
+    const struct canmat_dict_image_header *hdr;
+    const struct canmat_dict_image_obj *obj;
+    const struct canmat_dict_image_desc *desc;
+    const char *str;
+    struct canmat_dict_hash index_hash;
+    struct canmat_dict_name_hash name_hash;
+} canmat_dict_image_t;
+
+/** Use the image in buf, which must stay valid.  Checks the header
+ *  and all offsets. */
+canmat_status_t canmat_dict_image_init( canmat_dict_image_t *img, const void *buf, size_t size );
+
+/** Map an image file read-only */
+canmat_status_t canmat_dict_image_open( canmat_dict_image_t *img, const char *filename );
+
+/** Unmap an image from canmat_dict_image_open() */
+void canmat_dict_image_close( canmat_dict_image_t *img );
+
+/** Serialize dict into an image.  Free *buf with free(). */
+canmat_status_t canmat_dict_image_build( const struct canmat_dict *dict, void **buf, size_t *size );
+
+/** Return the object with given index and subindex, or NULL */
+const struct canmat_dict_image_obj *canmat_dict_image_search_index (
+    const canmat_dict_image_t *img, uint16_t idx, uint8_t subindex );
+
+/** Return the object with given name, or NULL */
+const struct canmat_dict_image_obj *canmat_dict_image_search_name (
+    const canmat_dict_image_t *img, const char *name );
+
+/** Fill obj from o for use with canmat_obj_ul() and friends.
+ *  Names point into the image; descriptors are not filled. */
+void canmat_dict_image_get_obj( const canmat_dict_image_t *img,
+                                const struct canmat_dict_image_obj *o, canmat_obj_t *obj );
+
+/** String at ref */
+static inline const char *canmat_dict_image_str( const canmat_dict_image_t *img, uint32_t ref ) {
+    return img->str + ref;
+}
+
+/** Descriptor list at ref, or NULL */
+static inline const struct canmat_dict_image_desc *
+canmat_dict_image_desc( const canmat_dict_image_t *img, uint32_t ref ) {
+    return ref ? img->desc + ref - 1 : NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_DICT_IMAGE_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
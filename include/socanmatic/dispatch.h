@@ -0,0 +1,143 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SOCANMATIC_DISPATCH_H
+#define SOCANMATIC_DISPATCH_H
+
+/**
+ * \file dispatch.h
+ *
+ * \brief Non-blocking SDO requests routed by a frame dispatcher.
+ *
+ * The blocking canmat_sdo_ul() and canmat_sdo_dl() wait for each
+ * response in turn.  A dispatcher instead sends a request and returns
+ * at once; when the response frame is passed to
+ * canmat_dispatch_frame(), the request's callback runs.  Requests to
+ * different nodes are outstanding together, and requests to the same
+ * node are queued and sent in order.
+ *
+ * Requests are owned by the caller and linked into the queue, so the
+ * dispatcher never allocates.  A request must stay valid until its
+ * callback has run.  The dispatcher is not thread-safe; use it from
+ * one thread.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct canmat_sdo_req;
+
+/** Called when a request completes, from canmat_dispatch_frame() */
+typedef void canmat_sdo_req_fun( struct canmat_sdo_req *req );
+
+/** An SDO request */
+struct canmat_sdo_req {
+    canmat_sdo_msg_t msg;         ///< the request
+    canmat_sdo_msg_t resp;        ///< the response, once done
+    canmat_status_t status;       ///< result, CANMAT_ERR_ABORT with code in resp.data.u32
+    canmat_sdo_req_fun *done;     ///< completion callback
+    void *cx;                     ///< for the callback
+    struct canmat_sdo_req *next;  ///< queue link
+};
+
+/** Routes frames from one interface to pending requests */
+struct canmat_dispatch {
+    canmat_iface_t *cif;
+    struct canmat_sdo_req *head[CANMAT_NODE_MASK+1];   ///< request in flight, per node
+    struct canmat_sdo_req *tail[CANMAT_NODE_MASK+1];   ///< last queued, per node
+    size_t pending;                                    ///< queued requests, all nodes
+
+    /** Called for frames that complete no request, may be NULL */
+    void (*recv)( void *cx, const struct can_frame *can );
+    void *recv_cx;
+};
+
+/** Initialize dispatcher on cif with nothing pending */
+void canmat_dispatch_init( struct canmat_dispatch *d, canmat_iface_t *cif );
+
+/** Queue an SDO upload of req->msg.
+ *
+ * Sends now if no other request to the node is in flight.  On error,
+ * req is not queued and its callback will not run.
+ */
+canmat_status_t canmat_dispatch_sdo_ul( struct canmat_dispatch *d, struct canmat_sdo_req *req );
+
+/** Queue an SDO download of req->msg, see canmat_dispatch_sdo_ul() */
+canmat_status_t canmat_dispatch_sdo_dl( struct canmat_dispatch *d, struct canmat_sdo_req *req );
+
+/** Route a received frame.
+ *
+ * Completes the request in flight when can is its response, then
+ * sends the next request to that node before running the callback,
+ * so the callback may queue more requests.  Other frames go to
+ * d->recv.
+ *
+ * \return 1 if can completed a request, 0 otherwise
+ */
+int canmat_dispatch_frame( struct canmat_dispatch *d, const struct can_frame *can );
+
+/** Complete every queued request with status, e.g. at a deadline.
+ *
+ * Requests in flight are forgotten, so late responses go to d->recv.
+ * Callbacks run after all queues are empty.
+ */
+void canmat_dispatch_cancel( struct canmat_dispatch *d, canmat_status_t status );
+
+/** Receive one frame from d->cif and route it */
+canmat_status_t canmat_dispatch_step( struct canmat_dispatch *d );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_DISPATCH_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
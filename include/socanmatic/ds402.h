@@ -167,13 +167,17 @@ struct canmat_402_drive {
 
     double pos_factor;
     double vel_factor;
-    double cur_factor;
+    double cur_factor;         ///< raw current (6078h) per ampere
+    double torque_factor;      ///< raw torque (6071h, 6077h) per newton-meter
 
     int32_t actual_pos_raw;
     int32_t actual_vel_raw;
     int32_t actual_cur_raw;
 
-    int16_t target_vel_raw;
+    int16_t target_vel_raw;    ///< vl target velocity (6042h)
+    int32_t target_pos_raw;    ///< csp target position (607Ah)
+    int32_t target_cs_vel_raw; ///< csv target velocity (60FFh)
+    int16_t target_torque_raw; ///< tq/cst target torque (6071h)
 
     double pos_max_soft;
     double pos_min_soft;
@@ -212,6 +216,23 @@ enum canmat_status canmat_402_stop( struct canmat_iface *cif, struct canmat_402_
 enum canmat_status canmat_402_dl_ctrlmask( struct canmat_iface *cif, struct canmat_402_drive *drive ,
                                            uint16_t mask_and, uint16_t mask_or );
 
+/** Return true if op_mode is one of the cyclic synchronous modes.
+ *
+ * In these modes, the target RPDO is latched by the drive on each
+ * SYNC, so the master must produce SYNC at a fixed period.
+ */
+static inline int canmat_402_op_mode_is_cyclic( enum canmat_402_op_mode op_mode ) {
+    return ( CANMAT_402_OP_MODE_CYCLIC_SYNC_POSITION == op_mode ||
+             CANMAT_402_OP_MODE_CYCLIC_SYNC_VELOCITY == op_mode ||
+             CANMAT_402_OP_MODE_CYCLIC_SYNC_TORQUE == op_mode );
+}
+
+/** Return true if op_mode takes a torque reference (6071h) */
+static inline int canmat_402_op_mode_is_torque( enum canmat_402_op_mode op_mode ) {
+    return ( CANMAT_402_OP_MODE_TORQUE == op_mode ||
+             CANMAT_402_OP_MODE_CYCLIC_SYNC_TORQUE == op_mode );
+}
+
 ///< set op mode and configure RPDO to receive
 enum canmat_status canmat_402_set_op_mode( struct canmat_iface *cif, struct canmat_402_drive *drive,
                                            enum canmat_402_op_mode op_mode );
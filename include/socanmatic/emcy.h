@@ -74,6 +74,9 @@ typedef enum canmat_emcy_class {
     CANMAT_EMCY_CODE_DEVICE_SPECIFIC     = 0xFF00
 } canmat_emcy_class_t;
 
+/// COB-ID of EMCY messages from node
+#define CANMAT_EMCY_COBID(node) ((canid_t)( ((node)&CANMAT_NODE_MASK) | CANMAT_FUNC_CODE_SYNC_EMCY))
+
 static inline uint16_t canmat_frame_emcy_get_eec( const struct can_frame *frame ) {
     return canmat_byte_ldle16( frame->data );
 }
@@ -82,6 +85,98 @@ static inline uint8_t canmat_frame_emcy_get_er( const struct can_frame *frame )
     return frame->data[2];
 }
 
+/** True if code is in class.
+ *
+ * Classes with zero low 12 bits match on the first digit, those with
+ * zero low 8 bits on the first two, others exactly.
+ */
+static inline int canmat_emcy_class_match( canmat_emcy_class_t cls, uint16_t code ) {
+    uint16_t c = (uint16_t)cls;
+    uint16_t mask = (c & 0x0FFF) ? ((c & 0x00FF) ? 0xFFFF : 0xFF00) : 0xF000;
+    return (code & mask) == c;
+}
+
+/*****************/
+/* EMCY Consumer */
+/*****************/
+
+/// EMCY messages kept per node, a power of two
+#define CANMAT_EMCY_HIST 16
+
+/// Most subscriptions
+#define CANMAT_EMCY_SUB_MAX 16
+
+/// Subscribe to every class
+#define CANMAT_EMCY_CLASS_ANY ((canmat_emcy_class_t)-1)
+
+/** A received EMCY message */
+struct canmat_emcy_entry {
+    int64_t time;                 ///< receive time, ns
+    uint16_t code;                ///< emergency error code
+    uint8_t reg;                  ///< error register, 1001h
+    uint8_t msef[5];              ///< manufacturer-specific error field
+};
+
+/** Message history of one node.
+ *
+ * There is one writer.  begin and end count messages whose write
+ * started and finished; readers check begin after copying to detect
+ * entries overwritten meanwhile.
+ */
+struct canmat_emcy_ring {
+    uint64_t begin;
+    uint64_t end;
+    struct canmat_emcy_entry entry[CANMAT_EMCY_HIST];
+};
+
+/** Called for each EMCY message matching a subscription */
+typedef void canmat_emcy_fun( void *cx, uint8_t node, const struct canmat_emcy_entry *entry );
+
+/** EMCY consumer for one network */
+struct canmat_emcy {
+    struct canmat_emcy_ring ring[CANMAT_NODE_MASK+1];
+    struct {
+        canmat_emcy_fun *fun;     ///< NULL if free
+        void *cx;
+        uint8_t node;             ///< 0 for all nodes
+        canmat_emcy_class_t cls;
+    } sub[CANMAT_EMCY_SUB_MAX];
+};
+
+/** Initialize with empty histories and no subscriptions */
+void canmat_emcy_init( struct canmat_emcy *e );
+
+/** Call fun for EMCY messages of node (0 for all) in class.
+ *
+ * \return subscription handle, or CANMAT_ERR_OVERFLOW if there are
+ * too many subscriptions
+ */
+int canmat_emcy_subscribe( struct canmat_emcy *e, uint8_t node, canmat_emcy_class_t cls,
+                           canmat_emcy_fun *fun, void *cx );
+
+/** Remove a subscription */
+void canmat_emcy_unsubscribe( struct canmat_emcy *e, int handle );
+
+/** Record an EMCY message and notify subscribers.
+ *
+ * \return 1 if can was an EMCY message, 0 otherwise
+ */
+int canmat_emcy_frame( struct canmat_emcy *e, const struct can_frame *can, int64_t now );
+
+/** Dispatcher recv hook, cx is a struct canmat_emcy, times from CLOCK_MONOTONIC */
+void canmat_emcy_recv( void *cx, const struct can_frame *can );
+
+/** Copy messages of node from sequence number *seq on, oldest first.
+ *
+ * May run concurrently with the writer.  Messages already
+ * overwritten are skipped.  *seq is advanced past what was read; pass
+ * it back to read only newer messages.
+ *
+ * \return number of entries copied to out, at most n
+ */
+size_t canmat_emcy_read( const struct canmat_emcy *e, uint8_t node, uint64_t *seq,
+                         struct canmat_emcy_entry *out, size_t n );
+
 
 
 #ifdef __cplusplus
@@ -0,0 +1,148 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOCANMATIC_FANOUT_H
+#define SOCANMATIC_FANOUT_H
+
+/**
+ * \file fanout.h
+ *
+ * \brief Write parameter lists to many nodes at once.
+ *
+ * A fan-out writes each node's parameter list in order with its own
+ * step-driven SDO client.  Each node always has one transfer in
+ * flight, so configuring many nodes takes about as long as the
+ * slowest node rather than the sum over nodes.  A parameter list is a
+ * concise DCF; nodes that get the same configuration may share one.
+ *
+ * A node stops at its first failure, which is kept with its abort
+ * code.  The fan-out counts the bits of every frame it sends and
+ * consumes, so canmat_fanout_load() gives the share of the bus it
+ * used.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** One node of a fan-out */
+struct canmat_fanout_node {
+    struct canmat_sdo_client client;
+    const struct canmat_cdcf *param;  ///< entries to write
+    size_t pos;                       ///< offset of the next entry in param
+    uint32_t written;                 ///< entries written
+    canmat_status_t status;           ///< CANMAT_OK, or the failure that stopped the node
+    uint32_t abort;                   ///< abort code of the failure
+    int64_t end;                      ///< when the node finished
+};
+
+/** Fan-out over nodes on one interface */
+struct canmat_fanout {
+    struct canmat_fanout_node *node;
+    size_t n;
+    canmat_sdo_client_send_fun *send;
+    void *send_cx;
+    int64_t start;                    ///< when the fan-out started
+    int64_t end;                      ///< when the last node finished
+    uint64_t frames;                  ///< frames sent and consumed
+    uint64_t bits;                    ///< bus bits of those frames
+    uint8_t slot[CANMAT_NODE_MASK+1]; ///< position + 1 of each node-ID, 0 if absent
+};
+
+/** Initialize fan-out over n nodes, sending through send.
+ *
+ * Each node[i] needs its client node-ID and param set with
+ * canmat_fanout_node_set() before canmat_fanout_start().
+ */
+void canmat_fanout_init( struct canmat_fanout *f, struct canmat_fanout_node *node, size_t n,
+                         canmat_sdo_client_send_fun *send, void *send_cx );
+
+/** Set the node-ID and parameters of node i */
+void canmat_fanout_node_set( struct canmat_fanout *f, size_t i, uint8_t node_id,
+                             const struct canmat_cdcf *param );
+
+/** Start the first transfer of every node.
+ *
+ * Nodes that cannot start finish at once with the error.
+ */
+void canmat_fanout_start( struct canmat_fanout *f, int64_t now );
+
+/** Advance the node the frame is for.
+ *
+ * \return 1 if can was for a node of f, 0 otherwise
+ */
+int canmat_fanout_frame( struct canmat_fanout *f, const struct can_frame *can, int64_t now );
+
+/** Handle passed deadlines */
+void canmat_fanout_timeout( struct canmat_fanout *f, int64_t now );
+
+/** Number of nodes still writing */
+size_t canmat_fanout_busy( const struct canmat_fanout *f );
+
+/** When canmat_fanout_timeout() must next be called, INT64_MAX if idle */
+int64_t canmat_fanout_deadline( const struct canmat_fanout *f );
+
+/** Start f and run it on cif until all nodes finish.
+ *
+ * f must send on cif.  Returns an interface error, or CANMAT_OK with
+ * each node's result in its status.
+ */
+canmat_status_t canmat_fanout_run( struct canmat_fanout *f, canmat_iface_t *cif );
+
+/** Share of a bus of kbps that the fan-out used from start to end */
+double canmat_fanout_load( const struct canmat_fanout *f, unsigned kbps );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_FANOUT_H
+
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -0,0 +1,194 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOCANMATIC_FLASH_H
+#define SOCANMATIC_FLASH_H
+
+/**
+ * \file flash.h
+ *
+ * \brief Program download, CiA 302-3.
+ *
+ * A flash job stops the node's program and clears it through program
+ * control (1F51h).  It then block-downloads the image to program data
+ * (1F50h) and polls flash status (1F57h) until the node has finished
+ * programming.  Finally it starts the new program.  A node that lacks
+ * stop, clear, or flash status skips those steps.
+ *
+ * The image is sent from the caller's buffer, which may be a mapped
+ * file, without a copy.  Each node has its own SDO channel, so
+ * canmat_flash_run() flashes several nodes at once.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CANMAT_FLASH_DATA    0x1F50    ///< program data, a DOMAIN per program
+#define CANMAT_FLASH_CONTROL 0x1F51    ///< program control, UNSIGNED8 per program
+#define CANMAT_FLASH_STATUS  0x1F57    ///< flash status, UNSIGNED32 per program
+
+/** Commands to program control */
+enum canmat_flash_control {
+    CANMAT_FLASH_CONTROL_STOP  = 0,
+    CANMAT_FLASH_CONTROL_START = 1,
+    CANMAT_FLASH_CONTROL_RESET = 2,
+    CANMAT_FLASH_CONTROL_CLEAR = 3
+};
+
+/// Flash status bit set while the node programs
+#define CANMAT_FLASH_STATUS_BUSY 0x01
+/// Error code in flash status, 0 if none
+#define CANMAT_FLASH_STATUS_ERROR(s) ( ((s) >> 1) & 0x7F )
+
+/// Frames a job can queue for canmat_flash_run(), two blocks' worth
+#define CANMAT_FLASH_TXQ 256
+
+/// Time between flash status reads while the node programs
+#define CANMAT_FLASH_POLL_NS 10000000LL
+/// Longest time the node may program after the download
+#define CANMAT_FLASH_BUSY_NS 60000000000LL
+
+enum canmat_flash_state {
+    CANMAT_FLASH_IDLE = 0,         ///< no job
+    CANMAT_FLASH_STOP,             ///< stopping the program
+    CANMAT_FLASH_CLEAR,            ///< clearing the program
+    CANMAT_FLASH_DOWNLOAD,         ///< sending the image
+    CANMAT_FLASH_CHECK,            ///< reading flash status
+    CANMAT_FLASH_WAIT,             ///< waiting to read flash status again
+    CANMAT_FLASH_START             ///< starting the new program
+};
+
+/** Program download to one node */
+struct canmat_flash {
+    struct canmat_sdo_client client;
+    uint8_t program;               ///< subindex of the program, usually 1
+    const uint8_t *image;
+    size_t size;
+    size_t sent;                   ///< bytes of image acknowledged
+
+    enum canmat_flash_state state;
+    canmat_status_t status;        ///< result, CANMAT_ERR_DEV with flash_status on flash errors
+    uint32_t abort;                ///< abort code of a failed transfer
+    uint32_t flash_status;         ///< last value read from 1F57h
+
+    int64_t start;                 ///< when the job started
+    int64_t download_start;        ///< when the image download started
+    int64_t download_end;          ///< when the node acknowledged the image
+    int64_t end;                   ///< when the job finished
+    int64_t poll;                  ///< next flash status read
+    uint8_t cmd;                   ///< data of the program control write
+    uint8_t buf[4];                ///< flash status
+
+    struct can_frame txq[CANMAT_FLASH_TXQ]; ///< frames from canmat_flash_queue()
+    uint16_t tx_head;              ///< next queued frame to send
+    uint16_t tx_n;                 ///< frames queued
+};
+
+/** Initialize job for program of node, sending frames through send */
+void canmat_flash_init( struct canmat_flash *f, uint8_t node, uint8_t program,
+                        canmat_sdo_client_send_fun *send, void *send_cx );
+
+/** Start flashing size bytes of image, which must stay valid until done */
+canmat_status_t canmat_flash_start( struct canmat_flash *f, const void *image, size_t size, int64_t now );
+
+/** Advance the job with a received frame.
+ *
+ * \return 1 if can was for this job, 0 otherwise
+ */
+int canmat_flash_frame( struct canmat_flash *f, const struct can_frame *can, int64_t now );
+
+/** Handle a passed deadline */
+void canmat_flash_timeout( struct canmat_flash *f, int64_t now );
+
+/** When canmat_flash_timeout() must next be called */
+int64_t canmat_flash_deadline( const struct canmat_flash *f );
+
+/** Is the job running? */
+static inline int canmat_flash_busy( const struct canmat_flash *f ) {
+    return CANMAT_FLASH_IDLE != f->state;
+}
+
+/** Bytes of the image sent so far */
+static inline size_t canmat_flash_sent( const struct canmat_flash *f ) {
+    return CANMAT_FLASH_DOWNLOAD == f->state ? f->client.pos : f->sent;
+}
+
+/** Called by canmat_flash_run() after each frame or deadline */
+typedef void canmat_flash_progress_fun( void *cx, const struct canmat_flash *f, size_t n );
+
+/** Run started jobs on cif until all finish.
+ *
+ * Jobs must send on cif, or through canmat_flash_queue().  Returns an
+ * interface error, or CANMAT_OK with each job's result in its status.
+ *
+ * \param progress may be NULL
+ */
+canmat_status_t canmat_flash_run( canmat_iface_t *cif, struct canmat_flash *f, size_t n,
+                                  canmat_flash_progress_fun *progress, void *cx );
+
+/** Queue a frame for canmat_flash_run() to send, cx is the job.
+ *
+ * A block download sends up to 127 frames at once, more than the
+ * default socketcan queue holds.  Jobs sending through this never
+ * wait on the interface, canmat_flash_run() sends the queued frames
+ * as the transmit queue drains and keeps serving the other nodes.
+ * The job's SDO timeout then runs from when each frame is sent.
+ * CANMAT_ERR_OVERFLOW if the job's queue is full.
+ */
+canmat_status_t canmat_flash_queue( void *cx, const struct can_frame *can );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_FLASH_H
+
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -0,0 +1,112 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SOCANMATIC_HIST_H
+#define SOCANMATIC_HIST_H
+
+/**
+ * \file hist.h
+ *
+ * \brief Fixed-size latency histograms for cyclic loops.
+ *
+ * Histograms are plain structs with no allocation, so they can live
+ * in locked memory and be updated from a real-time thread.  Each
+ * histogram has a single writer; readers should copy it first if
+ * the writer may be running.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Number of buckets.  The last bucket also counts overflow.
+#define CANMAT_HIST_NBUCKET 256
+
+/** A latency histogram with linear buckets */
+struct canmat_hist {
+    int64_t bucket_ns;                      ///< width of each bucket
+    uint64_t count;                         ///< number of samples
+    int64_t min;                            ///< smallest sample
+    int64_t max;                            ///< largest sample
+    double sum;                             ///< sum of samples, for mean
+    uint64_t bucket[CANMAT_HIST_NBUCKET];   ///< sample counts
+};
+
+/** Initialize histogram with given bucket width */
+void canmat_hist_init( struct canmat_hist *h, int64_t bucket_ns );
+
+/** Add a sample to the histogram.
+ *
+ * Negative samples are counted in the first bucket.
+ */
+static inline void canmat_hist_add( struct canmat_hist *h, int64_t ns ) {
+    int64_t i = ns / h->bucket_ns;
+    if( i < 0 ) i = 0;
+    else if( i >= CANMAT_HIST_NBUCKET ) i = CANMAT_HIST_NBUCKET - 1;
+    h->bucket[i]++;
+    if( 0 == h->count || ns < h->min ) h->min = ns;
+    if( 0 == h->count || ns > h->max ) h->max = ns;
+    h->count++;
+    h->sum += (double)ns;
+}
+
+/** Upper bound of the bucket containing the q quantile, 0 <= q <= 1 */
+int64_t canmat_hist_quantile( const struct canmat_hist *h, double q );
+
+/** Print summary and non-empty buckets */
+void canmat_hist_print( FILE *f, const char *name, const struct canmat_hist *h );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_HIST_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -57,6 +57,9 @@ struct canmat_iface_vtable {
     canmat_status_t (*set_kbps)( struct canmat_iface *cif, unsigned kbps );
     canmat_status_t (*print_info)( struct canmat_iface *cif, FILE *fptr );
     const char *(*strerror)( struct canmat_iface *cif );
+    /* Optional, NULL if the interface has no transmit timestamps */
+    canmat_status_t (*tx_stamp_enable)( struct canmat_iface *cif );
+    canmat_status_t (*tx_stamp)( struct canmat_iface *cif, struct timespec *ts );
 };
 
 typedef struct canmat_iface {
@@ -100,6 +103,36 @@ static inline canmat_status_t canmat_iface_set_kpbs( struct canmat_iface *cif, u
     return cif->vtable->set_kbps(cif, kbps);
 }
 
+/** Send through cx, a struct canmat_iface, to fit the send callbacks of
+ *  step-driven services */
+static inline canmat_status_t canmat_iface_send_cx( void *cx, const struct can_frame *frame ) {
+    return canmat_iface_send( (struct canmat_iface*)cx, frame );
+}
+
+/** Bits frame takes on the bus, with worst-case bit stuffing */
+static inline unsigned canmat_frame_bits( const struct can_frame *frame ) {
+    unsigned n = (frame->can_id & CAN_RTR_FLAG) ? 0 : (frame->can_dlc > 8 ? 8 : frame->can_dlc);
+    // SOF through CRC is stuffed; CRC delimiter, ACK, EOF, and IFS are not
+    unsigned stuffed = ((frame->can_id & CAN_EFF_FLAG) ? 54 : 34) + 8*n;
+    return stuffed + (stuffed - 1) / 4 + 13;
+}
+
+/** Ask the driver to timestamp sent frames */
+static inline canmat_status_t canmat_iface_tx_stamp_enable( struct canmat_iface *cif ) {
+    return cif->vtable->tx_stamp_enable ?
+        cif->vtable->tx_stamp_enable(cif) : CANMAT_ERR_NOT_SUP;
+}
+
+/** Get the CLOCK_REALTIME time the oldest unread sent frame went out.
+ *
+ * Does not block.  Returns CANMAT_ERR_UNDERFLOW when no timestamp is
+ * queued.
+ */
+static inline canmat_status_t canmat_iface_tx_stamp( struct canmat_iface *cif, struct timespec *ts ) {
+    return cif->vtable->tx_stamp ?
+        cif->vtable->tx_stamp(cif, ts) : CANMAT_ERR_NOT_SUP;
+}
+
 const char *canmat_iface_strerror( struct canmat_iface *cif, canmat_status_t status );
 
 #ifdef __cplusplus
@@ -0,0 +1,218 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOCANMATIC_LSS_H
+#define SOCANMATIC_LSS_H
+
+/**
+ * \file lss.h
+ *
+ * \brief Layer setting services master, CiA 305.
+ *
+ * The master runs one service at a time.  Starting a service sends
+ * its request.  The caller passes received frames to
+ * canmat_lss_master_frame() and calls canmat_lss_master_timeout()
+ * when canmat_lss_master_deadline() passes, or uses
+ * canmat_lss_master_run() to do both on an interface.
+ *
+ * Fast scan finds one unconfigured slave by a binary search over its
+ * 128-bit identity: a query per bit that answers whether any slave
+ * has the bit clear.  Slaves answer in separate frames, so each query
+ * waits out its whole response window, timeout_ns, and a slave costs
+ * 133 queries and 133 windows.  The slave found is left in configuration
+ * state, ready for canmat_lss_master_node_id().  Slaves with a
+ * configured or pending node-ID do not answer fast scan, so
+ * repeating scan, node-ID, and switch global to waiting assigns a
+ * whole bus.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// COB-ID of master requests
+#define CANMAT_LSS_MASTER_ID 0x7E5
+/// COB-ID of slave responses
+#define CANMAT_LSS_SLAVE_ID  0x7E4
+
+/// Default time to wait for slave responses
+#define CANMAT_LSS_TIMEOUT_NS 20000000LL
+
+/// Node-ID of a slave without one
+#define CANMAT_LSS_NODE_UNCONFIGURED 0xFF
+
+/** LSS command specifiers */
+enum canmat_lss_cs {
+    CANMAT_LSS_SWITCH_GLOBAL        = 0x04,
+    CANMAT_LSS_CONFIG_NODE_ID       = 0x11,
+    CANMAT_LSS_CONFIG_BIT_TIMING    = 0x13,
+    CANMAT_LSS_ACTIVATE_BIT_TIMING  = 0x15,
+    CANMAT_LSS_STORE                = 0x17,
+    CANMAT_LSS_SWITCH_VENDOR        = 0x40,
+    CANMAT_LSS_SWITCH_PRODUCT       = 0x41,
+    CANMAT_LSS_SWITCH_REVISION      = 0x42,
+    CANMAT_LSS_SWITCH_SERIAL        = 0x43,
+    CANMAT_LSS_SWITCH_RESP          = 0x44,
+    CANMAT_LSS_IDENTIFY_SLAVE       = 0x4F,
+    CANMAT_LSS_FASTSCAN             = 0x51,
+    CANMAT_LSS_INQUIRE_VENDOR       = 0x5A,
+    CANMAT_LSS_INQUIRE_PRODUCT      = 0x5B,
+    CANMAT_LSS_INQUIRE_REVISION     = 0x5C,
+    CANMAT_LSS_INQUIRE_SERIAL       = 0x5D,
+    CANMAT_LSS_INQUIRE_NODE_ID      = 0x5E
+};
+
+/** LSS slave states for switch global */
+enum canmat_lss_mode {
+    CANMAT_LSS_MODE_WAITING = 0,
+    CANMAT_LSS_MODE_CONFIG  = 1
+};
+
+/** Identity, 1018h subindices 1-4 */
+enum canmat_lss_id {
+    CANMAT_LSS_ID_VENDOR = 0,
+    CANMAT_LSS_ID_PRODUCT,
+    CANMAT_LSS_ID_REVISION,
+    CANMAT_LSS_ID_SERIAL
+};
+
+enum canmat_lss_master_state {
+    CANMAT_LSS_MASTER_IDLE = 0,    ///< no service running
+    CANMAT_LSS_MASTER_WAIT,        ///< waiting on a confirmed service response
+    CANMAT_LSS_MASTER_SCAN         ///< fast scan
+};
+
+/** What a frame or timeout did to the service */
+enum canmat_lss_event {
+    CANMAT_LSS_IGNORED = 0,        ///< not for this service
+    CANMAT_LSS_PENDING,            ///< service continues
+    CANMAT_LSS_DONE                ///< service finished, see status
+};
+
+/** LSS master for one network */
+struct canmat_lss_master {
+    canmat_sdo_client_send_fun *send;
+    void *send_cx;
+    int64_t timeout_ns;            ///< time to wait for each slave response
+
+    enum canmat_lss_master_state state;
+    canmat_status_t status;        ///< result of the last service
+    uint8_t expect;                ///< response command specifier
+    uint8_t error;                 ///< error code of configure and store services
+    uint8_t spec_error;            ///< implementation error when error is 0xFF
+    uint32_t value;                ///< result of inquire services
+    uint32_t identity[4];          ///< result of fast scan, by canmat_lss_id
+    int64_t deadline;
+
+    uint8_t sub;                   ///< fast scan identity part being searched
+    int bit;                       ///< fast scan bit being checked
+    int answered;                  ///< some slave answered the fast scan query
+};
+
+/** Initialize master sending frames through send */
+void canmat_lss_master_init( struct canmat_lss_master *m, canmat_sdo_client_send_fun *send, void *send_cx );
+
+/** Switch all slaves to mode, unconfirmed */
+canmat_status_t canmat_lss_master_switch_global( struct canmat_lss_master *m, enum canmat_lss_mode mode );
+
+/** Switch the slave with identity to configuration mode */
+canmat_status_t canmat_lss_master_switch_selective( struct canmat_lss_master *m, const uint32_t identity[4],
+                                                    int64_t now );
+
+/** Set the pending node-ID of the slave in configuration mode */
+canmat_status_t canmat_lss_master_node_id( struct canmat_lss_master *m, uint8_t node, int64_t now );
+
+/** Set the pending bit rate of the slave in configuration mode, see canmat_lss_bit_timing_index() */
+canmat_status_t canmat_lss_master_bit_timing( struct canmat_lss_master *m, uint8_t index, int64_t now );
+
+/** Switch all configured slaves to their pending bit rate after delay_ms, unconfirmed */
+canmat_status_t canmat_lss_master_activate_bit_timing( struct canmat_lss_master *m, uint16_t delay_ms );
+
+/** Store the pending configuration of the slave in configuration mode */
+canmat_status_t canmat_lss_master_store( struct canmat_lss_master *m, int64_t now );
+
+/** Ask the slave in configuration mode for an identity part or node-ID, result in m->value */
+canmat_status_t canmat_lss_master_inquire( struct canmat_lss_master *m, enum canmat_lss_cs cs, int64_t now );
+
+/** Start fast scan for one unconfigured slave.
+ *
+ * Finishes with status CANMAT_ERR_TIMEOUT if no slave answers, and
+ * the identity found in m->identity otherwise.
+ */
+canmat_status_t canmat_lss_master_fastscan( struct canmat_lss_master *m, int64_t now );
+
+/** Handle a received frame */
+enum canmat_lss_event
+canmat_lss_master_frame( struct canmat_lss_master *m, const struct can_frame *can, int64_t now );
+
+/** Handle a passed deadline */
+enum canmat_lss_event
+canmat_lss_master_timeout( struct canmat_lss_master *m, int64_t now );
+
+/** Run the current service on cif until it finishes and return its status.
+ *
+ * Frames other than LSS responses are dropped.
+ */
+canmat_status_t canmat_lss_master_run( struct canmat_lss_master *m, canmat_iface_t *cif );
+
+/** CiA 305 bit timing table index for kbps, or -1 */
+int canmat_lss_bit_timing_index( unsigned kbps );
+
+/** When the next slave response is due */
+static inline int64_t canmat_lss_master_deadline( const struct canmat_lss_master *m ) {
+    return m->deadline;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_LSS_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
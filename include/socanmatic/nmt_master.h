@@ -0,0 +1,145 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOCANMATIC_NMT_MASTER_H
+#define SOCANMATIC_NMT_MASTER_H
+
+/**
+ * \file nmt_master.h
+ *
+ * \brief NMT state table and heartbeat consumer.
+ *
+ * The master decodes boot-up and heartbeat frames into the NMT
+ * state of each node and supervises the consumer heartbeat times of
+ * 1016h.  Deadlines are kept in a hashed timer wheel: a heartbeat
+ * moves its node to another slot, and each tick visits one slot, so
+ * supervising all nodes costs O(1) per frame and per tick.
+ *
+ * As in DS301, supervision of a node starts with its first
+ * heartbeat.  Times are in nanoseconds on a caller monotonic clock.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Slots in the timer wheel, a power of two
+#define CANMAT_NMT_WHEEL_SLOTS 256
+
+/// Default wheel tick
+#define CANMAT_NMT_TICK_NS 1000000LL
+
+/// State of a node not heard from
+#define CANMAT_NMT_STATE_UNKNOWN 0xFF
+
+/** What happened to a node */
+enum canmat_nmt_event {
+    CANMAT_NMT_EVENT_BOOT,       ///< boot-up message
+    CANMAT_NMT_EVENT_STATE,      ///< heartbeat with a new state
+    CANMAT_NMT_EVENT_TIMEOUT,    ///< no heartbeat within the consumer time
+    CANMAT_NMT_EVENT_RESUMED     ///< heartbeat after a timeout
+};
+
+/** Called on node events, state is a canmat_nmt_err_msg_t or CANMAT_NMT_STATE_UNKNOWN */
+typedef void canmat_nmt_master_fun( void *cx, uint8_t node, enum canmat_nmt_event event, uint8_t state );
+
+/** Per-node state */
+struct canmat_nmt_node {
+    uint8_t state;                     ///< last reported NMT state
+    unsigned timed_out : 1;            ///< missed its consumer time
+    int64_t consumer_ns;               ///< 1016h time, 0 if not supervised
+    int64_t last_seen;                 ///< time of the last heartbeat
+    int64_t deadline;                  ///< when the node times out, if armed
+    struct canmat_nmt_node *prev;      ///< wheel slot list
+    struct canmat_nmt_node *next;      ///< wheel slot list
+    struct canmat_nmt_node **slot;     ///< slot holding this node, NULL if unarmed
+};
+
+/** NMT master for one network */
+struct canmat_nmt_master {
+    struct canmat_nmt_node node[CANMAT_NODE_MASK+1];
+    struct canmat_nmt_node *wheel[CANMAT_NMT_WHEEL_SLOTS];
+    int64_t tick_ns;
+    int64_t tick;                      ///< last tick processed
+    canmat_nmt_master_fun *fun;        ///< may be NULL
+    void *cx;
+};
+
+/** Initialize with all nodes unknown and unsupervised */
+void canmat_nmt_master_init( struct canmat_nmt_master *m, int64_t tick_ns, int64_t now,
+                             canmat_nmt_master_fun *fun, void *cx );
+
+/** Supervise node with a consumer heartbeat time, 0 to stop */
+canmat_status_t canmat_nmt_master_consumer( struct canmat_nmt_master *m, uint8_t node, uint16_t time_ms );
+
+/** Take consumer heartbeat times from 1016h in a value store */
+canmat_status_t canmat_nmt_master_load( struct canmat_nmt_master *m, const canmat_dict_t *dict,
+                                        const struct canmat_sdo_value *value );
+
+/** Handle a received frame.
+ *
+ * \return 1 if can was a boot-up or heartbeat message, 0 otherwise
+ */
+int canmat_nmt_master_frame( struct canmat_nmt_master *m, const struct can_frame *can, int64_t now );
+
+/** Advance the wheel to now, reporting nodes that timed out */
+void canmat_nmt_master_tick( struct canmat_nmt_master *m, int64_t now );
+
+/** Last reported state of node */
+static inline uint8_t canmat_nmt_master_state( const struct canmat_nmt_master *m, uint8_t node ) {
+    return m->node[node & CANMAT_NODE_MASK].state;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_NMT_MASTER_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -106,7 +106,7 @@ enum canmat_status canmat_pdo_process(
 enum canmat_status canmat_pdo_remap(
     struct canmat_iface *cif, uint8_t node, uint8_t pdo, enum canmat_direction dir,
     int transmission_type, int inhibit_time, int event_timer,
-    uint8_t cnt, const struct canmat_obj *objs[],
+    uint8_t cnt, const struct canmat_obj *const objs[],
     uint32_t *err );
 
 enum canmat_status canmat_rpdo_send(
@@ -127,6 +127,13 @@ static inline enum canmat_status canmat_rpdo_send_i16(
                                   (uint8_t)((val >> 8) & 0xFF) };
     return canmat_rpdo_send( cif, node, pdo, sizeof(val), data );
 }
+static inline enum canmat_status canmat_rpdo_send_i32(
+    struct canmat_iface *cif, uint8_t node, uint8_t pdo,
+    int32_t val ) {
+    uint8_t data[sizeof(val)];
+    canmat_byte_stle32( data, (uint32_t)val );
+    return canmat_rpdo_send( cif, node, pdo, sizeof(val), data );
+}
 
 
 #define CANMAT_RPDO_COBID( node, num ) ((CANMAT_FUNC_CODE_PDO1_RX + ((num)<<8))|(node))
@@ -0,0 +1,155 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOCANMATIC_PDO_SLAVE_H
+#define SOCANMATIC_PDO_SLAVE_H
+
+/**
+ * \file pdo_slave.h
+ *
+ * \brief Device side of PDOs over an SDO server value store.
+ *
+ * The engine reads the RPDO and TPDO communication (1400h, 1800h)
+ * and mapping (1600h, 1A00h) parameters from the same value store
+ * that canmat_sdo_server serves, and compiles each PDO into a table
+ * of frame offsets and value sizes.  Producing or consuming a PDO
+ * then only walks that table.  Call canmat_pdo_slave_load() again
+ * after the parameters change; canmat_pdo_slave_written() recompiles
+ * just the written PDO when used as the SDO server's written hook.
+ *
+ * TPDOs are sent on SYNC counts, event timers, and changes of
+ * state, no sooner than their inhibit time.  Synchronous RPDOs are
+ * latched and stored on the next SYNC, others are stored when
+ * received.  Times are in nanoseconds on a caller monotonic clock.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// RPDOs and TPDOs handled by the engine
+#define CANMAT_PDO_SLAVE_MAX 16
+
+/// One mapped value, bytes [offset, offset+size) of the frame
+struct canmat_pdo_slave_entry {
+    struct canmat_sdo_value *value;  ///< NULL for dummy mappings
+    uint8_t offset;
+    uint8_t size;
+};
+
+/// A compiled PDO
+struct canmat_pdo_slave_pdo {
+    canid_t cob_id;
+    uint8_t trans;                   ///< transmission type
+    uint8_t length;                  ///< frame bytes
+    uint8_t n_entry;
+    uint8_t sync_count;              ///< SYNCs since last sent
+    unsigned valid : 1;              ///< exists and is enabled
+    unsigned latched : 1;            ///< received, waiting on SYNC
+    unsigned sent : 1;               ///< data holds the last frame sent
+    unsigned pending : 1;            ///< due, waiting out the inhibit time
+    int64_t inhibit_ns;
+    int64_t event_ns;                ///< event timer, 0 if disabled
+    int64_t next_ok;                 ///< end of inhibit time
+    int64_t next_event;              ///< when the event timer fires
+    struct canmat_pdo_slave_entry entry[8];
+    uint8_t data[8];                 ///< last sent or latched frame
+};
+
+/// PDO engine for one node
+struct canmat_pdo_slave {
+    uint8_t node;
+    const canmat_dict_t *dict;
+    struct canmat_sdo_value *value;  ///< dict->length values
+    canmat_sdo_client_send_fun *send;
+    void *send_cx;
+    canid_t sync_id;
+    struct canmat_pdo_slave_pdo rpdo[CANMAT_PDO_SLAVE_MAX];
+    struct canmat_pdo_slave_pdo tpdo[CANMAT_PDO_SLAVE_MAX];
+};
+
+/** Initialize and load PDOs of node from the value store */
+canmat_status_t canmat_pdo_slave_init( struct canmat_pdo_slave *p, uint8_t node,
+                                       const canmat_dict_t *dict, struct canmat_sdo_value *value,
+                                       canmat_sdo_client_send_fun *send, void *send_cx );
+
+/** Recompile all PDOs from the value store.
+ *
+ * PDOs whose mapping can not be compiled are disabled and
+ * CANMAT_ERR_PARAM is returned; the others still run.  Enabled PDOs
+ * keep their SYNC counts, timers and latched data.
+ */
+canmat_status_t canmat_pdo_slave_load( struct canmat_pdo_slave *p );
+
+/** SDO server written hook, cx is a struct canmat_pdo_slave */
+void canmat_pdo_slave_written( void *cx, const canmat_obj_t *obj, struct canmat_sdo_value *val );
+
+/** Handle a received frame.
+ *
+ * \return 1 if can was a SYNC or an RPDO of this node, 0 otherwise
+ */
+int canmat_pdo_slave_frame( struct canmat_pdo_slave *p, const struct can_frame *can, int64_t now );
+
+/** Send due event-driven TPDOs: expired event timers and changed values */
+canmat_status_t canmat_pdo_slave_step( struct canmat_pdo_slave *p, int64_t now );
+
+/** Earliest time canmat_pdo_slave_step() may have something to send
+ *
+ * Changes of state are checked at every step, so this only covers
+ * event timers and inhibit times of pending changes.
+ */
+int64_t canmat_pdo_slave_deadline( const struct canmat_pdo_slave *p );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_PDO_SLAVE_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
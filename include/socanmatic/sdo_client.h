@@ -0,0 +1,205 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SOCANMATIC_SDO_CLIENT_H
+#define SOCANMATIC_SDO_CLIENT_H
+
+/**
+ * \file sdo_client.h
+ *
+ * \brief Step-driven SDO client for user event loops.
+ *
+ * The client is a state machine for one transfer at a time with one
+ * node.  Starting a transfer sends the first frame.  The caller then
+ * passes each received frame to canmat_sdo_client_frame() and calls
+ * canmat_sdo_client_timeout() when canmat_sdo_client_deadline()
+ * passes.  Expedited, segmented, and block transfers are supported.
+ *
+ * The client owns no socket or thread.  Frames go out through a send
+ * function, and data is read from or written to caller buffers, so a
+ * transfer allocates nothing.  Times are in nanoseconds on any
+ * monotonic clock the caller chooses.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Default time to wait for each server frame
+#define CANMAT_SDO_CLIENT_TIMEOUT_NS 1000000000LL
+
+/// Most segments in a block
+#define CANMAT_SDO_BLKSIZE_MAX 127
+
+/// Sends a frame for the client
+typedef canmat_status_t canmat_sdo_client_send_fun( void *cx, const struct can_frame *can );
+
+enum canmat_sdo_client_state {
+    CANMAT_SDO_CLIENT_IDLE = 0,    ///< no transfer
+    CANMAT_SDO_CLIENT_UL_INIT,     ///< waiting on initiate upload response
+    CANMAT_SDO_CLIENT_UL_SEG,      ///< waiting on upload segment
+    CANMAT_SDO_CLIENT_DL_INIT,     ///< waiting on initiate download response
+    CANMAT_SDO_CLIENT_DL_SEG,      ///< waiting on download segment response
+    CANMAT_SDO_CLIENT_UL_BLK_INIT, ///< waiting on initiate block upload response
+    CANMAT_SDO_CLIENT_UL_BLK,      ///< receiving block upload segments
+    CANMAT_SDO_CLIENT_UL_BLK_END,  ///< waiting on end block upload
+    CANMAT_SDO_CLIENT_DL_BLK_INIT, ///< waiting on initiate block download response
+    CANMAT_SDO_CLIENT_DL_BLK_ACK,  ///< waiting on block download acknowledgement
+    CANMAT_SDO_CLIENT_DL_BLK_END   ///< waiting on end block download response
+};
+
+/** What a frame or timeout did to the transfer */
+enum canmat_sdo_client_event {
+    CANMAT_SDO_CLIENT_IGNORED = 0, ///< not for this transfer
+    CANMAT_SDO_CLIENT_PENDING,     ///< transfer continues
+    CANMAT_SDO_CLIENT_DONE         ///< transfer finished, see status
+};
+
+/** SDO client for one node */
+struct canmat_sdo_client {
+    uint8_t node;
+    canmat_sdo_client_send_fun *send;
+    void *send_cx;
+    int64_t timeout_ns;            ///< time to wait for each server frame
+    uint8_t blksize_ul;            ///< segments per block we ask for in block uploads
+
+    enum canmat_sdo_client_state state;
+    canmat_status_t status;        ///< result of the last transfer
+    uint32_t abort;                ///< abort code sent or received
+    size_t length;                 ///< bytes transferred, once done
+
+    uint16_t index;
+    uint8_t subindex;
+    uint8_t *buf;                  ///< upload destination or download source
+    size_t size;                   ///< buffer capacity for uploads, data length for downloads
+    size_t pos;                    ///< bytes sent or received
+    int64_t deadline;              ///< when the next server frame is due
+
+    unsigned toggle : 1;           ///< segmented transfer toggle bit
+    unsigned crc : 1;              ///< both sides use block CRCs
+    unsigned last : 1;             ///< expedited, or final block segment sent or received
+    uint8_t blksize;               ///< segments in the current block
+    uint8_t seqno;                 ///< last segment in order in the current block
+    size_t block_start;            ///< pos at start of the current download block
+};
+
+/** Initialize client for node, sending frames through send */
+void canmat_sdo_client_init( struct canmat_sdo_client *c, uint8_t node,
+                             canmat_sdo_client_send_fun *send, void *send_cx );
+
+/** Start uploading index/subindex into buf of size bytes.
+ *
+ * Uses a block transfer if block is nonzero.  On error no transfer is
+ * started.
+ */
+canmat_status_t canmat_sdo_client_ul( struct canmat_sdo_client *c, uint16_t index, uint8_t subindex,
+                                      void *buf, size_t size, int block, int64_t now );
+
+/** Start downloading size bytes of data to index/subindex.
+ *
+ * Sizes up to 4 are expedited unless block is nonzero.  data must
+ * stay valid until the transfer is done.
+ */
+canmat_status_t canmat_sdo_client_dl( struct canmat_sdo_client *c, uint16_t index, uint8_t subindex,
+                                      const void *data, size_t size, int block, int64_t now );
+
+/** Advance the transfer with a received frame */
+enum canmat_sdo_client_event
+canmat_sdo_client_frame( struct canmat_sdo_client *c, const struct can_frame *can, int64_t now );
+
+/** Abort the transfer if its deadline has passed */
+enum canmat_sdo_client_event
+canmat_sdo_client_timeout( struct canmat_sdo_client *c, int64_t now );
+
+/** Abort the transfer with code */
+void canmat_sdo_client_abort( struct canmat_sdo_client *c, uint32_t code );
+
+/** Is a transfer in progress? */
+static inline int canmat_sdo_client_busy( const struct canmat_sdo_client *c ) {
+    return CANMAT_SDO_CLIENT_IDLE != c->state;
+}
+
+/** When canmat_sdo_client_timeout() must next be called */
+static inline int64_t canmat_sdo_client_deadline( const struct canmat_sdo_client *c ) {
+    return c->deadline;
+}
+
+/** CLOCK_MONOTONIC time in nanoseconds, the clock of the run loops */
+int64_t canmat_now_ns( void );
+
+/// Returned by a canmat_step_timeout_fun when its clients have finished
+#define CANMAT_STEP_DONE INT64_MIN
+
+/** Handles deadlines passed at now and returns the next deadline, or
+ *  CANMAT_STEP_DONE */
+typedef int64_t canmat_step_timeout_fun( void *cx, int64_t now );
+
+/** Handles a received frame */
+typedef void canmat_step_frame_fun( void *cx, const struct can_frame *can, int64_t now );
+
+/** Drive step-driven clients, such as SDO clients, on cif.
+ *
+ * Calls timeout, waits on cif until a frame arrives or the deadline
+ * it returned passes, and passes any frame to frame, until timeout
+ * returns CANMAT_STEP_DONE.  Returns an interface error or CANMAT_OK.
+ */
+canmat_status_t canmat_step_run( canmat_iface_t *cif, canmat_step_timeout_fun *timeout,
+                                 canmat_step_frame_fun *frame, void *cx );
+
+/** CRC-16 used by SDO block transfers */
+uint16_t canmat_sdo_crc( uint16_t crc, const uint8_t *data, size_t n );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_SDO_CLIENT_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
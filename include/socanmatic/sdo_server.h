@@ -0,0 +1,150 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SOCANMATIC_SDO_SERVER_H
+#define SOCANMATIC_SDO_SERVER_H
+
+/**
+ * \file sdo_server.h
+ *
+ * \brief SDO server for objects of a dictionary.
+ *
+ * The server answers SDO requests to its node from a value store
+ * parallel to dict->obj.  Numeric objects keep their value in the
+ * store.  Strings and domains point to caller buffers, which bound
+ * the size of downloads.  Downloads of strings and domains are
+ * written in place, so an aborted one leaves the buffer partly
+ * overwritten, unless the server has a staging buffer to receive
+ * into.  Access types and sizes are checked, and
+ * failures are answered with the matching abort code.  Expedited,
+ * segmented, and block transfers are supported.
+ *
+ * Like the client, the server owns no socket or thread and allocates
+ * nothing; pass it each received frame.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Stored value of one object */
+struct canmat_sdo_value {
+    canmat_scalar_t scalar;       ///< value of numeric objects
+    uint8_t *data;                ///< contents of strings and domains
+    size_t size;                  ///< bytes in data
+    size_t capacity;              ///< most bytes data may hold, 0 if read only
+};
+
+enum canmat_sdo_server_state {
+    CANMAT_SDO_SERVER_IDLE = 0,      ///< waiting on an initiate request
+    CANMAT_SDO_SERVER_DL_SEG,        ///< receiving download segments
+    CANMAT_SDO_SERVER_UL_SEG,        ///< sending upload segments
+    CANMAT_SDO_SERVER_DL_BLK,        ///< receiving block download segments
+    CANMAT_SDO_SERVER_DL_BLK_END,    ///< waiting on end block download
+    CANMAT_SDO_SERVER_UL_BLK_START,  ///< waiting on start block upload
+    CANMAT_SDO_SERVER_UL_BLK_ACK,    ///< waiting on block upload acknowledgement
+    CANMAT_SDO_SERVER_UL_BLK_END     ///< waiting on end block upload response
+};
+
+/** SDO server for one node */
+struct canmat_sdo_server {
+    uint8_t node;
+    const canmat_dict_t *dict;
+    struct canmat_sdo_value *value;  ///< dict->length values
+    canmat_sdo_client_send_fun *send;
+    void *send_cx;
+    uint8_t blksize;                 ///< segments per block we ask for in block downloads
+    uint8_t *stage;                  ///< receives string and domain downloads, may be NULL
+    size_t stage_capacity;           ///< bytes in stage, also bounds those downloads
+
+    /** Called after a download changes obj's value, may be NULL */
+    void (*written)( void *cx, const canmat_obj_t *obj, struct canmat_sdo_value *val );
+    void *written_cx;
+
+    enum canmat_sdo_server_state state;
+    uint16_t index;                  ///< of the current request
+    uint8_t subindex;                ///< of the current request
+    const canmat_obj_t *obj;         ///< object of the transfer
+    uint8_t *buf;                    ///< data of the transfer
+    size_t size;                     ///< bytes to send, or room to receive
+    size_t pos;                      ///< bytes sent or received
+    size_t block_start;              ///< pos at start of the current upload block
+    unsigned toggle : 1;
+    unsigned crc : 1;                ///< both sides use block CRCs
+    unsigned last : 1;               ///< final block segment sent or received
+    uint8_t seqno;                   ///< last segment in order in the current block
+    uint8_t blksize_ul;              ///< segments per block the client accepts
+    uint8_t scratch[8];              ///< little-endian numeric value being moved
+};
+
+/** Initialize server for node serving dict with value store value */
+void canmat_sdo_server_init( struct canmat_sdo_server *s, uint8_t node,
+                             const canmat_dict_t *dict, struct canmat_sdo_value *value,
+                             canmat_sdo_client_send_fun *send, void *send_cx );
+
+/** Answer a received frame.
+ *
+ * \return 1 if can was an SDO request to this node, 0 otherwise
+ */
+int canmat_sdo_server_frame( struct canmat_sdo_server *s, const struct can_frame *can );
+
+/** Stored value of obj, which must be in s->dict */
+static inline struct canmat_sdo_value *
+canmat_sdo_server_value( struct canmat_sdo_server *s, const canmat_obj_t *obj ) {
+    return s->value + (obj - s->dict->obj);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_SDO_SERVER_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
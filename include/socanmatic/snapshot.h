@@ -0,0 +1,228 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOCANMATIC_SNAPSHOT_H
+#define SOCANMATIC_SNAPSHOT_H
+
+/**
+ * \file snapshot.h
+ *
+ * \brief Object dictionary snapshots of nodes.
+ *
+ * A snapshot holds the values a node returned for every readable
+ * object of a dictionary.  A job takes a snapshot with a step-driven
+ * SDO client, using segmented transfers for values over four bytes.
+ * A job can also restore a snapshot to a node, to the same node or
+ * to another node of the same kind.  Restoring reads each writable
+ * object first and writes only the values that differ.
+ *
+ * An SDO server handles one transfer at a time.  To go faster, run
+ * one job per node; canmat_snapshot_run() drives several jobs on one
+ * interface at once.
+ *
+ * Nodes refuse to change a PDO while it is valid.  Before writing a
+ * PDO's communication parameters (1400h-15FFh, 1800h-19FFh) or
+ * mapping (1600h-17FFh, 1A00h-1BFFh), restore sets bit 31 of its
+ * COB-ID, and it writes the COB-ID back once it leaves the PDO's
+ * entries.  A COB-ID that differs is made invalid before the new one
+ * is written.  When a mapping differs, restore first writes 0 to its
+ * subindex 0.  It then writes the entries and finally the number of
+ * entries, as DS301 requires.  Each abort counts as a failed entry.
+ *
+ * Snapshots are written to files as a header followed by entries,
+ * and several snapshots may follow each other in one file.  All
+ * fields are little-endian:
+ *
+ *     magic "CANMATSS", version u8, node u8, entries u32
+ *     per entry: index u16, subindex u8, length u16, data
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CANMAT_SNAPSHOT_MAGIC "CANMATSS"
+#define CANMAT_SNAPSHOT_VERSION 1
+
+/// Longest value a job reads, longer values count as failed
+#define CANMAT_SNAPSHOT_VALUE_MAX 1024
+
+/** Value of one object */
+struct canmat_snapshot_entry {
+    uint16_t index;
+    uint8_t subindex;
+    uint16_t length;               ///< bytes of data
+    size_t offset;                 ///< of data in the snapshot
+};
+
+/** Values read from one node */
+struct canmat_snapshot {
+    uint8_t node;
+    size_t n;                      ///< entries, in the order read
+    size_t n_max;                  ///< room for entries
+    struct canmat_snapshot_entry *entry;
+    uint8_t *data;                 ///< values of all entries
+    size_t size;                   ///< bytes in data
+    size_t capacity;               ///< room in data
+};
+
+/** Initialize empty snapshot of node */
+void canmat_snapshot_init( struct canmat_snapshot *s, uint8_t node );
+
+/** Free the entries of s */
+void canmat_snapshot_destroy( struct canmat_snapshot *s );
+
+/** Append a value, CANMAT_ERR_OS if out of memory.
+ *
+ * If data is NULL, length bytes are added for the caller to fill.
+ */
+canmat_status_t canmat_snapshot_add( struct canmat_snapshot *s, uint16_t index, uint8_t subindex,
+                                     const void *data, size_t length );
+
+/** Value of entry e of s */
+static inline const uint8_t *
+canmat_snapshot_data( const struct canmat_snapshot *s, const struct canmat_snapshot_entry *e ) {
+    return s->data + e->offset;
+}
+
+/** Write s to f, CANMAT_ERR_OS on write errors */
+canmat_status_t canmat_snapshot_write( FILE *f, const struct canmat_snapshot *s );
+
+/** Read the next snapshot in f into an initialized s.
+ *
+ * \return CANMAT_OK, CANMAT_ERR_UNDERFLOW at the end of f,
+ *         CANMAT_ERR_PROTO for a malformed snapshot, or CANMAT_ERR_OS
+ */
+canmat_status_t canmat_snapshot_read( FILE *f, struct canmat_snapshot *s );
+
+enum canmat_snapshot_job_state {
+    CANMAT_SNAPSHOT_JOB_IDLE = 0,  ///< no job
+    CANMAT_SNAPSHOT_JOB_READ,      ///< reading an object into the snapshot
+    CANMAT_SNAPSHOT_JOB_COMPARE,   ///< reading an object to restore
+    CANMAT_SNAPSHOT_JOB_WRITE,     ///< writing an object that differs
+    CANMAT_SNAPSHOT_JOB_UNMAP,     ///< clearing a PDO mapping before writing it
+    CANMAT_SNAPSHOT_JOB_MAP,       ///< writing the number of PDO mapping entries
+    CANMAT_SNAPSHOT_JOB_COB,       ///< reading a PDO's COB-ID before changing the PDO
+    CANMAT_SNAPSHOT_JOB_INVALIDATE,///< setting bit 31 of a PDO's COB-ID
+    CANMAT_SNAPSHOT_JOB_VALIDATE   ///< writing back the COB-ID of a PDO made invalid
+};
+
+/** Snapshot or restore of one node */
+struct canmat_snapshot_job {
+    struct canmat_sdo_client client;
+    const canmat_dict_t *dict;
+    struct canmat_snapshot *snap;
+
+    enum canmat_snapshot_job_state state;
+    canmat_status_t status;        ///< CANMAT_ERR_TIMEOUT if the node stopped answering
+    size_t next;                   ///< object or entry of the current transfer
+    const struct canmat_snapshot_entry *map;  ///< subindex 0 of a PDO mapping being restored
+    unsigned remap : 1;            ///< map was cleared and must be written
+    unsigned revalidate : 1;       ///< guard was valid and must be made valid again
+    uint16_t guard;                ///< communication index of a PDO being changed, 0 if none
+    uint32_t cob;                  ///< COB-ID of guard before it was made invalid
+
+    size_t n_same;                 ///< entries equal to the node's values
+    size_t n_written;              ///< entries written
+    size_t n_failed;               ///< objects the node would not read or write
+
+    uint8_t zero;                  ///< data of a cleared mapping
+    uint8_t cob_data[4];           ///< data of a COB-ID write
+    uint8_t buf[CANMAT_SNAPSHOT_VALUE_MAX];
+};
+
+/** Initialize job for node, sending frames through send */
+void canmat_snapshot_job_init( struct canmat_snapshot_job *j, uint8_t node,
+                               canmat_sdo_client_send_fun *send, void *send_cx );
+
+/** Start reading every readable object of dict into the empty snap.
+ *
+ * Readable objects are variables and record or array entries that
+ * are not write-only and not domains.  Objects the node aborts count
+ * as failed and are left out.
+ */
+canmat_status_t canmat_snapshot_job_read( struct canmat_snapshot_job *j, const canmat_dict_t *dict,
+                                          struct canmat_snapshot *snap, int64_t now );
+
+/** Start restoring snap, which may be from another node.
+ *
+ * Entries that are not writable in dict are skipped.
+ */
+canmat_status_t canmat_snapshot_job_restore( struct canmat_snapshot_job *j, const canmat_dict_t *dict,
+                                             struct canmat_snapshot *snap, int64_t now );
+
+/** Advance the job with a received frame.
+ *
+ * \return 1 if can was for this job, 0 otherwise
+ */
+int canmat_snapshot_job_frame( struct canmat_snapshot_job *j, const struct can_frame *can, int64_t now );
+
+/** Handle a passed deadline */
+void canmat_snapshot_job_timeout( struct canmat_snapshot_job *j, int64_t now );
+
+/** Is the job running? */
+static inline int canmat_snapshot_job_busy( const struct canmat_snapshot_job *j ) {
+    return CANMAT_SNAPSHOT_JOB_IDLE != j->state;
+}
+
+/** Run started jobs on cif until all finish.
+ *
+ * Jobs must send on cif.  Returns an interface error, or CANMAT_OK
+ * with each job's result in its status.
+ */
+canmat_status_t canmat_snapshot_run( canmat_iface_t *cif, struct canmat_snapshot_job *job, size_t n );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_SNAPSHOT_H
+
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -0,0 +1,134 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOCANMATIC_SYNC_H
+#define SOCANMATIC_SYNC_H
+
+/**
+ * \file sync.h
+ *
+ * \brief Periodic SYNC producer.
+ *
+ * The producer sleeps to absolute deadlines on CLOCK_MONOTONIC, so
+ * lateness in one cycle does not shift the following ones.  Cycles
+ * that are missed entirely are skipped and counted rather than sent
+ * in a burst.  Each SYNC may carry the DS301 counter byte (1019h).
+ *
+ * Jitter is recorded as the time from the intended deadline until
+ * the frame is handed to the interface, and, when the interface
+ * provides transmit timestamps, until the driver sent it.  The driver
+ * stamps each frame that went out, in order, so stamps are matched to
+ * the SYNCs that were sent successfully, oldest first.
+ *
+ * \author Neil Dantam
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Default SYNC period, 1006h is in microseconds
+#define CANMAT_SYNC_PERIOD_NS 10000000LL
+
+/// Sent SYNCs remembered while their transmit timestamps are due
+#define CANMAT_SYNC_STAMP_MAX 16
+
+/** SYNC producer on one interface */
+struct canmat_sync_producer {
+    struct canmat_iface *cif;
+    canid_t cob_id;                ///< 1005h, normally 0x80
+    int64_t period_ns;             ///< 1006h
+    uint8_t counter_max;           ///< 1019h, 0 for SYNC without a counter
+    uint8_t counter;               ///< counter in the last SYNC sent
+    int tx_stamp;                  ///< interface gives transmit timestamps
+
+    struct timespec next;          ///< deadline of the next SYNC
+    struct timespec last;          ///< deadline of the last SYNC sent
+    int64_t real_offset;           ///< CLOCK_REALTIME - CLOCK_MONOTONIC, for tx stamps
+    int64_t stamp_due[CANMAT_SYNC_STAMP_MAX]; ///< deadlines of sent SYNCs not yet stamped
+    unsigned stamp_head;           ///< oldest in stamp_due
+    unsigned stamp_n;              ///< entries in stamp_due
+    uint64_t sent;                 ///< SYNCs sent
+    uint64_t missed;               ///< periods skipped after overruns
+    struct canmat_hist hist_send;  ///< deadline to send() returning
+    struct canmat_hist hist_tx;    ///< deadline to driver transmit timestamp
+};
+
+/** Initialize a producer with the default COB-ID and no counter.
+ *
+ * counter_max is 0, or 2-240 per 1019h.
+ */
+canmat_status_t canmat_sync_producer_init( struct canmat_sync_producer *p, struct canmat_iface *cif,
+                                           int64_t period_ns, uint8_t counter_max );
+
+/** Take COB-ID, period and counter from 1005h, 1006h and 1019h in a value store.
+ *
+ * Returns CANMAT_ERR_PARAM if 1005h is set without the generate bit
+ * (bit 30), which makes the node a SYNC consumer.
+ */
+canmat_status_t canmat_sync_producer_load( struct canmat_sync_producer *p, const canmat_dict_t *dict,
+                                           const struct canmat_sdo_value *value );
+
+/** Set the first deadline one period from now and try to enable transmit timestamps */
+void canmat_sync_producer_start( struct canmat_sync_producer *p );
+
+/** Sleep until the next deadline, then send SYNC.
+ *
+ * Returns CANMAT_ERR_OS with errno set if the sleep is interrupted.
+ */
+canmat_status_t canmat_sync_producer_step( struct canmat_sync_producer *p );
+
+/** Print jitter histograms and counts */
+void canmat_sync_producer_print( FILE *f, const struct canmat_sync_producer *p );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SOCANMATIC_SYNC_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -63,6 +63,20 @@ unsigned long parse_u( const char *arg, int base, uint64_t max );
 
 canmat_iface_t *open_iface( const char *type, const char *name );
 
+/* Number of buckets and slots in a perfect hash of n keys */
+void canmat_dict_hash_dims( size_t n, uint32_t *nbucket, uint32_t *nslot );
+
+/* Fill perfect hash h of keys into caller's seed and slot arrays,
+ * sized by canmat_dict_hash_dims().  Returns 0 on success. */
+int canmat_dict_hash_fill( struct canmat_dict_hash *h, uint32_t *seed, uint32_t *slot,
+                           const uint32_t *keys, size_t n );
+
+/* Fill name hash h of obj into caller's slot array.  nslot must be a
+ * power of two greater than n. */
+void canmat_dict_name_hash_fill( struct canmat_dict_name_hash *h,
+                                 struct canmat_dict_name_slot *slot, uint32_t nslot,
+                                 const struct canmat_obj *obj, size_t n );
+
 
 /* ex: set shiftwidth=4 tabstop=4 expandtab: */
 /* Local Variables:                          */
@@ -46,8 +46,21 @@
  * Reads reference commands from Ach channel, sends to drives.
  * Reads feedback from drives, posts to Ach channel
  *
+ * Transport:
+ *   - Ach (with sns), or a built-in shared-memory ring (-t shm)
+ *
  * PDO Usage:
  *   - Needs two RPDOs, one for control word and one for reference value
+ *   - One TPDO for position and velocity, optionally one for the
+ *     statusword.  In torque modes, the status TPDO also carries
+ *     current, since the first TPDO is full.
+ *
+ * Timing:
+ *   - In profile modes (vl), the loop is paced by the reference channel
+ *   - In cyclic synchronous modes (csp, csv), can402 is the SYNC
+ *     producer.  Each cycle, on an absolute timer, it sends all
+ *     target RPDOs, then SYNC, then collects the SYNC-triggered
+ *     TPDOs and posts the state.
  *
  */
 
@@ -61,6 +74,7 @@
 #include <getopt.h>
 #include <assert.h>
 #include <pthread.h>
+#include <time.h>
 
 
 #include <syslog.h>
@@ -70,8 +84,10 @@
 #include "socanmatic_private.h"
 
 #include "socanmatic/dict402.h"
+#include "socanmatic/pdo402.h"
 
-#include <sns.h>
+#include "can402_sns.h"
+#include "can402.h"
 
 struct canmat_402_set {
     struct canmat_iface *cif;
@@ -80,6 +96,24 @@ struct canmat_402_set {
 } canmat_402_set_t;
 
 
+/* Fault handling:
+ *   - The RX thread decodes status TPDOs into a per-drive event
+ *     queue.  EMCY messages go through a canmat_emcy consumer, whose
+ *     subscriber queues those of our drives the same way.
+ *   - At the start of each cycle, the control thread drains the
+ *     queues.  A drive reporting an error or fault state is sent
+ *     quick stop, and all drives are halted.  Faulted drives stay
+ *     stopped until can402 is restarted.
+ */
+
+/** Phases of a SYNC cycle, each with its own latency budget */
+enum can402_phase {
+    CAN402_PHASE_TX = 0,    ///< read reference, send target RPDOs
+    CAN402_PHASE_RX,        ///< send SYNC, collect TPDOs
+    CAN402_PHASE_PUBLISH,   ///< post state
+    CAN402_PHASE_MAX
+};
+
 struct can402_cx {
     struct canmat_402_set drive_set;
     struct sns_msg_motor_ref *msg_ref;
@@ -88,15 +122,35 @@ struct can402_cx {
     enum canmat_402_op_mode op_mode;
     _Bool halt;
 
-    ach_channel_t chan_ref;
-    ach_channel_t chan_state;
-    ach_channel_t chan_event;
+    struct can402_chan *chan_ref;
+    struct can402_chan *chan_state;
+    struct can402_chan *chan_event;
     struct timespec now;
+
+    /* SYNC cycle bookkeeping.  The feedback thread stamps each
+     * drive's TPDO with the current cycle number. */
+    uint64_t sync_cycle;
+    uint64_t fb_cycle[CANMAT_NODE_MASK+1];
+    pthread_mutex_t fb_mutex;
+    pthread_cond_t fb_cond;
+    unsigned long overrun[CAN402_PHASE_MAX];
+
+    /* Fault events, RX thread to control thread */
+    struct can402_evq evq[CANMAT_NODE_MASK+1];
+    struct canmat_emcy emcy;                    ///< written by RX thread
+    uint16_t rx_stat_word[CANMAT_NODE_MASK+1];  ///< owned by RX thread
+    _Bool faulted[CANMAT_NODE_MASK+1];
+    size_t n_faulted;
+
+    /* SYNC cycle timing */
+    struct canmat_hist hist_wakeup;     ///< timer wakeup latency
+    struct canmat_hist hist_exec;       ///< cycle execution time
 };
 
 const char *opt_chan_ref = "motor-ref";
 const char *opt_chan_state = "motor-state";
 const char *opt_chan_event = NULL;
+const char *opt_transport = NULL;
 const char *opt_cmd = NULL;
 const char *opt_api = "socketcan";
 const char **opt_pos = NULL;
@@ -109,6 +163,18 @@ int opt_tpdo_stat = -1;
 
 double opt_timeout_sec = 0.01; // 100 Hz
 
+/* SYNC period, zero for reference-paced operation */
+int64_t opt_sync_period_ns = 0;
+/* Budget for sending references, from start of cycle */
+double opt_budget_tx = 0.25;
+/* Budget for collecting feedback, from start of cycle */
+double opt_budget_rx = 0.75;
+
+/* Real-time settings */
+struct can402_rt opt_rt = { .policy = SCHED_OTHER,
+                            .cpu_ctrl = -1,
+                            .cpu_rx = -1 };
+
 // FIXME: 1
 double opt_vel_factor = 180/M_PI*1000;
 double opt_pos_factor = 180/M_PI*1000;
@@ -119,14 +185,18 @@ double opt_pos_factor = 180/M_PI*1000;
 
 static void init( struct can402_cx *cx );
 static void run( struct can402_cx *cx );
+static void run_sync( struct can402_cx *cx );
+static void dump_stats( struct can402_cx *cx );
 static void process( struct can402_cx *cx );
 static void halt( struct can402_cx *cx, _Bool is_halt );
+static void handle_events( struct can402_cx *cx );
 static void stop( struct can402_cx *cx );
 static void parse( struct can402_cx *cx, int argc, char **argv );
 
 /* Feedback thread */
 static void feedback_recv( struct can402_cx *cx );
 static void *feedback_recv_start( void *cx );
+static void recv_emcy( void *cx, uint8_t node, const struct canmat_emcy_entry *entry );
 
 /* Called from main thread */
 static void update_feedback( struct can402_cx *cx );
@@ -140,6 +210,18 @@ int main( int argc, char ** argv ) {
     // defaults
     cx.op_mode = CANMAT_402_OP_MODE_VELOCITY;
     cx.halt = 1;
+    {
+        pthread_condattr_t attr;
+        pthread_condattr_init( &attr );
+        pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+        pthread_cond_init( &cx.fb_cond, &attr );
+        pthread_condattr_destroy( &attr );
+        pthread_mutex_init( &cx.fb_mutex, NULL );
+    }
+    canmat_hist_init( &cx.hist_wakeup, 1000 );
+    canmat_hist_init( &cx.hist_exec, 1000 );
+    canmat_emcy_init( &cx.emcy );
+    canmat_emcy_subscribe( &cx.emcy, 0, CANMAT_EMCY_CLASS_ANY, recv_emcy, &cx );
 
     //parse
     parse( &cx, argc, argv );
@@ -150,6 +232,13 @@ int main( int argc, char ** argv ) {
         }
     }
 
+    // lock memory before setting up the drives and channels
+    opt_rt.period_ns = opt_sync_period_ns;
+    if( opt_rt.lock_memory ) {
+        can402_rt_lock_memory();
+    }
+    can402_rt_sigusr1_init();
+
     // init
     init(&cx);
 
@@ -170,7 +259,14 @@ int main( int argc, char ** argv ) {
         SNS_DIE( "Couldn't create feedback thread: %s\n", strerror(errno) );
         exit(EXIT_FAILURE);
     }
-    run(&cx);
+    /* After creating the RX thread, since SCHED_DEADLINE threads
+     * cannot create threads */
+    can402_rt_ctrl_thread( &opt_rt );
+    if( opt_sync_period_ns ) {
+        run_sync(&cx);
+    } else {
+        run(&cx);
+    }
 
     // stop
     if( pthread_join( feedback_thread, NULL ) ) {
@@ -182,10 +278,25 @@ int main( int argc, char ** argv ) {
 }
 
 
+static enum canmat_402_op_mode parse_op_mode( const char *arg ) {
+    if( 0 == strcasecmp( arg, "vl" ) ) {
+        return CANMAT_402_OP_MODE_VELOCITY;
+    } else if( 0 == strcasecmp( arg, "csv" ) ) {
+        return CANMAT_402_OP_MODE_CYCLIC_SYNC_VELOCITY;
+    } else if( 0 == strcasecmp( arg, "csp" ) ) {
+        return CANMAT_402_OP_MODE_CYCLIC_SYNC_POSITION;
+    } else if( 0 == strcasecmp( arg, "tq" ) ) {
+        return CANMAT_402_OP_MODE_TORQUE;
+    } else if( 0 == strcasecmp( arg, "cst" ) ) {
+        return CANMAT_402_OP_MODE_CYCLIC_SYNC_TORQUE;
+    }
+    SNS_DIE( "Unknown op mode: '%s'\n", arg );
+}
+
 static void parse( struct can402_cx *cx, int argc, char **argv )
 {
     assert( 0 == cx->drive_set.n );
-    for( int c; -1 != (c = getopt(argc, argv, "c:s:hH?Vf:a:n:R:C:d:e:" SNS_OPTSTRING)); ) {
+    for( int c; -1 != (c = getopt(argc, argv, "c:s:hH?Vf:a:n:R:C:S:d:e:t:m:y:P:k:K:L" SNS_OPTSTRING)); ) {
         switch(c) {
             SNS_OPTCASES
         case 'V':   /* version     */
@@ -213,6 +324,27 @@ static void parse( struct can402_cx *cx, int argc, char **argv )
         case 'e': /* event channel */
             opt_chan_event = strdup(optarg);
             break;
+        case 't': /* transport */
+            opt_transport = strdup(optarg);
+            break;
+        case 'm': /* op mode */
+            cx->op_mode = parse_op_mode(optarg);
+            break;
+        case 'y': /* sync period */
+            opt_sync_period_ns = 1000 * (int64_t)parse_u( optarg, 0, 1000000 );
+            break;
+        case 'P': /* scheduling policy */
+            can402_rt_parse_policy( &opt_rt, optarg );
+            break;
+        case 'k': /* control CPU */
+            opt_rt.cpu_ctrl = (int)parse_u( optarg, 0, CPU_SETSIZE-1 );
+            break;
+        case 'K': /* RX CPU */
+            opt_rt.cpu_rx = (int)parse_u( optarg, 0, CPU_SETSIZE-1 );
+            break;
+        case 'L': /* lock memory */
+            opt_rt.lock_memory = 1;
+            break;
         case 'n':   /* node  */
             SNS_REQUIRE( cx->drive_set.n < CANMAT_NODE_MASK-1, "Too many nodes\n" );
             cx->drive_set.drive[ cx->drive_set.n ].node_id = (uint8_t) parse_u( optarg, 16, CANMAT_NODE_MASK );
@@ -234,6 +366,12 @@ static void parse( struct can402_cx *cx, int argc, char **argv )
                 cx->drive_set.drive[ cx->drive_set.n - 1 ].rpdo_ctrl = opt_rpdo_ctrl;
             }
             break;
+        case 'S':   /* TPDO-Status  */
+            opt_tpdo_stat = (int) parse_u( optarg, 0, 255 );
+            if( cx->drive_set.n ) {
+                cx->drive_set.drive[ cx->drive_set.n - 1 ].tpdo_stat = opt_tpdo_stat;
+            }
+            break;
         case 'R':   /* RPDO-User  */
             opt_rpdo_user = (uint8_t) parse_u( optarg, 0, 255 );
             if( cx->drive_set.n ) {
@@ -255,13 +393,25 @@ static void parse( struct can402_cx *cx, int argc, char **argv )
                   "  -c ref_channel,           Reference Ach Channel name (last-message only)\n"
                   "  -s state_channel,         State Ach Channel name\n"
                   "  -e event_channel,         Event Ach Channel name (all messages)\n"
+                  "  -t transport,             Channel transport: ach, shm\n"
                   "  -R number,                User RPDO (from zero)\n"
                   "  -C number,                Control RPDO (from zero)\n"
+                  "  -S number,                Statusword TPDO (from zero)\n"
+                  "  -m mode,                  Op mode: vl (default), csv, csp, tq, cst\n"
+                  "  -y microseconds,          Produce SYNC at this period\n"
+                  "  -P policy[:arg],          Scheduling: other, fifo:PRIO, rr:PRIO, deadline:RUNTIME_USEC\n"
+                  "  -k cpu,                   Pin control thread to CPU\n"
+                  "  -K cpu,                   Pin RX thread to CPU\n"
+                  "  -L,                       Lock memory\n"
                   "  -?,                       Give program help list\n"
                   "  -V,                       Print program version\n"
                   "\n"
                   "Examples:\n"
                   " can402 -f can0 -R 1 -C 0 -n 3 -n 4 -c ref -s state    Interface with nodes 3 and 4\n"
+                  " can402 -f can0 -m csp -y 2000 -n 3 -n 4                 Position control at 500 Hz\n"
+                  " can402 -f can0 -m csp -y 1000 -P fifo:80 -k 2 -K 3 -L -n 3  Real-time, 1 kHz\n"
+                  "\n"
+                  "Send SIGUSR1 to print SYNC cycle timing histograms.\n"
                   "\n"
                   "Report bugs to <ntd@gatech.edu>"
                 );
@@ -278,6 +428,13 @@ static void parse( struct can402_cx *cx, int argc, char **argv )
 
     SNS_REQUIRE( cx->drive_set.cif, "can402: missing interface.\nTry `can402 -H' for more information.\n");
     SNS_REQUIRE( cx->drive_set.n, "can402: missing node IDs.\nTry `can402 -H' for more information.\n");
+    SNS_REQUIRE( opt_sync_period_ns || ! canmat_402_op_mode_is_cyclic(cx->op_mode),
+                 "can402: cyclic synchronous modes need a SYNC period (-y).\n" );
+    SNS_REQUIRE( opt_sync_period_ns || SCHED_DEADLINE != opt_rt.policy,
+                 "can402: SCHED_DEADLINE needs a SYNC period (-y).\n" );
+    if( canmat_402_op_mode_is_torque(cx->op_mode) && opt_tpdo_stat < 0 ) {
+        SNS_LOG( LOG_WARNING, "can402: no current feedback without a status TPDO (-S)\n" );
+    }
 
     cx->msg_ref = sns_msg_motor_ref_heap_alloc ( cx->drive_set.n );
     cx->msg_state = sns_msg_motor_state_heap_alloc ( cx->drive_set.n );
@@ -295,14 +452,16 @@ static void init( struct can402_cx *cx ) {
 
     sns_start();
 
-    sns_chan_open( &cx->chan_ref, opt_chan_ref, NULL );
-    sns_chan_open( &cx->chan_state, opt_chan_state, NULL );
-    {
-        ach_channel_t *chans[] = {&cx->chan_ref, NULL};
-        sns_sigcancel( chans, sns_sig_term_default );
+    if( NULL == opt_transport ) opt_transport = can402_chan_default_type;
+    size_t ref_size = sns_msg_motor_ref_size_n(cx->drive_set.n);
+    cx->chan_ref = can402_chan_open( opt_transport, opt_chan_ref, ref_size, CAN402_CHAN_SIGCANCEL );
+    cx->chan_state = can402_chan_open( opt_transport, opt_chan_state,
+                                       sns_msg_motor_state_size_n(cx->drive_set.n), 0 );
+    SNS_REQUIRE( cx->chan_ref && cx->chan_state, "can402: couldn't open channels\n" );
+    if( opt_chan_event ) {
+        cx->chan_event = can402_chan_open( opt_transport, opt_chan_event, ref_size, 0 );
+        SNS_REQUIRE( cx->chan_event, "can402: couldn't open event channel\n" );
     }
-    if( opt_chan_event )
-        sns_chan_open( &cx->chan_event, opt_chan_event, NULL );
 
 
     enum canmat_status r;
@@ -321,11 +480,10 @@ static void init( struct can402_cx *cx ) {
 
     // Map the control
     for( size_t i = 0; i < cx->drive_set.n; i ++ ) {
-        const struct canmat_obj *obj[1] =  {CANMAT_402_OBJ_CONTROLWORD};
-        r = canmat_pdo_remap( cx->drive_set.cif, cx->drive_set.drive[i].node_id,
-                              (uint8_t)(cx->drive_set.drive[i].rpdo_ctrl), CANMAT_DL,
-                              CANMAT_PDO_TRANSMISSION_TYPE_EVENT_DRIVEN, -1, -1,
-                              1, obj, &cx->drive_set.drive[i].abort_code );
+        r = canmat_402_pdo_ctrl_remap( cx->drive_set.cif, cx->drive_set.drive[i].node_id,
+                                       (uint8_t)(cx->drive_set.drive[i].rpdo_ctrl), CANMAT_DL,
+                                       CANMAT_PDO_TRANSMISSION_TYPE_EVENT_DRIVEN, -1, -1,
+                                       &cx->drive_set.drive[i].abort_code );
         if( r != CANMAT_OK ) {
             SNS_LOG( LOG_EMERG, "can402: couldn't map control rpdo: '%s'\n",
                      canmat_iface_strerror( cx->drive_set.cif, r) );
@@ -334,14 +492,16 @@ static void init( struct can402_cx *cx ) {
     }
 
     // map the feedback
+    /* With SYNC, drives answer every SYNC.  Otherwise, they send on a
+     * 10 ms event timer */
+    int fb_trans_type = opt_sync_period_ns ? CANMAT_PDO_TRANSMISSION_TYPE_SYNCHRONOUS_CYCLIC : 0xFE;
+    int fb_event_timer = opt_sync_period_ns ? 0 : 10;
     for( size_t i = 0; i < cx->drive_set.n; i ++ ) {
-        const canmat_obj_t *objs[2] = { CANMAT_402_OBJ_POSITION_ACTUAL_VALUE,
-                                        CANMAT_402_OBJ_VELOCITY_ACTUAL_VALUE };
         // user TPDO
-        r = canmat_pdo_remap( cx->drive_set.cif, cx->drive_set.drive[i].node_id,
-                              (uint8_t)(cx->drive_set.drive[i].tpdo_user), CANMAT_UL,
-                              0xFE, -1, 10,
-                              2, objs, &cx->drive_set.drive[i].abort_code );
+        r = canmat_402_pdo_user_remap( cx->drive_set.cif, cx->drive_set.drive[i].node_id,
+                                       (uint8_t)(cx->drive_set.drive[i].tpdo_user), CANMAT_UL,
+                                       fb_trans_type, -1, fb_event_timer,
+                                       &cx->drive_set.drive[i].abort_code );
         if( r != CANMAT_OK ) {
             SNS_LOG( LOG_EMERG, "can402: couldn't map user tpdo: '%s'\n",
                      canmat_iface_strerror( cx->drive_set.cif, r) );
@@ -349,11 +509,14 @@ static void init( struct can402_cx *cx ) {
         }
         // status TPDO
         if( 0 <= cx->drive_set.drive[i].tpdo_stat ) {
-            const canmat_obj_t *stat_obj[1] = { CANMAT_402_OBJ_STATUSWORD };
-            r = canmat_pdo_remap( cx->drive_set.cif, cx->drive_set.drive[i].node_id,
-                                  (uint8_t)(cx->drive_set.drive[i].tpdo_stat), CANMAT_UL,
-                                  0xFE, -1, 10,
-                                  1, stat_obj, &cx->drive_set.drive[i].abort_code );
+            // current is only mapped in torque modes
+            r = ( canmat_402_op_mode_is_torque(cx->op_mode) ?
+                  canmat_402_pdo_stat_cur_remap :
+                  canmat_402_pdo_stat_remap )
+                ( cx->drive_set.cif, cx->drive_set.drive[i].node_id,
+                  (uint8_t)(cx->drive_set.drive[i].tpdo_stat), CANMAT_UL,
+                  fb_trans_type, -1, fb_event_timer,
+                  &cx->drive_set.drive[i].abort_code );
             if( r != CANMAT_OK ) {
                 SNS_LOG( LOG_EMERG, "can402: couldn't map status tpdo: '%s'\n",
                          canmat_iface_strerror( cx->drive_set.cif, r) );
@@ -363,9 +526,37 @@ static void init( struct can402_cx *cx ) {
     }
 
 
+    // tell drives the cycle period so they can interpolate, all drives at once
+    if( opt_sync_period_ns ) {
+        struct canmat_cdcf period;
+        struct canmat_fanout f;
+        struct canmat_fanout_node *fn = (struct canmat_fanout_node*)
+            calloc( cx->drive_set.n, sizeof(fn[0]) );
+        canmat_scalar_t us = { .u32 = (uint32_t)(opt_sync_period_ns / 1000) };
+        canmat_cdcf_init( &period );
+        r = canmat_cdcf_add_obj( &period, CANMAT_402_OBJ_COMMUNICATION_CYCLE_PERIOD, &us );
+        SNS_REQUIRE( CANMAT_OK == r && fn, "can402: couldn't allocate cycle period\n" );
+        canmat_fanout_init( &f, fn, cx->drive_set.n, canmat_iface_send_cx, cx->drive_set.cif );
+        for( size_t i = 0; i < cx->drive_set.n; i ++ ) {
+            canmat_fanout_node_set( &f, i, cx->drive_set.drive[i].node_id, &period );
+        }
+        r = canmat_fanout_run( &f, cx->drive_set.cif );
+        for( size_t i = 0; i < cx->drive_set.n; i ++ ) {
+            cx->drive_set.drive[i].abort_code = fn[i].abort;
+            if( CANMAT_OK == r ) r = fn[i].status;
+        }
+        free( fn );
+        canmat_cdcf_destroy( &period );
+        if( r != CANMAT_OK ) {
+            SNS_LOG( LOG_EMERG, "can402: couldn't set cycle period: '%s'\n",
+                     canmat_iface_strerror( cx->drive_set.cif, r) );
+            goto FAIL;
+        }
+    }
+
     // set mode and PDOs
     for( size_t i = 0; i < cx->drive_set.n; i ++ ) {
-        r = canmat_402_set_op_mode( cx->drive_set.cif, &cx->drive_set.drive[i], CANMAT_402_OP_MODE_VELOCITY );
+        r = canmat_402_set_op_mode( cx->drive_set.cif, &cx->drive_set.drive[i], cx->op_mode );
         if( r != CANMAT_OK ) {
             SNS_LOG( LOG_EMERG, "can402: couldn't set op mode: '%s'\n",
                    canmat_iface_strerror( cx->drive_set.cif, r) );
@@ -396,32 +587,33 @@ FAIL:
 }
 
 
-static void get_msg( struct can402_cx *cx, ach_channel_t *channel,
+static void get_msg( struct can402_cx *cx, struct can402_chan *channel,
                      struct timespec *timeout, int options  )
 {
     const size_t expected_size = sns_msg_motor_ref_size_n(cx->drive_set.n);
     size_t frame_size = 0;
 
-    ach_status_t r = ach_get( channel, cx->msg_ref,
-                              expected_size,
-                              &frame_size, timeout, options );
+    enum can402_chan_status r = can402_chan_get( channel, cx->msg_ref,
+                                                 expected_size,
+                                                 &frame_size, timeout, options );
 
-    if( ACH_TIMEOUT == r ) {
+    if( CAN402_CHAN_TIMEOUT == r ) {
         /* If it's a timout, use the previously gotten time */
         memcpy(&cx->now, timeout, sizeof(*timeout));
     } else {
-        clock_gettime( ACH_DEFAULT_CLOCK, &cx->now );
+        clock_gettime( CLOCK_MONOTONIC, &cx->now );
     }
     update_feedback(cx);
     switch(r) {
-    case ACH_TIMEOUT:
+    case CAN402_CHAN_TIMEOUT:
         if( sns_msg_is_expired(&cx->msg_ref->header, &cx->now) ) {
             //SNS_LOG( LOG_NOTICE, "Reference timeout\n");
             halt(cx, 1);
             break;
         }
-    case ACH_MISSED_FRAME: /* This is probably OK */
-    case ACH_OK:
+        /* fall through */
+    case CAN402_CHAN_MISSED_FRAME: /* This is probably OK */
+    case CAN402_CHAN_OK:
         // validate
         if( 0 == sns_msg_motor_ref_check_size(cx->msg_ref, frame_size)  &&
             frame_size == expected_size )
@@ -435,35 +627,152 @@ static void get_msg( struct can402_cx *cx, ach_channel_t *channel,
         }
         break;
         /* Really bad things we just give up on */
-    case ACH_BUG:
-    case ACH_CORRUPT:
-        SNS_DIE( "ach_get failed badly, aborting: '%s'\n", ach_result_to_string(r) );
+    case CAN402_CHAN_CORRUPT:
+        SNS_DIE( "get failed badly, aborting: '%s'\n", can402_chan_strerror(r) );
         break;
-    case ACH_CANCELED:
-    case ACH_STALE_FRAMES:
+    case CAN402_CHAN_STALE_FRAMES:
+        /* Only happens without waiting, i.e., when SYNC-paced */
+        if( sns_msg_is_expired(&cx->msg_ref->header, &cx->now) ) {
+            halt(cx, 1);
+        } else if( options & CAN402_CHAN_O_LAST ) {
+            /* Drives may monitor RPDO timeouts, so resend the held reference */
+            process(cx);
+        }
+        break;
+    case CAN402_CHAN_CANCELED:
         break;
     default:
-        SNS_LOG( LOG_ERR, "ach_get failed: '%s'\n", ach_result_to_string(r) );
+        SNS_LOG( LOG_ERR, "get failed: '%s'\n", can402_chan_strerror(r) );
     }
 
 }
 
 static void run( struct can402_cx *cx ) {
     int64_t timeout_ns = (int64_t)(1e9*opt_timeout_sec);
-    clock_gettime( ACH_DEFAULT_CLOCK, &cx->now );
+    clock_gettime( CLOCK_MONOTONIC, &cx->now );
     cx->msg_ref->header.n = cx->drive_set.n;
     while( ! sns_cx.shutdown ) {
+        /*-- faults --*/
+        handle_events(cx);
         /*-- reference --*/
         struct timespec timeout = sns_time_add_ns( cx->now, timeout_ns );
-        get_msg(  cx, &cx->chan_ref, &timeout, ACH_O_WAIT | ACH_O_LAST );
+        get_msg(  cx, cx->chan_ref, &timeout, CAN402_CHAN_O_WAIT | CAN402_CHAN_O_LAST );
         /*-- event --*/
         if( opt_chan_event )
-            get_msg(  cx, &cx->chan_event, &timeout, 0 );
+            get_msg(  cx, cx->chan_event, &timeout, 0 );
         /*-- send_feedback --*/
         send_feedback(cx);
+        if( can402_rt_dump_requested() ) dump_stats(cx);
+    }
+}
+
+static void dump_stats( struct can402_cx *cx ) {
+    static const char *phase_name[CAN402_PHASE_MAX] = {"tx", "rx", "publish"};
+    canmat_hist_print( stderr, "wakeup", &cx->hist_wakeup );
+    canmat_hist_print( stderr, "exec", &cx->hist_exec );
+    for( size_t i = 0; i < CAN402_PHASE_MAX; i ++ ) {
+        if( cx->overrun[i] ) {
+            fprintf( stderr, "%s phase overran its budget %lu times\n",
+                     phase_name[i], cx->overrun[i] );
+        }
+    }
+}
+
+static int64_t state_lifetime_ns( void ) {
+    return opt_sync_period_ns ? 2*opt_sync_period_ns : (int64_t)(opt_timeout_sec*1e9*2);
+}
+
+static int64_t time_diff_ns( const struct timespec *a, const struct timespec *b ) {
+    return ( (int64_t)(a->tv_sec - b->tv_sec) * 1000000000 +
+             (int64_t)(a->tv_nsec - b->tv_nsec) );
+}
+
+/* Check time against the budget for a phase */
+static void check_budget( struct can402_cx *cx, enum can402_phase phase,
+                          const struct timespec *start, double budget )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    if( time_diff_ns(&now, start) > (int64_t)(budget * (double)opt_sync_period_ns) ) {
+        cx->overrun[phase]++;
     }
 }
 
+/* Wait until every drive has reported for this cycle, or the deadline passes */
+static void wait_feedback( struct can402_cx *cx, uint64_t cycle, const struct timespec *deadline ) {
+    pthread_mutex_lock( &cx->fb_mutex );
+    for(;;) {
+        size_t i = 0;
+        while( i < cx->drive_set.n && cycle == cx->fb_cycle[i] ) i++;
+        if( i == cx->drive_set.n ) break;
+        if( ETIMEDOUT == pthread_cond_timedwait( &cx->fb_cond, &cx->fb_mutex, deadline ) ) {
+            cx->overrun[CAN402_PHASE_RX]++;
+            break;
+        }
+    }
+    pthread_mutex_unlock( &cx->fb_mutex );
+}
+
+static void run_sync( struct can402_cx *cx ) {
+    struct timespec next;
+    clock_gettime( CLOCK_MONOTONIC, &next );
+    cx->msg_ref->header.n = cx->drive_set.n;
+    while( ! sns_cx.shutdown ) {
+        /*-- wait for start of cycle --*/
+        next = sns_time_add_ns( next, opt_sync_period_ns );
+        int r;
+        do {
+            r = clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL );
+        } while( EINTR == r && ! sns_cx.shutdown );
+        if( r && EINTR != r ) {
+            SNS_DIE( "clock_nanosleep failed: %s\n", strerror(r) );
+        }
+        if( sns_cx.shutdown ) break;
+        struct timespec wake;
+        clock_gettime( CLOCK_MONOTONIC, &wake );
+        canmat_hist_add( &cx->hist_wakeup, time_diff_ns( &wake, &next ) );
+
+        /*-- faults, before the reference can unhalt --*/
+        handle_events(cx);
+
+        /*-- reference, latest message only, never wait --*/
+        memcpy( &cx->now, &next, sizeof(next) );
+        get_msg( cx, cx->chan_ref, &next, CAN402_CHAN_O_LAST );
+        if( opt_chan_event )
+            get_msg( cx, cx->chan_event, &next, 0 );
+        check_budget( cx, CAN402_PHASE_TX, &next, opt_budget_tx );
+
+        /*-- SYNC, then collect the triggered TPDOs --*/
+        uint64_t cycle = __atomic_add_fetch( &cx->sync_cycle, 1, __ATOMIC_RELEASE );
+        canmat_status_t cr = canmat_sync( cx->drive_set.cif );
+        if( CANMAT_OK != cr ) {
+            SNS_LOG( LOG_ERR, "Couldn't send SYNC: %s\n",
+                     canmat_iface_strerror( cx->drive_set.cif, cr) );
+        }
+        struct timespec rx_deadline = sns_time_add_ns( next, (int64_t)(opt_budget_rx * (double)opt_sync_period_ns) );
+        wait_feedback( cx, cycle, &rx_deadline );
+
+        /*-- publish --*/
+        update_feedback(cx);
+        send_feedback(cx);
+        check_budget( cx, CAN402_PHASE_PUBLISH, &next, 1.0 );
+
+        struct timespec now;
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        canmat_hist_add( &cx->hist_exec, time_diff_ns( &now, &wake ) );
+
+        /* Skip missed cycles rather than bursting to catch up */
+        if( time_diff_ns( &now, &next ) > opt_sync_period_ns ) {
+            memcpy( &next, &now, sizeof(now) );
+        }
+
+        /* Printing is slow, but only happens when asked */
+        if( can402_rt_dump_requested() ) dump_stats(cx);
+    }
+
+    if( sns_cx.verbosity ) dump_stats(cx);
+}
+
 static double pos_limit( struct canmat_402_drive *drive, double val ) {
     // TODO: should we consider the pos offset here?
     double pos = drive->actual_pos;
@@ -492,10 +801,102 @@ static double pos_limit( struct canmat_402_drive *drive, double val ) {
     return val + off;
 }
 
+/* Without SYNC, only send changed targets to save bandwidth.  With
+ * SYNC, every target goes out each cycle so drives that monitor RPDO
+ * timeouts don't fault on a steady setpoint. */
+static _Bool rpdo_due( int64_t target, int64_t last ) {
+    return opt_sync_period_ns || target != last;
+}
+
 // workaround for Schunk PRL+ 0.62 firmware
 #define VEL_MIN (INT16_MIN+1)
 #define VEL_MAX (INT16_MAX)
 
+static void send_vl( struct can402_cx *cx, size_t i, double u ) {
+    struct canmat_402_drive *drive = &cx->drive_set.drive[i];
+    // position limit
+    double val = pos_limit( drive, u );
+    // clamp value
+    val *= drive->vel_factor;
+    int16_t vl_target = 0;
+    if( val > VEL_MAX ) {
+        vl_target = VEL_MAX;
+        SNS_LOG(LOG_DEBUG, "clamp+ %f -> %d 0x%x\n", val, vl_target, drive->node_id);
+    } else if (val < VEL_MIN ) {
+        vl_target = VEL_MIN;
+        SNS_LOG(LOG_DEBUG, "clamp- %f -> %d 0x%x\n", val, vl_target, drive->node_id);
+    } else vl_target = (int16_t) val;
+    // check if update necessary to save bandwidth
+    if( rpdo_due( vl_target, drive->target_vel_raw ) ) {
+        // send pdo
+        canmat_status_t cr = canmat_rpdo_send_i16( cx->drive_set.cif, drive->node_id,
+                                                   (uint8_t)drive->rpdo_user, vl_target );
+        if( CANMAT_OK == cr ) {
+            drive->target_vel_raw = vl_target;
+        } else {
+            SNS_LOG( LOG_ERR, "Couldn't send PDO: %s\n",
+                     canmat_iface_strerror( cx->drive_set.cif, cr) );
+        }
+    }
+}
+
+static int32_t clamp_i32( double val ) {
+    if( val > INT32_MAX ) return INT32_MAX;
+    else if( val < INT32_MIN ) return INT32_MIN;
+    else return (int32_t)val;
+}
+
+static void send_i32( struct can402_cx *cx, size_t i, int32_t target, int32_t *last ) {
+    struct canmat_402_drive *drive = &cx->drive_set.drive[i];
+    if( !rpdo_due( target, *last ) ) return;
+    canmat_status_t cr = canmat_rpdo_send_i32( cx->drive_set.cif, drive->node_id,
+                                               (uint8_t)drive->rpdo_user, target );
+    if( CANMAT_OK == cr ) {
+        *last = target;
+    } else {
+        SNS_LOG( LOG_ERR, "Couldn't send PDO: %s\n",
+                 canmat_iface_strerror( cx->drive_set.cif, cr) );
+    }
+}
+
+static void send_csv( struct can402_cx *cx, size_t i, double u ) {
+    struct canmat_402_drive *drive = &cx->drive_set.drive[i];
+    double val = pos_limit( drive, u ) * drive->vel_factor;
+    send_i32( cx, i, clamp_i32(val), &drive->target_cs_vel_raw );
+}
+
+static void send_torque( struct can402_cx *cx, size_t i, double u ) {
+    struct canmat_402_drive *drive = &cx->drive_set.drive[i];
+    double val = u * drive->torque_factor;
+    int16_t target;
+    if( val > INT16_MAX ) target = INT16_MAX;
+    else if( val < INT16_MIN ) target = INT16_MIN;
+    else target = (int16_t)val;
+    if( !rpdo_due( target, drive->target_torque_raw ) ) return;
+    canmat_status_t cr = canmat_rpdo_send_i16( cx->drive_set.cif, drive->node_id,
+                                               (uint8_t)drive->rpdo_user, target );
+    if( CANMAT_OK == cr ) {
+        drive->target_torque_raw = target;
+    } else {
+        SNS_LOG( LOG_ERR, "Couldn't send PDO: %s\n",
+                 canmat_iface_strerror( cx->drive_set.cif, cr) );
+    }
+}
+
+static void send_csp( struct can402_cx *cx, size_t i, double u ) {
+    struct canmat_402_drive *drive = &cx->drive_set.drive[i];
+    // references are in the offset frame, drive limits are not
+    double pos = u - drive->pos_offset;
+    if( pos > drive->pos_max_soft ) {
+        SNS_LOG(LOG_DEBUG, "limit+ 0x%x, %f > %f \n", drive->node_id, pos, drive->pos_max_soft );
+        pos = drive->pos_max_soft;
+    } else if( pos < drive->pos_min_soft ) {
+        SNS_LOG(LOG_DEBUG, "limit- 0x%x, %f < %f \n", drive->node_id, pos, drive->pos_min_soft );
+        pos = drive->pos_min_soft;
+    }
+    send_i32( cx, i, clamp_i32(pos * drive->pos_factor), &drive->target_pos_raw );
+}
+
 static void process( struct can402_cx *cx ) {
     if( SNS_LOG_PRIORITY(LOG_DEBUG + 1) ) {
         sns_msg_motor_ref_dump( stderr, cx->msg_ref );
@@ -514,36 +915,39 @@ static void process( struct can402_cx *cx ) {
      */
     switch( cx->msg_ref->mode ) {
     case SNS_MOTOR_MODE_VEL:
+        if( CANMAT_402_OP_MODE_VELOCITY != cx->op_mode &&
+            CANMAT_402_OP_MODE_CYCLIC_SYNC_VELOCITY != cx->op_mode ) {
+            goto BAD_MODE;
+        }
         halt(cx, 0); // unhalt
         if( cx->halt ) return;  // make sure we unhalted
         for( size_t i = 0; i < cx->msg_ref->header.n; i ++ ) {
-            // position limit
-            double val = pos_limit( &cx->drive_set.drive[i], cx->msg_ref->u[i] );
-            // clamp value
-            val *= cx->drive_set.drive[i].vel_factor;
-            int16_t vl_target = 0;
-            if( val > VEL_MAX ) {
-                vl_target = VEL_MAX;
-                SNS_LOG(LOG_DEBUG, "clamp+ %f -> %d 0x%x\n", val, vl_target, cx->drive_set.drive[i].node_id);
-            } else if (val < VEL_MIN ) {
-                vl_target = VEL_MIN;
-                SNS_LOG(LOG_DEBUG, "clamp- %f -> %d 0x%x\n", val, vl_target, cx->drive_set.drive[i].node_id);
-            } else vl_target = (int16_t) val;
-            // check if update necessary to save bandwidth
-            if( vl_target != cx->drive_set.drive[i].target_vel_raw ) {
-                // send pdo
-                canmat_status_t cr = canmat_rpdo_send_i16( cx->drive_set.cif,
-                                                           cx->drive_set.drive[i].node_id,
-                                                           (uint8_t)cx->drive_set.drive[i].rpdo_user,
-                                                           vl_target );
-                if( CANMAT_OK == cr ) {
-                    cx->drive_set.drive[i].target_vel_raw = vl_target;
-                } else {
-                    SNS_LOG( LOG_ERR, "Couldn't send PDO: %s\n",
-                             canmat_iface_strerror( cx->drive_set.cif, cr) );
-                }
+            if( CANMAT_402_OP_MODE_VELOCITY == cx->op_mode ) {
+                send_vl( cx, i, cx->msg_ref->u[i] );
+            } else {
+                send_csv( cx, i, cx->msg_ref->u[i] );
             }
-
+        }
+        break;
+    case SNS_MOTOR_MODE_POS:
+        if( CANMAT_402_OP_MODE_CYCLIC_SYNC_POSITION != cx->op_mode ) {
+            goto BAD_MODE;
+        }
+        halt(cx, 0); // unhalt
+        if( cx->halt ) return;  // make sure we unhalted
+        for( size_t i = 0; i < cx->msg_ref->header.n; i ++ ) {
+            send_csp( cx, i, cx->msg_ref->u[i] );
+        }
+        break;
+    case SNS_MOTOR_MODE_TORQ:
+        if( ! canmat_402_op_mode_is_torque(cx->op_mode) ) {
+            goto BAD_MODE;
+        }
+        halt(cx, 0); // unhalt
+        if( cx->halt ) return;  // make sure we unhalted
+        for( size_t i = 0; i < cx->msg_ref->header.n; i ++ ) {
+            // no position limit here, torque is not a motion reference
+            send_torque( cx, i, cx->msg_ref->u[i] );
         }
         break;
     case SNS_MOTOR_MODE_POS_OFFSET:
@@ -552,12 +956,17 @@ static void process( struct can402_cx *cx ) {
         }
         break;
     default:
-        SNS_LOG( LOG_ERR, "unhandled op mode in motor_ref msg: '%d'\n", cx->msg_ref->mode );
+        goto BAD_MODE;
     }
+    return;
+
+BAD_MODE:
+    SNS_LOG( LOG_ERR, "unhandled op mode in motor_ref msg: '%d'\n", cx->msg_ref->mode );
 }
 
 
 static void halt( struct can402_cx *cx, _Bool is_halt ) {
+    if( !is_halt && cx->n_faulted ) return;
     for( size_t i = 0; i < cx->drive_set.n; i ++ ) {
         _Bool halted = cx->drive_set.drive[i].ctrl_word & CANMAT_402_CTRLMASK_HALT;
         if( (is_halt && !halted) || (!is_halt && halted) ) {
@@ -584,14 +993,77 @@ static void halt( struct can402_cx *cx, _Bool is_halt ) {
     cx->halt = is_halt;
 }
 
+static void quick_stop( struct can402_cx *cx, size_t i ) {
+    struct canmat_402_drive *drive = &cx->drive_set.drive[i];
+    uint16_t ctrl = (uint16_t)( (drive->ctrl_word & CANMAT_402_CTRLCMD_MASK_AND_QUICK_STOP) |
+                                CANMAT_402_CTRLCMD_MASK_OR_QUICK_STOP );
+    canmat_status_t r = canmat_rpdo_send_u16( cx->drive_set.cif, drive->node_id,
+                                              (uint8_t)drive->rpdo_ctrl, ctrl );
+    if( CANMAT_OK != r ) {
+        SNS_LOG( LOG_EMERG, "Couldn't send quick stop PDO: %s\n",
+                 canmat_iface_strerror( cx->drive_set.cif, r) );
+    } else {
+        drive->ctrl_word = ctrl;
+    }
+}
+
+static void fault( struct can402_cx *cx, size_t i ) {
+    if( cx->faulted[i] ) return;
+    cx->faulted[i] = 1;
+    cx->n_faulted++;
+    quick_stop( cx, i );
+    halt( cx, 1 );
+}
+
+static void handle_events( struct can402_cx *cx ) {
+    for( size_t i = 0; i < cx->drive_set.n; i++ ) {
+        struct canmat_402_drive *drive = &cx->drive_set.drive[i];
+        struct can402_event ev;
+        while( 0 == can402_evq_pop( &cx->evq[i], &ev ) ) {
+            switch( ev.type ) {
+            case CAN402_EVENT_STATUS: {
+                drive->stat_word = ev.code;
+                enum canmat_402_state_val state = canmat_402_state( drive );
+                SNS_LOG( LOG_DEBUG, "drive 0x%x: statusword 0x%x, state '%s'\n",
+                         drive->node_id, drive->stat_word, canmat_402_state_string(state) );
+                if( CANMAT_402_STATE_VAL_FAULT == state ||
+                    CANMAT_402_STATE_VAL_FAULT_REACTION_ACTIVE == state ) {
+                    SNS_LOG( LOG_ERR, "drive 0x%x: fault, state '%s'\n",
+                             drive->node_id, canmat_402_state_string(state) );
+                    fault( cx, i );
+                }
+                break;
+            }
+            case CAN402_EVENT_EMCY:
+                if( CANMAT_EMCY_CODE_CLASS_NO_ERROR == ev.code ) {
+                    SNS_LOG( LOG_NOTICE, "drive 0x%x: EMCY error reset\n", drive->node_id );
+                } else {
+                    SNS_LOG( LOG_ERR, "drive 0x%x: EMCY code 0x%04x, register 0x%02x, "
+                             "data %02x:%02x:%02x:%02x:%02x\n",
+                             drive->node_id, ev.code, ev.reg,
+                             ev.msef[0], ev.msef[1], ev.msef[2], ev.msef[3], ev.msef[4] );
+                    fault( cx, i );
+                }
+                break;
+            }
+        }
+        if( __atomic_exchange_n( &cx->evq[i].overflow, 0, __ATOMIC_RELAXED ) ) {
+            SNS_LOG( LOG_ERR, "drive 0x%x: event queue overflow\n", drive->node_id );
+            fault( cx, i );
+        }
+    }
+}
+
 static void update_feedback( struct can402_cx *cx ) {
     for( size_t i = 0; i < cx->drive_set.n; i++ ) {
         // compute MKS values
         struct canmat_402_drive *drive = &cx->drive_set.drive[i];
         int32_t pos_raw = __atomic_load_n( &drive->actual_pos_raw , __ATOMIC_RELAXED );
         int32_t vel_raw = __atomic_load_n( &drive->actual_vel_raw , __ATOMIC_RELAXED );
+        int32_t cur_raw = __atomic_load_n( &drive->actual_cur_raw , __ATOMIC_RELAXED );
         drive->actual_pos =  pos_raw / drive->pos_factor;
         drive->actual_vel =  vel_raw / drive->vel_factor;
+        drive->actual_cur =  cur_raw / drive->cur_factor;
     }
 }
 
@@ -603,12 +1075,12 @@ static void send_feedback( struct can402_cx *cx ) {
         cx->msg_state->X[i].vel = drive->actual_vel;
     }
     cx->msg_state->header.seq++;
-    sns_msg_set_time( &cx->msg_state->header, &cx->now, (int64_t)(opt_timeout_sec*1e9*2) );
+    sns_msg_set_time( &cx->msg_state->header, &cx->now, state_lifetime_ns() );
     // send message
-    ach_status_t r = ach_put( &cx->chan_state, cx->msg_state,
-                              sns_msg_motor_state_size(cx->msg_state) );
-    if( ACH_OK != r ) {
-        SNS_LOG( LOG_ERR, "Couldn't put ach frame: %s\n", ach_result_to_string(r) );
+    enum can402_chan_status r = can402_chan_put( cx->chan_state, cx->msg_state,
+                                                 sns_msg_motor_state_size(cx->msg_state) );
+    if( CAN402_CHAN_OK != r ) {
+        SNS_LOG( LOG_ERR, "Couldn't put state frame: %s\n", can402_chan_strerror(r) );
     }
 }
 
@@ -617,10 +1089,73 @@ static void send_feedback( struct can402_cx *cx ) {
  * - Main thread will do unit conversions and Ach posting
  */
 static void *feedback_recv_start( void *cx ) {
+    can402_rt_rx_thread( &opt_rt );
     feedback_recv( (struct can402_cx*)cx );
     return NULL;
 }
 
+static void recv_user( struct can402_cx *cx, size_t j, const struct can_frame *can ) {
+    struct canmat_402_drive *drive = & cx->drive_set.drive[j];
+    // validate
+    if( CANMAT_402_PDO_USER_LENGTH == can->can_dlc ) {
+        struct canmat_402_pdo_user fb;
+        canmat_402_pdo_user_unpack( &fb, can->data );
+        /* FIXME: portability */
+        __atomic_store_n( &drive->actual_pos_raw, fb.position_actual_value, __ATOMIC_RELAXED );
+        __atomic_store_n( &drive->actual_vel_raw, fb.velocity_actual_value, __ATOMIC_RELAXED );
+        if( opt_sync_period_ns ) {
+            // stamp with the SYNC that triggered it
+            pthread_mutex_lock( &cx->fb_mutex );
+            cx->fb_cycle[j] = __atomic_load_n( &cx->sync_cycle, __ATOMIC_ACQUIRE );
+            pthread_cond_signal( &cx->fb_cond );
+            pthread_mutex_unlock( &cx->fb_mutex );
+        }
+    } else {
+        SNS_LOG(LOG_WARNING, "PDO message to short: %d, expected %d\n",
+                can->can_dlc, CANMAT_402_PDO_USER_LENGTH);
+    }
+}
+
+static void recv_stat( struct can402_cx *cx, size_t j, const struct can_frame *can ) {
+    uint16_t stat_word;
+    if( can->can_dlc >= CANMAT_402_PDO_STAT_CUR_LENGTH ) {
+        // current, mapped in torque modes
+        struct canmat_402_pdo_stat_cur stat;
+        canmat_402_pdo_stat_cur_unpack( &stat, can->data );
+        stat_word = stat.statusword;
+        __atomic_store_n( &cx->drive_set.drive[j].actual_cur_raw, stat.current_actual_value,
+                          __ATOMIC_RELAXED );
+    } else if( can->can_dlc >= CANMAT_402_PDO_STAT_LENGTH ) {
+        struct canmat_402_pdo_stat stat;
+        canmat_402_pdo_stat_unpack( &stat, can->data );
+        stat_word = stat.statusword;
+    } else {
+        SNS_LOG(LOG_WARNING, "Status PDO message to short: %d, expected %d\n",
+                can->can_dlc, CANMAT_402_PDO_STAT_LENGTH);
+        return;
+    }
+    // only queue changes, the drive may send every SYNC
+    if( stat_word != cx->rx_stat_word[j] ) {
+        struct can402_event ev = { .type = CAN402_EVENT_STATUS, .code = stat_word };
+        if( 0 == can402_evq_push( &cx->evq[j], &ev ) ) {
+            cx->rx_stat_word[j] = stat_word;
+        }
+    }
+}
+
+/* EMCY subscriber, called in the RX thread */
+static void recv_emcy( void *cx_, uint8_t node, const struct canmat_emcy_entry *entry ) {
+    struct can402_cx *cx = (struct can402_cx*)cx_;
+    for( size_t j = 0; j < cx->drive_set.n; j ++ ) {
+        if( cx->drive_set.drive[j].node_id != node ) continue;
+        struct can402_event ev = { .type = CAN402_EVENT_EMCY,
+                                   .code = entry->code,
+                                   .reg = entry->reg };
+        memcpy( ev.msef, entry->msef, sizeof(ev.msef) );
+        can402_evq_push( &cx->evq[j], &ev );
+    }
+}
+
 static void feedback_recv( struct can402_cx *cx ) {
     while(!sns_cx.shutdown) {
         struct can_frame can;
@@ -634,27 +1169,27 @@ static void feedback_recv( struct can402_cx *cx ) {
             }
             continue;
         }
+        if( can.can_id > CANMAT_EMCY_COBID( 0 ) &&
+            can.can_id <= CANMAT_EMCY_COBID( CANMAT_NODE_MASK ) )
+        {
+            if( 8 != can.can_dlc ) {
+                SNS_LOG(LOG_WARNING, "EMCY message wrong size: %d, expected 8\n", can.can_dlc);
+            }
+            canmat_emcy_frame( &cx->emcy, &can, canmat_now_ns() );
+            continue;
+        }
         // TODO: Binary search is better (but this array is tiny)
         // filter non-TPDOs
         if( can.can_id >= CANMAT_TPDO_COBID( 0, 0 ) &&
             can.can_id <= CANMAT_TPDO_COBID( CANMAT_NODE_MASK, 0xFF ) )
-        { // got a TPDO
+        {
             for( size_t j = 0; j < cx->drive_set.n; j ++ ) {
                 struct canmat_402_drive *drive = & cx->drive_set.drive[j];
-                if( CANMAT_TPDO_COBID( drive->node_id, drive->tpdo_user ) ==
-                    (int)can.can_id ) {
-                    // found matching drive
-                    // validate
-                    if( 8 == can.can_dlc ) {
-                        canmat_scalar_t pos, vel;
-                        pos.u32 = canmat_byte_ldle32( &can.data[0] );
-                        vel.u32 = canmat_byte_ldle32( &can.data[4] );
-                        /* FIXME: portability */
-                        __atomic_store_n( &drive->actual_pos_raw, pos.i32, __ATOMIC_RELAXED );
-                        __atomic_store_n( &drive->actual_vel_raw, vel.i32, __ATOMIC_RELAXED );
-                    } else {
-                        SNS_LOG(LOG_WARNING, "PDO message to short: %d, expected 8\n", can.can_dlc);
-                    }
+                if( CANMAT_TPDO_COBID( drive->node_id, drive->tpdo_user ) == (int)can.can_id ) {
+                    recv_user( cx, j, &can );
+                } else if( 0 <= drive->tpdo_stat &&
+                           CANMAT_TPDO_COBID( drive->node_id, drive->tpdo_stat ) == (int)can.can_id ) {
+                    recv_stat( cx, j, &can );
                 }
             }
         }
@@ -670,5 +1205,8 @@ static void stop( struct can402_cx *cx ) {
                      canmat_iface_strerror( cx->drive_set.cif, r) );
         }
     }
+    if( cx->chan_ref ) can402_chan_close( cx->chan_ref );
+    if( cx->chan_state ) can402_chan_close( cx->chan_state );
+    if( cx->chan_event ) can402_chan_close( cx->chan_event );
     sns_end();
 }
@@ -0,0 +1,227 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CAN402_H
+#define CAN402_H
+
+/* Real-time runtime support for can402.
+ *
+ * These are only meant for the daemon's own threads: the control
+ * thread that sends references and SYNC, and the RX thread that
+ * receives TPDOs.
+ */
+
+#include <sched.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+/* Bytes of stack to touch in each RT thread so page faults don't
+ * happen in the loop */
+#define CAN402_RT_STACK_PREFAULT (256*1024)
+
+/** Scheduling and memory settings for the daemon threads */
+struct can402_rt {
+    int policy;             ///< SCHED_OTHER, SCHED_FIFO, SCHED_RR, or SCHED_DEADLINE
+    int priority;           ///< static priority for FIFO/RR
+    int64_t runtime_ns;     ///< SCHED_DEADLINE runtime
+    int64_t period_ns;      ///< SCHED_DEADLINE period and deadline
+    int cpu_ctrl;           ///< control thread CPU, or -1 for any
+    int cpu_rx;             ///< RX thread CPU, or -1 for any
+    _Bool lock_memory;      ///< lock all pages and prefault stacks
+};
+
+/* Reference and state transport
+ *
+ * Channels carry whole messages.  Readers either take every message
+ * in order (event channel) or only the newest one (reference
+ * channel), like Ach.  Timeouts are absolute on CLOCK_MONOTONIC.
+ */
+
+enum can402_chan_status {
+    CAN402_CHAN_OK = 0,         ///< got a message
+    CAN402_CHAN_MISSED_FRAME,   ///< got a message, but older ones were lost
+    CAN402_CHAN_STALE_FRAMES,   ///< no new message
+    CAN402_CHAN_TIMEOUT,        ///< no new message before the timeout
+    CAN402_CHAN_CANCELED,       ///< wait interrupted
+    CAN402_CHAN_OVERFLOW,       ///< message too big for buffer or channel
+    CAN402_CHAN_ERROR,          ///< other failure, see errno
+    CAN402_CHAN_CORRUPT         ///< channel is unusable
+};
+
+#define CAN402_CHAN_O_WAIT 0x1      ///< block until a new message or timeout
+#define CAN402_CHAN_O_LAST 0x2      ///< take the newest message, skipping older ones
+
+#define CAN402_CHAN_SIGCANCEL 0x1   ///< termination signals cancel waits
+
+struct can402_chan;
+
+struct can402_chan_vtable {
+    const char *type;
+    struct can402_chan *(*open)( const char *name, size_t frame_max, int flags );
+    enum can402_chan_status (*get)( struct can402_chan *chan, void *buf, size_t size,
+                                    size_t *frame_size, const struct timespec *abstime,
+                                    int options );
+    enum can402_chan_status (*put)( struct can402_chan *chan, const void *buf, size_t size );
+    void (*close)( struct can402_chan *chan );
+};
+
+struct can402_chan {
+    const struct can402_chan_vtable *vtable;
+};
+
+/** Lock-free ring in POSIX shared memory, no dependencies */
+extern const struct can402_chan_vtable can402_chan_shm;
+
+#ifdef HAVE_SNS
+/** Ach channel */
+extern const struct can402_chan_vtable can402_chan_ach;
+#endif
+
+/** Default transport type */
+extern const char *can402_chan_default_type;
+
+/** Open channel of the named transport type, or NULL on failure */
+struct can402_chan *can402_chan_open( const char *type, const char *name,
+                                      size_t frame_max, int flags );
+
+static inline enum can402_chan_status
+can402_chan_get( struct can402_chan *chan, void *buf, size_t size, size_t *frame_size,
+                 const struct timespec *abstime, int options )
+{
+    return chan->vtable->get( chan, buf, size, frame_size, abstime, options );
+}
+
+static inline enum can402_chan_status
+can402_chan_put( struct can402_chan *chan, const void *buf, size_t size ) {
+    return chan->vtable->put( chan, buf, size );
+}
+
+static inline void can402_chan_close( struct can402_chan *chan ) {
+    chan->vtable->close( chan );
+}
+
+const char *can402_chan_strerror( enum can402_chan_status status );
+
+/* Events from the RX thread to the control thread */
+
+/* Per-drive event queue length, must be a power of two */
+#define CAN402_EVQ_SIZE 16
+
+enum can402_event_type {
+    CAN402_EVENT_STATUS,    ///< statusword changed
+    CAN402_EVENT_EMCY       ///< EMCY message
+};
+
+struct can402_event {
+    enum can402_event_type type;
+    uint16_t code;          ///< statusword or EMCY error code
+    uint8_t reg;            ///< EMCY error register
+    uint8_t msef[5];        ///< EMCY manufacturer-specific field
+};
+
+/** Single-producer, single-consumer event queue.
+ *
+ * The RX thread pushes, the control thread pops.  Neither blocks.
+ */
+struct can402_evq {
+    unsigned head;          ///< next slot to write, owned by producer
+    unsigned tail;          ///< next slot to read, owned by consumer
+    _Bool overflow;         ///< an event was dropped
+    struct can402_event ev[CAN402_EVQ_SIZE];
+};
+
+/** Push event, return zero on success or nonzero when full */
+static inline int can402_evq_push( struct can402_evq *q, const struct can402_event *ev ) {
+    unsigned head = __atomic_load_n( &q->head, __ATOMIC_RELAXED );
+    unsigned tail = __atomic_load_n( &q->tail, __ATOMIC_ACQUIRE );
+    if( head - tail >= CAN402_EVQ_SIZE ) {
+        __atomic_store_n( &q->overflow, 1, __ATOMIC_RELAXED );
+        return -1;
+    }
+    q->ev[head & (CAN402_EVQ_SIZE-1)] = *ev;
+    __atomic_store_n( &q->head, head + 1, __ATOMIC_RELEASE );
+    return 0;
+}
+
+/** Pop event, return zero on success or nonzero when empty */
+static inline int can402_evq_pop( struct can402_evq *q, struct can402_event *ev ) {
+    unsigned tail = __atomic_load_n( &q->tail, __ATOMIC_RELAXED );
+    unsigned head = __atomic_load_n( &q->head, __ATOMIC_ACQUIRE );
+    if( head == tail ) return -1;
+    *ev = q->ev[tail & (CAN402_EVQ_SIZE-1)];
+    __atomic_store_n( &q->tail, tail + 1, __ATOMIC_RELEASE );
+    return 0;
+}
+
+/** Parse policy spec: other, fifo[:PRIO], rr[:PRIO], or deadline:RUNTIME_USEC */
+void can402_rt_parse_policy( struct can402_rt *rt, const char *arg );
+
+/** Lock current and future pages and keep malloc from returning memory to the OS */
+void can402_rt_lock_memory( void );
+
+/** Apply settings to the calling control thread */
+void can402_rt_ctrl_thread( const struct can402_rt *rt );
+
+/** Apply settings to the calling RX thread.
+ *
+ * Under SCHED_DEADLINE, the RX thread uses SCHED_FIFO at the given
+ * priority since it is event driven.
+ */
+void can402_rt_rx_thread( const struct can402_rt *rt );
+
+/** Install SIGUSR1 handler for statistics dumps */
+void can402_rt_sigusr1_init( void );
+
+/** Check and clear a pending SIGUSR1 */
+_Bool can402_rt_dump_requested( void );
+
+#endif //CAN402_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
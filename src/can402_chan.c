@@ -0,0 +1,99 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "can402_sns.h"
+#include "can402.h"
+
+#ifdef HAVE_SNS
+const char *can402_chan_default_type = "ach";
+#else
+const char *can402_chan_default_type = "shm";
+#endif
+
+static const struct can402_chan_vtable *chan_types[] = {
+#ifdef HAVE_SNS
+    &can402_chan_ach,
+#endif
+    &can402_chan_shm,
+    NULL
+};
+
+struct can402_chan *can402_chan_open( const char *type, const char *name,
+                                      size_t frame_max, int flags )
+{
+    for( const struct can402_chan_vtable **v = chan_types; *v; v++ ) {
+        if( 0 == strcmp( type, (*v)->type ) ) {
+            return (*v)->open( name, frame_max, flags );
+        }
+    }
+    SNS_LOG( LOG_ERR, "Unknown transport: '%s'\n", type );
+    return NULL;
+}
+
+const char *can402_chan_strerror( enum can402_chan_status status ) {
+    switch( status ) {
+    case CAN402_CHAN_OK:           return "OK";
+    case CAN402_CHAN_MISSED_FRAME: return "Missed frame";
+    case CAN402_CHAN_STALE_FRAMES: return "Stale frames";
+    case CAN402_CHAN_TIMEOUT:      return "Timeout";
+    case CAN402_CHAN_CANCELED:     return "Canceled";
+    case CAN402_CHAN_OVERFLOW:     return "Overflow";
+    case CAN402_CHAN_ERROR:        return "Error";
+    case CAN402_CHAN_CORRUPT:      return "Corrupt channel";
+    }
+    return "Unknown status";
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -0,0 +1,133 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Ach transport for can402 */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "can402_sns.h"
+#include "can402.h"
+
+struct chan_ach {
+    struct can402_chan chan;
+    ach_channel_t ach;
+};
+
+static struct can402_chan *chan_ach_open( const char *name, size_t frame_max, int flags ) {
+    (void)frame_max;
+    struct chan_ach *c = (struct chan_ach*)calloc( 1, sizeof(*c) );
+    if( NULL == c ) {
+        SNS_LOG( LOG_ERR, "Couldn't allocate channel '%s'\n", name );
+        return NULL;
+    }
+    c->chan.vtable = &can402_chan_ach;
+    sns_chan_open( &c->ach, name, NULL );
+    if( flags & CAN402_CHAN_SIGCANCEL ) {
+        ach_channel_t *chans[] = {&c->ach, NULL};
+        sns_sigcancel( chans, sns_sig_term_default );
+    }
+    return &c->chan;
+}
+
+static enum can402_chan_status chan_ach_get( struct can402_chan *chan, void *buf, size_t size,
+                                             size_t *frame_size, const struct timespec *abstime,
+                                             int options )
+{
+    struct chan_ach *c = (struct chan_ach*)chan;
+    int ach_opts = ( ((options & CAN402_CHAN_O_WAIT) ? ACH_O_WAIT : 0) |
+                     ((options & CAN402_CHAN_O_LAST) ? ACH_O_LAST : 0) );
+    ach_status_t r = ach_get( &c->ach, buf, size, frame_size, abstime, ach_opts );
+    switch( r ) {
+    case ACH_OK:            return CAN402_CHAN_OK;
+    case ACH_MISSED_FRAME:  return CAN402_CHAN_MISSED_FRAME;
+    case ACH_STALE_FRAMES:  return CAN402_CHAN_STALE_FRAMES;
+    case ACH_TIMEOUT:       return CAN402_CHAN_TIMEOUT;
+    case ACH_CANCELED:      return CAN402_CHAN_CANCELED;
+    case ACH_OVERFLOW:      return CAN402_CHAN_OVERFLOW;
+    case ACH_BUG:
+    case ACH_CORRUPT:
+        SNS_LOG( LOG_ERR, "ach_get: '%s'\n", ach_result_to_string(r) );
+        return CAN402_CHAN_CORRUPT;
+    default:
+        SNS_LOG( LOG_ERR, "ach_get: '%s'\n", ach_result_to_string(r) );
+        return CAN402_CHAN_ERROR;
+    }
+}
+
+static enum can402_chan_status chan_ach_put( struct can402_chan *chan, const void *buf, size_t size ) {
+    struct chan_ach *c = (struct chan_ach*)chan;
+    ach_status_t r = ach_put( &c->ach, buf, size );
+    switch( r ) {
+    case ACH_OK:        return CAN402_CHAN_OK;
+    case ACH_OVERFLOW:  return CAN402_CHAN_OVERFLOW;
+    default:
+        SNS_LOG( LOG_ERR, "ach_put: '%s'\n", ach_result_to_string(r) );
+        return CAN402_CHAN_ERROR;
+    }
+}
+
+static void chan_ach_close( struct can402_chan *chan ) {
+    struct chan_ach *c = (struct chan_ach*)chan;
+    ach_close( &c->ach );
+    free( c );
+}
+
+const struct can402_chan_vtable can402_chan_ach = {
+    .type = "ach",
+    .open = chan_ach_open,
+    .get = chan_ach_get,
+    .put = chan_ach_put,
+    .close = chan_ach_close
+};
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
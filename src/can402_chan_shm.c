@@ -0,0 +1,304 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Shared-memory transport for can402
+ *
+ * Each channel is a POSIX shared memory object holding a ring of
+ * fixed-size slots.  There is one writer per channel and any number
+ * of readers.  Readers never block the writer: each slot has a
+ * sequence number, odd while being written, and a reader that sees
+ * it change during a copy discards the copy.  Waiting readers sleep
+ * on a futex that the writer bumps on every put.
+ *
+ * Message layout is whatever the peers agree on; can402 uses the sns
+ * motor message structs.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "can402_sns.h"
+#include "can402.h"
+
+#define SHM_MAGIC  0x63343032   /* "c402" */
+#define SHM_NSLOTS 16
+
+struct shm_header {
+    uint32_t magic;         ///< written last by the creator
+    uint32_t nslots;        ///< number of slots
+    uint64_t slot_size;     ///< max message size
+    uint64_t head;          ///< number of messages ever put
+    uint32_t futex;         ///< bumped on every put
+};
+
+struct shm_slot {
+    uint64_t seq;           ///< 2*index+1 while writing, 2*index+2 when done
+    uint64_t size;          ///< message size
+    /* message follows */
+};
+
+struct chan_shm {
+    struct can402_chan chan;
+    struct shm_header *hdr;
+    size_t map_size;
+    size_t stride;
+    uint64_t next;          ///< index of next message to read
+};
+
+static size_t shm_stride( uint64_t slot_size ) {
+    return (sizeof(struct shm_slot) + slot_size + 7) & ~(size_t)7;
+}
+
+static size_t shm_size( uint32_t nslots, uint64_t slot_size ) {
+    return sizeof(struct shm_header) + nslots * shm_stride(slot_size);
+}
+
+static struct shm_slot *shm_slot( struct chan_shm *c, uint64_t i ) {
+    return (struct shm_slot*)( (uint8_t*)(c->hdr + 1) + (i % c->hdr->nslots) * c->stride );
+}
+
+static int futex( uint32_t *uaddr, int op, uint32_t val, const struct timespec *abstime ) {
+    return (int)syscall( SYS_futex, uaddr, op, val, abstime, NULL, FUTEX_BITSET_MATCH_ANY );
+}
+
+static struct can402_chan *chan_shm_open( const char *name, size_t frame_max, int flags ) {
+    (void)flags;  // a signal interrupts the futex wait anyway
+    char path[NAME_MAX];
+    if( (size_t)snprintf( path, sizeof(path), "%s%s", ('/' == name[0]) ? "" : "/", name )
+        >= sizeof(path) )
+    {
+        SNS_LOG( LOG_ERR, "Channel name too long: '%s'\n", name );
+        return NULL;
+    }
+
+    size_t size;
+    int creator = 0;
+    int fd = shm_open( path, O_RDWR | O_CREAT | O_EXCL, 0666 );
+    if( fd >= 0 ) {
+        creator = 1;
+        size = shm_size( SHM_NSLOTS, frame_max );
+        if( ftruncate( fd, (off_t)size ) ) goto FAIL;
+    } else if( EEXIST == errno ) {
+        fd = shm_open( path, O_RDWR, 0 );
+        if( fd < 0 ) goto FAIL;
+        // wait for the creator to size it
+        struct stat st;
+        for( int i = 0; ; i++ ) {
+            if( fstat( fd, &st ) ) goto FAIL;
+            if( (size_t)st.st_size >= sizeof(struct shm_header) ) break;
+            if( i > 1000 ) { errno = ETIMEDOUT; goto FAIL; }
+            usleep( 1000 );
+        }
+        size = (size_t)st.st_size;
+    } else {
+        goto FAIL;
+    }
+
+    struct chan_shm *c = (struct chan_shm*)calloc( 1, sizeof(*c) );
+    if( NULL == c ) goto FAIL;
+    c->chan.vtable = &can402_chan_shm;
+    c->map_size = size;
+    c->hdr = (struct shm_header*)mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( MAP_FAILED == c->hdr ) {
+        free( c );
+        SNS_LOG( LOG_ERR, "Couldn't map channel '%s': %s\n", path, strerror(errno) );
+        return NULL;
+    }
+
+    if( creator ) {
+        c->hdr->nslots = SHM_NSLOTS;
+        c->hdr->slot_size = frame_max;
+        __atomic_store_n( &c->hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE );
+    } else {
+        for( int i = 0; SHM_MAGIC != __atomic_load_n( &c->hdr->magic, __ATOMIC_ACQUIRE ); i++ ) {
+            if( i > 1000 ) {
+                SNS_LOG( LOG_ERR, "Channel '%s' was never initialized\n", path );
+                goto FAIL_MAP;
+            }
+            usleep( 1000 );
+        }
+        if( size < shm_size( c->hdr->nslots, c->hdr->slot_size ) ) {
+            SNS_LOG( LOG_ERR, "Channel '%s' is truncated\n", path );
+            goto FAIL_MAP;
+        }
+        // left over from a run with smaller messages, every put would fail
+        if( c->hdr->slot_size < frame_max ) {
+            SNS_LOG( LOG_ERR, "Channel '%s' holds %"PRIu64" byte messages, need %zu; remove it\n",
+                     path, c->hdr->slot_size, frame_max );
+            goto FAIL_MAP;
+        }
+    }
+    c->stride = shm_stride( c->hdr->slot_size );
+    c->next = __atomic_load_n( &c->hdr->head, __ATOMIC_ACQUIRE );
+    return &c->chan;
+
+FAIL_MAP:
+    munmap( c->hdr, c->map_size );
+    free( c );
+    return NULL;
+
+FAIL:
+    SNS_LOG( LOG_ERR, "Couldn't open channel '%s': %s\n", path, strerror(errno) );
+    if( fd >= 0 ) close( fd );
+    return NULL;
+}
+
+/* Copy message i out of the ring.  Returns CAN402_CHAN_MISSED_FRAME
+ * if it was overwritten. */
+static enum can402_chan_status shm_read( struct chan_shm *c, uint64_t i,
+                                         void *buf, size_t size, size_t *frame_size )
+{
+    struct shm_slot *slot = shm_slot( c, i );
+    uint64_t seq = __atomic_load_n( &slot->seq, __ATOMIC_ACQUIRE );
+    if( 2*i + 2 != seq ) return CAN402_CHAN_MISSED_FRAME;
+    size_t n = (size_t)__atomic_load_n( &slot->size, __ATOMIC_RELAXED );
+    if( n > c->hdr->slot_size ) return CAN402_CHAN_MISSED_FRAME; // torn
+    *frame_size = n;
+    if( n > size ) return CAN402_CHAN_OVERFLOW;
+    memcpy( buf, slot + 1, n );
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    if( seq != __atomic_load_n( &slot->seq, __ATOMIC_RELAXED ) ) return CAN402_CHAN_MISSED_FRAME;
+    return CAN402_CHAN_OK;
+}
+
+static enum can402_chan_status chan_shm_get( struct can402_chan *chan, void *buf, size_t size,
+                                             size_t *frame_size, const struct timespec *abstime,
+                                             int options )
+{
+    struct chan_shm *c = (struct chan_shm*)chan;
+    struct shm_header *hdr = c->hdr;
+    _Bool missed = 0;
+    *frame_size = 0;
+    for(;;) {
+        uint32_t wake = __atomic_load_n( &hdr->futex, __ATOMIC_ACQUIRE );
+        uint64_t head = __atomic_load_n( &hdr->head, __ATOMIC_ACQUIRE );
+        if( head > c->next ) {
+            uint64_t i;
+            if( options & CAN402_CHAN_O_LAST ) {
+                i = head - 1;
+            } else if( head - c->next > hdr->nslots ) {
+                i = head - hdr->nslots;
+                missed = 1;
+            } else {
+                i = c->next;
+            }
+            enum can402_chan_status r = shm_read( c, i, buf, size, frame_size );
+            switch( r ) {
+            case CAN402_CHAN_OK:
+                c->next = i + 1;
+                return missed ? CAN402_CHAN_MISSED_FRAME : CAN402_CHAN_OK;
+            case CAN402_CHAN_MISSED_FRAME:
+                // overwritten while we looked, try again
+                c->next = i + 1;
+                missed = 1;
+                continue;
+            default:
+                c->next = i + 1;
+                return r;
+            }
+        }
+        if( ! (options & CAN402_CHAN_O_WAIT) ) return CAN402_CHAN_STALE_FRAMES;
+        // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC time
+        if( futex( &hdr->futex, FUTEX_WAIT_BITSET, wake, abstime ) ) {
+            switch( errno ) {
+            case EAGAIN:    break;
+            case ETIMEDOUT: return CAN402_CHAN_TIMEOUT;
+            case EINTR:     return CAN402_CHAN_CANCELED;
+            default:        return CAN402_CHAN_ERROR;
+            }
+        }
+    }
+}
+
+static enum can402_chan_status chan_shm_put( struct can402_chan *chan, const void *buf, size_t size ) {
+    struct chan_shm *c = (struct chan_shm*)chan;
+    struct shm_header *hdr = c->hdr;
+    if( size > hdr->slot_size ) return CAN402_CHAN_OVERFLOW;
+
+    uint64_t i = __atomic_load_n( &hdr->head, __ATOMIC_RELAXED );
+    struct shm_slot *slot = shm_slot( c, i );
+    __atomic_store_n( &slot->seq, 2*i + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    memcpy( slot + 1, buf, size );
+    __atomic_store_n( &slot->size, size, __ATOMIC_RELAXED );
+    __atomic_store_n( &slot->seq, 2*i + 2, __ATOMIC_RELEASE );
+    __atomic_store_n( &hdr->head, i + 1, __ATOMIC_RELEASE );
+
+    __atomic_add_fetch( &hdr->futex, 1, __ATOMIC_RELEASE );
+    futex( &hdr->futex, FUTEX_WAKE, INT_MAX, NULL );
+    return CAN402_CHAN_OK;
+}
+
+static void chan_shm_close( struct can402_chan *chan ) {
+    struct chan_shm *c = (struct chan_shm*)chan;
+    munmap( c->hdr, c->map_size );
+    free( c );
+}
+
+const struct can402_chan_vtable can402_chan_shm = {
+    .type = "shm",
+    .open = chan_shm_open,
+    .get = chan_shm_get,
+    .put = chan_shm_put,
+    .close = chan_shm_close
+};
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
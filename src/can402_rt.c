@@ -0,0 +1,210 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+
+#include "socanmatic.h"
+#include "socanmatic_private.h"
+
+#include "can402_sns.h"
+
+#include "can402.h"
+
+/* glibc has no wrapper for sched_setattr */
+struct can402_sched_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+static int set_deadline( const struct can402_rt *rt ) {
+#ifdef SYS_sched_setattr
+    struct can402_sched_attr attr;
+    memset( &attr, 0, sizeof(attr) );
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = (uint64_t)rt->runtime_ns;
+    attr.sched_deadline = (uint64_t)rt->period_ns;
+    attr.sched_period = (uint64_t)rt->period_ns;
+    return syscall( SYS_sched_setattr, 0, &attr, 0 ) ? errno : 0;
+#else
+    (void)rt;
+    return ENOSYS;
+#endif
+}
+
+static void set_sched( int policy, int priority, int cpu, const char *name ) {
+    int r;
+    if( cpu >= 0 ) {
+        cpu_set_t set;
+        CPU_ZERO( &set );
+        CPU_SET( (size_t)cpu, &set );
+        if( (r = pthread_setaffinity_np( pthread_self(), sizeof(set), &set )) ) {
+            SNS_DIE( "Couldn't pin %s thread to CPU %d: %s\n", name, cpu, strerror(r) );
+        }
+    }
+    if( SCHED_FIFO == policy || SCHED_RR == policy ) {
+        struct sched_param param;
+        memset( &param, 0, sizeof(param) );
+        param.sched_priority = priority;
+        if( (r = pthread_setschedparam( pthread_self(), policy, &param )) ) {
+            SNS_DIE( "Couldn't set %s thread priority: %s\n", name, strerror(r) );
+        }
+    }
+}
+
+static void prefault_stack( void ) {
+    volatile unsigned char buf[CAN402_RT_STACK_PREFAULT];
+    for( size_t i = 0; i < sizeof(buf); i += 1024 ) {
+        buf[i] = 0;
+    }
+}
+
+static int policy_is( const char *arg, size_t n, const char *name ) {
+    return n == strlen(name) && 0 == strncasecmp( arg, name, n );
+}
+
+void can402_rt_parse_policy( struct can402_rt *rt, const char *arg ) {
+    const char *colon = strchr( arg, ':' );
+    size_t n = colon ? (size_t)(colon - arg) : strlen(arg);
+    if( policy_is( arg, n, "other" ) ) {
+        rt->policy = SCHED_OTHER;
+    } else if( policy_is( arg, n, "fifo" ) ) {
+        rt->policy = SCHED_FIFO;
+    } else if( policy_is( arg, n, "rr" ) ) {
+        rt->policy = SCHED_RR;
+    } else if( policy_is( arg, n, "deadline" ) ) {
+        rt->policy = SCHED_DEADLINE;
+        SNS_REQUIRE( colon, "SCHED_DEADLINE needs a runtime, e.g., deadline:200\n" );
+        rt->runtime_ns = 1000 * (int64_t)parse_u( colon + 1, 0, 1000000 );
+        rt->priority = sched_get_priority_min( SCHED_FIFO ); // for RX thread
+        return;
+    } else {
+        SNS_DIE( "Unknown scheduling policy: '%s'\n", arg );
+    }
+    if( colon ) {
+        int lo = sched_get_priority_min( rt->policy );
+        int hi = sched_get_priority_max( rt->policy );
+        unsigned long u = parse_u( colon + 1, 0, UINT32_MAX );
+        SNS_REQUIRE( u >= (unsigned long)lo && u <= (unsigned long)hi,
+                     "Priority for %.*s must be %d to %d\n", (int)n, arg, lo, hi );
+        rt->priority = (int)u;
+    } else if( SCHED_OTHER != rt->policy ) {
+        rt->priority = sched_get_priority_min( rt->policy );
+    }
+}
+
+void can402_rt_lock_memory( void ) {
+    if( mlockall( MCL_CURRENT | MCL_FUTURE ) ) {
+        SNS_DIE( "Couldn't lock memory: %s\n", strerror(errno) );
+    }
+    // keep freed memory in the process, and never use mmap for malloc
+    mallopt( M_TRIM_THRESHOLD, -1 );
+    mallopt( M_MMAP_MAX, 0 );
+}
+
+void can402_rt_ctrl_thread( const struct can402_rt *rt ) {
+    if( rt->lock_memory ) prefault_stack();
+    set_sched( rt->policy, rt->priority, rt->cpu_ctrl, "control" );
+    if( SCHED_DEADLINE == rt->policy ) {
+        SNS_REQUIRE( rt->period_ns > 0 && rt->runtime_ns <= rt->period_ns,
+                     "SCHED_DEADLINE needs a SYNC period no less than the runtime\n" );
+        int r = set_deadline( rt );
+        if( r ) SNS_DIE( "Couldn't set SCHED_DEADLINE: %s\n", strerror(r) );
+    }
+}
+
+void can402_rt_rx_thread( const struct can402_rt *rt ) {
+    if( rt->lock_memory ) prefault_stack();
+    set_sched( SCHED_DEADLINE == rt->policy ? SCHED_FIFO : rt->policy,
+               rt->priority, rt->cpu_rx, "RX" );
+}
+
+static volatile sig_atomic_t dump_requested = 0;
+
+static void sigusr1_handler( int sig ) {
+    (void)sig;
+    dump_requested = 1;
+}
+
+void can402_rt_sigusr1_init( void ) {
+    struct sigaction act;
+    memset( &act, 0, sizeof(act) );
+    act.sa_handler = sigusr1_handler;
+    sigemptyset( &act.sa_mask );
+    if( sigaction( SIGUSR1, &act, NULL ) ) {
+        SNS_DIE( "Couldn't install SIGUSR1 handler: %s\n", strerror(errno) );
+    }
+}
+
+_Bool can402_rt_dump_requested( void ) {
+    if( dump_requested ) {
+        dump_requested = 0;
+        return 1;
+    }
+    return 0;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
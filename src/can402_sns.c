@@ -0,0 +1,138 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Stand-in for the parts of sns used by can402, see can402_sns.h */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "can402_sns.h"
+
+struct sns_cx sns_cx;
+
+static void sig_term( int sig ) {
+    (void)sig;
+    sns_cx.shutdown = 1;
+}
+
+void sns_init( void ) {
+    struct sigaction act;
+    memset( &act, 0, sizeof(act) );
+    act.sa_handler = sig_term;
+    sigemptyset( &act.sa_mask );
+    sigaction( SIGINT, &act, NULL );
+    sigaction( SIGTERM, &act, NULL );
+}
+
+void sns_start( void ) { }
+void sns_end( void ) { }
+
+size_t sns_msg_motor_ref_size_n( uint32_t n ) {
+    return offsetof(struct sns_msg_motor_ref, u) + n * sizeof(double);
+}
+
+size_t sns_msg_motor_state_size_n( uint32_t n ) {
+    return offsetof(struct sns_msg_motor_state, X) + n * sizeof(struct sns_msg_motor_state_elt);
+}
+
+size_t sns_msg_motor_state_size( const struct sns_msg_motor_state *msg ) {
+    return sns_msg_motor_state_size_n( msg->header.n );
+}
+
+struct sns_msg_motor_ref *sns_msg_motor_ref_heap_alloc( uint32_t n ) {
+    struct sns_msg_motor_ref *msg = (struct sns_msg_motor_ref*)calloc( 1, sns_msg_motor_ref_size_n(n) );
+    msg->header.n = n;
+    return msg;
+}
+
+struct sns_msg_motor_state *sns_msg_motor_state_heap_alloc( uint32_t n ) {
+    struct sns_msg_motor_state *msg = (struct sns_msg_motor_state*)calloc( 1, sns_msg_motor_state_size_n(n) );
+    msg->header.n = n;
+    return msg;
+}
+
+int sns_msg_motor_ref_check_size( const struct sns_msg_motor_ref *msg, size_t size ) {
+    return ( size < sizeof(struct sns_msg_header) ||
+             size != sns_msg_motor_ref_size_n(msg->header.n) );
+}
+
+void sns_msg_motor_ref_dump( FILE *out, const struct sns_msg_motor_ref *msg ) {
+    fprintf( out, "motor_ref: seq %"PRId64", mode %d:", msg->header.seq, msg->mode );
+    for( uint32_t i = 0; i < msg->header.n; i++ ) {
+        fprintf( out, " %f", msg->u[i] );
+    }
+    fputc( '\n', out );
+}
+
+static int64_t ts_ns( int64_t sec, int64_t nsec ) {
+    return sec * 1000000000 + nsec;
+}
+
+int sns_msg_is_expired( const struct sns_msg_header *msg, const struct timespec *now ) {
+    return ts_ns( msg->sec, msg->nsec ) + msg->dur_nsec < ts_ns( now->tv_sec, now->tv_nsec );
+}
+
+void sns_msg_set_time( struct sns_msg_header *msg, const struct timespec *now, int64_t duration_ns ) {
+    msg->sec = now->tv_sec;
+    msg->nsec = now->tv_nsec;
+    msg->dur_nsec = duration_ns;
+}
+
+struct timespec sns_time_add_ns( struct timespec ts, int64_t ns ) {
+    int64_t t = ts_ns( ts.tv_sec, ts.tv_nsec ) + ns;
+    struct timespec r;
+    r.tv_sec = (time_t)(t / 1000000000);
+    r.tv_nsec = (long)(t % 1000000000);
+    return r;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
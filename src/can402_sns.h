@@ -0,0 +1,163 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CAN402_SNS_H
+#define CAN402_SNS_H
+
+/* The parts of sns used by can402.
+ *
+ * With sns, this is just sns.h.  Without it, a minimal stand-in
+ * provides logging, option handling, signal-driven shutdown, and the
+ * motor messages, so can402 can run with the shm transport on a stock
+ * system.  Messages built this way are not binary compatible with
+ * sns.
+ */
+
+#ifdef HAVE_SNS
+
+#include <sns.h>
+
+#else /* HAVE_SNS */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+
+struct sns_cx {
+    int verbosity;
+    volatile sig_atomic_t shutdown;
+};
+
+extern struct sns_cx sns_cx;
+
+#define SNS_LOG_PRIORITY(priority) ( (priority) <= LOG_NOTICE + sns_cx.verbosity )
+
+#define SNS_LOG( priority, ... )                                \
+    do {                                                        \
+        if( SNS_LOG_PRIORITY(priority) ) {                      \
+            fprintf( stderr, __VA_ARGS__ );                     \
+        }                                                       \
+    } while(0)
+
+#define SNS_DIE( ... )                                          \
+    do {                                                        \
+        fprintf( stderr, __VA_ARGS__ );                         \
+        exit( EXIT_FAILURE );                                   \
+    } while(0)
+
+#define SNS_REQUIRE( test, ... )                                \
+    do {                                                        \
+        if( !(test) ) SNS_DIE( __VA_ARGS__ );                   \
+    } while(0)
+
+#define SNS_OPTSTRING "vq"
+
+#define SNS_OPTCASES                                            \
+    case 'v': sns_cx.verbosity++; break;                        \
+    case 'q': sns_cx.verbosity--; break;
+
+/** Install termination signal handlers */
+void sns_init( void );
+void sns_start( void );
+void sns_end( void );
+
+struct sns_msg_header {
+    int64_t sec;            ///< time of message
+    int64_t nsec;
+    int64_t dur_nsec;       ///< valid duration of message
+    int64_t seq;            ///< sequence number
+    uint32_t n;             ///< number of elements
+};
+
+enum sns_motor_mode {
+    SNS_MOTOR_MODE_HALT = 1,
+    SNS_MOTOR_MODE_RESET,
+    SNS_MOTOR_MODE_POS,
+    SNS_MOTOR_MODE_VEL,
+    SNS_MOTOR_MODE_TORQ,
+    SNS_MOTOR_MODE_CUR,
+    SNS_MOTOR_MODE_POS_OFFSET
+};
+
+struct sns_msg_motor_ref {
+    struct sns_msg_header header;
+    enum sns_motor_mode mode;
+    double u[1];
+};
+
+struct sns_msg_motor_state_elt {
+    double pos;
+    double vel;
+};
+
+struct sns_msg_motor_state {
+    struct sns_msg_header header;
+    enum sns_motor_mode mode;
+    struct sns_msg_motor_state_elt X[1];
+};
+
+size_t sns_msg_motor_ref_size_n( uint32_t n );
+size_t sns_msg_motor_state_size_n( uint32_t n );
+size_t sns_msg_motor_state_size( const struct sns_msg_motor_state *msg );
+struct sns_msg_motor_ref *sns_msg_motor_ref_heap_alloc( uint32_t n );
+struct sns_msg_motor_state *sns_msg_motor_state_heap_alloc( uint32_t n );
+int sns_msg_motor_ref_check_size( const struct sns_msg_motor_ref *msg, size_t size );
+void sns_msg_motor_ref_dump( FILE *out, const struct sns_msg_motor_ref *msg );
+
+int sns_msg_is_expired( const struct sns_msg_header *msg, const struct timespec *now );
+void sns_msg_set_time( struct sns_msg_header *msg, const struct timespec *now, int64_t duration_ns );
+struct timespec sns_time_add_ns( struct timespec ts, int64_t ns );
+
+#endif /* HAVE_SNS */
+
+#endif //CAN402_SNS_H
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -52,6 +52,12 @@
 #include <assert.h>
 #include <poll.h>
 #include <time.h>
+#include <signal.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "socanmatic.h"
 #include "socanmatic/dict402.h"
@@ -66,6 +72,15 @@ static const char *opt_api = "socketcan";
 static const char **opt_pos = NULL;
 static size_t opt_npos = 0;
 static size_t opt_timestamp = 0;
+static const canmat_dict_t *opt_dict = &canmat_dict402;
+static const char **opt_eds = NULL;
+static size_t opt_n_eds = 0;
+static unsigned long opt_sync_period_us = CANMAT_SYNC_PERIOD_NS / 1000;
+static unsigned long opt_sync_counter = 0;
+static unsigned long opt_sync_count = 0;
+static unsigned long opt_scan_timeout_ms = 200;
+static int opt_scan_heartbeat = 0;
+static unsigned long opt_kbps = 1000;
 
 //uint16_t opt_canid = 0;
 //uint8_t opt_can_dlc = 0;
@@ -114,6 +129,13 @@ static int cmd_set( can_set_t *canset, size_t n, const char **args );
 static int cmd_nmt( can_set_t *canset, size_t n, const char **args );
 static int cmd_probe( can_set_t *canset, size_t n, const char **args );
 static int cmd_map_rpdo( can_set_t *canset, size_t n, const char **args );
+static int cmd_sync( can_set_t *canset, size_t n, const char **args );
+static int cmd_scan( can_set_t *canset, size_t n, const char **args );
+static int cmd_snapshot( can_set_t *canset, size_t n, const char **args );
+static int cmd_restore( can_set_t *canset, size_t n, const char **args );
+static int cmd_dcf_dl( can_set_t *canset, size_t n, const char **args );
+static int cmd_configure( can_set_t *canset, size_t n, const char **args );
+static int cmd_flash( can_set_t *canset, size_t n, const char **args );
 
 static void verbf( int level , const char fmt[], ...)          ATTR_PRINTF(2,3);
 static void fail( const char fmt[], ...)          ATTR_PRINTF(1,2);
@@ -144,6 +166,13 @@ static cmd_fun_t posarg_cmd( const char *arg ) {
                  {"nmt", cmd_nmt},
                  {"probe", cmd_probe},
                  {"map-rpdo", cmd_map_rpdo },
+                 {"sync", cmd_sync },
+                 {"scan", cmd_scan },
+                 {"snapshot", cmd_snapshot },
+                 {"restore", cmd_restore },
+                 {"dcf-dl", cmd_dcf_dl },
+                 {"configure", cmd_configure },
+                 {"flash", cmd_flash },
                  {NULL, NULL} };
     size_t i;
     for( i = 0; cmds[i].name != NULL; i ++ ) {
@@ -177,8 +206,17 @@ int main( int argc, char ** argv ) {
 
     can_set_t canset = {0};
 
+    static const struct option long_options[] = {
+        {"period",  required_argument, NULL, 'P'},
+        {"counter", required_argument, NULL, 'C'},
+        {"count",   required_argument, NULL, 'N'},
+        {"timeout", required_argument, NULL, 'T'},
+        {"heartbeat", no_argument,     NULL, 'B'},
+        {"bitrate", required_argument, NULL, 'R'},
+        {NULL, 0, NULL, 0} };
+
     int c, i = 0;
-    while( (c = getopt( argc, argv, "tvhH?Vf:a:")) != -1 ) {
+    while( (c = getopt_long( argc, argv, "tvhH?Vf:a:d:", long_options, NULL )) != -1 ) {
         switch(c) {
         case 'V':   /* version     */
             puts( "canmat " PACKAGE_VERSION "\n"
@@ -202,6 +240,28 @@ int main( int argc, char ** argv ) {
         case 'f':   /* interface  */
             set_iface( &canset, opt_api, optarg );
             break;
+        case 'd':   /* dictionary  */
+            opt_eds = (const char**) realloc( (void*)opt_eds, sizeof(char*) * (opt_n_eds+1) );
+            opt_eds[opt_n_eds++] = optarg;
+            break;
+        case 'P':   /* sync period  */
+            opt_sync_period_us = parse_u( optarg, 10, UINT32_MAX );
+            break;
+        case 'C':   /* sync counter overflow  */
+            opt_sync_counter = parse_u( optarg, 10, 240 );
+            break;
+        case 'N':   /* number of syncs  */
+            opt_sync_count = parse_u( optarg, 10, ULONG_MAX );
+            break;
+        case 'T':   /* scan deadline  */
+            opt_scan_timeout_ms = parse_u( optarg, 10, UINT32_MAX );
+            break;
+        case 'B':   /* scan heartbeats  */
+            opt_scan_heartbeat = 1;
+            break;
+        case 'R':   /* bus bitrate  */
+            opt_kbps = parse_u( optarg, 10, 1000 );
+            break;
         case '?':   /* help     */
         case 'h':
         case 'H':
@@ -213,6 +273,15 @@ int main( int argc, char ** argv ) {
                   "  -a api_type,              CAN API, e.g, socketcan, ntcan\n"
                   "  -f interface,             CAN interface (multiple allowed)\n"
                   "  -t,                       Timestamp output\n"
+                  "  -d file.eds,              Object dictionary from EDS/DCF file (multiple\n"
+                  "                            allowed, replaces the built-in DS402 dictionary)\n"
+                  "  --period=us,              SYNC period in microseconds (sync command)\n"
+                  "  --counter=max,            SYNC counter overflow value, 2-240 (sync command)\n"
+                  "  --count=n,                Number of SYNCs to send, 0 for no limit (sync command)\n"
+                  "  --timeout=ms,             Time to wait for all responses (scan command)\n"
+                  "  --heartbeat,              Also list nodes by heartbeat, waiting out the\n"
+                  "                            whole timeout (scan command)\n"
+                  "  --bitrate=kbps,           Bus bitrate for load reports, default 1000\n"
                   "  -?,                       Give program help list\n"
                   "  -V,                       Print program version\n"
                   "\n"
@@ -231,6 +300,15 @@ int main( int argc, char ** argv ) {
                   "  canmat nmt node (start|stop|preop|reset-(node|com))\n"
                   "                                               Send an NMT message\n"
                   "  canmat map-rpdo node pdo-num param-name      Establish RPDO mapping\n"
+                  "  canmat --period=1000 sync                    Produce SYNC and report jitter\n"
+                  "  canmat scan                                  List nodes with their identity\n"
+                  "  canmat snapshot node [node...] file          Save all readable objects of nodes\n"
+                  "  canmat restore file [node...]                Write back objects that differ, to the\n"
+                  "                                               saved nodes or the first one to each node\n"
+                  "  canmat dcf-dl node file.dcf [target]         Download DCF values of node as one concise\n"
+                  "                                               DCF to 1F22h of target (default node)\n"
+                  "  canmat configure file.dcf node [node...]     Write DCF values to all nodes at once\n"
+                  "  canmat flash node [node...] image            Download program image to all nodes at once\n"
                   "\n"
                   "Report bugs to <ntd@gatech.edu>"
                 );
@@ -246,6 +324,16 @@ int main( int argc, char ** argv ) {
 
     hard_assert( opt_command, "canmat: missing command.\nTry `canmat -H' for more information.\n");
 
+    if( opt_n_eds ) {
+        struct canmat_dict *dict;
+        struct canmat_eds_error err;
+        canmat_status_t r = canmat_dict_load_eds( opt_n_eds, opt_eds, &dict, &err );
+        hard_assert( CANMAT_OK == r, "Couldn't load dictionary %s:%u: %s\n",
+                     err.file ? err.file : "", err.line,
+                     CANMAT_ERR_OS == r ? strerror(errno) : canmat_strerror(r) );
+        opt_dict = dict;
+    }
+
 
     // TODO: check fds if multiple interfaces
 
@@ -276,7 +364,7 @@ static void pollin_raw( struct can_frame *can ) {
 }
 
 static void pollin_display( struct can_frame *can ) {
-    canmat_display( &canmat_dict402, can );
+    canmat_display( opt_dict, can );
 }
 
 static void pollin1( const char *name, canmat_iface_t *cif, void (printer)(struct can_frame*) ) {
@@ -443,7 +531,7 @@ static int cmd_dict_dl( can_set_t *canset, size_t n, const char **arg) {
     const char *param = arg[1];
     const char *val = arg[2];
 
-    canmat_obj_t *obj = canmat_dict_search_name( &canmat_dict402, param );
+    canmat_obj_t *obj = canmat_dict_search_name( opt_dict, param );
 
     hard_assert( obj, "Object `%s' not found\n", param );
     hard_assert( 1 == canset->n, "Can only send on 1 interface\n" );
@@ -467,7 +555,7 @@ static int cmd_dict_ul( can_set_t *canset, size_t n, const char **arg ) {
     uint8_t node = (uint8_t)parse_uhex( arg[0], CANMAT_NODE_MASK );
     const char *param = arg[1];
 
-    canmat_obj_t *obj = canmat_dict_search_name( &canmat_dict402, param );
+    canmat_obj_t *obj = canmat_dict_search_name( opt_dict, param );
     hard_assert( obj, "Object `%s' not found\n", param );
 
     hard_assert( 1 == canset->n, "Can only send on 1 interface\n" );
@@ -571,7 +659,7 @@ static int probe_pdo( can_set_t *canset, size_t n, const char **arg) {
 
     hard_assert( 1 == canset->n, "Only one CAN interface supported\n");
 
-    canmat_status_t r = canmat_probe_pdo( &canmat_dict402, canset->cif[0], node );
+    canmat_status_t r = canmat_probe_pdo( opt_dict, canset->cif[0], node );
 
     hard_assert( CANMAT_OK == r, "Probing failed: %s\n", canmat_iface_strerror(canset->cif[0], r) );
 
@@ -599,7 +687,7 @@ static int cmd_map_rpdo( can_set_t *canset, size_t n, const char **arg ) {
     const char *param = arg[2];
 
 
-    canmat_obj_t *obj = canmat_dict_search_name( &canmat_dict402, param );
+    canmat_obj_t *obj = canmat_dict_search_name( opt_dict, param );
     hard_assert( NULL != obj, "Unknown parameter: %s\n", param );
 
     uint32_t err;
@@ -616,6 +704,464 @@ static int cmd_map_rpdo( can_set_t *canset, size_t n, const char **arg ) {
     return 0;
 }
 
+static volatile sig_atomic_t sync_stop = 0;
+
+static void sync_sighandler( int sig ) {
+    (void)sig;
+    sync_stop = 1;
+}
+
+static int cmd_sync( can_set_t *canset, size_t n, const char **arg ) {
+    (void)arg;
+    hard_assert( 0 == n, "Extra arguments\n");
+    hard_assert( 1 == canset->n, "Only one CAN interface supported\n");
+
+    struct canmat_sync_producer p;
+    canmat_status_t r = canmat_sync_producer_init( &p, canset->cif[0],
+                                                   (int64_t)opt_sync_period_us * 1000,
+                                                   (uint8_t)opt_sync_counter );
+    hard_assert( CANMAT_OK == r, "Invalid SYNC period or counter\n" );
+
+    struct sigaction act;
+    memset( &act, 0, sizeof(act) );
+    act.sa_handler = sync_sighandler;
+    sigaction( SIGINT, &act, NULL );
+    sigaction( SIGTERM, &act, NULL );
+
+    canmat_sync_producer_start( &p );
+    verbf( 1, "SYNC every %lu us, tx timestamps %s\n", opt_sync_period_us,
+           p.tx_stamp ? "on" : "off" );
+    while( !sync_stop && (0 == opt_sync_count || p.sent < opt_sync_count) ) {
+        r = canmat_sync_producer_step( &p );
+        if( CANMAT_ERR_OS == r && EINTR == errno ) continue;
+        hard_assert( CANMAT_OK == r, "Couldn't send SYNC: %s\n",
+                     canmat_iface_strerror(canset->cif[0], r) );
+    }
+    canmat_sync_producer_print( stdout, &p );
+
+    return 0;
+}
+
+/* Identity objects read from each node by scan */
+static const struct {
+    uint16_t index;
+    uint8_t subindex;
+} scan_obj[] = { {0x1000, 0},       // device type
+                 {0x1018, 1},       // vendor-ID
+                 {0x1018, 2},       // product code
+                 {0x1018, 3} };     // revision number
+
+#define SCAN_N_OBJ (sizeof(scan_obj)/sizeof(scan_obj[0]))
+
+struct scan_node {
+    struct canmat_sdo_req req[SCAN_N_OBJ];
+    unsigned queued;                  ///< bitmask of req handed to the dispatcher
+};
+
+static int64_t scan_now( void ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void scan_done( struct canmat_sdo_req *req ) {
+    // a send that failed on a full queue is queued again
+    if( CANMAT_ERR_OS == req->status ) {
+        struct scan_node *s = (struct scan_node*)req->cx;
+        s->queued &= ~(1u << (req - s->req));
+    }
+}
+
+static void scan_recv( void *cx, const struct can_frame *can ) {
+    canmat_nmt_master_frame( (struct canmat_nmt_master*)cx, can, scan_now() );
+}
+
+/* Queue every request not yet queued.
+ *
+ * Sends go out back-to-back, so the interface queue may fill.  Return
+ * 1 when requests are left for later.
+ */
+static int scan_queue( struct canmat_dispatch *d, struct scan_node *node ) {
+    for( size_t i = 1; i <= CANMAT_NODE_MASK; i ++ ) {
+        for( size_t j = 0; j < SCAN_N_OBJ; j ++ ) {
+            if( node[i].queued & (1u << j) ) continue;
+            canmat_status_t r = canmat_dispatch_sdo_ul( d, &node[i].req[j] );
+            if( CANMAT_OK == r ) {
+                node[i].queued |= 1u << j;
+            } else if( CANMAT_ERR_OS == r &&
+                       (ENOBUFS == d->cif->err || EAGAIN == d->cif->err) ) {
+                return 1;
+            } else {
+                fail( "Couldn't send request: %s\n", canmat_iface_strerror(d->cif, r) );
+            }
+        }
+    }
+    return 0;
+}
+
+static const char *scan_state( uint8_t state ) {
+    switch( state ) {
+    case CANMAT_NMT_ERR_BOOT:    return "boot";
+    case CANMAT_NMT_ERR_STOPPED: return "stopped";
+    case CANMAT_NMT_ERR_OP:      return "operational";
+    case CANMAT_NMT_ERR_PRE_OP:  return "pre-operational";
+    default:                     return "-";
+    }
+}
+
+static void scan_print_u32( const struct canmat_sdo_req *req ) {
+    if( CANMAT_OK == req->status ) printf( "  0x%08"PRIx32, req->resp.data.u32 );
+    else printf( "  %-10s", "-" );
+}
+
+static int cmd_scan( can_set_t *canset, size_t n, const char **arg ) {
+    (void)arg;
+    hard_assert( 0 == n, "Extra arguments\n");
+    hard_assert( 1 == canset->n, "Only one CAN interface supported\n");
+
+    struct canmat_dispatch d;
+    canmat_dispatch_init( &d, canset->cif[0] );
+
+    int64_t start = scan_now();
+    int64_t deadline = start + (int64_t)opt_scan_timeout_ms * 1000000;
+
+    struct canmat_nmt_master *m = NULL;
+    if( opt_scan_heartbeat ) {
+        m = (struct canmat_nmt_master*) malloc( sizeof(*m) );
+        canmat_nmt_master_init( m, CANMAT_NMT_TICK_NS, start, NULL, NULL );
+        d.recv = scan_recv;
+        d.recv_cx = m;
+    }
+
+    struct scan_node *node = (struct scan_node*) calloc( CANMAT_NODE_MASK+1, sizeof(node[0]) );
+    for( size_t i = 1; i <= CANMAT_NODE_MASK; i ++ ) {
+        for( size_t j = 0; j < SCAN_N_OBJ; j ++ ) {
+            struct canmat_sdo_req *req = &node[i].req[j];
+            req->msg.node = (uint8_t)i;
+            req->msg.index = scan_obj[j].index;
+            req->msg.subindex = scan_obj[j].subindex;
+            req->msg.data_type = CANMAT_DATA_TYPE_UNSIGNED32;
+            req->status = CANMAT_ERR_TIMEOUT;
+            req->done = scan_done;
+            req->cx = &node[i];
+        }
+    }
+
+    // every node's first request goes out now, the rest as each node answers
+    struct pollfd pfd = { .fd = canset->cif[0]->fd, .events = POLLIN };
+    for(;;) {
+        int backlog = scan_queue( &d, node );
+        if( !backlog && 0 == d.pending && !opt_scan_heartbeat ) break;
+
+        int64_t now = scan_now();
+        if( now >= deadline ) break;
+        int64_t wait_ms = (deadline - now + 999999) / 1000000;
+        if( backlog && wait_ms > 1 ) wait_ms = 1;
+
+        int k = poll( &pfd, 1, (int)wait_ms );
+        if( k < 0 && EINTR != errno ) fail( "poll failed: %s\n", strerror(errno) );
+        if( k > 0 ) {
+            canmat_status_t r = canmat_dispatch_step( &d );
+            hard_assert( CANMAT_OK == r, "Couldn't receive: %s\n",
+                         canmat_iface_strerror(canset->cif[0], r) );
+        }
+    }
+    canmat_dispatch_cancel( &d, CANMAT_ERR_TIMEOUT );
+
+    size_t found = 0;
+    printf( "node  device-type vendor      product     revision    state\n" );
+    for( size_t i = 1; i <= CANMAT_NODE_MASK; i ++ ) {
+        // any response, even an abort, means something is there
+        int seen = m && CANMAT_NMT_STATE_UNKNOWN != canmat_nmt_master_state( m, (uint8_t)i );
+        for( size_t j = 0; j < SCAN_N_OBJ; j ++ ) {
+            seen |= ( CANMAT_OK == node[i].req[j].status ||
+                      CANMAT_ERR_ABORT == node[i].req[j].status );
+        }
+        if( !seen ) continue;
+        found++;
+        printf( "0x%02x", (unsigned)i );
+        for( size_t j = 0; j < SCAN_N_OBJ; j ++ ) scan_print_u32( &node[i].req[j] );
+        printf( "  %s\n", m ? scan_state( canmat_nmt_master_state( m, (uint8_t)i ) ) : "-" );
+    }
+    verbf( 1, "%zu nodes in %.1f ms\n", found, (double)(scan_now() - start) / 1e6 );
+
+    free( node );
+    free( m );
+    return 0;
+}
+
+static void snapshot_run( canmat_iface_t *cif, struct canmat_snapshot_job *job, size_t n ) {
+    canmat_status_t r = canmat_snapshot_run( cif, job, n );
+    hard_assert( CANMAT_OK == r, "Couldn't run transfers: %s\n", canmat_iface_strerror(cif, r) );
+}
+
+/* Print the failure of a job, return 1 if it failed */
+static int snapshot_failed( canmat_iface_t *cif, const struct canmat_snapshot_job *job ) {
+    if( CANMAT_OK == job->status ) return 0;
+    printf( "0x%02x: %s\n", job->client.node, canmat_iface_strerror(cif, job->status) );
+    return 1;
+}
+
+static int cmd_snapshot( can_set_t *canset, size_t n, const char **arg ) {
+    hard_assert( n >= 2, "Insufficient arguments\n");
+    hard_assert( 1 == canset->n, "Only one CAN interface supported\n");
+    canmat_iface_t *cif = canset->cif[0];
+    size_t n_node = n - 1;
+    const char *file = arg[n_node];
+
+    struct canmat_snapshot *snap = (struct canmat_snapshot*) calloc( n_node, sizeof(snap[0]) );
+    struct canmat_snapshot_job *job = (struct canmat_snapshot_job*) calloc( n_node, sizeof(job[0]) );
+    for( size_t i = 0; i < n_node; i ++ ) {
+        uint8_t node = (uint8_t)parse_uhex( arg[i], CANMAT_NODE_MASK );
+        canmat_snapshot_init( &snap[i], node );
+        canmat_snapshot_job_init( &job[i], node, canmat_iface_send_cx, cif );
+        canmat_status_t r = canmat_snapshot_job_read( &job[i], opt_dict, &snap[i], scan_now() );
+        hard_assert( CANMAT_OK == r, "Couldn't send request: %s\n", canmat_iface_strerror(cif, r) );
+    }
+    snapshot_run( cif, job, n_node );
+
+    // nodes that failed are left out of the file
+    int failed = 0;
+    FILE *f = fopen( file, "wb" );
+    hard_assert( f, "Couldn't open %s: %s\n", file, strerror(errno) );
+    for( size_t i = 0; i < n_node; i ++ ) {
+        if( snapshot_failed( cif, &job[i] ) ) {
+            failed = 1;
+            canmat_snapshot_destroy( &snap[i] );
+            continue;
+        }
+        hard_assert( CANMAT_OK == canmat_snapshot_write( f, &snap[i] ),
+                     "Couldn't write %s: %s\n", file, strerror(errno) );
+        printf( "0x%02x: %zu objects, %zu unreadable\n",
+                snap[i].node, snap[i].n, job[i].n_failed );
+        canmat_snapshot_destroy( &snap[i] );
+    }
+    hard_assert( 0 == fclose(f), "Couldn't write %s: %s\n", file, strerror(errno) );
+
+    free( job );
+    free( snap );
+    return failed ? EXIT_FAILURE : 0;
+}
+
+static int cmd_restore( can_set_t *canset, size_t n, const char **arg ) {
+    hard_assert( n >= 1, "Insufficient arguments\n");
+    hard_assert( 1 == canset->n, "Only one CAN interface supported\n");
+    canmat_iface_t *cif = canset->cif[0];
+    const char *file = arg[0];
+
+    FILE *f = fopen( file, "rb" );
+    hard_assert( f, "Couldn't open %s: %s\n", file, strerror(errno) );
+    struct canmat_snapshot *snap = NULL;
+    size_t n_snap = 0;
+    for(;;) {
+        snap = (struct canmat_snapshot*) realloc( snap, (n_snap+1) * sizeof(snap[0]) );
+        canmat_snapshot_init( &snap[n_snap], 0 );
+        canmat_status_t r = canmat_snapshot_read( f, &snap[n_snap] );
+        if( CANMAT_ERR_UNDERFLOW == r ) break;
+        hard_assert( CANMAT_OK == r, "Couldn't read %s: %s\n", file,
+                     CANMAT_ERR_OS == r ? strerror(errno) : canmat_strerror(r) );
+        n_snap++;
+    }
+    fclose( f );
+    hard_assert( n_snap, "No snapshots in %s\n", file );
+
+    // with nodes given, clone the first snapshot to each
+    size_t n_node = n > 1 ? n - 1 : n_snap;
+    struct canmat_snapshot_job *job = (struct canmat_snapshot_job*) calloc( n_node, sizeof(job[0]) );
+    for( size_t i = 0; i < n_node; i ++ ) {
+        struct canmat_snapshot *s = n > 1 ? &snap[0] : &snap[i];
+        uint8_t node = n > 1 ? (uint8_t)parse_uhex( arg[i+1], CANMAT_NODE_MASK ) : s->node;
+        canmat_snapshot_job_init( &job[i], node, canmat_iface_send_cx, cif );
+        canmat_status_t r = canmat_snapshot_job_restore( &job[i], opt_dict, s, scan_now() );
+        hard_assert( CANMAT_OK == r, "Couldn't send request: %s\n", canmat_iface_strerror(cif, r) );
+    }
+    snapshot_run( cif, job, n_node );
+
+    int failed = 0;
+    for( size_t i = 0; i < n_node; i ++ ) {
+        if( snapshot_failed( cif, &job[i] ) ) {
+            failed = 1;
+            continue;
+        }
+        printf( "0x%02x: %zu written, %zu same, %zu failed\n", job[i].client.node,
+                job[i].n_written, job[i].n_same, job[i].n_failed );
+        failed |= 0 != job[i].n_failed;
+    }
+
+    for( size_t i = 0; i < n_snap; i ++ ) canmat_snapshot_destroy( &snap[i] );
+    free( snap );
+    free( job );
+    return failed ? EXIT_FAILURE : 0;
+}
+
+static int cmd_dcf_dl( can_set_t *canset, size_t n, const char **arg ) {
+    hard_assert( n >= 2, "Insufficient arguments\n");
+    hard_assert( 1 == canset->n, "Only one CAN interface supported\n");
+    uint8_t node = (uint8_t)parse_uhex( arg[0], CANMAT_NODE_MASK );
+    uint8_t target = n > 2 ? (uint8_t)parse_uhex( arg[2], CANMAT_NODE_MASK ) : node;
+
+    struct canmat_cdcf c;
+    struct canmat_eds_error err;
+    canmat_cdcf_init( &c );
+    canmat_status_t r = canmat_cdcf_load_dcf( &c, 1, arg+1, opt_dict, node, &err );
+    hard_assert( CANMAT_OK == r, "Couldn't load %s:%u: %s\n",
+                 err.file ? err.file : "", err.line,
+                 CANMAT_ERR_OS == r ? strerror(errno) : canmat_strerror(r) );
+    verbf( 1, "%"PRIu32" entries, %zu bytes\n", c.n, c.size );
+
+    uint32_t abort_code;
+    r = canmat_cdcf_dl( canset->cif[0], target, CANMAT_CDCF_INDEX, node, &c, &abort_code );
+    if( CANMAT_ERR_ABORT == r ) {
+        fail("Transfer aborted: '%s' (0x%08x)\n", canmat_sdo_strerror(abort_code), abort_code );
+    }
+    hard_assert( CANMAT_OK == r, "Download failed: '%s'\n",
+                 canmat_iface_strerror(canset->cif[0], r) );
+
+    canmat_cdcf_destroy( &c );
+    return 0;
+}
+
+static int cmd_configure( can_set_t *canset, size_t n, const char **arg ) {
+    hard_assert( n >= 2, "Insufficient arguments\n");
+    hard_assert( 1 == canset->n, "Only one CAN interface supported\n");
+    canmat_iface_t *cif = canset->cif[0];
+    size_t n_node = n - 1;
+
+    // values may use $NODEID, so each node gets its own list
+    struct canmat_cdcf *c = (struct canmat_cdcf*) calloc( n_node, sizeof(c[0]) );
+    struct canmat_fanout_node *fn = (struct canmat_fanout_node*) calloc( n_node, sizeof(fn[0]) );
+    struct canmat_fanout f;
+    canmat_fanout_init( &f, fn, n_node, canmat_iface_send_cx, cif );
+    for( size_t i = 0; i < n_node; i ++ ) {
+        uint8_t node = (uint8_t)parse_uhex( arg[i+1], CANMAT_NODE_MASK );
+        struct canmat_eds_error err;
+        canmat_cdcf_init( &c[i] );
+        canmat_status_t r = canmat_cdcf_load_dcf( &c[i], 1, arg, opt_dict, node, &err );
+        hard_assert( CANMAT_OK == r, "Couldn't load %s:%u: %s\n",
+                     err.file ? err.file : "", err.line,
+                     CANMAT_ERR_OS == r ? strerror(errno) : canmat_strerror(r) );
+        canmat_fanout_node_set( &f, i, node, &c[i] );
+    }
+
+    canmat_status_t r = canmat_fanout_run( &f, cif );
+    hard_assert( CANMAT_OK == r, "Couldn't run transfers: %s\n", canmat_iface_strerror(cif, r) );
+
+    int failed = 0;
+    for( size_t i = 0; i < n_node; i ++ ) {
+        const struct canmat_fanout_node *x = &fn[i];
+        printf( "0x%02x: %"PRIu32" of %"PRIu32" written in %.1f ms", x->client.node,
+                x->written, c[i].n, (double)(x->end - f.start) / 1e6 );
+        if( CANMAT_ERR_ABORT == x->status ) {
+            printf( ", %04x:%02x aborted: '%s' (0x%08x)", x->client.index, x->client.subindex,
+                    canmat_sdo_strerror(x->abort), x->abort );
+        } else if( CANMAT_OK != x->status ) {
+            printf( ", %04x:%02x failed: %s", x->client.index, x->client.subindex,
+                    canmat_iface_strerror(cif, x->status) );
+        }
+        printf( "\n" );
+        failed |= CANMAT_OK != x->status;
+        canmat_cdcf_destroy( &c[i] );
+    }
+    printf( "%zu nodes in %.1f ms, %"PRIu64" frames, %.1f%% of %lu kbit/s\n",
+            n_node, (double)(f.end - f.start) / 1e6, f.frames,
+            100 * canmat_fanout_load( &f, (unsigned)opt_kbps ), opt_kbps );
+
+    free( fn );
+    free( c );
+    return failed ? EXIT_FAILURE : 0;
+}
+
+/* Best case data rate: 7 bytes in an unstuffed 111 bit block segment */
+static double flash_max_rate( void ) {
+    return 7.0 * (double)opt_kbps * 1000 / 111;
+}
+
+struct flash_progress {
+    int64_t start;
+    int64_t last;
+};
+
+static void flash_progress( void *cx, const struct canmat_flash *f, size_t n ) {
+    struct flash_progress *p = (struct flash_progress*)cx;
+    int64_t now = scan_now();
+    if( now - p->last < 250000000 ) return;
+    p->last = now;
+    size_t sent = 0, size = 0;
+    for( size_t i = 0; i < n; i ++ ) {
+        sent += canmat_flash_sent( &f[i] );
+        size += f[i].size;
+    }
+    fprintf( stderr, "\r%zu of %zu bytes, %.0f B/s ", sent, size,
+             (double)sent * 1e9 / (double)(now - p->start) );
+}
+
+static int cmd_flash( can_set_t *canset, size_t n, const char **arg ) {
+    hard_assert( n >= 2, "Insufficient arguments\n");
+    hard_assert( 1 == canset->n, "Only one CAN interface supported\n");
+    canmat_iface_t *cif = canset->cif[0];
+    size_t n_node = n - 1;
+    const char *path = arg[n_node];
+
+    // send straight from the mapped file
+    int fd = open( path, O_RDONLY );
+    hard_assert( fd >= 0, "Couldn't open %s: %s\n", path, strerror(errno) );
+    struct stat st;
+    hard_assert( 0 == fstat( fd, &st ), "Couldn't stat %s: %s\n", path, strerror(errno) );
+    size_t size = (size_t)st.st_size;
+    hard_assert( size > 0, "Empty image: %s\n", path );
+    void *image = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    hard_assert( MAP_FAILED != image, "Couldn't map %s: %s\n", path, strerror(errno) );
+    close( fd );
+    madvise( image, size, MADV_SEQUENTIAL );
+
+    struct flash_progress p = { .start = scan_now() };
+    p.last = p.start;
+    struct canmat_flash *f = (struct canmat_flash*) calloc( n_node, sizeof(f[0]) );
+    for( size_t i = 0; i < n_node; i ++ ) {
+        uint8_t node = (uint8_t)parse_uhex( arg[i], CANMAT_NODE_MASK );
+        canmat_flash_init( &f[i], node, 1, canmat_flash_queue, &f[i] );
+        canmat_status_t r = canmat_flash_start( &f[i], image, size, p.start );
+        hard_assert( CANMAT_OK == r, "Couldn't start 0x%02x: %s\n", node, canmat_iface_strerror(cif, r) );
+    }
+
+    canmat_status_t r = canmat_flash_run( cif, f, n_node, flash_progress, &p );
+    hard_assert( CANMAT_OK == r, "Couldn't run transfers: %s\n", canmat_iface_strerror(cif, r) );
+    fprintf( stderr, "\n" );
+
+    int failed = 0;
+    int64_t end = p.start;
+    for( size_t i = 0; i < n_node; i ++ ) {
+        const struct canmat_flash *x = &f[i];
+        printf( "0x%02x: ", x->client.node );
+        if( CANMAT_ERR_ABORT == x->status ) {
+            printf( "%04x:%02x aborted: '%s' (0x%08x)\n", x->client.index, x->client.subindex,
+                    canmat_sdo_strerror(x->abort), x->abort );
+        } else if( CANMAT_ERR_DEV == x->status ) {
+            printf( "flash error %"PRIu32" (status 0x%08"PRIx32")\n",
+                    CANMAT_FLASH_STATUS_ERROR(x->flash_status), x->flash_status );
+        } else if( CANMAT_OK != x->status ) {
+            printf( "%04x:%02x failed: %s\n", x->client.index, x->client.subindex,
+                    canmat_iface_strerror(cif, x->status) );
+        } else {
+            double t = (double)(x->download_end - x->download_start) / 1e9;
+            printf( "%zu bytes in %.3f s, %.0f B/s, done in %.3f s\n", x->size, t,
+                    t > 0 ? (double)x->size / t : 0, (double)(x->end - x->start) / 1e9 );
+        }
+        failed |= CANMAT_OK != x->status;
+        if( x->download_end > end ) end = x->download_end;
+    }
+
+    // nodes share the bus, so compare the total with its capacity
+    double t = (double)(end - p.start) / 1e9;
+    double rate = t > 0 ? (double)(size * n_node) / t : 0;
+    printf( "%zu nodes, %.0f B/s, %.1f%% of %.0f B/s at %lu kbit/s\n",
+            n_node, rate, 100 * rate / flash_max_rate(), flash_max_rate(), opt_kbps );
+
+    free( f );
+    munmap( image, size );
+    return failed ? EXIT_FAILURE : 0;
+}
+
 static void verbf( int level , const char fmt[], ...) {
     if( level <= opt_verbosity ) {
         fputs("# ", stderr);
@@ -0,0 +1,128 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "socanmatic.h"
+
+void canmat_cdcf_init( struct canmat_cdcf *c ) {
+    memset( c, 0, sizeof(*c) );
+}
+
+void canmat_cdcf_destroy( struct canmat_cdcf *c ) {
+    free( c->data );
+    canmat_cdcf_init( c );
+}
+
+canmat_status_t canmat_cdcf_add( struct canmat_cdcf *c, uint16_t index, uint8_t subindex,
+                                 const void *data, size_t n ) {
+    if( n > UINT32_MAX ) return CANMAT_ERR_PARAM;
+    size_t size = (c->size ? c->size : 4) + 7 + n;
+    if( size > c->capacity ) {
+        size_t capacity = c->capacity ? 2*c->capacity : 256;
+        while( capacity < size ) capacity *= 2;
+        uint8_t *d = (uint8_t*)realloc( c->data, capacity );
+        if( NULL == d ) return CANMAT_ERR_OS;
+        c->data = d;
+        c->capacity = capacity;
+    }
+    if( 0 == c->size ) c->size = 4;
+    uint8_t *e = c->data + c->size;
+    canmat_byte_stle16( e, index );
+    e[2] = subindex;
+    canmat_byte_stle32( e+3, (uint32_t)n );
+    if( n ) memcpy( e+7, data, n );
+    c->size = size;
+    canmat_byte_stle32( c->data, ++c->n );
+    return CANMAT_OK;
+}
+
+canmat_status_t canmat_cdcf_add_obj( struct canmat_cdcf *c, const canmat_obj_t *obj,
+                                     const canmat_scalar_t *val ) {
+    uint8_t d[4];
+    switch( canmat_obj_bitsize( obj ) ) {
+    case 8:
+        d[0] = val->u8;
+        return canmat_cdcf_add( c, obj->index, obj->subindex, d, 1 );
+    case 16:
+        canmat_byte_stle16( d, val->u16 );
+        return canmat_cdcf_add( c, obj->index, obj->subindex, d, 2 );
+    case 32:
+        canmat_byte_stle32( d, val->u32 );
+        return canmat_cdcf_add( c, obj->index, obj->subindex, d, 4 );
+    default:
+        return CANMAT_ERR_PARAM;
+    }
+}
+
+static int64_t dl_timeout( void *cx, int64_t now ) {
+    struct canmat_sdo_client *c = (struct canmat_sdo_client*)cx;
+    canmat_sdo_client_timeout( c, now );
+    return canmat_sdo_client_busy( c ) ? canmat_sdo_client_deadline( c ) : CANMAT_STEP_DONE;
+}
+
+static void dl_frame( void *cx, const struct can_frame *can, int64_t now ) {
+    canmat_sdo_client_frame( (struct canmat_sdo_client*)cx, can, now );
+}
+
+canmat_status_t canmat_cdcf_dl( canmat_iface_t *cif, uint8_t node, uint16_t index, uint8_t subindex,
+                                const struct canmat_cdcf *c, uint32_t *abort ) {
+    static const uint8_t empty[4] = {0};
+    struct canmat_sdo_client client;
+    canmat_sdo_client_init( &client, node, canmat_iface_send_cx, cif );
+    canmat_status_t r = canmat_sdo_client_dl( &client, index, subindex,
+                                              c->size ? c->data : empty, c->size ? c->size : 4,
+                                              1, canmat_now_ns() );
+    if( CANMAT_OK != r ) return r;
+    r = canmat_step_run( cif, dl_timeout, dl_frame, &client );
+    if( CANMAT_OK != r ) return r;
+    if( abort ) *abort = client.abort;
+    return client.status;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
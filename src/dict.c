@@ -63,6 +63,17 @@ static int dict_compar_index( const void *a, const void *b ) {
 }
 
 canmat_obj_t *canmat_dict_search_name( const struct canmat_dict *dict, const char *name ) {
+    if( dict->name_hash ) {
+        const struct canmat_dict_name_hash *h = dict->name_hash;
+        uint32_t hash = canmat_dict_name_hash( name );
+        for( uint32_t j = hash & h->mask; h->slot[j].i; j = (j+1) & h->mask ) {
+            if( h->slot[j].hash == hash ) {
+                canmat_obj_t *obj = dict->obj + h->slot[j].i - 1;
+                if( 0 == strcasecmp( name, obj->parameter_name ) ) return obj;
+            }
+        }
+        return NULL;
+    }
     canmat_dict_name_tree_t *p =
         (canmat_dict_name_tree_t *) bsearch( name, dict->btree_name,
                                              dict->length, sizeof( dict->btree_name[0] ),
@@ -77,11 +88,140 @@ canmat_obj_t *canmat_dict_search_name( const struct canmat_dict *dict, const cha
 
 canmat_obj_t *canmat_dict_search_index( const struct canmat_dict *dict, uint16_t idx, uint8_t subindex ) {
     int32_t key = (idx << 8) | subindex;
+    if( dict->index_hash ) {
+        canmat_obj_t *obj = dict->obj + canmat_dict_hash_lookup( dict->index_hash, (uint32_t)key );
+        return ( CANMAT_DICT_INDEX_KEY(obj->index, obj->subindex) == (uint32_t)key ) ? obj : NULL;
+    }
     return  (canmat_obj_t *) bsearch( &key, dict->obj,
                                       dict->length, sizeof( dict->obj[0] ),
                                       dict_compar_index );
 }
 
+static uint32_t pow2_ceil( size_t n ) {
+    uint32_t p = 1;
+    while( p < n ) p <<= 1;
+    return p;
+}
+
+struct hash_key {
+    uint32_t key;
+    uint32_t bucket;
+    size_t count;       ///< keys in this bucket
+    size_t i;           ///< position of key
+};
+
+/* Buckets with most keys first, keys of a bucket together */
+static int hash_key_compar( const void *a, const void *b ) {
+    const struct hash_key *a1 = (const struct hash_key*)a;
+    const struct hash_key *b1 = (const struct hash_key*)b;
+    if( a1->count != b1->count ) return (a1->count > b1->count) ? -1 : 1;
+    if( a1->bucket != b1->bucket ) return (a1->bucket < b1->bucket) ? -1 : 1;
+    return 0;
+}
+
+#define HASH_MAX_SEED (1u << 20)
+
+void canmat_dict_hash_dims( size_t n, uint32_t *nbucket, uint32_t *nslot ) {
+    *nbucket = pow2_ceil( (n+1) / 2 );
+    *nslot = pow2_ceil( n );
+}
+
+int canmat_dict_hash_fill( struct canmat_dict_hash *h, uint32_t *seed, uint32_t *slot,
+                           const uint32_t *keys, size_t n ) {
+    uint32_t nbucket, nslot;
+    canmat_dict_hash_dims( n, &nbucket, &nslot );
+    memset( seed, 0, nbucket * sizeof(seed[0]) );
+    memset( slot, 0, nslot * sizeof(slot[0]) );
+    h->bucket_mask = nbucket - 1;
+    h->slot_mask = nslot - 1;
+    h->seed = seed;
+    h->slot = slot;
+    if( 0 == n ) return 0;
+
+    struct hash_key *hk = (struct hash_key*)calloc( n, sizeof(*hk) );
+    size_t *count = (size_t*)calloc( nbucket, sizeof(size_t) );
+    uint8_t *taken = (uint8_t*)calloc( nslot, 1 );
+    uint32_t *try_slot = (uint32_t*)calloc( n, sizeof(uint32_t) );
+    int ok = hk && count && taken && try_slot;
+
+    for( size_t i = 0; ok && i < n; i++ ) {
+        hk[i].key = keys[i];
+        hk[i].bucket = canmat_dict_hash(keys[i], 0) & h->bucket_mask;
+        hk[i].i = i;
+        count[hk[i].bucket]++;
+    }
+    for( size_t i = 0; ok && i < n; i++ ) {
+        hk[i].count = count[hk[i].bucket];
+    }
+    if( ok ) qsort( hk, n, sizeof(*hk), hash_key_compar );
+
+    // Find a seed for each bucket that puts its keys in free slots
+    for( size_t i = 0; ok && i < n; i += hk[i].count ) {
+        size_t m = hk[i].count;
+        uint32_t s;
+        for( s = 1; s < HASH_MAX_SEED; s++ ) {
+            size_t j;
+            for( j = 0; j < m; j++ ) {
+                uint32_t t = canmat_dict_hash(hk[i+j].key, s) & h->slot_mask;
+                size_t k;
+                if( taken[t] ) break;
+                for( k = 0; k < j && try_slot[k] != t; k++ );
+                if( k < j ) break;
+                try_slot[j] = t;
+            }
+            if( j == m ) break;
+        }
+        if( HASH_MAX_SEED == s ) {
+            ok = 0;  // probably duplicate keys
+            break;
+        }
+        seed[hk[i].bucket] = s;
+        for( size_t j = 0; j < m; j++ ) {
+            taken[ try_slot[j] ] = 1;
+            slot[ try_slot[j] ] = (uint32_t)hk[i+j].i;
+        }
+    }
+
+    free( hk );
+    free( count );
+    free( taken );
+    free( try_slot );
+    return ok ? 0 : -1;
+}
+
+struct canmat_dict_hash *canmat_dict_hash_build( const uint32_t *keys, size_t n ) {
+    if( 0 == n || n > UINT32_MAX/2 ) return NULL;
+
+    uint32_t nbucket, nslot;
+    canmat_dict_hash_dims( n, &nbucket, &nslot );
+
+    // one block for the table and its arrays
+    struct canmat_dict_hash *h = (struct canmat_dict_hash*)
+        malloc( sizeof(*h) + (nbucket + nslot) * sizeof(uint32_t) );
+    if( NULL == h ) return NULL;
+    uint32_t *seed = (uint32_t*)(h + 1);
+    if( canmat_dict_hash_fill( h, seed, seed + nbucket, keys, n ) ) {
+        free( h );
+        return NULL;
+    }
+    return h;
+}
+
+void canmat_dict_name_hash_fill( struct canmat_dict_name_hash *h,
+                                 struct canmat_dict_name_slot *slot, uint32_t nslot,
+                                 const struct canmat_obj *obj, size_t n ) {
+    memset( slot, 0, nslot * sizeof(slot[0]) );
+    h->mask = nslot - 1;
+    h->slot = slot;
+    for( size_t i = 0; i < n; i++ ) {
+        uint32_t hash = canmat_dict_name_hash( obj[i].parameter_name );
+        uint32_t j;
+        for( j = hash & h->mask; slot[j].i; j = (j+1) & h->mask );
+        slot[j].hash = hash;
+        slot[j].i = (uint32_t)(i+1);
+    }
+}
+
 canmat_status_t canmat_obj_ul( canmat_iface_t *cif, uint8_t node, const canmat_obj_t *obj,
                                canmat_scalar_t *val, uint32_t *err_val ) {
     if( NULL == obj  ||
@@ -301,6 +441,7 @@ int canmat_obj_bitsize( const struct canmat_obj *obj ) {
         return 16;
     case CANMAT_DATA_TYPE_INTEGER32:
     case CANMAT_DATA_TYPE_UNSIGNED32:
+    case CANMAT_DATA_TYPE_REAL32:
         return 32;
     default:
         return -1;
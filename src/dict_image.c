@@ -0,0 +1,416 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "socanmatic.h"
+#include "socanmatic_private.h"
+
+#define IMAGE_ALIGN(x) ( ((x) + 7) & ~(size_t)7 )
+
+static int host_is_le( void ) {
+    uint16_t x = 1;
+    return 1 == *(uint8_t*)&x;
+}
+
+/* Check that count elements of elsize at off fit in size */
+static int check_sect( size_t size, uint32_t off, uint32_t count, size_t elsize ) {
+    return 0 == off % 4 &&
+        off <= size &&
+        (uint64_t)count * elsize <= (uint64_t)(size - off);
+}
+
+static int check_mask( uint32_t mask ) {
+    return mask < UINT32_MAX && 0 == (mask & (mask + 1));
+}
+
+canmat_status_t canmat_dict_image_init( canmat_dict_image_t *img, const void *buf, size_t size ) {
+    const struct canmat_dict_image_header *hdr = (const struct canmat_dict_image_header*)buf;
+    const uint8_t *base = (const uint8_t*)buf;
+
+    if( !host_is_le() ) return CANMAT_ERR_NOT_SUP;
+    if( size < sizeof(*hdr) ||
+        memcmp( hdr->magic, CANMAT_DICT_IMAGE_MAGIC, sizeof(hdr->magic) ) ||
+        CANMAT_DICT_IMAGE_VERSION != hdr->version ||
+        hdr->size > size )
+        return CANMAT_ERR_PARAM;
+    size = hdr->size;
+
+    if( 0 == hdr->n_obj ||
+        !check_mask( hdr->index_bucket_mask ) || !check_mask( hdr->index_slot_mask ) ||
+        !check_mask( hdr->name_mask ) ||
+        !check_sect( size, hdr->obj, hdr->n_obj, sizeof(struct canmat_dict_image_obj) ) ||
+        !check_sect( size, hdr->desc, hdr->n_desc, sizeof(struct canmat_dict_image_desc) ) ||
+        !check_sect( size, hdr->index_seed, hdr->index_bucket_mask + 1, sizeof(uint32_t) ) ||
+        !check_sect( size, hdr->index_slot, hdr->index_slot_mask + 1, sizeof(uint32_t) ) ||
+        !check_sect( size, hdr->name_slot, hdr->name_mask + 1, sizeof(canmat_dict_name_slot_t) ) ||
+        !check_sect( size, hdr->str, hdr->str_size, 1 ) ||
+        0 == hdr->str_size )
+        return CANMAT_ERR_PARAM;
+
+    const struct canmat_dict_image_obj *obj = (const struct canmat_dict_image_obj*)(base + hdr->obj);
+    const struct canmat_dict_image_desc *desc = (const struct canmat_dict_image_desc*)(base + hdr->desc);
+    const uint32_t *index_slot = (const uint32_t*)(base + hdr->index_slot);
+    const canmat_dict_name_slot_t *name_slot = (const canmat_dict_name_slot_t*)(base + hdr->name_slot);
+    const char *str = (const char*)(base + hdr->str);
+
+    // references stay in the image
+    if( '\0' != str[0] || '\0' != str[hdr->str_size - 1] ) return CANMAT_ERR_PARAM;
+    if( hdr->n_desc && 0 != desc[hdr->n_desc - 1].name ) return CANMAT_ERR_PARAM;
+    for( uint32_t i = 0; i < hdr->n_obj; i++ ) {
+        if( obj[i].name >= hdr->str_size ||
+            obj[i].mask_desc > hdr->n_desc || obj[i].value_desc > hdr->n_desc )
+            return CANMAT_ERR_PARAM;
+    }
+    for( uint32_t i = 0; i < hdr->n_desc; i++ ) {
+        if( desc[i].name >= hdr->str_size || desc[i].description >= hdr->str_size )
+            return CANMAT_ERR_PARAM;
+    }
+    for( uint32_t i = 0; i <= hdr->index_slot_mask; i++ ) {
+        if( index_slot[i] >= hdr->n_obj ) return CANMAT_ERR_PARAM;
+    }
+    for( uint32_t i = 0; i <= hdr->name_mask; i++ ) {
+        if( name_slot[i].i > hdr->n_obj ) return CANMAT_ERR_PARAM;
+    }
+
+    memset( img, 0, sizeof(*img) );
+    img->base = base;
+    img->size = size;
+    img->hdr = hdr;
+    img->obj = obj;
+    img->desc = desc;
+    img->str = str;
+    img->index_hash.bucket_mask = hdr->index_bucket_mask;
+    img->index_hash.slot_mask = hdr->index_slot_mask;
+    img->index_hash.seed = (const uint32_t*)(base + hdr->index_seed);
+    img->index_hash.slot = index_slot;
+    img->name_hash.mask = hdr->name_mask;
+    img->name_hash.slot = name_slot;
+    return CANMAT_OK;
+}
+
+canmat_status_t canmat_dict_image_open( canmat_dict_image_t *img, const char *filename ) {
+    int fd = open( filename, O_RDONLY );
+    if( fd < 0 ) return CANMAT_ERR_OS;
+
+    struct stat st;
+    if( fstat( fd, &st ) ) {
+        int e = errno;
+        close( fd );
+        errno = e;
+        return CANMAT_ERR_OS;
+    }
+    if( (size_t)st.st_size < sizeof(struct canmat_dict_image_header) ) {
+        close( fd );
+        return CANMAT_ERR_PARAM;
+    }
+
+    void *base = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    int e = errno;
+    close( fd );
+    if( MAP_FAILED == base ) {
+        errno = e;
+        return CANMAT_ERR_OS;
+    }
+
+    canmat_status_t r = canmat_dict_image_init( img, base, (size_t)st.st_size );
+    if( CANMAT_OK != r ) {
+        munmap( base, (size_t)st.st_size );
+        return r;
+    }
+    img->size = (size_t)st.st_size;
+    img->mapped = 1;
+    return CANMAT_OK;
+}
+
+void canmat_dict_image_close( canmat_dict_image_t *img ) {
+    if( img->mapped ) {
+        munmap( (void*)img->base, img->size );
+    }
+    memset( img, 0, sizeof(*img) );
+}
+
+const struct canmat_dict_image_obj *canmat_dict_image_search_index (
+    const canmat_dict_image_t *img, uint16_t idx, uint8_t subindex )
+{
+    uint32_t key = CANMAT_DICT_INDEX_KEY( idx, subindex );
+    const struct canmat_dict_image_obj *o = img->obj + canmat_dict_hash_lookup( &img->index_hash, key );
+    return ( o->index == idx && o->subindex == subindex ) ? o : NULL;
+}
+
+const struct canmat_dict_image_obj *canmat_dict_image_search_name (
+    const canmat_dict_image_t *img, const char *name )
+{
+    const struct canmat_dict_name_hash *h = &img->name_hash;
+    uint32_t hash = canmat_dict_name_hash( name );
+    // the image may be full, so stop after one pass
+    for( uint32_t j = hash & h->mask, n = 0; n <= h->mask && h->slot[j].i; j = (j+1) & h->mask, n++ ) {
+        if( h->slot[j].hash == hash ) {
+            const struct canmat_dict_image_obj *o = img->obj + h->slot[j].i - 1;
+            if( 0 == strcasecmp( name, canmat_dict_image_str( img, o->name ) ) ) return o;
+        }
+    }
+    return NULL;
+}
+
+void canmat_dict_image_get_obj( const canmat_dict_image_t *img,
+                                const struct canmat_dict_image_obj *o, canmat_obj_t *obj ) {
+    canmat_obj_t x = {
+        .index = o->index,
+        .subindex = o->subindex,
+        .parameter_name = canmat_dict_image_str( img, o->name ),
+        .sub_number = o->sub_number,
+        .access_type = (enum canmat_access_type)o->access_type,
+        .object_type = (enum canmat_object_type)o->object_type,
+        .data_type = (enum canmat_data_type)o->data_type,
+        .pdo_mapping = o->pdo_mapping ? 1 : 0,
+        .value_descriptor = NULL,
+        .mask_descriptor = NULL
+    };
+    memcpy( obj, &x, sizeof(x) );
+}
+
+/* Interned strings for the image builder */
+struct str_pool {
+    char *buf;
+    size_t size;
+    uint32_t mask;
+    uint32_t *slot;         ///< string offset, 0 for empty
+};
+
+static uint32_t str_hash( const char *s ) {
+    uint32_t h = 0x811c9dc5U;
+    for( ; *s; s++ ) h = (h ^ (unsigned char)*s) * 0x01000193U;
+    return h;
+}
+
+/* Add s to the pool, or return it if already present */
+static uint32_t str_intern( struct str_pool *p, const char *s ) {
+    if( NULL == s || '\0' == *s ) return 0;
+    uint32_t j;
+    for( j = str_hash(s) & p->mask; p->slot[j]; j = (j+1) & p->mask ) {
+        if( 0 == strcmp( p->buf + p->slot[j], s ) ) return p->slot[j];
+    }
+    size_t n = strlen( s ) + 1;
+    memcpy( p->buf + p->size, s, n );
+    p->slot[j] = (uint32_t)p->size;
+    p->size += n;
+    return p->slot[j];
+}
+
+/* Distinct descriptor lists of dict */
+struct desc_ref {
+    const struct canmat_code_descriptor *d;
+    uint32_t ref;
+};
+
+static size_t desc_len( const struct canmat_code_descriptor *d ) {
+    size_t n = 0;
+    while( d[n].name ) n++;
+    return n;
+}
+
+static uint32_t desc_find( const struct desc_ref *refs, size_t n, const struct canmat_code_descriptor *d ) {
+    for( size_t i = 0; i < n; i++ ) {
+        if( refs[i].d == d ) return refs[i].ref;
+    }
+    return 0;
+}
+
+canmat_status_t canmat_dict_image_build( const struct canmat_dict *dict, void **pbuf, size_t *psize ) {
+    size_t n = dict->length;
+    if( 0 == n || n > UINT32_MAX / 4 ) return CANMAT_ERR_PARAM;
+
+    // descriptor lists and string bound
+    struct desc_ref *refs = (struct desc_ref*)calloc( 2*n, sizeof(refs[0]) );
+    uint32_t *keys = (uint32_t*)calloc( n, sizeof(keys[0]) );
+    uint32_t *pos = (uint32_t*)calloc( n, sizeof(pos[0]) );
+    if( NULL == refs || NULL == keys || NULL == pos ) {
+        free( refs ); free( keys ); free( pos );
+        return CANMAT_ERR_OS;
+    }
+    size_t n_refs = 0, n_desc = 0, n_str = 1, n_strs = 0, n_keys = 0;
+    for( size_t i = 0; i < n; i++ ) {
+        const canmat_obj_t *o = dict->obj + i;
+        n_str += strlen( o->parameter_name ) + 1;
+        n_strs++;
+        const struct canmat_code_descriptor *ds[2] = {o->mask_descriptor, o->value_descriptor};
+        for( size_t j = 0; j < 2; j++ ) {
+            if( NULL == ds[j] || desc_find( refs, n_refs, ds[j] ) ) continue;
+            size_t m = desc_len( ds[j] );
+            refs[n_refs].d = ds[j];
+            refs[n_refs].ref = (uint32_t)n_desc + 1;
+            n_refs++;
+            n_desc += m + 1;
+            for( size_t k = 0; k < m; k++ ) {
+                n_str += strlen( ds[j][k].name ) + 1;
+                if( ds[j][k].description ) n_str += strlen( ds[j][k].description ) + 1;
+                n_strs += 2;
+            }
+        }
+        // an ARRAY or RECORD and its sub0 share a key; use sub0
+        uint32_t key = CANMAT_DICT_INDEX_KEY( o->index, o->subindex );
+        if( 0 == n_keys || keys[n_keys-1] != key ) {
+            keys[n_keys] = key;
+            pos[n_keys++] = (uint32_t)i;
+        } else if( CANMAT_OBJECT_TYPE_VAR == o->object_type ) {
+            pos[n_keys-1] = (uint32_t)i;
+        }
+    }
+
+    uint32_t nbucket, nslot, n_name_slot = 1;
+    canmat_dict_hash_dims( n_keys, &nbucket, &nslot );
+    while( n_name_slot < 2*n ) n_name_slot <<= 1;
+    uint32_t n_pool_slot = 1;
+    while( n_pool_slot < 2*n_strs ) n_pool_slot <<= 1;
+
+    size_t off_obj = IMAGE_ALIGN( sizeof(struct canmat_dict_image_header) );
+    size_t off_desc = off_obj + IMAGE_ALIGN( n * sizeof(struct canmat_dict_image_obj) );
+    size_t off_seed = off_desc + IMAGE_ALIGN( n_desc * sizeof(struct canmat_dict_image_desc) );
+    size_t off_slot = off_seed + IMAGE_ALIGN( nbucket * sizeof(uint32_t) );
+    size_t off_name = off_slot + IMAGE_ALIGN( nslot * sizeof(uint32_t) );
+    size_t off_str = off_name + IMAGE_ALIGN( n_name_slot * sizeof(canmat_dict_name_slot_t) );
+    size_t size = off_str + n_str;
+
+    uint8_t *buf = (uint8_t*)calloc( 1, size );
+    struct str_pool pool = { .size = 1, .mask = n_pool_slot - 1,
+                             .slot = (uint32_t*)calloc( n_pool_slot, sizeof(uint32_t) ) };
+    canmat_status_t r = CANMAT_OK;
+    if( size > UINT32_MAX ) {
+        r = CANMAT_ERR_OVERFLOW;
+        goto END;
+    }
+    if( NULL == buf || NULL == pool.slot ) {
+        r = CANMAT_ERR_OS;
+        goto END;
+    }
+    pool.buf = (char*)buf + off_str;
+
+    struct canmat_dict_image_header *hdr = (struct canmat_dict_image_header*)buf;
+    struct canmat_dict_image_obj *obj = (struct canmat_dict_image_obj*)(buf + off_obj);
+    struct canmat_dict_image_desc *desc = (struct canmat_dict_image_desc*)(buf + off_desc);
+
+    // descriptors
+    for( size_t i = 0; i < n_refs; i++ ) {
+        const struct canmat_code_descriptor *d = refs[i].d;
+        struct canmat_dict_image_desc *x = desc + refs[i].ref - 1;
+        for( size_t k = 0; d[k].name; k++ ) {
+            x[k].name = str_intern( &pool, d[k].name );
+            x[k].description = str_intern( &pool, d[k].description );
+            x[k].value = d[k].value;
+        }
+    }
+
+    // objects
+    for( size_t i = 0; i < n; i++ ) {
+        const canmat_obj_t *o = dict->obj + i;
+        obj[i].index = o->index;
+        obj[i].subindex = o->subindex;
+        obj[i].sub_number = o->sub_number;
+        obj[i].access_type = (uint8_t)o->access_type;
+        obj[i].object_type = (uint8_t)o->object_type;
+        obj[i].pdo_mapping = (uint8_t)o->pdo_mapping;
+        obj[i].data_type = (uint32_t)o->data_type;
+        obj[i].name = str_intern( &pool, o->parameter_name );
+        obj[i].mask_desc = o->mask_descriptor ? desc_find( refs, n_refs, o->mask_descriptor ) : 0;
+        obj[i].value_desc = o->value_descriptor ? desc_find( refs, n_refs, o->value_descriptor ) : 0;
+    }
+
+    // hashes
+    {
+        struct canmat_dict_hash h;
+        uint32_t *seed = (uint32_t*)(buf + off_seed);
+        uint32_t *slot = (uint32_t*)(buf + off_slot);
+        if( canmat_dict_hash_fill( &h, seed, slot, keys, n_keys ) ) {
+            r = CANMAT_ERR_PARAM;
+            goto END;
+        }
+        for( uint32_t j = 0; j < nslot; j++ ) slot[j] = pos[slot[j]];
+        hdr->index_bucket_mask = h.bucket_mask;
+        hdr->index_slot_mask = h.slot_mask;
+    }
+    {
+        struct canmat_dict_name_hash h;
+        canmat_dict_name_hash_fill( &h, (canmat_dict_name_slot_t*)(buf + off_name), n_name_slot,
+                                    dict->obj, n );
+        hdr->name_mask = h.mask;
+    }
+
+    memcpy( hdr->magic, CANMAT_DICT_IMAGE_MAGIC, sizeof(hdr->magic) );
+    hdr->version = CANMAT_DICT_IMAGE_VERSION;
+    hdr->n_obj = (uint32_t)n;
+    hdr->obj = (uint32_t)off_obj;
+    hdr->n_desc = (uint32_t)n_desc;
+    hdr->desc = (uint32_t)off_desc;
+    hdr->index_seed = (uint32_t)off_seed;
+    hdr->index_slot = (uint32_t)off_slot;
+    hdr->name_slot = (uint32_t)off_name;
+    hdr->str = (uint32_t)off_str;
+    hdr->str_size = (uint32_t)pool.size;
+    hdr->size = (uint32_t)(off_str + pool.size);
+
+    *pbuf = buf;
+    *psize = hdr->size;
+    buf = NULL;
+
+END:
+    free( buf );
+    free( pool.slot );
+    free( refs );
+    free( keys );
+    free( pos );
+    return r;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
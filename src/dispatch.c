@@ -0,0 +1,161 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "socanmatic.h"
+
+void canmat_dispatch_init( struct canmat_dispatch *d, canmat_iface_t *cif ) {
+    memset( d, 0, sizeof(*d) );
+    d->cif = cif;
+}
+
+static canmat_status_t send_req( struct canmat_dispatch *d, struct canmat_sdo_req *req ) {
+    struct can_frame can;
+    canmat_status_t r = canmat_sdo2can( &can, &req->msg, 0 );
+    if( CANMAT_OK != r ) return r;
+    return canmat_iface_send( d->cif, &can );
+}
+
+static canmat_status_t queue_req( struct canmat_dispatch *d, struct canmat_sdo_req *req ) {
+    uint8_t node = req->msg.node;
+    if( 0 == node || node > CANMAT_NODE_MASK ) return CANMAT_ERR_PARAM;
+
+    req->next = NULL;
+    if( NULL == d->head[node] ) {
+        canmat_status_t r = send_req( d, req );
+        if( CANMAT_OK != r ) return r;
+        d->head[node] = req;
+    } else {
+        d->tail[node]->next = req;
+    }
+    d->tail[node] = req;
+    d->pending++;
+    return CANMAT_OK;
+}
+
+canmat_status_t canmat_dispatch_sdo_ul( struct canmat_dispatch *d, struct canmat_sdo_req *req ) {
+    req->msg.cmd_spec = CANMAT_CCS_EX_UL;
+    return queue_req( d, req );
+}
+
+canmat_status_t canmat_dispatch_sdo_dl( struct canmat_dispatch *d, struct canmat_sdo_req *req ) {
+    req->msg.cmd_spec = CANMAT_CCS_EX_DL;
+    return queue_req( d, req );
+}
+
+/* Pop the request in flight and send the next one to node.  Requests
+ * that can't be sent are popped too and returned, in order, for the
+ * caller to complete with their error. */
+static struct canmat_sdo_req *pop_req( struct canmat_dispatch *d, uint8_t node ) {
+    struct canmat_sdo_req *failed = NULL, **failed_tail = &failed;
+    d->head[node] = d->head[node]->next;
+    d->pending--;
+    while( d->head[node] ) {
+        struct canmat_sdo_req *next = d->head[node];
+        canmat_status_t r = send_req( d, next );
+        if( CANMAT_OK == r ) break;
+        next->status = r;
+        d->head[node] = next->next;
+        d->pending--;
+        next->next = NULL;
+        *failed_tail = next;
+        failed_tail = &next->next;
+    }
+    if( NULL == d->head[node] ) d->tail[node] = NULL;
+    return failed;
+}
+
+int canmat_dispatch_frame( struct canmat_dispatch *d, const struct can_frame *can ) {
+    uint8_t node = canmat_frame_node( can );
+    struct canmat_sdo_req *req = d->head[node];
+    if( NULL == req || can->can_id != CANMAT_SDO_RESP_ID(node) ) {
+        if( d->recv ) d->recv( d->recv_cx, can );
+        return 0;
+    }
+
+    req->status = canmat_can2sdo( &req->resp, can, req->msg.data_type );
+    struct canmat_sdo_req *failed = pop_req( d, node );
+
+    // callbacks last, they may queue more requests
+    if( req->done ) req->done( req );
+    while( failed ) {
+        struct canmat_sdo_req *next = failed->next;
+        if( failed->done ) failed->done( failed );
+        failed = next;
+    }
+    return 1;
+}
+
+void canmat_dispatch_cancel( struct canmat_dispatch *d, canmat_status_t status ) {
+    struct canmat_sdo_req *all = NULL, **tail = &all;
+    for( size_t node = 0; node <= CANMAT_NODE_MASK; node++ ) {
+        if( NULL == d->head[node] ) continue;
+        *tail = d->head[node];
+        tail = &d->tail[node]->next;
+        d->head[node] = d->tail[node] = NULL;
+    }
+    d->pending = 0;
+
+    // callbacks last, they may queue more requests
+    while( all ) {
+        struct canmat_sdo_req *next = all->next;
+        all->next = NULL;
+        all->status = status;
+        if( all->done ) all->done( all );
+        all = next;
+    }
+}
+
+canmat_status_t canmat_dispatch_step( struct canmat_dispatch *d ) {
+    struct can_frame can;
+    canmat_status_t r = canmat_iface_recv( d->cif, &can );
+    if( CANMAT_OK == r ) canmat_dispatch_frame( d, &can );
+    return r;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -152,14 +152,26 @@ enum canmat_status canmat_402_init( struct canmat_iface *cif, uint8_t id, struct
         drive->pos_min_soft = drive->pos_min_hard + 5*M_PI/180;
     }
 
-    // current
-    /* { */
-    /*     canmat_obj_t *obj = canmat_dict_search_name( &canmat_dict402, "current actual value" ); */
-    /*     assert( obj && obj->data_type == CANMAT_DATA_TYPE_INTEGER32 ); */
-    /*     r = canmat_obj_ul( cif, drive->node_id, obj, &val ); */
-    /*     if( CANMAT_OK != r ) return r; */
-    /*     drive->actual_cur_raw = val.i32; */
-    /* } */
+    // current and torque scaling, optional since not every drive
+    // implements profile torque
+    {
+        uint32_t rated;
+        int16_t cur;
+        drive->cur_factor = drive->torque_factor = 1000; // fraction of rated
+        if( CANMAT_OK == canmat_402_ul_motor_rated_current( cif, drive->node_id, &rated,
+                                                            &drive->abort_code ) && rated ) {
+            drive->cur_factor = 1e6 / rated;      // rated is mA
+        }
+        if( CANMAT_OK == canmat_402_ul_motor_rated_torque( cif, drive->node_id, &rated,
+                                                           &drive->abort_code ) && rated ) {
+            drive->torque_factor = 1e6 / rated;   // rated is mNm
+        }
+        if( CANMAT_OK == canmat_402_ul_current_actual_value( cif, drive->node_id, &cur,
+                                                             &drive->abort_code ) ) {
+            drive->actual_cur_raw = cur;
+        }
+        drive->abort_code = 0;
+    }
     return CANMAT_OK;
 }
 
@@ -251,6 +263,7 @@ enum canmat_status canmat_402_set_op_mode( struct canmat_iface *cif, struct canm
     struct canmat_obj *ref_obj = NULL;
     uint16_t ctrl_and = 0xFFFF, ctrl_or = 0;
     canmat_scalar_t ref_val = {0};
+    int trans_type = CANMAT_PDO_TRANSMISSION_TYPE_EVENT_DRIVEN;
     switch( op_mode ) {
     case CANMAT_402_OP_MODE_VELOCITY:
         ref_obj = CANMAT_402_OBJ_VL_TARGET_VELOCITY;
@@ -260,6 +273,28 @@ enum canmat_status canmat_402_set_op_mode( struct canmat_iface *cif, struct canm
                     CANMAT_402_CTRLMASK_VL_RFG_UNLOCK |
                     CANMAT_402_CTRLMASK_VL_RFG_USE_REF );
         break;
+    case CANMAT_402_OP_MODE_CYCLIC_SYNC_VELOCITY:
+        ref_obj = CANMAT_402_OBJ_TARGET_VELOCITY;
+        ref_val.i32 = 0;
+        trans_type = CANMAT_PDO_TRANSMISSION_TYPE_SYNCHRONOUS_CYCLIC;
+        break;
+    case CANMAT_402_OP_MODE_TORQUE:
+        ref_obj = CANMAT_402_OBJ_TARGET_TORQUE;
+        ref_val.i16 = 0;
+        break;
+    case CANMAT_402_OP_MODE_CYCLIC_SYNC_TORQUE:
+        ref_obj = CANMAT_402_OBJ_TARGET_TORQUE;
+        ref_val.i16 = 0;
+        trans_type = CANMAT_PDO_TRANSMISSION_TYPE_SYNCHRONOUS_CYCLIC;
+        break;
+    case CANMAT_402_OP_MODE_CYCLIC_SYNC_POSITION:
+        // No-motion target is wherever we are now
+        ref_obj = CANMAT_402_OBJ_TARGET_POSITION;
+        CHECK_STATUS( canmat_402_ul_position_actual_value( cif, drive->node_id,
+                                                           &drive->actual_pos_raw, &drive->abort_code ) );
+        ref_val.i32 = drive->actual_pos_raw;
+        trans_type = CANMAT_PDO_TRANSMISSION_TYPE_SYNCHRONOUS_CYCLIC;
+        break;
     default: return CANMAT_ERR_PARAM;
     }
     if( NULL == ref_obj ) return CANMAT_ERR_PARAM;
@@ -280,11 +315,19 @@ enum canmat_status canmat_402_set_op_mode( struct canmat_iface *cif, struct canm
         CHECK_STATUS( canmat_obj_dl( cif, drive->node_id, ref_obj, &ref_val, &(drive->abort_code) ) );
     }
 
+    // Remember the reference we just gave
+    switch( op_mode ) {
+    case CANMAT_402_OP_MODE_CYCLIC_SYNC_POSITION: drive->target_pos_raw = ref_val.i32;    break;
+    case CANMAT_402_OP_MODE_CYCLIC_SYNC_VELOCITY: drive->target_cs_vel_raw = ref_val.i32; break;
+    case CANMAT_402_OP_MODE_TORQUE:
+    case CANMAT_402_OP_MODE_CYCLIC_SYNC_TORQUE:   drive->target_torque_raw = ref_val.i16; break;
+    default: break;
+    }
 
     // Map the RPDO
     const struct canmat_obj *obj_ar[1] = {ref_obj};
     canmat_status_t r = canmat_pdo_remap( cif, drive->node_id, (uint8_t)(drive->rpdo_user), CANMAT_DL,
-                                          CANMAT_PDO_TRANSMISSION_TYPE_EVENT_DRIVEN, -1, -1,
+                                          trans_type, -1, -1,
                                           1, obj_ar, &(drive->abort_code) );
 
     // set control word
@@ -0,0 +1,980 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Runtime EDS/DCF loader.
+ *
+ * Reads the same subset of the EDS format as canmatc: object sections
+ * [XXXX] and [XXXXsubYY], and enum sections [enum:name] of
+ * NAME.value / NAME.description pairs.  Other sections are ignored.
+ * Files are layered as in canmatc: keys of an object override the
+ * same keys from earlier files, and enums replace earlier enums.
+ * The whole dictionary goes into one allocation, laid out as:
+ *
+ *   struct canmat_dict
+ *   canmat_obj_t[n]
+ *   canmat_dict_name_tree_t[n]
+ *   index hash and name hash headers
+ *   code descriptors
+ *   name hash slots
+ *   index hash seeds and slots
+ *   strings
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "socanmatic.h"
+#include "socanmatic_private.h"
+
+static inline int tolower_ascii( int c ) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : (unsigned char)c;
+}
+
+struct eds_kv {
+    char *key;
+    char *field;            ///< enum sections: text after the '.' in key
+    char *value;
+    unsigned line;
+};
+
+/* Object keys used by the loader */
+enum eds_field {
+    EDS_F_PARAMETER_NAME,
+    EDS_F_OBJECT_TYPE,
+    EDS_F_DATA_TYPE,
+    EDS_F_ACCESS_TYPE,
+    EDS_F_PDO_MAPPING,
+    EDS_F_SUB_NUMBER,
+    EDS_F_MASK_ENUM,
+    EDS_F_VALUE_ENUM,
+    EDS_F_PARAMETER_VALUE,
+    EDS_N_FIELD
+};
+
+static const char *eds_field_names[EDS_N_FIELD] = {
+    "ParameterName",
+    "ObjectType",
+    "DataType",
+    "AccessType",
+    "PDOMapping",
+    "SubNumber",
+    "MaskEnum",
+    "ValueEnum",
+    "ParameterValue"
+};
+
+enum eds_sect_type {
+    EDS_SECT_OBJ,
+    EDS_SECT_ENUM
+};
+
+struct eds_sect {
+    enum eds_sect_type type;
+    char *name;
+    size_t file;
+    unsigned line;
+    size_t seq;             ///< order of appearance over all files
+    size_t kv0;             ///< first key in kv array
+    size_t n_kv;
+    uint32_t key;           ///< objects: CANMAT_DICT_INDEX_KEY
+    int sub;                ///< objects: section has a subindex
+    size_t field[EDS_N_FIELD];  ///< objects: kv position + 1 of each field, 0 if absent
+
+    // enums, filled in when referenced
+    size_t n_elt;
+    struct canmat_code_descriptor *desc;
+};
+
+struct eds_parse {
+    char **buf;
+    size_t n_buf;
+    struct eds_kv *kv;
+    size_t n_kv, max_kv;
+    struct eds_sect *sect;
+    size_t n_sect, max_sect;
+};
+
+struct eds_elt {
+    const char *name;
+    const char *value;
+    const char *desc;
+    unsigned line;
+};
+
+#define ARENA_ALIGN(x) ( ((x) + 15) & ~(size_t)15 )
+
+static canmat_status_t fail( struct canmat_eds_error *err, const char *file, unsigned line,
+                             canmat_status_t r ) {
+    if( err ) {
+        err->file = file;
+        err->line = line;
+    }
+    return r;
+}
+
+static char *read_file( const char *name ) {
+    int fd = open( name, O_RDONLY );
+    if( fd < 0 ) return NULL;
+    struct stat st;
+    char *buf = NULL;
+    if( 0 == fstat( fd, &st ) && NULL != (buf = (char*)malloc( (size_t)st.st_size + 1 )) ) {
+        size_t n = 0;
+        while( n < (size_t)st.st_size ) {
+            ssize_t r = read( fd, buf + n, (size_t)st.st_size - n );
+            if( r > 0 ) n += (size_t)r;
+            else if( r < 0 && EINTR == errno ) continue;
+            else break;
+        }
+        buf[n] = '\0';
+    }
+    int e = errno;
+    close( fd );
+    errno = e;
+    return buf;
+}
+
+/* strcasecmp() for ASCII, without the locale */
+static int ascii_casecmp( const char *a, const char *b ) {
+    for( ;; a++, b++ ) {
+        int c = tolower_ascii( *a ), d = tolower_ascii( *b );
+        if( c != d || '\0' == c ) return c - d;
+    }
+}
+
+static char *trim( char *s ) {
+    while( isspace((unsigned char)*s) ) s++;
+    char *e = s + strlen(s);
+    while( e > s && isspace((unsigned char)e[-1]) ) e--;
+    *e = '\0';
+    return s;
+}
+
+/* Parse a section name as an object, return 0 on success */
+static int parse_obj_name( const char *name, uint32_t *key, int *sub ) {
+    char *end;
+    if( !isxdigit((unsigned char)name[0]) ) return -1;
+    unsigned long idx = strtoul( name, &end, 16 );
+    unsigned long subidx = 0;
+    if( idx > 0xFFFF ) return -1;
+    if( '\0' == *end ) {
+        *sub = 0;
+    } else if( 0 == strncasecmp( end, "sub", 3 ) && isxdigit((unsigned char)end[3]) ) {
+        subidx = strtoul( end + 3, &end, 16 );
+        if( '\0' != *end || subidx > 0xFF ) return -1;
+        *sub = 1;
+    } else {
+        return -1;
+    }
+    *key = CANMAT_DICT_INDEX_KEY( idx, subidx );
+    return 0;
+}
+
+static int parse_enum_name( const char *name ) {
+    if( strncmp( name, "enum:", 5 ) || '\0' == name[5] ) return -1;
+    for( const char *p = name + 5; *p; p++ ) {
+        if( !(isalnum((unsigned char)*p) || '_' == *p) ) return -1;
+    }
+    return 0;
+}
+
+static canmat_status_t parse_buf( struct eds_parse *P, size_t file, char *buf, unsigned *line ) {
+    struct eds_sect *cur = NULL;
+    int in_sect = 0;
+    char *next;
+    *line = 0;
+    for( char *p = buf; *p; p = next ) {
+        (*line)++;
+        char *eol = strchr( p, '\n' );
+        if( eol ) {
+            *eol = '\0';
+            next = eol + 1;
+        } else {
+            next = p + strlen(p);
+        }
+        char *s = trim( p );
+        if( '\0' == *s || ';' == *s || '#' == *s ) continue;
+
+        if( '[' == *s ) {
+            char *e = strchr( s, ']' );
+            if( NULL == e ) return CANMAT_ERR_PARAM;
+            *e = '\0';
+            s = trim( s + 1 );
+            in_sect = 1;
+            cur = NULL;
+            uint32_t key;
+            int sub;
+            int is_obj = (0 == parse_obj_name( s, &key, &sub ));
+            if( is_obj || 0 == parse_enum_name( s ) ) {
+                if( P->n_sect == P->max_sect ) {
+                    P->max_sect = P->max_sect ? 2*P->max_sect : 256;
+                    struct eds_sect *n = (struct eds_sect*)
+                        realloc( P->sect, P->max_sect * sizeof(P->sect[0]) );
+                    if( NULL == n ) return CANMAT_ERR_OS;
+                    P->sect = n;
+                }
+                cur = P->sect + P->n_sect;
+                memset( cur, 0, sizeof(*cur) );
+                cur->type = is_obj ? EDS_SECT_OBJ : EDS_SECT_ENUM;
+                cur->name = is_obj ? s : s + 5;
+                cur->file = file;
+                cur->line = *line;
+                cur->seq = P->n_sect++;
+                cur->kv0 = P->n_kv;
+                if( is_obj ) {
+                    cur->key = key;
+                    cur->sub = sub;
+                }
+            }
+            continue;
+        }
+
+        // key = value
+        char *eq = strpbrk( s, "=:" );
+        if( NULL == eq || !in_sect ) return CANMAT_ERR_PARAM;
+        if( NULL == cur ) continue;
+        *eq = '\0';
+        char *key = trim( s );
+        char *value = eq + 1;
+        // inline comment
+        for( char *c = value; *c; c++ ) {
+            if( ';' == *c && c > value && isspace((unsigned char)c[-1]) ) {
+                *c = '\0';
+                break;
+            }
+        }
+        value = trim( value );
+        char *field = NULL;
+        int f = -1;
+        if( EDS_SECT_ENUM == cur->type ) {
+            field = strrchr( key, '.' );
+            if( NULL == field ) continue;
+            *field++ = '\0';
+        } else {
+            for( f = 0; f < EDS_N_FIELD && ascii_casecmp( key, eds_field_names[f] ); f++ );
+            if( EDS_N_FIELD == f ) continue;
+        }
+
+        if( P->n_kv == P->max_kv ) {
+            P->max_kv = P->max_kv ? 2*P->max_kv : 1024;
+            struct eds_kv *n = (struct eds_kv*)realloc( P->kv, P->max_kv * sizeof(P->kv[0]) );
+            if( NULL == n ) return CANMAT_ERR_OS;
+            P->kv = n;
+        }
+        struct eds_kv *kv = P->kv + P->n_kv++;
+        kv->key = key;
+        kv->field = field;
+        kv->value = value;
+        kv->line = *line;
+        cur->n_kv++;
+        if( f >= 0 ) cur->field[f] = P->n_kv;
+    }
+    return CANMAT_OK;
+}
+
+/* Last value of field in object section */
+static const struct eds_kv *sect_get( const struct eds_parse *P, const struct eds_sect *s,
+                                      enum eds_field f ) {
+    return s->field[f] ? P->kv + s->field[f] - 1 : NULL;
+}
+
+static int parse_num( const char *s, unsigned long max, unsigned long *v ) {
+    char *end;
+    if( '\0' == *s ) return -1;
+    errno = 0;
+    *v = strtoul( s, &end, 0 );
+    return ( '\0' != *end || errno || *v > max ) ? -1 : 0;
+}
+
+/* Enum values are small C expressions, e.g. 1 << 4, 0xFFFF + 1 */
+static int eval_or( const char **s, long long *v );
+
+static void skip_space( const char **s ) {
+    while( isspace((unsigned char)**s) ) (*s)++;
+}
+
+static int eval_unary( const char **s, long long *v ) {
+    skip_space( s );
+    if( '-' == **s || '~' == **s ) {
+        char op = *(*s)++;
+        if( eval_unary( s, v ) ) return -1;
+        *v = ('-' == op) ? -*v : ~*v;
+        return 0;
+    } else if( '(' == **s ) {
+        (*s)++;
+        if( eval_or( s, v ) ) return -1;
+        skip_space( s );
+        if( ')' != **s ) return -1;
+        (*s)++;
+        return 0;
+    } else if( isdigit((unsigned char)**s) ) {
+        char *end;
+        *v = (long long)strtoull( *s, &end, 0 );
+        *s = end;
+        return 0;
+    }
+    return -1;
+}
+
+static int eval_add( const char **s, long long *v ) {
+    if( eval_unary( s, v ) ) return -1;
+    for(;;) {
+        skip_space( s );
+        char op = **s;
+        if( '+' != op && '-' != op ) return 0;
+        (*s)++;
+        long long b;
+        if( eval_unary( s, &b ) ) return -1;
+        *v = ('+' == op) ? *v + b : *v - b;
+    }
+}
+
+static int eval_shift( const char **s, long long *v ) {
+    if( eval_add( s, v ) ) return -1;
+    for(;;) {
+        skip_space( s );
+        int left = ('<' == (*s)[0] && '<' == (*s)[1]);
+        int right = ('>' == (*s)[0] && '>' == (*s)[1]);
+        if( !left && !right ) return 0;
+        *s += 2;
+        long long b;
+        if( eval_add( s, &b ) || b < 0 || b > 62 ) return -1;
+        *v = left ? *v << b : *v >> b;
+    }
+}
+
+static int eval_or( const char **s, long long *v ) {
+    if( eval_shift( s, v ) ) return -1;
+    for(;;) {
+        skip_space( s );
+        if( '|' != **s ) return 0;
+        (*s)++;
+        long long b;
+        if( eval_shift( s, &b ) ) return -1;
+        *v |= b;
+    }
+}
+
+static int eval_expr( const char *s, int *v ) {
+    long long x;
+    if( eval_or( &s, &x ) ) return -1;
+    skip_space( &s );
+    if( '\0' != *s ) return -1;
+    *v = (int)x;
+    return 0;
+}
+
+struct eds_token {
+    const char *name;
+    int value;
+};
+
+static const struct eds_token eds_data_types[] = {
+    {"BOOLEAN",         CANMAT_DATA_TYPE_BOOLEAN},
+    {"INTEGER8",        CANMAT_DATA_TYPE_INTEGER8},
+    {"INTEGER16",       CANMAT_DATA_TYPE_INTEGER16},
+    {"INTEGER32",       CANMAT_DATA_TYPE_INTEGER32},
+    {"INTEGER64",       CANMAT_DATA_TYPE_INTEGER64},
+    {"UNSIGNED8",       CANMAT_DATA_TYPE_UNSIGNED8},
+    {"UNSIGNED16",      CANMAT_DATA_TYPE_UNSIGNED16},
+    {"UNSIGNED32",      CANMAT_DATA_TYPE_UNSIGNED32},
+    {"UNSIGNED64",      CANMAT_DATA_TYPE_UNSIGNED64},
+    {"REAL32",          CANMAT_DATA_TYPE_REAL32},
+    {"REAL64",          CANMAT_DATA_TYPE_REAL64},
+    {"VISIBLE_STRING",  CANMAT_DATA_TYPE_VISIBLE_STRING},
+    {"OCTET_STRING",    CANMAT_DATA_TYPE_OCTET_STRING},
+    {"UNICODE_STRING",  CANMAT_DATA_TYPE_UNICODE_STRING},
+    {"TIME_OF_DAY",     CANMAT_DATA_TYPE_TIME_OF_DAY},
+    {"TIME_DIFFERENCE", CANMAT_DATA_TYPE_TIME_DIFFERENCE},
+    {"DOMAIN",          CANMAT_DATA_TYPE_DOMAIN},
+    {"IDENTITY",        CANMAT_DATA_TYPE_IDENTITY},
+    {NULL, 0}
+};
+
+static const struct eds_token eds_object_types[] = {
+    {"NULL",      CANMAT_OBJECT_TYPE_NULL},
+    {"DOMAIN",    CANMAT_OBJECT_TYPE_DOMAIN},
+    {"DEFTYPE",   CANMAT_OBJECT_TYPE_DEFTYPE},
+    {"DEFSTRUCT", CANMAT_OBJECT_TYPE_DEFSTRUCT},
+    {"VAR",       CANMAT_OBJECT_TYPE_VAR},
+    {"ARRAY",     CANMAT_OBJECT_TYPE_ARRAY},
+    {"RECORD",    CANMAT_OBJECT_TYPE_RECORD},
+    {NULL, 0}
+};
+
+static const struct eds_token eds_access_types[] = {
+    {"RO",    CANMAT_ACCESS_RO},
+    {"WO",    CANMAT_ACCESS_WO},
+    {"RW",    CANMAT_ACCESS_RW},
+    {"RWR",   CANMAT_ACCESS_RWR},
+    {"RWW",   CANMAT_ACCESS_RWW},
+    {"CONST", CANMAT_ACCESS_CONST},
+    {NULL, 0}
+};
+
+/* Token by name, or numeric value if numeric is set */
+static int parse_token( const struct eds_token *tok, const char *s, int numeric, int *v ) {
+    for( ; tok->name; tok++ ) {
+        if( 0 == ascii_casecmp( tok->name, s ) ) {
+            *v = tok->value;
+            return 0;
+        }
+    }
+    unsigned long u;
+    if( numeric && 0 == parse_num( s, 0xFFFF, &u ) ) {
+        *v = (int)u;
+        return 0;
+    }
+    return -1;
+}
+
+/* Objects by index, subindex, then order of appearance */
+static int obj_compar( const void *a, const void *b ) {
+    const struct eds_sect *a1 = *(const struct eds_sect *const*)a;
+    const struct eds_sect *b1 = *(const struct eds_sect *const*)b;
+    if( a1->key != b1->key ) return (a1->key < b1->key) ? -1 : 1;
+    if( a1->sub != b1->sub ) return a1->sub - b1->sub;
+    return (a1->seq < b1->seq) ? -1 : (a1->seq > b1->seq);
+}
+
+static int name_tree_compar( const void *a, const void *b ) {
+    return ascii_casecmp( ((const canmat_dict_name_tree_t*)a)->parameter_name,
+                          ((const canmat_dict_name_tree_t*)b)->parameter_name );
+}
+
+static int elt_compar( const void *a, const void *b ) {
+    const struct canmat_code_descriptor *a1 = (const struct canmat_code_descriptor*)a;
+    const struct canmat_code_descriptor *b1 = (const struct canmat_code_descriptor*)b;
+    return (a1->value > b1->value) - (a1->value < b1->value);
+}
+
+static struct eds_sect *find_enum( struct eds_parse *P, const char *name ) {
+    for( size_t i = P->n_sect; i > 0; i-- ) {
+        struct eds_sect *s = P->sect + i - 1;
+        if( EDS_SECT_ENUM == s->type && 0 == strcmp( s->name, name ) ) return s;
+    }
+    return NULL;
+}
+
+/* Collect distinct elements of an enum section, return count */
+static size_t enum_elts( const struct eds_parse *P, const struct eds_sect *s, struct eds_elt *elt ) {
+    size_t n = 0;
+    for( size_t i = 0; i < s->n_kv; i++ ) {
+        const struct eds_kv *kv = P->kv + s->kv0 + i;
+        int is_value = (0 == ascii_casecmp( kv->field, "value" ));
+        if( !is_value && ascii_casecmp( kv->field, "description" ) ) continue;
+        size_t j;
+        for( j = 0; j < n && ascii_casecmp( elt[j].name, kv->key ); j++ );
+        if( j == n ) {
+            elt[n].name = kv->key;
+            elt[n].value = NULL;
+            elt[n].desc = NULL;
+            elt[n].line = kv->line;
+            n++;
+        }
+        if( is_value ) {
+            elt[j].value = kv->value;
+            elt[j].line = kv->line;
+        } else {
+            elt[j].desc = kv->value;
+        }
+    }
+    return n;
+}
+
+static char *arena_strcpy( char **str, const char *s, int lower ) {
+    char *r = *str;
+    size_t i;
+    for( i = 0; s[i]; i++ ) {
+        r[i] = lower ? (char)tolower_ascii( s[i] ) : s[i];
+    }
+    r[i] = '\0';
+    *str += i + 1;
+    return r;
+}
+
+static canmat_status_t build( struct eds_parse *P, const char *const *files,
+                              struct canmat_dict **pdict, struct canmat_eds_error *err ) {
+    canmat_status_t r = CANMAT_OK;
+    struct eds_sect **obj = NULL;
+    struct eds_elt *elt = NULL;
+    uint32_t *keys = NULL;
+    uint32_t *pos = NULL;
+    size_t n = 0;
+
+    // objects, later layers override earlier keys
+    obj = (struct eds_sect**)malloc( (P->n_sect + 1) * sizeof(obj[0]) );
+    elt = (struct eds_elt*)malloc( (P->n_kv + 1) * sizeof(elt[0]) );
+    if( NULL == obj || NULL == elt ) {
+        r = CANMAT_ERR_OS;
+        goto END;
+    }
+    for( size_t i = 0; i < P->n_sect; i++ ) {
+        if( EDS_SECT_OBJ == P->sect[i].type ) obj[n++] = P->sect + i;
+    }
+    qsort( obj, n, sizeof(obj[0]), obj_compar );
+    {
+        size_t m = 0;
+        for( size_t i = 0; i < n; i++ ) {
+            if( m > 0 && obj[m-1]->key == obj[i]->key && obj[m-1]->sub == obj[i]->sub ) {
+                for( size_t f = 0; f < EDS_N_FIELD; f++ ) {
+                    if( 0 == obj[i]->field[f] ) obj[i]->field[f] = obj[m-1]->field[f];
+                }
+                obj[m-1] = obj[i];
+            } else {
+                obj[m++] = obj[i];
+            }
+        }
+        n = m;
+    }
+    if( 0 == n ) {
+        r = fail( err, NULL, 0, CANMAT_ERR_PARAM );
+        goto END;
+    }
+
+    // sizes
+    size_t n_desc = 0, n_str = 0, n_keys = 0;
+    for( size_t i = 0; i < n; i++ ) {
+        const struct eds_sect *s = obj[i];
+        const struct eds_kv *name = sect_get( P, s, EDS_F_PARAMETER_NAME );
+        if( NULL == name ) {
+            r = fail( err, files[s->file], s->line, CANMAT_ERR_PARAM );
+            goto END;
+        }
+        n_str += strlen( name->value ) + 1;
+        if( 0 == i || obj[i-1]->key != s->key ) n_keys++;
+        const enum eds_field refs[2] = {EDS_F_MASK_ENUM, EDS_F_VALUE_ENUM};
+        for( size_t j = 0; j < 2; j++ ) {
+            const struct eds_kv *kv = sect_get( P, s, refs[j] );
+            if( NULL == kv ) continue;
+            struct eds_sect *e = find_enum( P, kv->value );
+            if( NULL == e ) {
+                r = fail( err, files[s->file], kv->line, CANMAT_ERR_PARAM );
+                goto END;
+            }
+            if( 0 == e->n_elt ) {
+                size_t m = enum_elts( P, e, elt );
+                e->n_elt = m + 1;
+                n_desc += m + 1;
+                for( size_t k = 0; k < m; k++ ) {
+                    n_str += 2 * strlen( elt[k].name ) + 2;
+                    if( elt[k].desc ) n_str += strlen( elt[k].desc ) + 1;
+                }
+            }
+        }
+    }
+
+    uint32_t nbucket, nslot;
+    canmat_dict_hash_dims( n_keys, &nbucket, &nslot );
+    uint32_t n_name_slot = 1;
+    while( n_name_slot < 2*n ) n_name_slot <<= 1;
+
+    size_t off_obj = ARENA_ALIGN( sizeof(struct canmat_dict) );
+    size_t off_tree = off_obj + ARENA_ALIGN( n * sizeof(canmat_obj_t) );
+    size_t off_hash = off_tree + ARENA_ALIGN( n * sizeof(canmat_dict_name_tree_t) );
+    size_t off_name_hash = off_hash + ARENA_ALIGN( sizeof(canmat_dict_hash_t) );
+    size_t off_desc = off_name_hash + ARENA_ALIGN( sizeof(canmat_dict_name_hash_t) );
+    size_t off_name_slot = off_desc + ARENA_ALIGN( n_desc * sizeof(struct canmat_code_descriptor) );
+    size_t off_seed = off_name_slot + ARENA_ALIGN( n_name_slot * sizeof(canmat_dict_name_slot_t) );
+    size_t off_str = off_seed + ARENA_ALIGN( (nbucket + nslot) * sizeof(uint32_t) );
+    size_t size = off_str + n_str;
+
+    char *arena = (char*)calloc( 1, size );
+    keys = (uint32_t*)malloc( n_keys * sizeof(keys[0]) );
+    pos = (uint32_t*)malloc( n_keys * sizeof(pos[0]) );
+    if( NULL == arena || NULL == keys || NULL == pos ) {
+        free( arena );
+        r = CANMAT_ERR_OS;
+        goto END;
+    }
+    struct canmat_dict *dict = (struct canmat_dict*)arena;
+    canmat_obj_t *objs = (canmat_obj_t*)(arena + off_obj);
+    canmat_dict_name_tree_t *tree = (canmat_dict_name_tree_t*)(arena + off_tree);
+    canmat_dict_hash_t *index_hash = (canmat_dict_hash_t*)(arena + off_hash);
+    canmat_dict_name_hash_t *name_hash = (canmat_dict_name_hash_t*)(arena + off_name_hash);
+    struct canmat_code_descriptor *desc = (struct canmat_code_descriptor*)(arena + off_desc);
+    canmat_dict_name_slot_t *name_slot = (canmat_dict_name_slot_t*)(arena + off_name_slot);
+    uint32_t *seed = (uint32_t*)(arena + off_seed);
+    char *str = arena + off_str;
+
+    // objects
+    n_keys = 0;
+    for( size_t i = 0; i < n; i++ ) {
+        const struct eds_sect *s = obj[i];
+        const struct eds_kv *kv;
+        int object_type = s->sub ? CANMAT_OBJECT_TYPE_VAR : 0;
+        int data_type = 0;
+        int access_type = CANMAT_ACCESS_UNKNOWN;
+        unsigned long pdo_mapping = 0, sub_number = 0;
+        struct canmat_code_descriptor *d[2] = {NULL, NULL};
+
+        if( (kv = sect_get( P, s, EDS_F_OBJECT_TYPE )) &&
+            ( parse_token( eds_object_types, kv->value, 1, &object_type ) ||
+              (s->sub && CANMAT_OBJECT_TYPE_VAR != object_type) ) )
+            goto PARSE_ERR;
+        if( (kv = sect_get( P, s, EDS_F_DATA_TYPE )) &&
+            parse_token( eds_data_types, kv->value, 1, &data_type ) )
+            goto PARSE_ERR;
+        if( (kv = sect_get( P, s, EDS_F_ACCESS_TYPE )) &&
+            parse_token( eds_access_types, kv->value, 0, &access_type ) )
+            goto PARSE_ERR;
+        if( (kv = sect_get( P, s, EDS_F_PDO_MAPPING )) &&
+            parse_num( kv->value, 1, &pdo_mapping ) )
+            goto PARSE_ERR;
+        if( (kv = sect_get( P, s, EDS_F_SUB_NUMBER )) &&
+            parse_num( kv->value, 0xFF, &sub_number ) )
+            goto PARSE_ERR;
+
+        const enum eds_field refs[2] = {EDS_F_MASK_ENUM, EDS_F_VALUE_ENUM};
+        for( size_t j = 0; j < 2; j++ ) {
+            if( NULL == (kv = sect_get( P, s, refs[j] )) ) continue;
+            struct eds_sect *e = find_enum( P, kv->value );
+            if( NULL == e->desc ) {
+                size_t m = enum_elts( P, e, elt );
+                e->desc = desc;
+                for( size_t k = 0; k < m; k++ ) {
+                    desc[k].name = arena_strcpy( &str, elt[k].name, 1 );
+                    desc[k].description = elt[k].desc ?
+                        arena_strcpy( &str, elt[k].desc, 0 ) : desc[k].name;
+                    if( elt[k].value && eval_expr( elt[k].value, &desc[k].value ) ) {
+                        r = fail( err, files[e->file], elt[k].line, CANMAT_ERR_PARAM );
+                        free( arena );
+                        goto END;
+                    }
+                }
+                qsort( desc, m, sizeof(desc[0]), elt_compar );
+                desc += m + 1;
+            }
+            d[j] = e->desc;
+        }
+
+        canmat_obj_t o = {
+            .index = (uint16_t)(s->key >> 8),
+            .subindex = (uint8_t)(s->key & 0xFF),
+            .parameter_name = arena_strcpy( &str, sect_get( P, s, EDS_F_PARAMETER_NAME )->value, 0 ),
+            .sub_number = (uint8_t)sub_number,
+            .access_type = (enum canmat_access_type)access_type,
+            .object_type = (enum canmat_object_type)object_type,
+            .data_type = (enum canmat_data_type)data_type,
+            .pdo_mapping = pdo_mapping ? 1 : 0,
+            .mask_descriptor = d[0],
+            .value_descriptor = d[1]
+        };
+        memcpy( objs + i, &o, sizeof(o) );
+        tree[i].parameter_name = objs[i].parameter_name;
+        tree[i].i = i;
+
+        // an ARRAY or RECORD and its sub0 share a key, sub0 sorts last
+        if( 0 == n_keys || keys[n_keys-1] != s->key ) {
+            keys[n_keys++] = s->key;
+        }
+        pos[n_keys-1] = (uint32_t)i;
+        continue;
+
+    PARSE_ERR:
+        r = fail( err, files[s->file], kv->line, CANMAT_ERR_PARAM );
+        free( arena );
+        goto END;
+    }
+
+    qsort( tree, n, sizeof(tree[0]), name_tree_compar );
+    if( canmat_dict_hash_fill( index_hash, seed, seed + nbucket, keys, n_keys ) ) {
+        free( arena );
+        r = CANMAT_ERR_OS;
+        goto END;
+    }
+    for( size_t j = 0; j < nslot; j++ ) {
+        seed[nbucket + j] = pos[ seed[nbucket + j] ];
+    }
+    canmat_dict_name_hash_fill( name_hash, name_slot, n_name_slot, objs, n );
+
+    dict->length = n;
+    dict->btree_name = tree;
+    dict->obj = objs;
+    dict->index_hash = index_hash;
+    dict->name_hash = name_hash;
+    *pdict = dict;
+
+END:
+    free( obj );
+    free( elt );
+    free( keys );
+    free( pos );
+    return r;
+}
+
+static canmat_status_t parse_files( struct eds_parse *P, size_t n_files, const char *const *files,
+                                    struct canmat_eds_error *err ) {
+    canmat_status_t r = CANMAT_OK;
+    memset( P, 0, sizeof(*P) );
+    fail( err, NULL, 0, CANMAT_OK );
+
+    P->buf = (char**)calloc( n_files + 1, sizeof(P->buf[0]) );
+    if( NULL == P->buf ) return CANMAT_ERR_OS;
+
+    for( size_t i = 0; CANMAT_OK == r && i < n_files; i++ ) {
+        unsigned line;
+        P->buf[i] = read_file( files[i] );
+        P->n_buf++;
+        if( NULL == P->buf[i] ) {
+            r = fail( err, files[i], 0, CANMAT_ERR_OS );
+        } else if( CANMAT_OK != (r = parse_buf( P, i, P->buf[i], &line )) ) {
+            fail( err, files[i], line, r );
+        }
+    }
+    return r;
+}
+
+static void parse_free( struct eds_parse *P ) {
+    if( P->buf ) {
+        for( size_t i = 0; i < P->n_buf; i++ ) free( P->buf[i] );
+    }
+    free( P->buf );
+    free( P->kv );
+    free( P->sect );
+}
+
+canmat_status_t canmat_dict_load_eds( size_t n_files, const char *const *files,
+                                      struct canmat_dict **dict, struct canmat_eds_error *err ) {
+    struct eds_parse P;
+    canmat_status_t r = parse_files( &P, n_files, files, err );
+    if( CANMAT_OK == r ) {
+        r = build( &P, files, dict, err );
+    }
+    parse_free( &P );
+    return r;
+}
+
+/* An object value of a DCF */
+struct dcf_val {
+    uint16_t index;
+    uint8_t subindex;
+    int data_type;
+    const struct eds_kv *value;
+    const char *file;
+};
+
+static int dcf_pdo_mapping( uint16_t index ) {
+    return (index >= 0x1600 && index <= 0x17FF) || (index >= 0x1A00 && index <= 0x1BFF);
+}
+
+static int dcf_pdo_comm( uint16_t index ) {
+    return (index >= 0x1400 && index <= 0x15FF) || (index >= 0x1800 && index <= 0x19FF);
+}
+
+/* Append a ParameterValue, numbers may use $NODEID.  Bits of set are
+ * set in UNSIGNED32 values. */
+static canmat_status_t dcf_add( struct canmat_cdcf *c, const struct dcf_val *v, uint8_t node,
+                                uint32_t set, struct canmat_eds_error *err ) {
+    const char *s = v->value->value;
+    switch( v->data_type ) {
+    case CANMAT_DATA_TYPE_VISIBLE_STRING:
+    case CANMAT_DATA_TYPE_OCTET_STRING:
+        return canmat_cdcf_add( c, v->index, v->subindex, s, strlen(s) );
+    default:
+        break;
+    }
+
+    const canmat_obj_t obj = { .index = v->index, .subindex = v->subindex,
+                               .data_type = (enum canmat_data_type)v->data_type };
+    canmat_scalar_t val;
+    char buf[64];
+    if( CANMAT_DATA_TYPE_REAL32 != v->data_type ) {
+        // integers are expressions, e.g. $NODEID+0x180
+        const char *id = strstr( s, "$NODEID" );
+        if( id ) {
+            snprintf( buf, sizeof(buf), "%.*s%u%s", (int)(id - s), s, (unsigned)node, id + 7 );
+            s = buf;
+        }
+        long long x;
+        const char *e = s;
+        if( eval_or( &e, &x ) ) goto PARSE_ERR;
+        skip_space( &e );
+        if( '\0' != *e ) goto PARSE_ERR;
+        snprintf( buf, sizeof(buf), "%lld", x );
+        s = buf;
+    }
+    if( canmat_typed_parse( obj.data_type, s, &val ) ) goto PARSE_ERR;
+    if( CANMAT_DATA_TYPE_UNSIGNED32 == obj.data_type ) val.u32 |= set;
+    if( CANMAT_OK != canmat_cdcf_add_obj( c, &obj, &val ) ) goto PARSE_ERR;
+    return CANMAT_OK;
+
+PARSE_ERR:
+    return fail( err, v->file, v->value->line, CANMAT_ERR_PARAM );
+}
+
+/* End of the values of val[i].index */
+static size_t dcf_group_end( const struct dcf_val *val, size_t m, size_t i ) {
+    size_t j = i;
+    while( j < m && val[j].index == val[i].index ) j++;
+    return j;
+}
+
+/* First value of index, or m */
+static size_t dcf_find( const struct dcf_val *val, size_t m, uint16_t index ) {
+    size_t i = 0;
+    while( i < m && val[i].index != index ) i++;
+    return i;
+}
+
+/* Append the values [i,j) of a PDO mapping */
+static canmat_status_t dcf_add_map( struct canmat_cdcf *c, const struct dcf_val *val, size_t i, size_t j,
+                                    uint8_t node, struct canmat_eds_error *err ) {
+    canmat_status_t r = CANMAT_OK;
+    if( 0 != val[i].subindex ) {
+        for( size_t k = i; CANMAT_OK == r && k < j; k++ ) r = dcf_add( c, val + k, node, 0, err );
+        return r;
+    }
+    // clear, map, then enable
+    static const uint8_t zero = 0;
+    r = canmat_cdcf_add( c, val[i].index, 0, &zero, 1 );
+    for( size_t k = i + 1; CANMAT_OK == r && k < j; k++ ) r = dcf_add( c, val + k, node, 0, err );
+    if( CANMAT_OK == r ) r = dcf_add( c, val + i, node, 0, err );
+    return r;
+}
+
+canmat_status_t canmat_cdcf_load_dcf( struct canmat_cdcf *c, size_t n_files, const char *const *files,
+                                      const canmat_dict_t *dict, uint8_t node,
+                                      struct canmat_eds_error *err ) {
+    struct eds_parse P;
+    struct eds_sect **obj = NULL;
+    struct dcf_val *val = NULL;
+    size_t n = 0, m = 0;
+    canmat_status_t r = parse_files( &P, n_files, files, err );
+    if( CANMAT_OK != r ) goto END;
+
+    obj = (struct eds_sect**)malloc( (P.n_sect + 1) * sizeof(obj[0]) );
+    val = (struct dcf_val*)malloc( (P.n_sect + 1) * sizeof(val[0]) );
+    if( NULL == obj || NULL == val ) {
+        r = CANMAT_ERR_OS;
+        goto END;
+    }
+    for( size_t i = 0; i < P.n_sect; i++ ) {
+        if( EDS_SECT_OBJ == P.sect[i].type ) obj[n++] = P.sect + i;
+    }
+    qsort( obj, n, sizeof(obj[0]), obj_compar );
+
+    // writable values, later layers override earlier keys
+    for( size_t i = 0; i < n; ) {
+        const struct eds_kv *kv[EDS_N_FIELD] = {NULL};
+        const struct eds_sect *s = obj[i];
+        for( ; i < n && obj[i]->key == s->key; i++ ) {
+            for( size_t f = 0; f < EDS_N_FIELD; f++ ) {
+                const struct eds_kv *k = sect_get( &P, obj[i], (enum eds_field)f );
+                if( k ) kv[f] = k;
+            }
+            s = obj[i];
+        }
+        if( NULL == kv[EDS_F_PARAMETER_VALUE] ) continue;
+
+        uint16_t index = (uint16_t)(s->key >> 8);
+        uint8_t subindex = (uint8_t)(s->key & 0xFF);
+        const canmat_obj_t *o = dict ? canmat_dict_search_index( dict, index, subindex ) : NULL;
+        int data_type = o ? (int)o->data_type : -1;
+        int access_type = o ? (int)o->access_type : CANMAT_ACCESS_UNKNOWN;
+        if( (kv[EDS_F_DATA_TYPE] &&
+             parse_token( eds_data_types, kv[EDS_F_DATA_TYPE]->value, 1, &data_type )) ||
+            (kv[EDS_F_ACCESS_TYPE] &&
+             parse_token( eds_access_types, kv[EDS_F_ACCESS_TYPE]->value, 0, &access_type )) ||
+            data_type < 0 )
+        {
+            r = fail( err, files[s->file], kv[EDS_F_PARAMETER_VALUE]->line, CANMAT_ERR_PARAM );
+            goto END;
+        }
+        if( CANMAT_ACCESS_WO != access_type && CANMAT_ACCESS_RW != access_type &&
+            CANMAT_ACCESS_RWR != access_type && CANMAT_ACCESS_RWW != access_type )
+            continue;
+
+        struct dcf_val *v = val + m++;
+        v->index = index;
+        v->subindex = subindex;
+        v->data_type = data_type;
+        v->value = kv[EDS_F_PARAMETER_VALUE];
+        v->file = files[s->file];
+    }
+
+    for( size_t i = 0; CANMAT_OK == r && i < m; ) {
+        size_t j = dcf_group_end( val, m, i );
+        uint16_t index = val[i].index;
+        if( dcf_pdo_comm( index ) ) {
+            // a PDO must be invalid while it changes
+            size_t cob = i;
+            while( cob < j && 1 != val[cob].subindex ) cob++;
+            if( cob < j ) r = dcf_add( c, val + cob, node, CANMAT_COBID_PDO_MASK_VALID, err );
+            for( size_t k = i; CANMAT_OK == r && k < j; k++ ) {
+                if( k != cob ) r = dcf_add( c, val + k, node, 0, err );
+            }
+            size_t map = dcf_find( val, m, (uint16_t)(index + 0x200) );
+            if( CANMAT_OK == r && map < m ) {
+                r = dcf_add_map( c, val, map, dcf_group_end( val, m, map ), node, err );
+            }
+            if( CANMAT_OK == r && cob < j ) r = dcf_add( c, val + cob, node, 0, err );
+        } else if( dcf_pdo_mapping( index ) ) {
+            // with its PDO unless the DCF has no parameters for it
+            if( m == dcf_find( val, m, (uint16_t)(index - 0x200) ) ) {
+                r = dcf_add_map( c, val, i, j, node, err );
+            }
+        } else {
+            for( size_t k = i; CANMAT_OK == r && k < j; k++ ) r = dcf_add( c, val + k, node, 0, err );
+        }
+        i = j;
+    }
+
+END:
+    free( obj );
+    free( val );
+    parse_free( &P );
+    return r;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
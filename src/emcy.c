@@ -0,0 +1,140 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "socanmatic.h"
+
+void canmat_emcy_init( struct canmat_emcy *e ) {
+    memset( e, 0, sizeof(*e) );
+}
+
+int canmat_emcy_subscribe( struct canmat_emcy *e, uint8_t node, canmat_emcy_class_t cls,
+                           canmat_emcy_fun *fun, void *cx ) {
+    for( int i = 0; i < CANMAT_EMCY_SUB_MAX; i++ ) {
+        if( NULL == e->sub[i].fun ) {
+            e->sub[i].fun = fun;
+            e->sub[i].cx = cx;
+            e->sub[i].node = node;
+            e->sub[i].cls = cls;
+            return i;
+        }
+    }
+    return CANMAT_ERR_OVERFLOW;
+}
+
+void canmat_emcy_unsubscribe( struct canmat_emcy *e, int handle ) {
+    if( handle >= 0 && handle < CANMAT_EMCY_SUB_MAX ) e->sub[handle].fun = NULL;
+}
+
+int canmat_emcy_frame( struct canmat_emcy *e, const struct can_frame *can, int64_t now ) {
+    uint8_t node = canmat_frame_node( can );
+    // node 0 is SYNC
+    if( canmat_frame_func(can) != CANMAT_FUNC_CODE_SYNC_EMCY || 0 == node ||
+        (can->can_id & (CAN_RTR_FLAG | CAN_EFF_FLAG)) || can->can_dlc < 3 )
+    {
+        return 0;
+    }
+    struct canmat_emcy_entry x;
+    memset( &x, 0, sizeof(x) );
+    x.time = now;
+    x.code = canmat_frame_emcy_get_eec( can );
+    x.reg = canmat_frame_emcy_get_er( can );
+    if( can->can_dlc > 3 ) memcpy( x.msef, can->data+3, (size_t)(can->can_dlc > 8 ? 8 : can->can_dlc) - 3 );
+
+    struct canmat_emcy_ring *r = &e->ring[node];
+    uint64_t s = r->end;
+    __atomic_store_n( &r->begin, s+1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    r->entry[s & (CANMAT_EMCY_HIST-1)] = x;
+    __atomic_store_n( &r->end, s+1, __ATOMIC_RELEASE );
+
+    for( int i = 0; i < CANMAT_EMCY_SUB_MAX; i++ ) {
+        if( e->sub[i].fun &&
+            (0 == e->sub[i].node || node == e->sub[i].node) &&
+            (CANMAT_EMCY_CLASS_ANY == e->sub[i].cls || canmat_emcy_class_match(e->sub[i].cls, x.code)) )
+        {
+            e->sub[i].fun( e->sub[i].cx, node, &x );
+        }
+    }
+    return 1;
+}
+
+void canmat_emcy_recv( void *cx, const struct can_frame *can ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    canmat_emcy_frame( (struct canmat_emcy*)cx, can,
+                       (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec );
+}
+
+size_t canmat_emcy_read( const struct canmat_emcy *e, uint8_t node, uint64_t *seq,
+                         struct canmat_emcy_entry *out, size_t n ) {
+    const struct canmat_emcy_ring *r = &e->ring[node & CANMAT_NODE_MASK];
+    uint64_t end = __atomic_load_n( &r->end, __ATOMIC_ACQUIRE );
+    uint64_t s = *seq;
+    if( end - s > CANMAT_EMCY_HIST ) s = end - CANMAT_EMCY_HIST;
+    if( end - s > n ) end = s + n;
+
+    size_t k = 0;
+    for( uint64_t i = s; i < end; i++ ) {
+        out[k++] = r->entry[i & (CANMAT_EMCY_HIST-1)];
+    }
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    uint64_t begin = __atomic_load_n( &r->begin, __ATOMIC_RELAXED );
+
+    // entry i is gone once the write of i + CANMAT_EMCY_HIST began
+    size_t torn = 0;
+    if( begin > s + CANMAT_EMCY_HIST ) {
+        torn = (size_t)(begin - s - CANMAT_EMCY_HIST);
+        if( torn > k ) torn = k;
+        memmove( out, out + torn, (k - torn) * sizeof(out[0]) );
+    }
+    *seq = end;
+    return k - torn;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -0,0 +1,189 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "socanmatic.h"
+
+/* Count and pass on frames of the clients */
+static canmat_status_t fanout_send( void *cx, const struct can_frame *can ) {
+    struct canmat_fanout *f = (struct canmat_fanout*)cx;
+    f->frames++;
+    f->bits += canmat_frame_bits( can );
+    return f->send( f->send_cx, can );
+}
+
+void canmat_fanout_init( struct canmat_fanout *f, struct canmat_fanout_node *node, size_t n,
+                         canmat_sdo_client_send_fun *send, void *send_cx ) {
+    memset( f, 0, sizeof(*f) );
+    memset( node, 0, n * sizeof(node[0]) );
+    f->node = node;
+    f->n = n;
+    f->send = send;
+    f->send_cx = send_cx;
+}
+
+void canmat_fanout_node_set( struct canmat_fanout *f, size_t i, uint8_t node_id,
+                             const struct canmat_cdcf *param ) {
+    struct canmat_fanout_node *n = &f->node[i];
+    canmat_sdo_client_init( &n->client, node_id, fanout_send, f );
+    n->param = param;
+    f->slot[node_id & CANMAT_NODE_MASK] = (uint8_t)(i + 1);
+}
+
+static void finish( struct canmat_fanout *f, struct canmat_fanout_node *n,
+                    canmat_status_t status, int64_t now ) {
+    n->status = status;
+    n->end = now;
+    if( now > f->end ) f->end = now;
+}
+
+/* Start writing the entry at n->pos, or finish */
+static void next( struct canmat_fanout *f, struct canmat_fanout_node *n, int64_t now ) {
+    const struct canmat_cdcf *p = n->param;
+    if( NULL == p || n->pos + 7 > p->size ) {
+        finish( f, n, CANMAT_OK, now );
+        return;
+    }
+    const uint8_t *e = p->data + n->pos;
+    uint32_t size = canmat_byte_ldle32( e+3 );
+    if( size > p->size - n->pos - 7 ) {
+        finish( f, n, CANMAT_ERR_PARAM, now );
+        return;
+    }
+    n->pos += 7 + size;
+    canmat_status_t r = canmat_sdo_client_dl( &n->client, canmat_byte_ldle16( e ), e[2],
+                                              e+7, size, 0, now );
+    if( CANMAT_OK != r ) finish( f, n, r, now );
+}
+
+static void done( struct canmat_fanout *f, struct canmat_fanout_node *n, int64_t now ) {
+    if( CANMAT_OK == n->client.status ) {
+        n->written++;
+        next( f, n, now );
+    } else {
+        n->abort = n->client.abort;
+        finish( f, n, n->client.status, now );
+    }
+}
+
+void canmat_fanout_start( struct canmat_fanout *f, int64_t now ) {
+    f->start = f->end = now;
+    f->frames = f->bits = 0;
+    for( size_t i = 0; i < f->n; i++ ) {
+        struct canmat_fanout_node *n = &f->node[i];
+        n->pos = 4;
+        n->written = 0;
+        n->status = CANMAT_OK;
+        n->abort = 0;
+        next( f, n, now );
+    }
+}
+
+int canmat_fanout_frame( struct canmat_fanout *f, const struct can_frame *can, int64_t now ) {
+    uint8_t slot = f->slot[ canmat_frame_node(can) ];
+    if( 0 == slot ) return 0;
+    struct canmat_fanout_node *n = &f->node[slot - 1];
+    enum canmat_sdo_client_event ev = canmat_sdo_client_frame( &n->client, can, now );
+    if( CANMAT_SDO_CLIENT_IGNORED == ev ) return 0;
+    f->frames++;
+    f->bits += canmat_frame_bits( can );
+    if( CANMAT_SDO_CLIENT_DONE == ev ) done( f, n, now );
+    return 1;
+}
+
+void canmat_fanout_timeout( struct canmat_fanout *f, int64_t now ) {
+    for( size_t i = 0; i < f->n; i++ ) {
+        struct canmat_fanout_node *n = &f->node[i];
+        if( CANMAT_SDO_CLIENT_DONE == canmat_sdo_client_timeout( &n->client, now ) ) {
+            done( f, n, now );
+        }
+    }
+}
+
+size_t canmat_fanout_busy( const struct canmat_fanout *f ) {
+    size_t k = 0;
+    for( size_t i = 0; i < f->n; i++ ) {
+        if( canmat_sdo_client_busy( &f->node[i].client ) ) k++;
+    }
+    return k;
+}
+
+int64_t canmat_fanout_deadline( const struct canmat_fanout *f ) {
+    int64_t deadline = INT64_MAX;
+    for( size_t i = 0; i < f->n; i++ ) {
+        const struct canmat_sdo_client *c = &f->node[i].client;
+        if( canmat_sdo_client_busy(c) && canmat_sdo_client_deadline(c) < deadline ) {
+            deadline = canmat_sdo_client_deadline(c);
+        }
+    }
+    return deadline;
+}
+
+static int64_t run_timeout( void *cx, int64_t now ) {
+    struct canmat_fanout *f = (struct canmat_fanout*)cx;
+    canmat_fanout_timeout( f, now );
+    return canmat_fanout_busy( f ) ? canmat_fanout_deadline( f ) : CANMAT_STEP_DONE;
+}
+
+static void run_frame( void *cx, const struct can_frame *can, int64_t now ) {
+    canmat_fanout_frame( (struct canmat_fanout*)cx, can, now );
+}
+
+canmat_status_t canmat_fanout_run( struct canmat_fanout *f, canmat_iface_t *cif ) {
+    canmat_fanout_start( f, canmat_now_ns() );
+    return canmat_step_run( cif, run_timeout, run_frame, f );
+}
+
+double canmat_fanout_load( const struct canmat_fanout *f, unsigned kbps ) {
+    int64_t dt = f->end - f->start;
+    if( dt <= 0 || 0 == kbps ) return 0;
+    return (double)f->bits * 1e6 / ((double)dt * kbps);
+}
+
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
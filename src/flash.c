@@ -0,0 +1,277 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include "socanmatic.h"
+
+/// Longest wait before sending again into a full transmit queue
+#define SEND_RETRY_NS 1000000LL
+
+canmat_status_t canmat_flash_queue( void *cx, const struct can_frame *can ) {
+    struct canmat_flash *f = (struct canmat_flash*)cx;
+    if( f->tx_n >= CANMAT_FLASH_TXQ ) return CANMAT_ERR_OVERFLOW;
+    f->txq[(f->tx_head + f->tx_n) % CANMAT_FLASH_TXQ] = *can;
+    f->tx_n++;
+    return CANMAT_OK;
+}
+
+void canmat_flash_init( struct canmat_flash *f, uint8_t node, uint8_t program,
+                        canmat_sdo_client_send_fun *send, void *send_cx ) {
+    memset( f, 0, sizeof(*f) );
+    canmat_sdo_client_init( &f->client, node, send, send_cx );
+    f->program = program;
+}
+
+static void finish( struct canmat_flash *f, canmat_status_t status, int64_t now ) {
+    f->state = CANMAT_FLASH_IDLE;
+    f->status = status;
+    f->end = now;
+}
+
+/* Enter state if a transfer started, otherwise end the job */
+static void started( struct canmat_flash *f, canmat_status_t r, enum canmat_flash_state state,
+                     int64_t now ) {
+    if( CANMAT_OK == r ) f->state = state;
+    else finish( f, r, now );
+}
+
+static void control( struct canmat_flash *f, enum canmat_flash_control cmd,
+                     enum canmat_flash_state state, int64_t now ) {
+    f->cmd = (uint8_t)cmd;
+    started( f, canmat_sdo_client_dl( &f->client, CANMAT_FLASH_CONTROL, f->program,
+                                      &f->cmd, 1, 0, now ),
+             state, now );
+}
+
+static void check( struct canmat_flash *f, int64_t now ) {
+    started( f, canmat_sdo_client_ul( &f->client, CANMAT_FLASH_STATUS, f->program,
+                                      f->buf, sizeof(f->buf), 0, now ),
+             CANMAT_FLASH_CHECK, now );
+}
+
+/* Did the node abort because it lacks the object? */
+static int missing( const struct canmat_sdo_client *c ) {
+    return CANMAT_ERR_ABORT == c->status &&
+        ( CANMAT_ABORT_OBJ_EXIST == c->abort || CANMAT_ABORT_SUBINDEX_EXIST == c->abort );
+}
+
+canmat_status_t canmat_flash_start( struct canmat_flash *f, const void *image, size_t size, int64_t now ) {
+    if( canmat_flash_busy(f) ) return CANMAT_ERR_PARAM;
+    f->image = (const uint8_t*)image;
+    f->size = size;
+    f->sent = 0;
+    f->abort = 0;
+    f->flash_status = 0;
+    f->start = now;
+    f->download_start = f->download_end = 0;
+    control( f, CANMAT_FLASH_CONTROL_STOP, CANMAT_FLASH_STOP, now );
+    return canmat_flash_busy(f) ? CANMAT_OK : f->status;
+}
+
+/* Handle a finished transfer */
+static void done( struct canmat_flash *f, int64_t now ) {
+    struct canmat_sdo_client *c = &f->client;
+    if( CANMAT_OK != c->status && !missing(c) ) {
+        // a node may refuse to stop a program that is not running
+        if( CANMAT_FLASH_STOP != f->state || CANMAT_ERR_ABORT != c->status ) {
+            f->abort = c->abort;
+            finish( f, c->status, now );
+            return;
+        }
+    }
+
+    switch( f->state ) {
+    case CANMAT_FLASH_STOP:
+        control( f, CANMAT_FLASH_CONTROL_CLEAR, CANMAT_FLASH_CLEAR, now );
+        return;
+    case CANMAT_FLASH_CLEAR:
+        f->download_start = now;
+        started( f, canmat_sdo_client_dl( &f->client, CANMAT_FLASH_DATA, f->program,
+                                          f->image, f->size, 1, now ),
+                 CANMAT_FLASH_DOWNLOAD, now );
+        return;
+    case CANMAT_FLASH_DOWNLOAD:
+        if( missing(c) ) {
+            f->abort = c->abort;
+            finish( f, c->status, now );
+            return;
+        }
+        f->download_end = now;
+        f->sent = f->size;
+        check( f, now );
+        return;
+    case CANMAT_FLASH_CHECK:
+        if( CANMAT_OK == c->status ) {
+            f->flash_status = canmat_byte_ldle32( f->buf );
+            if( CANMAT_FLASH_STATUS_ERROR( f->flash_status ) ) {
+                finish( f, CANMAT_ERR_DEV, now );
+                return;
+            }
+            if( f->flash_status & CANMAT_FLASH_STATUS_BUSY ) {
+                if( now - f->download_end > CANMAT_FLASH_BUSY_NS ) {
+                    finish( f, CANMAT_ERR_TIMEOUT, now );
+                } else {
+                    f->state = CANMAT_FLASH_WAIT;
+                    f->poll = now + CANMAT_FLASH_POLL_NS;
+                }
+                return;
+            }
+        }
+        control( f, CANMAT_FLASH_CONTROL_START, CANMAT_FLASH_START, now );
+        return;
+    case CANMAT_FLASH_START:
+        if( missing(c) ) {
+            f->abort = c->abort;
+            finish( f, c->status, now );
+            return;
+        }
+        finish( f, CANMAT_OK, now );
+        return;
+    case CANMAT_FLASH_WAIT:
+    case CANMAT_FLASH_IDLE:
+        return;
+    }
+}
+
+int canmat_flash_frame( struct canmat_flash *f, const struct can_frame *can, int64_t now ) {
+    if( !canmat_flash_busy(f) ) return 0;
+    enum canmat_sdo_client_event ev = canmat_sdo_client_frame( &f->client, can, now );
+    if( CANMAT_SDO_CLIENT_IGNORED == ev ) return 0;
+    if( CANMAT_SDO_CLIENT_DONE == ev ) done( f, now );
+    return 1;
+}
+
+void canmat_flash_timeout( struct canmat_flash *f, int64_t now ) {
+    if( CANMAT_FLASH_WAIT == f->state ) {
+        if( now >= f->poll ) check( f, now );
+    } else if( canmat_flash_busy(f) &&
+               CANMAT_SDO_CLIENT_DONE == canmat_sdo_client_timeout( &f->client, now ) ) {
+        done( f, now );
+    }
+}
+
+int64_t canmat_flash_deadline( const struct canmat_flash *f ) {
+    return CANMAT_FLASH_WAIT == f->state ? f->poll : canmat_sdo_client_deadline( &f->client );
+}
+
+struct run {
+    canmat_iface_t *cif;
+    struct canmat_flash *f;
+    size_t n;
+    canmat_flash_progress_fun *progress;
+    void *cx;
+    canmat_status_t status;        ///< interface error that stopped the run
+    size_t next;                   ///< job to send from first at the next flush
+};
+
+/* Send queued frames, one from each job in turn, until the queues are
+ * empty or the transmit queue is full.  Sets backlog if frames are
+ * left.  The next flush picks up with the job after the last one
+ * served, so a bus taking fewer frames than there are jobs still gets
+ * to all of them.  A job's answer is due a timeout after its frame
+ * reached the bus, not after it was queued. */
+static canmat_status_t flush( struct run *x, int64_t now, int *backlog ) {
+    // stop after a full turn of jobs with nothing to send
+    for( size_t idle = 0; idle < x->n; x->next = (x->next + 1) % x->n ) {
+        struct canmat_flash *f = &x->f[x->next];
+        if( 0 == f->tx_n ) {
+            idle++;
+            continue;
+        }
+        canmat_status_t r = canmat_iface_send( x->cif, &f->txq[f->tx_head] );
+        if( CANMAT_ERR_OS == r && (ENOBUFS == x->cif->err || EAGAIN == x->cif->err) ) {
+            *backlog = 1;
+            return CANMAT_OK;
+        }
+        if( CANMAT_OK != r ) return r;
+        f->tx_head = (uint16_t)((f->tx_head + 1) % CANMAT_FLASH_TXQ);
+        f->tx_n--;
+        f->client.deadline = now + f->client.timeout_ns;
+        idle = 0;
+    }
+    *backlog = 0;
+    return CANMAT_OK;
+}
+
+static int64_t run_timeout( void *cx, int64_t now ) {
+    struct run *x = (struct run*)cx;
+    int64_t deadline = CANMAT_STEP_DONE;
+    for( size_t i = 0; i < x->n; i++ ) {
+        canmat_flash_timeout( &x->f[i], now );
+        if( canmat_flash_busy( &x->f[i] ) ) {
+            int64_t d = canmat_flash_deadline( &x->f[i] );
+            if( CANMAT_STEP_DONE == deadline || d < deadline ) deadline = d;
+        }
+    }
+    int backlog;
+    x->status = flush( x, now, &backlog );
+    if( CANMAT_OK != x->status ) return CANMAT_STEP_DONE;
+    if( x->progress ) x->progress( x->cx, x->f, x->n );
+
+    // socketcan may report room while the device queue is still full,
+    // so retry the backlog shortly rather than waiting for POLLOUT
+    if( backlog && (CANMAT_STEP_DONE == deadline || deadline - now > SEND_RETRY_NS) ) {
+        deadline = now + SEND_RETRY_NS;
+    }
+    return deadline;
+}
+
+static void run_frame( void *cx, const struct can_frame *can, int64_t now ) {
+    struct run *x = (struct run*)cx;
+    for( size_t i = 0; i < x->n && !canmat_flash_frame( &x->f[i], can, now ); i++ );
+}
+
+canmat_status_t canmat_flash_run( canmat_iface_t *cif, struct canmat_flash *f, size_t n,
+                                  canmat_flash_progress_fun *progress, void *cx ) {
+    struct run x = { cif, f, n, progress, cx, CANMAT_OK, 0 };
+    canmat_status_t r = canmat_step_run( cif, run_timeout, run_frame, &x );
+    return CANMAT_OK == r ? x.status : r;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -0,0 +1,89 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "socanmatic.h"
+
+void canmat_hist_init( struct canmat_hist *h, int64_t bucket_ns ) {
+    memset( h, 0, sizeof(*h) );
+    h->bucket_ns = bucket_ns > 0 ? bucket_ns : 1;
+}
+
+int64_t canmat_hist_quantile( const struct canmat_hist *h, double q ) {
+    if( 0 == h->count ) return 0;
+    uint64_t target = (uint64_t)(q * (double)h->count);
+    uint64_t n = 0;
+    for( size_t i = 0; i < CANMAT_HIST_NBUCKET - 1; i ++ ) {
+        n += h->bucket[i];
+        if( n > target ) return (int64_t)(i+1) * h->bucket_ns;
+    }
+    // in the overflow bucket
+    return h->max;
+}
+
+void canmat_hist_print( FILE *f, const char *name, const struct canmat_hist *h ) {
+    fprintf( f, "%s: n=%"PRIu64, name, h->count );
+    if( 0 == h->count ) {
+        fputc( '\n', f );
+        return;
+    }
+    fprintf( f, " min=%"PRId64" mean=%.0f p99=%"PRId64" p99.9=%"PRId64" max=%"PRId64" (ns)\n",
+             h->min, h->sum / (double)h->count,
+             canmat_hist_quantile( h, 0.99 ), canmat_hist_quantile( h, 0.999 ),
+             h->max );
+    for( size_t i = 0; i < CANMAT_HIST_NBUCKET; i ++ ) {
+        if( h->bucket[i] ) {
+            fprintf( f, "  %s%8"PRId64": %"PRIu64"\n",
+                     (CANMAT_HIST_NBUCKET - 1 == i) ? ">=" : "< ",
+                     (CANMAT_HIST_NBUCKET - 1 == i) ? (int64_t)i * h->bucket_ns : (int64_t)(i+1) * h->bucket_ns,
+                     h->bucket[i] );
+        }
+    }
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
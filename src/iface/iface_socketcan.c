@@ -43,6 +43,8 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
@@ -58,6 +60,8 @@ static canmat_status_t v_filter( struct canmat_iface *cif, const struct can_filt
 static const char *v_strerror( struct canmat_iface *cif );
 static canmat_status_t v_set_kbps( struct canmat_iface *cif, unsigned kbps );
 static canmat_status_t v_print_info( struct canmat_iface *cif, FILE *fptr );
+static canmat_status_t v_tx_stamp_enable( struct canmat_iface *cif );
+static canmat_status_t v_tx_stamp( struct canmat_iface *cif, struct timespec *ts );
 
 static struct canmat_iface_vtable vtable = {
     .open=v_open,
@@ -67,7 +71,9 @@ static struct canmat_iface_vtable vtable = {
     .filter=v_filter,
     .strerror=v_strerror,
     .set_kbps=v_set_kbps,
-    .print_info=v_print_info
+    .print_info=v_print_info,
+    .tx_stamp_enable=v_tx_stamp_enable,
+    .tx_stamp=v_tx_stamp
 };
 
 canmat_iface_t * canmat_iface_new_socketcan( void ) {
@@ -155,6 +161,37 @@ static canmat_status_t v_filter( struct canmat_iface *cif, const struct can_filt
 
 }
 
+static canmat_status_t v_tx_stamp_enable( struct canmat_iface *cif ) {
+    int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_TSONLY;
+    if( setsockopt( cif->fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags) ) ) {
+        return set_err(cif);
+    }
+    return CANMAT_OK;
+}
+
+static canmat_status_t v_tx_stamp( struct canmat_iface *cif, struct timespec *ts ) {
+    char control[256];
+    struct msghdr msg;
+    memset( &msg, 0, sizeof(msg) );
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    // timestamps come back on the error queue
+    if( recvmsg( cif->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT ) < 0 ) {
+        if( EAGAIN == errno || EWOULDBLOCK == errno ) return CANMAT_ERR_UNDERFLOW;
+        return set_err(cif);
+    }
+    for( struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c) ) {
+        if( SOL_SOCKET == c->cmsg_level && SO_TIMESTAMPING == c->cmsg_type ) {
+            struct scm_timestamping stamp;
+            memcpy( &stamp, CMSG_DATA(c), sizeof(stamp) );
+            *ts = stamp.ts[0];
+            return CANMAT_OK;
+        }
+    }
+    return CANMAT_ERR_UNDERFLOW;
+}
+
 /* ex: set shiftwidth=4 tabstop=4 expandtab: */
 /* Local Variables:                          */
 /* mode: c                                   */
@@ -0,0 +1,253 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "socanmatic.h"
+
+/// Fast scan bit value to check for any unconfigured slave
+#define SCAN_RESET  0x80
+/// Fast scan step confirming a whole identity part
+#define SCAN_CONFIRM -1
+
+void canmat_lss_master_init( struct canmat_lss_master *m, canmat_sdo_client_send_fun *send, void *send_cx ) {
+    memset( m, 0, sizeof(*m) );
+    m->send = send;
+    m->send_cx = send_cx;
+    m->timeout_ns = CANMAT_LSS_TIMEOUT_NS;
+}
+
+static canmat_status_t send_cmd( struct canmat_lss_master *m, uint8_t cs, const uint8_t *data, size_t n ) {
+    struct can_frame can;
+    memset( &can, 0, sizeof(can) );
+    can.can_id = CANMAT_LSS_MASTER_ID;
+    can.can_dlc = 8;
+    can.data[0] = cs;
+    if( n ) memcpy( can.data+1, data, n );
+    return m->send( m->send_cx, &can );
+}
+
+/* Send a confirmed request and wait for response cs */
+static canmat_status_t request( struct canmat_lss_master *m, uint8_t cs, const uint8_t *data, size_t n,
+                                uint8_t expect, int64_t now ) {
+    if( CANMAT_LSS_MASTER_IDLE != m->state ) return CANMAT_ERR_PARAM;
+    canmat_status_t r = send_cmd( m, cs, data, n );
+    if( CANMAT_OK != r ) return r;
+    m->state = CANMAT_LSS_MASTER_WAIT;
+    m->expect = expect;
+    m->error = m->spec_error = 0;
+    m->value = 0;
+    m->deadline = now + m->timeout_ns;
+    return CANMAT_OK;
+}
+
+canmat_status_t canmat_lss_master_switch_global( struct canmat_lss_master *m, enum canmat_lss_mode mode ) {
+    uint8_t d = (uint8_t)mode;
+    return send_cmd( m, CANMAT_LSS_SWITCH_GLOBAL, &d, 1 );
+}
+
+canmat_status_t canmat_lss_master_switch_selective( struct canmat_lss_master *m, const uint32_t identity[4],
+                                                    int64_t now ) {
+    if( CANMAT_LSS_MASTER_IDLE != m->state ) return CANMAT_ERR_PARAM;
+    uint8_t d[4];
+    // the slave answers only the last, serial number request
+    for( int i = CANMAT_LSS_ID_VENDOR; i < CANMAT_LSS_ID_SERIAL; i++ ) {
+        canmat_byte_stle32( d, identity[i] );
+        canmat_status_t r = send_cmd( m, (uint8_t)(CANMAT_LSS_SWITCH_VENDOR + i), d, 4 );
+        if( CANMAT_OK != r ) return r;
+    }
+    canmat_byte_stle32( d, identity[CANMAT_LSS_ID_SERIAL] );
+    return request( m, CANMAT_LSS_SWITCH_SERIAL, d, 4, CANMAT_LSS_SWITCH_RESP, now );
+}
+
+canmat_status_t canmat_lss_master_node_id( struct canmat_lss_master *m, uint8_t node, int64_t now ) {
+    if( (0 == node || node > CANMAT_NODE_MASK) && CANMAT_LSS_NODE_UNCONFIGURED != node ) {
+        return CANMAT_ERR_PARAM;
+    }
+    return request( m, CANMAT_LSS_CONFIG_NODE_ID, &node, 1, CANMAT_LSS_CONFIG_NODE_ID, now );
+}
+
+canmat_status_t canmat_lss_master_bit_timing( struct canmat_lss_master *m, uint8_t index, int64_t now ) {
+    // table selector 0 is the CiA 305 table
+    uint8_t d[2] = {0, index};
+    return request( m, CANMAT_LSS_CONFIG_BIT_TIMING, d, 2, CANMAT_LSS_CONFIG_BIT_TIMING, now );
+}
+
+canmat_status_t canmat_lss_master_activate_bit_timing( struct canmat_lss_master *m, uint16_t delay_ms ) {
+    uint8_t d[2];
+    canmat_byte_stle16( d, delay_ms );
+    return send_cmd( m, CANMAT_LSS_ACTIVATE_BIT_TIMING, d, 2 );
+}
+
+canmat_status_t canmat_lss_master_store( struct canmat_lss_master *m, int64_t now ) {
+    return request( m, CANMAT_LSS_STORE, NULL, 0, CANMAT_LSS_STORE, now );
+}
+
+canmat_status_t canmat_lss_master_inquire( struct canmat_lss_master *m, enum canmat_lss_cs cs, int64_t now ) {
+    if( cs < CANMAT_LSS_INQUIRE_VENDOR || cs > CANMAT_LSS_INQUIRE_NODE_ID ) return CANMAT_ERR_PARAM;
+    return request( m, (uint8_t)cs, NULL, 0, (uint8_t)cs, now );
+}
+
+/* Send the fast scan query for the current sub and bit */
+static canmat_status_t scan_query( struct canmat_lss_master *m, int64_t now ) {
+    uint8_t d[7];
+    uint8_t next = m->sub;
+    uint8_t bit;
+    if( SCAN_CONFIRM == m->bit ) {
+        bit = 0;
+        next = (uint8_t)((m->sub + 1) & 3);
+    } else {
+        bit = (uint8_t)m->bit;
+    }
+    canmat_byte_stle32( d, m->identity[m->sub] );
+    d[4] = bit;
+    d[5] = m->sub;
+    d[6] = next;
+    m->answered = 0;
+    m->deadline = now + m->timeout_ns;
+    return send_cmd( m, CANMAT_LSS_FASTSCAN, d, 7 );
+}
+
+canmat_status_t canmat_lss_master_fastscan( struct canmat_lss_master *m, int64_t now ) {
+    if( CANMAT_LSS_MASTER_IDLE != m->state ) return CANMAT_ERR_PARAM;
+    memset( m->identity, 0, sizeof(m->identity) );
+    m->sub = 0;
+    m->bit = SCAN_RESET;
+    canmat_status_t r = scan_query( m, now );
+    if( CANMAT_OK == r ) m->state = CANMAT_LSS_MASTER_SCAN;
+    return r;
+}
+
+static enum canmat_lss_event finish( struct canmat_lss_master *m, canmat_status_t status ) {
+    m->state = CANMAT_LSS_MASTER_IDLE;
+    m->status = status;
+    return CANMAT_LSS_DONE;
+}
+
+/* Advance fast scan on whether some slave answered the last query */
+static enum canmat_lss_event scan_next( struct canmat_lss_master *m, int answered, int64_t now ) {
+    if( SCAN_RESET == m->bit ) {
+        if( !answered ) return finish( m, CANMAT_ERR_TIMEOUT );
+        m->bit = 31;
+    } else if( SCAN_CONFIRM == m->bit ) {
+        // the slave stopped answering
+        if( !answered ) return finish( m, CANMAT_ERR_PROTO );
+        if( CANMAT_LSS_ID_SERIAL == m->sub ) return finish( m, CANMAT_OK );
+        m->sub++;
+        m->bit = 31;
+    } else {
+        // silence means every remaining slave has the bit set
+        if( !answered ) m->identity[m->sub] |= (uint32_t)1 << m->bit;
+        m->bit = m->bit ? m->bit - 1 : SCAN_CONFIRM;
+    }
+    canmat_status_t r = scan_query( m, now );
+    return CANMAT_OK == r ? CANMAT_LSS_PENDING : finish( m, r );
+}
+
+enum canmat_lss_event
+canmat_lss_master_frame( struct canmat_lss_master *m, const struct can_frame *can, int64_t now ) {
+    if( CANMAT_LSS_SLAVE_ID != can->can_id || can->can_dlc < 1 ) return CANMAT_LSS_IGNORED;
+    uint8_t cs = can->data[0];
+    switch( m->state ) {
+    case CANMAT_LSS_MASTER_SCAN:
+        // slaves answer separately, so wait out the query's window
+        if( CANMAT_LSS_IDENTIFY_SLAVE != cs ) return CANMAT_LSS_IGNORED;
+        m->answered = 1;
+        return CANMAT_LSS_PENDING;
+    case CANMAT_LSS_MASTER_WAIT:
+        if( m->expect != cs ) return CANMAT_LSS_IGNORED;
+        switch( cs ) {
+        case CANMAT_LSS_CONFIG_NODE_ID:
+        case CANMAT_LSS_CONFIG_BIT_TIMING:
+        case CANMAT_LSS_STORE:
+            m->error = can->data[1];
+            m->spec_error = can->data[2];
+            return finish( m, m->error ? CANMAT_ERR_DEV : CANMAT_OK );
+        case CANMAT_LSS_SWITCH_RESP:
+            return finish( m, CANMAT_OK );
+        default:
+            m->value = canmat_byte_ldle32( can->data+1 );
+            if( CANMAT_LSS_INQUIRE_NODE_ID == cs ) m->value &= 0xFF;
+            return finish( m, CANMAT_OK );
+        }
+    case CANMAT_LSS_MASTER_IDLE:
+        break;
+    }
+    return CANMAT_LSS_IGNORED;
+}
+
+enum canmat_lss_event
+canmat_lss_master_timeout( struct canmat_lss_master *m, int64_t now ) {
+    if( CANMAT_LSS_MASTER_IDLE == m->state || now < m->deadline ) return CANMAT_LSS_PENDING;
+    if( CANMAT_LSS_MASTER_SCAN == m->state ) return scan_next( m, m->answered, now );
+    return finish( m, CANMAT_ERR_TIMEOUT );
+}
+
+static int64_t run_timeout( void *cx, int64_t now ) {
+    struct canmat_lss_master *m = (struct canmat_lss_master*)cx;
+    canmat_lss_master_timeout( m, now );
+    return CANMAT_LSS_MASTER_IDLE == m->state ? CANMAT_STEP_DONE : m->deadline;
+}
+
+static void run_frame( void *cx, const struct can_frame *can, int64_t now ) {
+    canmat_lss_master_frame( (struct canmat_lss_master*)cx, can, now );
+}
+
+canmat_status_t canmat_lss_master_run( struct canmat_lss_master *m, canmat_iface_t *cif ) {
+    canmat_status_t r = canmat_step_run( cif, run_timeout, run_frame, m );
+    return CANMAT_OK == r ? m->status : r;
+}
+
+int canmat_lss_bit_timing_index( unsigned kbps ) {
+    static const unsigned table[] = {1000, 800, 500, 250, 125, 0, 50, 20, 10};
+    for( size_t i = 0; i < sizeof(table)/sizeof(table[0]); i++ ) {
+        if( kbps && table[i] == kbps ) return (int)i;
+    }
+    return -1;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
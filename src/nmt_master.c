@@ -0,0 +1,167 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "socanmatic.h"
+
+static void unlink_node( struct canmat_nmt_node *n ) {
+    if( NULL == n->slot ) return;
+    if( n->prev ) n->prev->next = n->next;
+    else *n->slot = n->next;
+    if( n->next ) n->next->prev = n->prev;
+    n->prev = n->next = NULL;
+    n->slot = NULL;
+}
+
+static void link_node( struct canmat_nmt_master *m, struct canmat_nmt_node *n ) {
+    // first tick at or after the deadline
+    int64_t t = (n->deadline + m->tick_ns - 1) / m->tick_ns;
+    struct canmat_nmt_node **slot = &m->wheel[ t & (CANMAT_NMT_WHEEL_SLOTS - 1) ];
+    n->prev = NULL;
+    n->next = *slot;
+    if( n->next ) n->next->prev = n;
+    *slot = n;
+    n->slot = slot;
+}
+
+void canmat_nmt_master_init( struct canmat_nmt_master *m, int64_t tick_ns, int64_t now,
+                             canmat_nmt_master_fun *fun, void *cx ) {
+    memset( m, 0, sizeof(*m) );
+    for( size_t i = 0; i < sizeof(m->node)/sizeof(m->node[0]); i++ ) {
+        m->node[i].state = CANMAT_NMT_STATE_UNKNOWN;
+    }
+    m->tick_ns = tick_ns > 0 ? tick_ns : CANMAT_NMT_TICK_NS;
+    m->tick = now / m->tick_ns;
+    m->fun = fun;
+    m->cx = cx;
+}
+
+canmat_status_t canmat_nmt_master_consumer( struct canmat_nmt_master *m, uint8_t node, uint16_t time_ms ) {
+    if( 0 == node || node > CANMAT_NODE_MASK ) return CANMAT_ERR_PARAM;
+    struct canmat_nmt_node *n = &m->node[node];
+    n->consumer_ns = (int64_t)time_ms * 1000000;
+    if( 0 == time_ms ) unlink_node( n );
+    return CANMAT_OK;
+}
+
+canmat_status_t canmat_nmt_master_load( struct canmat_nmt_master *m, const canmat_dict_t *dict,
+                                        const struct canmat_sdo_value *value ) {
+    const canmat_obj_t *obj = canmat_dict_search_index( dict, 0x1016, 0 );
+    if( NULL == obj ) return CANMAT_ERR_PARAM;
+    uint8_t count = value[obj - dict->obj].scalar.u8;
+    for( uint8_t i = 1; i <= count; i++ ) {
+        if( NULL == (obj = canmat_dict_search_index( dict, 0x1016, i )) ) return CANMAT_ERR_PARAM;
+        // node in bits 16-23, time in ms in bits 0-15
+        uint32_t u = value[obj - dict->obj].scalar.u32;
+        uint8_t node = (uint8_t)(u >> 16);
+        if( 0 == node || node > CANMAT_NODE_MASK ) continue;
+        canmat_nmt_master_consumer( m, node, (uint16_t)u );
+    }
+    return CANMAT_OK;
+}
+
+static void event( struct canmat_nmt_master *m, uint8_t node, enum canmat_nmt_event e ) {
+    if( m->fun ) m->fun( m->cx, node, e, m->node[node].state );
+}
+
+int canmat_nmt_master_frame( struct canmat_nmt_master *m, const struct can_frame *can, int64_t now ) {
+    if( canmat_frame_func(can) != CANMAT_FUNC_CODE_NMT_ERR ||
+        (can->can_id & (CAN_RTR_FLAG | CAN_EFF_FLAG)) || can->can_dlc < 1 )
+    {
+        return 0;
+    }
+    uint8_t id = canmat_frame_node( can );
+    if( 0 == id ) return 0;
+    struct canmat_nmt_node *n = &m->node[id];
+    // the toggle bit is only used in node guarding responses
+    uint8_t state = can->data[0] & 0x7F;
+    uint8_t old = n->state;
+
+    n->state = state;
+    n->last_seen = now;
+    unlink_node( n );
+    if( n->consumer_ns ) {
+        n->deadline = now + n->consumer_ns;
+        link_node( m, n );
+    }
+    if( n->timed_out ) {
+        n->timed_out = 0;
+        event( m, id, CANMAT_NMT_EVENT_RESUMED );
+    }
+    if( CANMAT_NMT_ERR_BOOT == state ) event( m, id, CANMAT_NMT_EVENT_BOOT );
+    else if( state != old ) event( m, id, CANMAT_NMT_EVENT_STATE );
+    return 1;
+}
+
+void canmat_nmt_master_tick( struct canmat_nmt_master *m, int64_t now ) {
+    int64_t end = now / m->tick_ns;
+    // past one turn, each slot is visited once
+    int64_t start = (end - m->tick > CANMAT_NMT_WHEEL_SLOTS) ? end - CANMAT_NMT_WHEEL_SLOTS : m->tick;
+    for( int64_t t = start + 1; t <= end; t++ ) {
+        struct canmat_nmt_node **slot = &m->wheel[ t & (CANMAT_NMT_WHEEL_SLOTS - 1) ];
+        // detach the slot so callbacks may rearm nodes
+        struct canmat_nmt_node *n = *slot;
+        *slot = NULL;
+        while( n ) {
+            struct canmat_nmt_node *next = n->next;
+            n->prev = n->next = NULL;
+            n->slot = NULL;
+            if( n->deadline <= now ) {
+                n->timed_out = 1;
+                event( m, (uint8_t)(n - m->node), CANMAT_NMT_EVENT_TIMEOUT );
+            } else {
+                // a later turn of the wheel
+                link_node( m, n );
+            }
+            n = next;
+        }
+    }
+    m->tick = end;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -53,7 +53,7 @@
 enum canmat_status canmat_pdo_remap(
     struct canmat_iface *cif, uint8_t node, uint8_t pdo, enum canmat_direction dir,
     int transmission_type, int inhibit_time, int event_timer,
-    uint8_t cnt, const struct canmat_obj *objs[], uint32_t *err )
+    uint8_t cnt, const struct canmat_obj *const objs[], uint32_t *err )
 {
 
     // check parameters
@@ -0,0 +1,287 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "socanmatic.h"
+
+static struct canmat_sdo_value *
+store( struct canmat_pdo_slave *p, uint16_t index, uint8_t subindex ) {
+    const canmat_obj_t *obj = canmat_dict_search_index( p->dict, index, subindex );
+    return obj ? p->value + (obj - p->dict->obj) : NULL;
+}
+
+/* Compile one PDO from its communication and mapping parameters,
+ * leaving its timing and latched state alone */
+static canmat_status_t compile( struct canmat_pdo_slave *p, struct canmat_pdo_slave_pdo *pdo,
+                                uint16_t com, uint16_t map ) {
+    pdo->cob_id = 0;
+    pdo->trans = 0;
+    pdo->length = 0;
+    pdo->n_entry = 0;
+    pdo->valid = 0;
+    pdo->inhibit_ns = 0;
+    pdo->event_ns = 0;
+    memset( pdo->entry, 0, sizeof(pdo->entry) );
+
+    struct canmat_sdo_value *v = store( p, com, 1 );
+    if( NULL == v ) return CANMAT_OK;
+    uint32_t cob = v->scalar.u32;
+    // set bit means not valid
+    if( cob & CANMAT_COBID_PDO_MASK_VALID ) return CANMAT_OK;
+    pdo->cob_id = (cob & CANMAT_COBID_PDO_MASK_FRAME) ?
+        ((cob & CANMAT_COBID_MASK) | CAN_EFF_FLAG) : (cob & CAN_SFF_MASK);
+
+    pdo->trans = (v = store(p, com, 2)) ? v->scalar.u8 : CANMAT_PDO_TRANS_EVENT_DEV;
+    if( (v = store(p, com, 3)) ) pdo->inhibit_ns = (int64_t)v->scalar.u16 * 100000;  // 100us
+    if( (v = store(p, com, 5)) ) pdo->event_ns = (int64_t)v->scalar.u16 * 1000000;   // 1ms
+
+    if( NULL == (v = store(p, map, 0)) ) return CANMAT_ERR_PARAM;
+    uint8_t n = v->scalar.u8;
+    if( n > 8 ) return CANMAT_ERR_PARAM;
+    uint8_t offset = 0;
+    for( uint8_t i = 0; i < n; i++ ) {
+        if( NULL == (v = store(p, map, (uint8_t)(i+1))) ) return CANMAT_ERR_PARAM;
+        uint16_t index = (uint16_t)(v->scalar.u32 >> 16);
+        uint8_t subindex = (uint8_t)(v->scalar.u32 >> 8);
+        uint8_t bits = (uint8_t)v->scalar.u32;
+        struct canmat_pdo_slave_entry *e = &pdo->entry[i];
+        e->offset = offset;
+        e->size = bits / 8;
+        if( 0 == bits || bits % 8 || offset + e->size > 8 ) return CANMAT_ERR_PARAM;
+        if( index >= CANMAT_DATA_TYPE_BOOLEAN && index <= CANMAT_DATA_TYPE_UNSIGNED32 ) {
+            // dummy mapping, skips bytes
+            e->value = NULL;
+        } else {
+            const canmat_obj_t *obj = canmat_dict_search_index( p->dict, index, subindex );
+            if( NULL == obj || !obj->pdo_mapping ||
+                canmat_obj_bitsize(obj) != bits )
+            {
+                return CANMAT_ERR_PARAM;
+            }
+            e->value = p->value + (obj - p->dict->obj);
+        }
+        offset = (uint8_t)(offset + e->size);
+    }
+    pdo->n_entry = n;
+    pdo->length = offset;
+    // an empty mapping is as good as disabled
+    pdo->valid = n > 0;
+    return CANMAT_OK;
+}
+
+/* Recompile PDO i; a disabled PDO forgets what it sent or latched */
+static canmat_status_t reload( struct canmat_pdo_slave *p, int tx, uint16_t i ) {
+    struct canmat_pdo_slave_pdo *pdo = tx ? &p->tpdo[i] : &p->rpdo[i];
+    canmat_status_t r = tx ?
+        compile( p, pdo, (uint16_t)(CANMAT_TPDO_COM_BASE + i), (uint16_t)(CANMAT_TPDO_MAP_BASE + i) ) :
+        compile( p, pdo, (uint16_t)(CANMAT_RPDO_COM_BASE + i), (uint16_t)(CANMAT_RPDO_MAP_BASE + i) );
+    if( CANMAT_OK != r ) pdo->valid = 0;
+    if( !pdo->valid ) {
+        pdo->latched = 0;
+        pdo->sent = 0;
+        pdo->pending = 0;
+        pdo->sync_count = 0;
+    }
+    return r;
+}
+
+static void load_sync( struct canmat_pdo_slave *p ) {
+    struct canmat_sdo_value *v = store( p, 0x1005, 0 );
+    p->sync_id = (v && (v->scalar.u32 & CAN_SFF_MASK)) ?
+        (v->scalar.u32 & CAN_SFF_MASK) : CANMAT_FUNC_CODE_SYNC_EMCY;
+}
+
+canmat_status_t canmat_pdo_slave_load( struct canmat_pdo_slave *p ) {
+    canmat_status_t r = CANMAT_OK;
+    load_sync( p );
+    for( uint16_t i = 0; i < CANMAT_PDO_SLAVE_MAX; i++ ) {
+        canmat_status_t rr;
+        if( CANMAT_OK != (rr = reload( p, 0, i )) ) r = rr;
+        if( CANMAT_OK != (rr = reload( p, 1, i )) ) r = rr;
+    }
+    return r;
+}
+
+canmat_status_t canmat_pdo_slave_init( struct canmat_pdo_slave *p, uint8_t node,
+                                       const canmat_dict_t *dict, struct canmat_sdo_value *value,
+                                       canmat_sdo_client_send_fun *send, void *send_cx ) {
+    memset( p, 0, sizeof(*p) );
+    p->node = node;
+    p->dict = dict;
+    p->value = value;
+    p->send = send;
+    p->send_cx = send_cx;
+    return canmat_pdo_slave_load( p );
+}
+
+void canmat_pdo_slave_written( void *cx, const canmat_obj_t *obj, struct canmat_sdo_value *val ) {
+    (void)val;
+    struct canmat_pdo_slave *p = (struct canmat_pdo_slave*)cx;
+    if( 0x1005 == obj->index ) {
+        load_sync( p );
+    } else if( obj->index >= CANMAT_RPDO_COM_BASE && obj->index < CANMAT_TPDO_MAP_BASE + 0x200 ) {
+        // 1400h RPDO com, 1600h RPDO map, 1800h TPDO com, 1A00h TPDO map
+        uint16_t i = obj->index & 0x1FF;
+        if( i < CANMAT_PDO_SLAVE_MAX ) reload( p, obj->index >= CANMAT_TPDO_COM_BASE, i );
+    }
+}
+
+static void pack( const struct canmat_pdo_slave_pdo *pdo, uint8_t *data ) {
+    memset( data, 0, 8 );
+    for( const struct canmat_pdo_slave_entry *e = pdo->entry; e < pdo->entry + pdo->n_entry; e++ ) {
+        if( NULL == e->value ) continue;
+        switch( e->size ) {
+        case 1: data[e->offset] = e->value->scalar.u8; break;
+        case 2: canmat_byte_stle16( data + e->offset, e->value->scalar.u16 ); break;
+        case 4: canmat_byte_stle32( data + e->offset, e->value->scalar.u32 ); break;
+        }
+    }
+}
+
+static void unpack( const struct canmat_pdo_slave_pdo *pdo, const uint8_t *data ) {
+    for( const struct canmat_pdo_slave_entry *e = pdo->entry; e < pdo->entry + pdo->n_entry; e++ ) {
+        if( NULL == e->value ) continue;
+        switch( e->size ) {
+        case 1: e->value->scalar.u8 = data[e->offset]; break;
+        case 2: e->value->scalar.u16 = canmat_byte_ldle16( data + e->offset ); break;
+        case 4: e->value->scalar.u32 = canmat_byte_ldle32( data + e->offset ); break;
+        }
+    }
+}
+
+/* Send data as the TPDO and restart its timers */
+static canmat_status_t produce( struct canmat_pdo_slave *p, struct canmat_pdo_slave_pdo *pdo,
+                                const uint8_t *data, int64_t now ) {
+    struct can_frame can;
+    memset( &can, 0, sizeof(can) );
+    can.can_id = pdo->cob_id;
+    can.can_dlc = pdo->length;
+    memcpy( can.data, data, 8 );
+    memcpy( pdo->data, data, 8 );
+    pdo->sent = 1;
+    pdo->pending = 0;
+    pdo->sync_count = 0;
+    pdo->next_ok = now + pdo->inhibit_ns;
+    pdo->next_event = now + pdo->event_ns;
+    return p->send( p->send_cx, &can );
+}
+
+static void on_sync( struct canmat_pdo_slave *p, int64_t now ) {
+    for( struct canmat_pdo_slave_pdo *pdo = p->rpdo; pdo < p->rpdo + CANMAT_PDO_SLAVE_MAX; pdo++ ) {
+        if( pdo->latched ) {
+            unpack( pdo, pdo->data );
+            pdo->latched = 0;
+        }
+    }
+    for( struct canmat_pdo_slave_pdo *pdo = p->tpdo; pdo < p->tpdo + CANMAT_PDO_SLAVE_MAX; pdo++ ) {
+        if( !pdo->valid ) continue;
+        uint8_t data[8];
+        if( CANMAT_PDO_TRANS_SYNC0 == pdo->trans ) {
+            // acyclic: on SYNC after a change
+            pack( pdo, data );
+            if( !pdo->sent || memcmp( data, pdo->data, 8 ) ) produce( p, pdo, data, now );
+        } else if( pdo->trans <= CANMAT_PDO_TRANS_SYNC1 ) {
+            if( ++pdo->sync_count >= pdo->trans ) {
+                pack( pdo, data );
+                produce( p, pdo, data, now );
+            }
+        }
+    }
+}
+
+int canmat_pdo_slave_frame( struct canmat_pdo_slave *p, const struct can_frame *can, int64_t now ) {
+    if( can->can_id == p->sync_id ) {
+        on_sync( p, now );
+        return 1;
+    }
+    for( struct canmat_pdo_slave_pdo *pdo = p->rpdo; pdo < p->rpdo + CANMAT_PDO_SLAVE_MAX; pdo++ ) {
+        if( !pdo->valid || pdo->cob_id != can->can_id ) continue;
+        // too short frames are dropped
+        if( can->can_dlc >= pdo->length ) {
+            if( pdo->trans <= CANMAT_PDO_TRANS_SYNC1 ) {
+                memcpy( pdo->data, can->data, 8 );
+                pdo->latched = 1;
+            } else {
+                unpack( pdo, can->data );
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+canmat_status_t canmat_pdo_slave_step( struct canmat_pdo_slave *p, int64_t now ) {
+    canmat_status_t r = CANMAT_OK;
+    for( struct canmat_pdo_slave_pdo *pdo = p->tpdo; pdo < p->tpdo + CANMAT_PDO_SLAVE_MAX; pdo++ ) {
+        if( !pdo->valid || pdo->trans < CANMAT_PDO_TRANS_EVENT_MFR ) continue;
+        uint8_t data[8];
+        pack( pdo, data );
+        if( !pdo->sent || memcmp( data, pdo->data, 8 ) ||
+            (pdo->event_ns && now >= pdo->next_event) )
+        {
+            pdo->pending = 1;
+        }
+        if( pdo->pending && now >= pdo->next_ok ) {
+            canmat_status_t rr = produce( p, pdo, data, now );
+            if( CANMAT_OK != rr ) r = rr;
+        }
+    }
+    return r;
+}
+
+int64_t canmat_pdo_slave_deadline( const struct canmat_pdo_slave *p ) {
+    int64_t t = INT64_MAX;
+    for( const struct canmat_pdo_slave_pdo *pdo = p->tpdo; pdo < p->tpdo + CANMAT_PDO_SLAVE_MAX; pdo++ ) {
+        if( !pdo->valid || pdo->trans < CANMAT_PDO_TRANS_EVENT_MFR ) continue;
+        if( pdo->pending && pdo->next_ok < t ) t = pdo->next_ok;
+        if( pdo->event_ns && pdo->next_event < t ) t = pdo->next_event;
+    }
+    return t;
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -0,0 +1,443 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include "socanmatic.h"
+
+/* Command bytes, CiA 301 section 7.2.4.3 */
+#define CMD_CS(cmd)        ((unsigned)(cmd) >> 5)
+#define BLK_SUB(cmd)       ((unsigned)(cmd) & 0x3)
+
+#define BLK_SUB_INIT   0
+#define BLK_SUB_END    1
+#define BLK_SUB_ACK    2
+#define BLK_SUB_START  3
+
+#define BLK_SEQ_LAST   0x80
+
+void canmat_sdo_client_init( struct canmat_sdo_client *c, uint8_t node,
+                             canmat_sdo_client_send_fun *send, void *send_cx ) {
+    memset( c, 0, sizeof(*c) );
+    c->node = node;
+    c->send = send;
+    c->send_cx = send_cx;
+    c->timeout_ns = CANMAT_SDO_CLIENT_TIMEOUT_NS;
+    c->blksize_ul = CANMAT_SDO_BLKSIZE_MAX;
+}
+
+uint16_t canmat_sdo_crc( uint16_t crc, const uint8_t *data, size_t n ) {
+    // CCITT polynomial x^16 + x^12 + x^5 + 1, MSB first
+    for( size_t i = 0; i < n; i ++ ) {
+        crc = (uint16_t)( crc ^ (data[i] << 8) );
+        for( int j = 0; j < 8; j ++ ) {
+            crc = (uint16_t)( (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1) );
+        }
+    }
+    return crc;
+}
+
+static canmat_status_t send_cmd( struct canmat_sdo_client *c, uint8_t cmd,
+                                 const uint8_t *data, size_t n, int mux ) {
+    struct can_frame can;
+    memset( &can, 0, sizeof(can) );
+    can.can_id = CANMAT_SDO_REQ_ID(c->node);
+    can.can_dlc = 8;
+    can.data[0] = cmd;
+    if( mux ) {
+        canmat_byte_stle16( can.data+1, c->index );
+        can.data[3] = c->subindex;
+        memcpy( can.data+4, data, n );
+    } else {
+        memcpy( can.data+1, data, n );
+    }
+    return c->send( c->send_cx, &can );
+}
+
+static enum canmat_sdo_client_event finish( struct canmat_sdo_client *c, canmat_status_t status ) {
+    c->state = CANMAT_SDO_CLIENT_IDLE;
+    c->status = status;
+    return CANMAT_SDO_CLIENT_DONE;
+}
+
+static enum canmat_sdo_client_event abort_status( struct canmat_sdo_client *c, uint32_t code,
+                                                  canmat_status_t status ) {
+    uint8_t d[4];
+    canmat_byte_stle32( d, code );
+    send_cmd( c, CANMAT_SDO_CMD_ABORT, d, 4, 1 );
+    c->abort = code;
+    return finish( c, status );
+}
+
+/* Result of sending the frame that continues a transfer */
+static enum canmat_sdo_client_event sent( struct canmat_sdo_client *c, canmat_status_t r ) {
+    return CANMAT_OK == r ? CANMAT_SDO_CLIENT_PENDING : finish( c, r );
+}
+
+static void start( struct canmat_sdo_client *c, uint16_t index, uint8_t subindex,
+                   const void *buf, size_t size, int64_t now ) {
+    c->index = index;
+    c->subindex = subindex;
+    c->buf = (uint8_t*)buf;
+    c->size = size;
+    c->pos = 0;
+    c->length = 0;
+    c->toggle = 0;
+    c->crc = 0;
+    c->last = 0;
+    c->seqno = 0;
+    c->status = CANMAT_OK;
+    c->abort = 0;
+    c->deadline = now + c->timeout_ns;
+}
+
+static canmat_status_t started( struct canmat_sdo_client *c, canmat_status_t r,
+                                enum canmat_sdo_client_state state ) {
+    c->state = CANMAT_OK == r ? state : CANMAT_SDO_CLIENT_IDLE;
+    c->status = r;
+    return r;
+}
+
+canmat_status_t canmat_sdo_client_ul( struct canmat_sdo_client *c, uint16_t index, uint8_t subindex,
+                                      void *buf, size_t size, int block, int64_t now ) {
+    if( canmat_sdo_client_busy(c) ) return CANMAT_ERR_PARAM;
+    start( c, index, subindex, buf, size, now );
+    if( block ) {
+        // ask for CRCs, no protocol switch
+        uint8_t d[2] = { c->blksize_ul, 0 };
+        c->blksize = c->blksize_ul;
+        return started( c, send_cmd( c, (uint8_t)((CANMAT_CCS_BLK_UL << 5) | (1 << 2)), d, 2, 1 ),
+                        CANMAT_SDO_CLIENT_UL_BLK_INIT );
+    } else {
+        return started( c, send_cmd( c, CANMAT_CCS_EX_UL << 5, NULL, 0, 1 ),
+                        CANMAT_SDO_CLIENT_UL_INIT );
+    }
+}
+
+canmat_status_t canmat_sdo_client_dl( struct canmat_sdo_client *c, uint16_t index, uint8_t subindex,
+                                      const void *data, size_t size, int block, int64_t now ) {
+    if( canmat_sdo_client_busy(c) || size > UINT32_MAX ) return CANMAT_ERR_PARAM;
+    start( c, index, subindex, data, size, now );
+    uint8_t d[4];
+    if( block ) {
+        canmat_byte_stle32( d, (uint32_t)size );
+        // CRC supported, size indicated
+        return started( c, send_cmd( c, (uint8_t)((CANMAT_CCS_BLK_DL << 5) | (1 << 2) | (1 << 1)),
+                                     d, 4, 1 ),
+                        CANMAT_SDO_CLIENT_DL_BLK_INIT );
+    } else if( size > 0 && size <= 4 ) {
+        // expedited, size indicated
+        memset( d, 0, sizeof(d) );
+        memcpy( d, data, size );
+        c->pos = size;
+        c->last = 1;
+        return started( c, send_cmd( c, (uint8_t)((CANMAT_CCS_EX_DL << 5) | ((4 - size) << 2) | 0x3),
+                                     d, 4, 1 ),
+                        CANMAT_SDO_CLIENT_DL_INIT );
+    } else {
+        canmat_byte_stle32( d, (uint32_t)size );
+        return started( c, send_cmd( c, (uint8_t)((CANMAT_CCS_EX_DL << 5) | 0x1), d, 4, 1 ),
+                        CANMAT_SDO_CLIENT_DL_INIT );
+    }
+}
+
+void canmat_sdo_client_abort( struct canmat_sdo_client *c, uint32_t code ) {
+    if( canmat_sdo_client_busy(c) ) abort_status( c, code, CANMAT_ERR_ABORT );
+}
+
+enum canmat_sdo_client_event
+canmat_sdo_client_timeout( struct canmat_sdo_client *c, int64_t now ) {
+    if( ! canmat_sdo_client_busy(c) ) return CANMAT_SDO_CLIENT_IGNORED;
+    if( now < c->deadline ) return CANMAT_SDO_CLIENT_PENDING;
+    return abort_status( c, CANMAT_ABORT_SDO_TIMEOUT, CANMAT_ERR_TIMEOUT );
+}
+
+/* Send the next segment of a segmented download */
+static enum canmat_sdo_client_event dl_segment( struct canmat_sdo_client *c ) {
+    size_t n = c->size - c->pos;
+    if( n > 7 ) n = 7;
+    int last = (c->pos + n == c->size);
+    uint8_t cmd = (uint8_t)( (CANMAT_CCS_SEG_DL << 5) | (c->toggle << 4) |
+                             ((7 - n) << 1) | (last ? 1 : 0) );
+    canmat_status_t r = send_cmd( c, cmd, c->buf + c->pos, n, 0 );
+    c->pos += n;
+    return sent( c, r );
+}
+
+/* Send segments of a block download, from pos, up to blksize */
+static enum canmat_sdo_client_event dl_block( struct canmat_sdo_client *c ) {
+    c->block_start = c->pos;
+    c->seqno = 0;
+    c->last = 0;
+    while( c->seqno < c->blksize && !c->last ) {
+        size_t n = c->size - c->pos;
+        if( n > 7 ) n = 7;
+        c->last = (c->pos + n == c->size);
+        c->seqno++;
+        canmat_status_t r = send_cmd( c, (uint8_t)(c->seqno | (c->last ? BLK_SEQ_LAST : 0)),
+                                      c->buf + c->pos, n, 0 );
+        if( CANMAT_OK != r ) return finish( c, r );
+        c->pos += n;
+    }
+    return CANMAT_SDO_CLIENT_PENDING;
+}
+
+/* Copy up to n bytes to the upload buffer, false if it would overflow */
+static int ul_copy( struct canmat_sdo_client *c, const uint8_t *data, size_t n ) {
+    if( c->pos + n > c->size ) return 0;
+    memcpy( c->buf + c->pos, data, n );
+    c->pos += n;
+    return 1;
+}
+
+static int mux_ok( const struct canmat_sdo_client *c, const uint8_t *d ) {
+    return canmat_byte_ldle16( d+1 ) == c->index && d[3] == c->subindex;
+}
+
+#define PROTO_ERROR(c) abort_status( (c), CANMAT_ABORT_INVALID_CMD_SPEC, CANMAT_ERR_PROTO )
+#define OVERFLOW(c)    abort_status( (c), CANMAT_ABORT_OOM, CANMAT_ERR_OVERFLOW )
+
+enum canmat_sdo_client_event
+canmat_sdo_client_frame( struct canmat_sdo_client *c, const struct can_frame *can, int64_t now ) {
+    if( ! canmat_sdo_client_busy(c) ||
+        can->can_id != CANMAT_SDO_RESP_ID(c->node) )
+    {
+        return CANMAT_SDO_CLIENT_IGNORED;
+    }
+
+    uint8_t d[8] = {0};
+    memcpy( d, can->data, can->can_dlc < 8 ? can->can_dlc : 8 );
+    uint8_t cmd = d[0];
+
+    // sequence number 0 is never sent, so this is an abort in every state
+    if( CANMAT_SDO_CMD_ABORT == cmd ) {
+        c->abort = canmat_byte_ldle32( d+4 );
+        return finish( c, CANMAT_ERR_ABORT );
+    }
+
+    c->deadline = now + c->timeout_ns;
+
+    switch( c->state ) {
+    case CANMAT_SDO_CLIENT_UL_INIT: {
+        if( CANMAT_SCS_EX_UL != CMD_CS(cmd) || !mux_ok(c, d) ) return PROTO_ERROR(c);
+        struct canmat_sdo_cmd_ex x = canmat_can2sdo_cmd_ex( can );
+        if( x.e ) {
+            if( ! ul_copy( c, d+4, x.s ? 4u - x.n : 4u ) ) return OVERFLOW(c);
+            c->length = c->pos;
+            return finish( c, CANMAT_OK );
+        }
+        if( x.s && canmat_byte_ldle32( d+4 ) > c->size ) return OVERFLOW(c);
+        c->state = CANMAT_SDO_CLIENT_UL_SEG;
+        return sent( c, send_cmd( c, CANMAT_CCS_SEG_UL << 5, NULL, 0, 0 ) );
+    }
+
+    case CANMAT_SDO_CLIENT_UL_SEG: {
+        if( CANMAT_SCS_SEG_UL != CMD_CS(cmd) ) return PROTO_ERROR(c);
+        if( ((cmd >> 4) & 1) != c->toggle ) {
+            return abort_status( c, CANMAT_ABORT_TOGGLE_NOT_ALTERNATED, CANMAT_ERR_PROTO );
+        }
+        if( ! ul_copy( c, d+1, 7u - ((cmd >> 1) & 0x7) ) ) return OVERFLOW(c);
+        if( cmd & 1 ) {
+            c->length = c->pos;
+            return finish( c, CANMAT_OK );
+        }
+        c->toggle ^= 1;
+        return sent( c, send_cmd( c, (uint8_t)((CANMAT_CCS_SEG_UL << 5) | (c->toggle << 4)),
+                                  NULL, 0, 0 ) );
+    }
+
+    case CANMAT_SDO_CLIENT_DL_INIT:
+        if( CANMAT_SCS_EX_DL != CMD_CS(cmd) || !mux_ok(c, d) ) return PROTO_ERROR(c);
+        if( c->last ) {
+            // expedited
+            c->length = c->pos;
+            return finish( c, CANMAT_OK );
+        }
+        c->state = CANMAT_SDO_CLIENT_DL_SEG;
+        return dl_segment( c );
+
+    case CANMAT_SDO_CLIENT_DL_SEG:
+        if( CANMAT_SCS_SEG_DL != CMD_CS(cmd) ) return PROTO_ERROR(c);
+        if( ((cmd >> 4) & 1) != c->toggle ) {
+            return abort_status( c, CANMAT_ABORT_TOGGLE_NOT_ALTERNATED, CANMAT_ERR_PROTO );
+        }
+        if( c->pos == c->size ) {
+            c->length = c->pos;
+            return finish( c, CANMAT_OK );
+        }
+        c->toggle ^= 1;
+        return dl_segment( c );
+
+    case CANMAT_SDO_CLIENT_UL_BLK_INIT:
+        if( CANMAT_SCS_BLK_UL != CMD_CS(cmd) || BLK_SUB_INIT != (cmd & 1) || !mux_ok(c, d) ) {
+            return PROTO_ERROR(c);
+        }
+        if( (cmd & 0x2) && canmat_byte_ldle32( d+4 ) > c->size ) return OVERFLOW(c);
+        c->crc = (cmd >> 2) & 1u;
+        c->state = CANMAT_SDO_CLIENT_UL_BLK;
+        return sent( c, send_cmd( c, (CANMAT_CCS_BLK_UL << 5) | BLK_SUB_START, NULL, 0, 0 ) );
+
+    case CANMAT_SDO_CLIENT_UL_BLK: {
+        uint8_t seq = cmd & 0x7F;
+        if( seq == c->seqno + 1 ) {
+            // the last segment is padded, trimmed at the end
+            if( c->pos > c->size ) return OVERFLOW(c);
+            size_t n = c->size - c->pos < 7 ? c->size - c->pos : 7;
+            memcpy( c->buf + c->pos, d+1, n );
+            c->pos += 7;
+            c->seqno = seq;
+            c->last = (unsigned)((cmd & BLK_SEQ_LAST) != 0);
+        }
+        // the server waits after the last or blksize'th segment
+        if( (cmd & BLK_SEQ_LAST) || seq >= c->blksize ) {
+            uint8_t a[2] = { c->seqno, c->blksize };
+            if( c->last ) c->state = CANMAT_SDO_CLIENT_UL_BLK_END;
+            c->seqno = 0;
+            return sent( c, send_cmd( c, (CANMAT_CCS_BLK_UL << 5) | BLK_SUB_ACK, a, 2, 0 ) );
+        }
+        return CANMAT_SDO_CLIENT_PENDING;
+    }
+
+    case CANMAT_SDO_CLIENT_UL_BLK_END: {
+        if( CANMAT_SCS_BLK_UL != CMD_CS(cmd) || BLK_SUB_END != BLK_SUB(cmd) ) return PROTO_ERROR(c);
+        size_t pad = (cmd >> 2) & 0x7;
+        if( pad > c->pos ) return PROTO_ERROR(c);
+        c->pos -= pad;
+        if( c->pos > c->size ) return OVERFLOW(c);
+        if( c->crc && canmat_byte_ldle16( d+1 ) != canmat_sdo_crc( 0, c->buf, c->pos ) ) {
+            return abort_status( c, CANMAT_ABORT_CRC, CANMAT_ERR_PROTO );
+        }
+        c->length = c->pos;
+        canmat_status_t r = send_cmd( c, (CANMAT_CCS_BLK_UL << 5) | BLK_SUB_END, NULL, 0, 0 );
+        return finish( c, r );
+    }
+
+    case CANMAT_SDO_CLIENT_DL_BLK_INIT:
+        if( CANMAT_SCS_BLK_DL != CMD_CS(cmd) || BLK_SUB_INIT != BLK_SUB(cmd) || !mux_ok(c, d) ) {
+            return PROTO_ERROR(c);
+        }
+        if( d[4] < 1 || d[4] > CANMAT_SDO_BLKSIZE_MAX ) {
+            return abort_status( c, CANMAT_ABORT_INVALID_BLOCK_SIZE, CANMAT_ERR_PROTO );
+        }
+        c->crc = (cmd >> 2) & 1u;
+        c->blksize = d[4];
+        c->state = CANMAT_SDO_CLIENT_DL_BLK_ACK;
+        return dl_block( c );
+
+    case CANMAT_SDO_CLIENT_DL_BLK_ACK: {
+        if( CANMAT_SCS_BLK_DL != CMD_CS(cmd) || BLK_SUB_ACK != BLK_SUB(cmd) ) return PROTO_ERROR(c);
+        uint8_t ackseq = d[1];
+        if( ackseq > c->seqno ) {
+            return abort_status( c, CANMAT_ABORT_INVALID_SEQ_NO, CANMAT_ERR_PROTO );
+        }
+        if( d[2] < 1 || d[2] > CANMAT_SDO_BLKSIZE_MAX ) {
+            return abort_status( c, CANMAT_ABORT_INVALID_BLOCK_SIZE, CANMAT_ERR_PROTO );
+        }
+        c->blksize = d[2];
+        if( c->last && ackseq == c->seqno ) {
+            // all acknowledged, give the unused bytes of the last segment
+            size_t tail = c->size % 7;
+            size_t pad = (0 == c->size) ? 7 : (tail ? 7 - tail : 0);
+            uint8_t e[2] = {0,0};
+            if( c->crc ) canmat_byte_stle16( e, canmat_sdo_crc( 0, c->buf, c->size ) );
+            c->state = CANMAT_SDO_CLIENT_DL_BLK_END;
+            return sent( c, send_cmd( c, (uint8_t)((CANMAT_CCS_BLK_DL << 5) | (pad << 2) | BLK_SUB_END),
+                                      e, 2, 0 ) );
+        }
+        // resend from the first segment not acknowledged
+        c->pos = c->block_start + 7u * ackseq;
+        return dl_block( c );
+    }
+
+    case CANMAT_SDO_CLIENT_DL_BLK_END:
+        if( CANMAT_SCS_BLK_DL != CMD_CS(cmd) || BLK_SUB_END != BLK_SUB(cmd) ) return PROTO_ERROR(c);
+        c->length = c->size;
+        return finish( c, CANMAT_OK );
+
+    case CANMAT_SDO_CLIENT_IDLE:
+        break;
+    }
+    return CANMAT_SDO_CLIENT_IGNORED;
+}
+
+
+int64_t canmat_now_ns( void ) {
+    struct timespec t;
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+canmat_status_t canmat_step_run( canmat_iface_t *cif, canmat_step_timeout_fun *timeout,
+                                 canmat_step_frame_fun *frame, void *cx ) {
+    for(;;) {
+        int64_t now = canmat_now_ns();
+        int64_t deadline = timeout( cx, now );
+        if( CANMAT_STEP_DONE == deadline ) return CANMAT_OK;
+
+        int64_t wait = deadline - now;
+        int ms = wait <= 0 ? 0 : wait >= (int64_t)INT_MAX * 1000000 ? -1 :
+            (int)((wait + 999999) / 1000000);
+        struct pollfd pfd = { .fd = cif->fd, .events = POLLIN };
+        int r = ms ? poll( &pfd, 1, ms ) : 0;
+        if( r < 0 ) {
+            if( EINTR == errno ) continue;
+            cif->err = errno;
+            return CANMAT_ERR_OS;
+        }
+        if( r > 0 ) {
+            struct can_frame can;
+            canmat_status_t cr = canmat_iface_recv( cif, &can );
+            if( CANMAT_OK != cr ) return cr;
+            frame( cx, &can, canmat_now_ns() );
+        }
+    }
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
@@ -0,0 +1,402 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "socanmatic.h"
+
+#define BLK_SUB_INIT   0
+#define BLK_SUB_END    1
+#define BLK_SUB_ACK    2
+#define BLK_SUB_START  3
+
+#define BLK_SEQ_LAST   0x80
+
+void canmat_sdo_server_init( struct canmat_sdo_server *s, uint8_t node,
+                             const canmat_dict_t *dict, struct canmat_sdo_value *value,
+                             canmat_sdo_client_send_fun *send, void *send_cx ) {
+    memset( s, 0, sizeof(*s) );
+    s->node = node;
+    s->dict = dict;
+    s->value = value;
+    s->send = send;
+    s->send_cx = send_cx;
+    s->blksize = CANMAT_SDO_BLKSIZE_MAX;
+}
+
+/* Bytes of a numeric value, 0 for objects stored in a buffer */
+static size_t scalar_size( enum canmat_data_type type ) {
+    switch( type ) {
+    case CANMAT_DATA_TYPE_BOOLEAN:
+    case CANMAT_DATA_TYPE_INTEGER8:
+    case CANMAT_DATA_TYPE_UNSIGNED8:
+        return 1;
+    case CANMAT_DATA_TYPE_INTEGER16:
+    case CANMAT_DATA_TYPE_UNSIGNED16:
+        return 2;
+    case CANMAT_DATA_TYPE_INTEGER32:
+    case CANMAT_DATA_TYPE_UNSIGNED32:
+    case CANMAT_DATA_TYPE_REAL32:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static int send_resp( struct canmat_sdo_server *s, uint8_t cmd,
+                      const uint8_t *data, size_t n, int mux ) {
+    struct can_frame can;
+    memset( &can, 0, sizeof(can) );
+    can.can_id = CANMAT_SDO_RESP_ID(s->node);
+    can.can_dlc = 8;
+    can.data[0] = cmd;
+    if( mux ) {
+        canmat_byte_stle16( can.data+1, s->index );
+        can.data[3] = s->subindex;
+        if( n ) memcpy( can.data+4, data, n );
+    } else {
+        if( n ) memcpy( can.data+1, data, n );
+    }
+    s->send( s->send_cx, &can );
+    return 1;
+}
+
+static int abort_code( struct canmat_sdo_server *s, uint32_t code ) {
+    uint8_t d[4];
+    canmat_byte_stle32( d, code );
+    s->state = CANMAT_SDO_SERVER_IDLE;
+    return send_resp( s, CANMAT_SDO_CMD_ABORT, d, 4, 1 );
+}
+
+/* Find the object of the request, or the abort code */
+static uint32_t lookup( struct canmat_sdo_server *s, const uint8_t *d ) {
+    s->index = canmat_byte_ldle16( d+1 );
+    s->subindex = d[3];
+    s->obj = canmat_dict_search_index( s->dict, s->index, s->subindex );
+    if( NULL == s->obj ) {
+        return canmat_dict_search_index( s->dict, s->index, 0 ) ?
+            CANMAT_ABORT_SUBINDEX_EXIST : CANMAT_ABORT_OBJ_EXIST;
+    }
+    return 0;
+}
+
+/* Point the transfer at the value to upload */
+static uint32_t begin_ul( struct canmat_sdo_server *s ) {
+    if( CANMAT_ACCESS_WO == s->obj->access_type ) return CANMAT_ABORT_WRITE_ONLY;
+    struct canmat_sdo_value *v = canmat_sdo_server_value( s, s->obj );
+    size_t n = scalar_size( s->obj->data_type );
+    if( n ) {
+        uint32_t u = (4 == n) ? v->scalar.u32 : (2 == n) ? v->scalar.u16 : v->scalar.u8;
+        canmat_byte_stle32( s->scratch, u );
+        s->buf = s->scratch;
+        s->size = n;
+    } else {
+        s->buf = v->data;
+        s->size = v->data ? v->size : 0;
+    }
+    s->pos = 0;
+    return 0;
+}
+
+/* Point the transfer at room for a download of size bytes, if known */
+static uint32_t begin_dl( struct canmat_sdo_server *s, size_t size, int known ) {
+    if( CANMAT_ACCESS_RO == s->obj->access_type ||
+        CANMAT_ACCESS_CONST == s->obj->access_type )
+    {
+        return CANMAT_ABORT_READ_ONLY;
+    }
+    struct canmat_sdo_value *v = canmat_sdo_server_value( s, s->obj );
+    size_t n = scalar_size( s->obj->data_type );
+    if( n ) {
+        if( known && size > n ) return CANMAT_ABORT_DATA_TOO_HI;
+        if( known && size < n ) return CANMAT_ABORT_DATA_TOO_LO;
+        s->buf = s->scratch;
+        s->size = n;
+    } else {
+        if( NULL == v->data || 0 == v->capacity ) return CANMAT_ABORT_READ_ONLY;
+        // staged downloads leave the value alone until they complete
+        s->buf = s->stage ? s->stage : v->data;
+        s->size = s->stage && s->stage_capacity < v->capacity ? s->stage_capacity : v->capacity;
+        if( known && size > s->size ) return CANMAT_ABORT_DATA_TOO_HI;
+    }
+    s->pos = 0;
+    return 0;
+}
+
+/* Store n downloaded bytes as the object's value */
+static uint32_t commit( struct canmat_sdo_server *s, size_t n ) {
+    struct canmat_sdo_value *v = canmat_sdo_server_value( s, s->obj );
+    size_t ss = scalar_size( s->obj->data_type );
+    if( ss ) {
+        if( n < ss ) return CANMAT_ABORT_DATA_TOO_LO;
+        if( 1 == ss )      v->scalar.u8 = s->scratch[0];
+        else if( 2 == ss ) v->scalar.u16 = canmat_byte_ldle16( s->scratch );
+        else               v->scalar.u32 = canmat_byte_ldle32( s->scratch );
+    } else {
+        if( s->buf != v->data ) memcpy( v->data, s->buf, n );
+        v->size = n;
+    }
+    if( s->written ) s->written( s->written_cx, s->obj, v );
+    return 0;
+}
+
+#define TRY( s, expr ) do { uint32_t tryc_ = (expr); if( tryc_ ) return abort_code( (s), tryc_ ); } while(0)
+
+static int initiate_dl( struct canmat_sdo_server *s, uint8_t cmd, const uint8_t *d ) {
+    struct canmat_sdo_cmd_ex x = { .s = cmd & 1u, .e = (cmd >> 1) & 1u, .n = (cmd >> 2) & 3u };
+    TRY( s, lookup( s, d ) );
+    if( x.e ) {
+        size_t n = x.s ? 4u - x.n : 4u;
+        size_t ss = scalar_size( s->obj->data_type );
+        // size not indicated, take what the type needs
+        if( !x.s && ss ) n = ss;
+        TRY( s, begin_dl( s, n, 1 ) );
+        memcpy( s->buf, d+4, n );
+        TRY( s, commit( s, n ) );
+        s->state = CANMAT_SDO_SERVER_IDLE;
+    } else {
+        TRY( s, begin_dl( s, canmat_byte_ldle32( d+4 ), x.s ) );
+        s->toggle = 0;
+        s->state = CANMAT_SDO_SERVER_DL_SEG;
+    }
+    return send_resp( s, CANMAT_SCS_EX_DL << 5, NULL, 0, 1 );
+}
+
+static int dl_segment( struct canmat_sdo_server *s, uint8_t cmd, const uint8_t *d ) {
+    if( ((cmd >> 4) & 1) != s->toggle ) return abort_code( s, CANMAT_ABORT_TOGGLE_NOT_ALTERNATED );
+    size_t n = 7u - ((cmd >> 1) & 7);
+    if( s->pos + n > s->size ) return abort_code( s, CANMAT_ABORT_DATA_TOO_HI );
+    memcpy( s->buf + s->pos, d+1, n );
+    s->pos += n;
+    if( cmd & 1 ) {
+        TRY( s, commit( s, s->pos ) );
+        s->state = CANMAT_SDO_SERVER_IDLE;
+    }
+    uint8_t t = (uint8_t)(s->toggle << 4);
+    s->toggle ^= 1;
+    return send_resp( s, (uint8_t)((CANMAT_SCS_SEG_DL << 5) | t), NULL, 0, 0 );
+}
+
+static int initiate_ul( struct canmat_sdo_server *s, const uint8_t *d ) {
+    TRY( s, lookup( s, d ) );
+    TRY( s, begin_ul( s ) );
+    if( s->size >= 1 && s->size <= 4 ) {
+        s->state = CANMAT_SDO_SERVER_IDLE;
+        return send_resp( s, (uint8_t)((CANMAT_SCS_EX_UL << 5) | ((4 - s->size) << 2) | 0x3),
+                          s->buf, s->size, 1 );
+    }
+    uint8_t sz[4];
+    canmat_byte_stle32( sz, (uint32_t)s->size );
+    s->toggle = 0;
+    s->state = CANMAT_SDO_SERVER_UL_SEG;
+    return send_resp( s, (CANMAT_SCS_EX_UL << 5) | 0x1, sz, 4, 1 );
+}
+
+static int ul_segment( struct canmat_sdo_server *s, uint8_t cmd ) {
+    if( ((cmd >> 4) & 1) != s->toggle ) return abort_code( s, CANMAT_ABORT_TOGGLE_NOT_ALTERNATED );
+    size_t n = s->size - s->pos;
+    if( n > 7 ) n = 7;
+    int last = (s->pos + n == s->size);
+    uint8_t r = (uint8_t)( (CANMAT_SCS_SEG_UL << 5) | (s->toggle << 4) |
+                           ((7 - n) << 1) | (last ? 1 : 0) );
+    const uint8_t *p = s->buf + s->pos;
+    s->pos += n;
+    s->toggle ^= 1;
+    if( last ) s->state = CANMAT_SDO_SERVER_IDLE;
+    return send_resp( s, r, p, n, 0 );
+}
+
+static int initiate_blk_dl( struct canmat_sdo_server *s, uint8_t cmd, const uint8_t *d ) {
+    TRY( s, lookup( s, d ) );
+    TRY( s, begin_dl( s, canmat_byte_ldle32( d+4 ), (cmd >> 1) & 1 ) );
+    s->crc = (cmd >> 2) & 1u;
+    s->seqno = 0;
+    s->last = 0;
+    s->state = CANMAT_SDO_SERVER_DL_BLK;
+    // we generate CRCs
+    uint8_t b[1] = { s->blksize };
+    return send_resp( s, (CANMAT_SCS_BLK_DL << 5) | (1 << 2), b, 1, 1 );
+}
+
+static int dl_blk_segment( struct canmat_sdo_server *s, uint8_t cmd, const uint8_t *d ) {
+    uint8_t seq = cmd & 0x7F;
+    if( seq == s->seqno + 1 ) {
+        // the last segment is padded, trimmed at the end
+        if( s->pos > s->size ) return abort_code( s, CANMAT_ABORT_DATA_TOO_HI );
+        size_t n = s->size - s->pos < 7 ? s->size - s->pos : 7;
+        memcpy( s->buf + s->pos, d+1, n );
+        s->pos += 7;
+        s->seqno = seq;
+        s->last = (unsigned)((cmd & BLK_SEQ_LAST) != 0);
+    }
+    // the client waits after the last or blksize'th segment
+    if( (cmd & BLK_SEQ_LAST) || seq >= s->blksize ) {
+        uint8_t a[2] = { s->seqno, s->blksize };
+        if( s->last ) s->state = CANMAT_SDO_SERVER_DL_BLK_END;
+        s->seqno = 0;
+        return send_resp( s, (CANMAT_SCS_BLK_DL << 5) | BLK_SUB_ACK, a, 2, 0 );
+    }
+    return 1;
+}
+
+static int end_blk_dl( struct canmat_sdo_server *s, uint8_t cmd, const uint8_t *d ) {
+    size_t pad = (cmd >> 2) & 7;
+    if( pad > s->pos ) return abort_code( s, CANMAT_ABORT_INVALID_CMD_SPEC );
+    s->pos -= pad;
+    if( s->pos > s->size ) return abort_code( s, CANMAT_ABORT_DATA_TOO_HI );
+    if( s->crc && canmat_byte_ldle16( d+1 ) != canmat_sdo_crc( 0, s->buf, s->pos ) ) {
+        return abort_code( s, CANMAT_ABORT_CRC );
+    }
+    TRY( s, commit( s, s->pos ) );
+    s->state = CANMAT_SDO_SERVER_IDLE;
+    return send_resp( s, (CANMAT_SCS_BLK_DL << 5) | BLK_SUB_END, NULL, 0, 0 );
+}
+
+/* Send segments of a block upload, from pos, up to blksize_ul */
+static int ul_block( struct canmat_sdo_server *s ) {
+    s->block_start = s->pos;
+    s->seqno = 0;
+    s->last = 0;
+    while( s->seqno < s->blksize_ul && !s->last ) {
+        size_t n = s->size - s->pos;
+        if( n > 7 ) n = 7;
+        s->last = (s->pos + n == s->size);
+        s->seqno++;
+        send_resp( s, (uint8_t)(s->seqno | (s->last ? BLK_SEQ_LAST : 0)), s->buf + s->pos, n, 0 );
+        s->pos += n;
+    }
+    s->state = CANMAT_SDO_SERVER_UL_BLK_ACK;
+    return 1;
+}
+
+static int initiate_blk_ul( struct canmat_sdo_server *s, uint8_t cmd, const uint8_t *d ) {
+    TRY( s, lookup( s, d ) );
+    if( d[4] < 1 || d[4] > CANMAT_SDO_BLKSIZE_MAX ) {
+        return abort_code( s, CANMAT_ABORT_INVALID_BLOCK_SIZE );
+    }
+    TRY( s, begin_ul( s ) );
+    s->blksize_ul = d[4];
+    s->crc = (cmd >> 2) & 1u;
+    s->state = CANMAT_SDO_SERVER_UL_BLK_START;
+    // we generate CRCs, size indicated
+    uint8_t sz[4];
+    canmat_byte_stle32( sz, (uint32_t)s->size );
+    return send_resp( s, (CANMAT_SCS_BLK_UL << 5) | (1 << 2) | (1 << 1), sz, 4, 1 );
+}
+
+static int ack_blk_ul( struct canmat_sdo_server *s, const uint8_t *d ) {
+    uint8_t ackseq = d[1];
+    if( ackseq > s->seqno ) return abort_code( s, CANMAT_ABORT_INVALID_SEQ_NO );
+    if( d[2] < 1 || d[2] > CANMAT_SDO_BLKSIZE_MAX ) {
+        return abort_code( s, CANMAT_ABORT_INVALID_BLOCK_SIZE );
+    }
+    s->blksize_ul = d[2];
+    if( s->last && ackseq == s->seqno ) {
+        // all acknowledged, give the unused bytes of the last segment
+        size_t tail = s->size % 7;
+        size_t pad = (0 == s->size) ? 7 : (tail ? 7 - tail : 0);
+        uint8_t e[2] = {0,0};
+        if( s->crc ) canmat_byte_stle16( e, canmat_sdo_crc( 0, s->buf, s->size ) );
+        s->state = CANMAT_SDO_SERVER_UL_BLK_END;
+        return send_resp( s, (uint8_t)((CANMAT_SCS_BLK_UL << 5) | (pad << 2) | BLK_SUB_END), e, 2, 0 );
+    }
+    // resend from the first segment not acknowledged
+    s->pos = s->block_start + 7u * ackseq;
+    return ul_block( s );
+}
+
+int canmat_sdo_server_frame( struct canmat_sdo_server *s, const struct can_frame *can ) {
+    if( can->can_id != CANMAT_SDO_REQ_ID(s->node) ) return 0;
+
+    uint8_t d[8] = {0};
+    memcpy( d, can->data, can->can_dlc < 8 ? can->can_dlc : 8 );
+    uint8_t cmd = d[0];
+
+    if( CANMAT_SDO_CMD_ABORT == cmd ) {
+        s->state = CANMAT_SDO_SERVER_IDLE;
+        return 1;
+    }
+    if( CANMAT_SDO_SERVER_DL_BLK == s->state ) return dl_blk_segment( s, cmd, d );
+
+    switch( cmd >> 5 ) {
+    case CANMAT_CCS_EX_DL:
+        return initiate_dl( s, cmd, d );
+    case CANMAT_CCS_EX_UL:
+        return initiate_ul( s, d );
+    case CANMAT_CCS_SEG_DL:
+        if( CANMAT_SDO_SERVER_DL_SEG == s->state ) return dl_segment( s, cmd, d );
+        break;
+    case CANMAT_CCS_SEG_UL:
+        if( CANMAT_SDO_SERVER_UL_SEG == s->state ) return ul_segment( s, cmd );
+        break;
+    case CANMAT_CCS_BLK_DL:
+        if( 0 == (cmd & 1) ) return initiate_blk_dl( s, cmd, d );
+        if( CANMAT_SDO_SERVER_DL_BLK_END == s->state ) return end_blk_dl( s, cmd, d );
+        break;
+    case CANMAT_CCS_BLK_UL:
+        switch( cmd & 3 ) {
+        case BLK_SUB_INIT:
+            return initiate_blk_ul( s, cmd, d );
+        case BLK_SUB_START:
+            if( CANMAT_SDO_SERVER_UL_BLK_START == s->state ) return ul_block( s );
+            break;
+        case BLK_SUB_ACK:
+            if( CANMAT_SDO_SERVER_UL_BLK_ACK == s->state ) return ack_blk_ul( s, d );
+            break;
+        case BLK_SUB_END:
+            if( CANMAT_SDO_SERVER_UL_BLK_END == s->state ) {
+                s->state = CANMAT_SDO_SERVER_IDLE;
+                return 1;
+            }
+            break;
+        }
+        break;
+    }
+    return abort_code( s, CANMAT_ABORT_INVALID_CMD_SPEC );
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
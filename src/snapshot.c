@@ -0,0 +1,453 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "socanmatic.h"
+
+void canmat_snapshot_init( struct canmat_snapshot *s, uint8_t node ) {
+    memset( s, 0, sizeof(*s) );
+    s->node = node;
+}
+
+void canmat_snapshot_destroy( struct canmat_snapshot *s ) {
+    free( s->entry );
+    free( s->data );
+    canmat_snapshot_init( s, s->node );
+}
+
+canmat_status_t canmat_snapshot_add( struct canmat_snapshot *s, uint16_t index, uint8_t subindex,
+                                     const void *data, size_t length ) {
+    if( length > UINT16_MAX ) return CANMAT_ERR_PARAM;
+    if( s->n == s->n_max ) {
+        size_t n_max = s->n_max ? 2*s->n_max : 64;
+        struct canmat_snapshot_entry *e =
+            (struct canmat_snapshot_entry*)realloc( s->entry, n_max * sizeof(e[0]) );
+        if( NULL == e ) return CANMAT_ERR_OS;
+        s->entry = e;
+        s->n_max = n_max;
+    }
+    if( s->size + length > s->capacity ) {
+        size_t capacity = s->capacity ? 2*s->capacity : 1024;
+        while( capacity < s->size + length ) capacity *= 2;
+        uint8_t *d = (uint8_t*)realloc( s->data, capacity );
+        if( NULL == d ) return CANMAT_ERR_OS;
+        s->data = d;
+        s->capacity = capacity;
+    }
+    struct canmat_snapshot_entry *e = &s->entry[s->n++];
+    e->index = index;
+    e->subindex = subindex;
+    e->length = (uint16_t)length;
+    e->offset = s->size;
+    if( data && length ) memcpy( s->data + s->size, data, length );
+    s->size += length;
+    return CANMAT_OK;
+}
+
+canmat_status_t canmat_snapshot_write( FILE *f, const struct canmat_snapshot *s ) {
+    uint8_t hdr[14];
+    memcpy( hdr, CANMAT_SNAPSHOT_MAGIC, 8 );
+    hdr[8] = CANMAT_SNAPSHOT_VERSION;
+    hdr[9] = s->node;
+    canmat_byte_stle32( hdr+10, (uint32_t)s->n );
+    if( 1 != fwrite( hdr, sizeof(hdr), 1, f ) ) return CANMAT_ERR_OS;
+    for( size_t i = 0; i < s->n; i++ ) {
+        const struct canmat_snapshot_entry *e = &s->entry[i];
+        uint8_t d[5];
+        canmat_byte_stle16( d, e->index );
+        d[2] = e->subindex;
+        canmat_byte_stle16( d+3, e->length );
+        if( 1 != fwrite( d, sizeof(d), 1, f ) ||
+            e->length != fwrite( canmat_snapshot_data(s, e), 1, e->length, f ) )
+        {
+            return CANMAT_ERR_OS;
+        }
+    }
+    return CANMAT_OK;
+}
+
+/* Status of a short read */
+static canmat_status_t short_read( FILE *f ) {
+    return ferror( f ) ? CANMAT_ERR_OS : CANMAT_ERR_PROTO;
+}
+
+canmat_status_t canmat_snapshot_read( FILE *f, struct canmat_snapshot *s ) {
+    uint8_t hdr[14];
+    size_t k = fread( hdr, 1, sizeof(hdr), f );
+    if( 0 == k && feof(f) ) return CANMAT_ERR_UNDERFLOW;
+    if( sizeof(hdr) != k ) return short_read( f );
+    if( memcmp( hdr, CANMAT_SNAPSHOT_MAGIC, 8 ) || CANMAT_SNAPSHOT_VERSION != hdr[8] ) {
+        return CANMAT_ERR_PROTO;
+    }
+    s->node = hdr[9];
+    uint32_t n = canmat_byte_ldle32( hdr+10 );
+
+    for( uint32_t i = 0; i < n; i++ ) {
+        uint8_t d[5];
+        if( 1 != fread( d, sizeof(d), 1, f ) ) return short_read( f );
+        uint16_t length = canmat_byte_ldle16( d+3 );
+        canmat_status_t r = canmat_snapshot_add( s, canmat_byte_ldle16( d ), d[2], NULL, length );
+        if( CANMAT_OK != r ) return r;
+        uint8_t *data = s->data + s->entry[s->n-1].offset;
+        if( length != fread( data, 1, length, f ) ) return short_read( f );
+    }
+    return CANMAT_OK;
+}
+
+static int readable( const canmat_obj_t *o ) {
+    return CANMAT_OBJECT_TYPE_VAR == o->object_type &&
+        CANMAT_DATA_TYPE_DOMAIN != o->data_type &&
+        CANMAT_ACCESS_UNKNOWN != o->access_type &&
+        CANMAT_ACCESS_WO != o->access_type;
+}
+
+static int writable( const canmat_obj_t *o ) {
+    switch( o->access_type ) {
+    case CANMAT_ACCESS_WO:
+    case CANMAT_ACCESS_RW:
+    case CANMAT_ACCESS_RWR:
+    case CANMAT_ACCESS_RWW:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int pdo_mapping( uint16_t index ) {
+    return (index >= 0x1600 && index <= 0x17FF) || (index >= 0x1A00 && index <= 0x1BFF);
+}
+
+/* Communication index of the PDO that index configures, 0 if none */
+static uint16_t pdo_comm( uint16_t index ) {
+    if( pdo_mapping( index ) ) return (uint16_t)(index - 0x200);
+    if( (index >= 0x1400 && index <= 0x15FF) || (index >= 0x1800 && index <= 0x19FF) ) return index;
+    return 0;
+}
+
+void canmat_snapshot_job_init( struct canmat_snapshot_job *j, uint8_t node,
+                               canmat_sdo_client_send_fun *send, void *send_cx ) {
+    memset( j, 0, sizeof(*j) );
+    canmat_sdo_client_init( &j->client, node, send, send_cx );
+}
+
+static void finish( struct canmat_snapshot_job *j, canmat_status_t status ) {
+    j->state = CANMAT_SNAPSHOT_JOB_IDLE;
+    j->status = status;
+}
+
+/* Enter state if a transfer started, otherwise end the job */
+static void started( struct canmat_snapshot_job *j, canmat_status_t r,
+                     enum canmat_snapshot_job_state state ) {
+    if( CANMAT_OK == r ) j->state = state;
+    else finish( j, r );
+}
+
+/* Read the next readable object from j->next */
+static void read_next( struct canmat_snapshot_job *j, int64_t now ) {
+    for( ; j->next < j->dict->length; j->next++ ) {
+        const canmat_obj_t *o = &j->dict->obj[j->next];
+        if( readable(o) ) {
+            started( j, canmat_sdo_client_ul( &j->client, o->index, o->subindex,
+                                              j->buf, sizeof(j->buf), 0, now ),
+                     CANMAT_SNAPSHOT_JOB_READ );
+            return;
+        }
+    }
+    finish( j, CANMAT_OK );
+}
+
+/* Leave the PDO mapping being restored, writing back its number of
+ * entries if it was cleared.  Return 1 if that write started. */
+static int map_end( struct canmat_snapshot_job *j, int64_t now ) {
+    const struct canmat_snapshot_entry *m = j->map;
+    int remap = j->remap;
+    j->map = NULL;
+    j->remap = 0;
+    if( !remap ) return 0;
+    started( j, canmat_sdo_client_dl( &j->client, m->index, 0, canmat_snapshot_data( j->snap, m ),
+                                      m->length, 0, now ),
+             CANMAT_SNAPSHOT_JOB_MAP );
+    return 1;
+}
+
+/* Leave the PDO made invalid for changes, writing back its COB-ID if
+ * it was valid.  Return 1 if that write started. */
+static int guard_end( struct canmat_snapshot_job *j, int64_t now ) {
+    uint16_t comm = j->guard;
+    int revalidate = j->revalidate;
+    j->guard = 0;
+    j->revalidate = 0;
+    if( !revalidate ) return 0;
+    canmat_byte_stle32( j->cob_data, j->cob );
+    started( j, canmat_sdo_client_dl( &j->client, comm, 1, j->cob_data, 4, 0, now ),
+             CANMAT_SNAPSHOT_JOB_VALIDATE );
+    return 1;
+}
+
+/* Compare the next writable entry from j->next */
+static void restore_next( struct canmat_snapshot_job *j, int64_t now ) {
+    for( ; j->next < j->snap->n; j->next++ ) {
+        const struct canmat_snapshot_entry *e = &j->snap->entry[j->next];
+        if( j->map && j->map->index != e->index && map_end( j, now ) ) return;
+        if( j->guard && j->guard != pdo_comm( e->index ) && guard_end( j, now ) ) return;
+        const canmat_obj_t *o = canmat_dict_search_index( j->dict, e->index, e->subindex );
+        if( NULL == o || !writable(o) ) continue;
+        if( 0 == e->subindex && pdo_mapping( e->index ) ) j->map = e;
+        started( j, canmat_sdo_client_ul( &j->client, e->index, e->subindex,
+                                          j->buf, sizeof(j->buf), 0, now ),
+                 CANMAT_SNAPSHOT_JOB_COMPARE );
+        return;
+    }
+    if( j->map && map_end( j, now ) ) return;
+    if( j->guard && guard_end( j, now ) ) return;
+    finish( j, CANMAT_OK );
+}
+
+/* Write the current entry, unless it is the number of entries of a
+ * cleared mapping, which map_end() writes */
+static void write_entry( struct canmat_snapshot_job *j, int64_t now ) {
+    const struct canmat_snapshot_entry *e = &j->snap->entry[j->next];
+    if( e == j->map ) {
+        j->next++;
+        restore_next( j, now );
+    } else {
+        started( j, canmat_sdo_client_dl( &j->client, e->index, e->subindex,
+                                          canmat_snapshot_data( j->snap, e ), e->length, 0, now ),
+                 CANMAT_SNAPSHOT_JOB_WRITE );
+    }
+}
+
+/* Write the current entry, clearing its PDO mapping first */
+static void modify( struct canmat_snapshot_job *j, int64_t now ) {
+    if( j->map && !j->remap ) {
+        j->remap = 1;
+        j->zero = 0;
+        started( j, canmat_sdo_client_dl( &j->client, j->map->index, 0, &j->zero, 1, 0, now ),
+                 CANMAT_SNAPSHOT_JOB_UNMAP );
+    } else {
+        write_entry( j, now );
+    }
+}
+
+/* Set bit 31 of the COB-ID of PDO comm, which is now cob */
+static void invalidate( struct canmat_snapshot_job *j, uint16_t comm, uint32_t cob, int64_t now ) {
+    canmat_byte_stle32( j->cob_data, cob | CANMAT_COBID_PDO_MASK_VALID );
+    started( j, canmat_sdo_client_dl( &j->client, comm, 1, j->cob_data, 4, 0, now ),
+             CANMAT_SNAPSHOT_JOB_INVALIDATE );
+}
+
+/* Start changing the current entry, which differs from the node's
+ * value in j->buf.  A valid PDO is made invalid first. */
+static void change( struct canmat_snapshot_job *j, int64_t now ) {
+    const struct canmat_snapshot_entry *e = &j->snap->entry[j->next];
+    const struct canmat_sdo_client *c = &j->client;
+    uint16_t comm = pdo_comm( e->index );
+    if( comm && comm == e->index && 1 == e->subindex ) {
+        // the COB-ID itself, which sets whether the PDO ends up valid
+        if( comm == j->guard ) {
+            j->guard = 0;
+            j->revalidate = 0;
+        }
+        uint32_t cob = canmat_byte_ldle32( j->buf );
+        if( CANMAT_OK == c->status && 4 == c->length && !(cob & CANMAT_COBID_PDO_MASK_VALID) ) {
+            invalidate( j, comm, cob, now );
+            return;
+        }
+    } else if( comm && comm != j->guard ) {
+        j->guard = comm;
+        started( j, canmat_sdo_client_ul( &j->client, comm, 1, j->buf, sizeof(j->buf), 0, now ),
+                 CANMAT_SNAPSHOT_JOB_COB );
+        return;
+    }
+    modify( j, now );
+}
+
+/* Handle a finished transfer */
+static void done( struct canmat_snapshot_job *j, int64_t now ) {
+    struct canmat_sdo_client *c = &j->client;
+    if( CANMAT_ERR_TIMEOUT == c->status ) {
+        finish( j, CANMAT_ERR_TIMEOUT );
+        return;
+    }
+
+    switch( j->state ) {
+    case CANMAT_SNAPSHOT_JOB_READ:
+        if( CANMAT_OK == c->status ) {
+            canmat_status_t r = canmat_snapshot_add( j->snap, c->index, c->subindex, j->buf, c->length );
+            if( CANMAT_OK != r ) {
+                finish( j, r );
+                return;
+            }
+        } else {
+            j->n_failed++;
+        }
+        j->next++;
+        read_next( j, now );
+        return;
+    case CANMAT_SNAPSHOT_JOB_COMPARE: {
+        // a value we cannot read is written anyway
+        const struct canmat_snapshot_entry *e = &j->snap->entry[j->next];
+        if( CANMAT_OK == c->status && c->length == e->length &&
+            0 == memcmp( j->buf, canmat_snapshot_data( j->snap, e ), e->length ) )
+        {
+            j->n_same++;
+            j->next++;
+            restore_next( j, now );
+        } else {
+            change( j, now );
+        }
+        return;
+    }
+    case CANMAT_SNAPSHOT_JOB_COB: {
+        uint32_t cob = canmat_byte_ldle32( j->buf );
+        if( CANMAT_OK == c->status && 4 == c->length && !(cob & CANMAT_COBID_PDO_MASK_VALID) ) {
+            j->cob = cob;
+            j->revalidate = 1;
+            invalidate( j, j->guard, cob, now );
+        } else {
+            modify( j, now );
+        }
+        return;
+    }
+    case CANMAT_SNAPSHOT_JOB_INVALIDATE:
+        if( CANMAT_OK != c->status ) j->n_failed++;
+        modify( j, now );
+        return;
+    case CANMAT_SNAPSHOT_JOB_VALIDATE:
+        if( CANMAT_OK != c->status ) j->n_failed++;
+        restore_next( j, now );
+        return;
+    case CANMAT_SNAPSHOT_JOB_UNMAP:
+        if( CANMAT_OK != c->status ) j->n_failed++;
+        write_entry( j, now );
+        return;
+    case CANMAT_SNAPSHOT_JOB_WRITE:
+        j->next++;
+        // fall through
+    case CANMAT_SNAPSHOT_JOB_MAP:
+        if( CANMAT_OK == c->status ) j->n_written++;
+        else j->n_failed++;
+        restore_next( j, now );
+        return;
+    case CANMAT_SNAPSHOT_JOB_IDLE:
+        return;
+    }
+}
+
+canmat_status_t canmat_snapshot_job_read( struct canmat_snapshot_job *j, const canmat_dict_t *dict,
+                                          struct canmat_snapshot *snap, int64_t now ) {
+    if( canmat_snapshot_job_busy(j) ) return CANMAT_ERR_PARAM;
+    j->dict = dict;
+    j->snap = snap;
+    j->next = 0;
+    j->n_same = j->n_written = j->n_failed = 0;
+    read_next( j, now );
+    return canmat_snapshot_job_busy(j) ? CANMAT_OK : j->status;
+}
+
+canmat_status_t canmat_snapshot_job_restore( struct canmat_snapshot_job *j, const canmat_dict_t *dict,
+                                             struct canmat_snapshot *snap, int64_t now ) {
+    if( canmat_snapshot_job_busy(j) ) return CANMAT_ERR_PARAM;
+    j->dict = dict;
+    j->snap = snap;
+    j->next = 0;
+    j->map = NULL;
+    j->remap = 0;
+    j->guard = 0;
+    j->revalidate = 0;
+    j->n_same = j->n_written = j->n_failed = 0;
+    restore_next( j, now );
+    return canmat_snapshot_job_busy(j) ? CANMAT_OK : j->status;
+}
+
+int canmat_snapshot_job_frame( struct canmat_snapshot_job *j, const struct can_frame *can, int64_t now ) {
+    if( !canmat_snapshot_job_busy(j) ) return 0;
+    enum canmat_sdo_client_event ev = canmat_sdo_client_frame( &j->client, can, now );
+    if( CANMAT_SDO_CLIENT_IGNORED == ev ) return 0;
+    if( CANMAT_SDO_CLIENT_DONE == ev ) done( j, now );
+    return 1;
+}
+
+void canmat_snapshot_job_timeout( struct canmat_snapshot_job *j, int64_t now ) {
+    if( canmat_snapshot_job_busy(j) &&
+        CANMAT_SDO_CLIENT_DONE == canmat_sdo_client_timeout( &j->client, now ) )
+    {
+        done( j, now );
+    }
+}
+
+struct run {
+    struct canmat_snapshot_job *job;
+    size_t n;
+};
+
+static int64_t run_timeout( void *cx, int64_t now ) {
+    struct run *x = (struct run*)cx;
+    int64_t deadline = CANMAT_STEP_DONE;
+    for( size_t i = 0; i < x->n; i++ ) {
+        canmat_snapshot_job_timeout( &x->job[i], now );
+        if( canmat_snapshot_job_busy( &x->job[i] ) ) {
+            int64_t d = canmat_sdo_client_deadline( &x->job[i].client );
+            if( CANMAT_STEP_DONE == deadline || d < deadline ) deadline = d;
+        }
+    }
+    return deadline;
+}
+
+static void run_frame( void *cx, const struct can_frame *can, int64_t now ) {
+    struct run *x = (struct run*)cx;
+    for( size_t i = 0; i < x->n && !canmat_snapshot_job_frame( &x->job[i], can, now ); i++ );
+}
+
+canmat_status_t canmat_snapshot_run( canmat_iface_t *cif, struct canmat_snapshot_job *job, size_t n ) {
+    struct run x = { job, n };
+    return canmat_step_run( cif, run_timeout, run_frame, &x );
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
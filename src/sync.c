@@ -0,0 +1,182 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include "socanmatic.h"
+
+static int64_t ts_ns( const struct timespec *t ) {
+    return (int64_t)t->tv_sec * 1000000000LL + t->tv_nsec;
+}
+
+static void ts_add( struct timespec *t, int64_t ns ) {
+    int64_t x = ts_ns(t) + ns;
+    t->tv_sec = (time_t)(x / 1000000000LL);
+    t->tv_nsec = (long)(x % 1000000000LL);
+}
+
+static canmat_status_t check_counter( uint8_t counter_max ) {
+    return ( 1 == counter_max || counter_max > 240 ) ? CANMAT_ERR_PARAM : CANMAT_OK;
+}
+
+canmat_status_t canmat_sync_producer_init( struct canmat_sync_producer *p, struct canmat_iface *cif,
+                                           int64_t period_ns, uint8_t counter_max ) {
+    memset( p, 0, sizeof(*p) );
+    if( period_ns <= 0 || CANMAT_OK != check_counter(counter_max) ) return CANMAT_ERR_PARAM;
+    p->cif = cif;
+    p->cob_id = CANMAT_FUNC_CODE_SYNC_EMCY;
+    p->period_ns = period_ns;
+    p->counter_max = counter_max;
+    canmat_hist_init( &p->hist_send, 1000 );
+    canmat_hist_init( &p->hist_tx, 1000 );
+    return CANMAT_OK;
+}
+
+canmat_status_t canmat_sync_producer_load( struct canmat_sync_producer *p, const canmat_dict_t *dict,
+                                           const struct canmat_sdo_value *value ) {
+    const canmat_obj_t *obj;
+    if( (obj = canmat_dict_search_index(dict, 0x1005, 0)) ) {
+        uint32_t cob = value[obj - dict->obj].scalar.u32;
+        // an unset entry keeps the default, a SYNC consumer must not produce
+        if( cob && !(cob & CANMAT_COBID_SYNC_MASK_GEN) ) return CANMAT_ERR_PARAM;
+        if( cob & CAN_SFF_MASK ) p->cob_id = cob & CAN_SFF_MASK;
+    }
+    if( (obj = canmat_dict_search_index(dict, 0x1006, 0)) ) {
+        uint32_t us = value[obj - dict->obj].scalar.u32;
+        if( us ) p->period_ns = (int64_t)us * 1000;
+    }
+    if( (obj = canmat_dict_search_index(dict, 0x1019, 0)) ) {
+        uint8_t c = value[obj - dict->obj].scalar.u8;
+        if( CANMAT_OK != check_counter(c) ) return CANMAT_ERR_PARAM;
+        p->counter_max = c;
+    }
+    return CANMAT_OK;
+}
+
+void canmat_sync_producer_start( struct canmat_sync_producer *p ) {
+    p->tx_stamp = (CANMAT_OK == canmat_iface_tx_stamp_enable( p->cif ));
+    p->counter = 0;
+    p->stamp_head = p->stamp_n = 0;
+    clock_gettime( CLOCK_MONOTONIC, &p->next );
+    ts_add( &p->next, p->period_ns );
+}
+
+/* Read transmit timestamps of SYNCs sent so far, each belongs to the
+ * oldest sent SYNC not yet stamped */
+static void read_tx_stamps( struct canmat_sync_producer *p ) {
+    struct timespec ts;
+    while( CANMAT_OK == canmat_iface_tx_stamp( p->cif, &ts ) ) {
+        // a stamp with no SYNC waiting is for a frame we did not send
+        if( 0 == p->stamp_n ) continue;
+        int64_t due = p->stamp_due[p->stamp_head];
+        p->stamp_head = (p->stamp_head + 1) % CANMAT_SYNC_STAMP_MAX;
+        p->stamp_n--;
+        canmat_hist_add( &p->hist_tx, ts_ns(&ts) - p->real_offset - due );
+    }
+}
+
+/* Remember a sent SYNC until its timestamp arrives, forgetting the
+ * oldest if the driver never stamped it */
+static void stamp_wait( struct canmat_sync_producer *p, int64_t due ) {
+    if( CANMAT_SYNC_STAMP_MAX == p->stamp_n ) {
+        p->stamp_head = (p->stamp_head + 1) % CANMAT_SYNC_STAMP_MAX;
+        p->stamp_n--;
+    }
+    p->stamp_due[(p->stamp_head + p->stamp_n) % CANMAT_SYNC_STAMP_MAX] = due;
+    p->stamp_n++;
+}
+
+canmat_status_t canmat_sync_producer_step( struct canmat_sync_producer *p ) {
+    if( p->tx_stamp && p->sent ) read_tx_stamps( p );
+
+    int r = clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &p->next, NULL );
+    if( r ) {
+        errno = r;
+        return CANMAT_ERR_OS;
+    }
+
+    struct can_frame can;
+    memset( &can, 0, sizeof(can) );
+    can.can_id = p->cob_id;
+    if( p->counter_max ) {
+        p->counter = (uint8_t)( p->counter >= p->counter_max ? 1 : p->counter + 1 );
+        can.can_dlc = 1;
+        can.data[0] = p->counter;
+    }
+    canmat_status_t cr = canmat_iface_send( p->cif, &can );
+
+    struct timespec now, real;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    if( p->tx_stamp ) {
+        clock_gettime( CLOCK_REALTIME, &real );
+        p->real_offset = ts_ns(&real) - ts_ns(&now);
+    }
+    canmat_hist_add( &p->hist_send, ts_ns(&now) - ts_ns(&p->next) );
+    if( CANMAT_OK == cr ) {
+        p->sent++;
+        if( p->tx_stamp ) stamp_wait( p, ts_ns(&p->next) );
+    }
+
+    /* Skip missed periods rather than bursting to catch up */
+    p->last = p->next;
+    ts_add( &p->next, p->period_ns );
+    while( ts_ns(&p->next) <= ts_ns(&now) ) {
+        ts_add( &p->next, p->period_ns );
+        p->missed++;
+    }
+    return cr;
+}
+
+void canmat_sync_producer_print( FILE *f, const struct canmat_sync_producer *p ) {
+    fprintf( f, "sync: %"PRIu64" sent, %"PRIu64" missed, period %"PRId64" ns\n",
+             p->sent, p->missed, p->period_ns );
+    canmat_hist_print( f, "send", &p->hist_send );
+    if( p->hist_tx.count ) canmat_hist_print( f, "tx", &p->hist_tx );
+}
+
+
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
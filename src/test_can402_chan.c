@@ -0,0 +1,137 @@
+/* -*- mode: C; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "can402_sns.h"
+#include "can402.h"
+
+#define SLOTS 16   /* must match the shm transport's ring */
+
+static void put_n( struct can402_chan *c, uint32_t first, uint32_t n ) {
+    for( uint32_t i = first; i < first + n; i++ ) {
+        assert( CAN402_CHAN_OK == can402_chan_put( c, &i, sizeof(i) ) );
+    }
+}
+
+static enum can402_chan_status get( struct can402_chan *c, uint32_t *x, int options ) {
+    struct timespec past = {0, 0};
+    size_t size = 0;
+    enum can402_chan_status r = can402_chan_get( c, x, sizeof(*x), &size, &past, options );
+    assert( CAN402_CHAN_OK != r || sizeof(*x) == size );
+    return r;
+}
+
+static void shm(void) {
+    char name[64];
+    snprintf( name, sizeof(name), "/test_can402_chan_%d", (int)getpid() );
+    struct can402_chan *w = can402_chan_open( "shm", name, sizeof(uint32_t), 0 );
+    assert( w );
+    // readers attach to the existing ring and start at its head
+    put_n( w, 100, 1 );
+    struct can402_chan *r = can402_chan_open( "shm", name, sizeof(uint32_t), 0 );
+    assert( r );
+    uint32_t x = 0;
+    assert( CAN402_CHAN_STALE_FRAMES == get( r, &x, 0 ) );
+    // a ring too small for the messages is refused
+    assert( NULL == can402_chan_open( "shm", name, 2*sizeof(uint32_t), 0 ) );
+
+    // all messages, in order
+    put_n( w, 0, 3 );
+    for( uint32_t i = 0; i < 3; i++ ) {
+        assert( CAN402_CHAN_OK == get( r, &x, 0 ) && i == x );
+    }
+    assert( CAN402_CHAN_STALE_FRAMES == get( r, &x, 0 ) );
+    assert( CAN402_CHAN_TIMEOUT == get( r, &x, CAN402_CHAN_O_WAIT ) );
+
+    // latest message only
+    put_n( w, 10, 3 );
+    assert( CAN402_CHAN_OK == get( r, &x, CAN402_CHAN_O_LAST ) && 12 == x );
+    assert( CAN402_CHAN_STALE_FRAMES == get( r, &x, CAN402_CHAN_O_LAST ) );
+
+    // overrun skips to the oldest message still in the ring
+    put_n( w, 20, SLOTS + 3 );
+    assert( CAN402_CHAN_MISSED_FRAME == get( r, &x, 0 ) && 23 == x );
+    for( uint32_t i = 24; i < 20 + SLOTS + 3; i++ ) {
+        assert( CAN402_CHAN_OK == get( r, &x, 0 ) && i == x );
+    }
+    assert( CAN402_CHAN_STALE_FRAMES == get( r, &x, 0 ) );
+
+    // oversized messages
+    uint64_t big = 0;
+    assert( CAN402_CHAN_OVERFLOW == can402_chan_put( w, &big, sizeof(big) ) );
+    put_n( w, 30, 1 );
+    uint16_t small;
+    size_t size = 0;
+    struct timespec past = {0, 0};
+    assert( CAN402_CHAN_OVERFLOW == can402_chan_get( r, &small, sizeof(small), &size, &past, 0 ) );
+    assert( sizeof(uint32_t) == size );
+
+    can402_chan_close( r );
+    can402_chan_close( w );
+    shm_unlink( name );
+}
+
+int main( int argc, char **argv ) {
+    (void) argc; (void) argv;
+
+    shm();
+
+    return 0;
+}
+
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/* Local Variables:                          */
+/* mode: c                                   */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
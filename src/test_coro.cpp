@@ -0,0 +1,186 @@
+/* -*- mode: C++; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Drives the coroutines of coro.hpp with run() over a fake interface
+ * whose nodes are canmat_sdo_servers. */
+
+#include <cassert>
+#include <deque>
+#include <vector>
+
+#include "socanmatic.h"
+#include "socanmatic/dict402.h"
+#include "socanmatic/dict402.hpp"
+#include "socanmatic/coro.hpp"
+
+using namespace socanmatic;
+
+#define N_NODE 4
+
+/* Simulated nodes 1 to N_NODE: sent frames go to every node, and their
+ * answers wait to be received */
+static struct {
+    canmat_sdo_server node[N_NODE];
+    std::vector<canmat_sdo_value> value[N_NODE];
+    std::vector<uint32_t> cob[N_NODE];   ///< writes to 1800h sub 1
+    std::deque<can_frame> answers;
+    size_t n_sent;
+} bus;
+
+static canmat_status_t test_answer( void *cx, const struct can_frame *can ) {
+    (void)cx;
+    bus.answers.push_back( *can );
+    return CANMAT_OK;
+}
+
+static canmat_status_t test_send( struct canmat_iface *cif, const struct can_frame *can ) {
+    (void)cif;
+    bus.n_sent++;
+    for( auto &s : bus.node ) canmat_sdo_server_frame( &s, can );
+    return CANMAT_OK;
+}
+
+static canmat_status_t test_recv( struct canmat_iface *cif, struct can_frame *can ) {
+    (void)cif;
+    if( bus.answers.empty() ) return CANMAT_ERR_UNDERFLOW;
+    *can = bus.answers.front();
+    bus.answers.pop_front();
+    return CANMAT_OK;
+}
+
+static void test_written( void *cx, const canmat_obj_t *obj, struct canmat_sdo_value *val ) {
+    if( CANMAT_TPDO_COM_BASE == obj->index && 1 == obj->subindex ) {
+        static_cast<std::vector<uint32_t>*>(cx)->push_back( val->scalar.u32 );
+    }
+}
+
+static canmat_sdo_value *value( size_t i, uint16_t index, uint8_t subindex ) {
+    return canmat_sdo_server_value( &bus.node[i],
+                                    canmat_dict_search_index( &canmat_dict402, index, subindex ) );
+}
+
+/* What a tool would do to bring up each drive */
+static task<canmat_status_t> configure( canmat_dispatch &d, uint8_t node ) {
+    auto s = co_await sdo_ul<canmat_402::statusword>( d, node );
+    if( !s ) co_return s.status;
+    assert( 0x200 + node == s.value );
+    auto r = co_await sdo_dl<canmat_402::controlword>( d, node, uint16_t(0x0f) );
+    if( !r ) co_return r.status;
+    uint32_t err = 0;
+    co_return co_await pdo_remap<canmat_402::pdo_stat_cur>( d, node, 0, CANMAT_UL, 1, -1, -1, &err );
+}
+
+static task< result<uint32_t> > missing( canmat_dispatch &d, uint8_t node ) {
+    co_return co_await sdo_ul< object<0x2000, 0, CANMAT_DATA_TYPE_UNSIGNED32> >( d, node );
+}
+
+static task<void> stuck() {
+    co_await std::suspend_always{};
+}
+
+int main( int argc, char **argv ) {
+    (void) argc; (void) argv;
+
+    canmat_iface_vtable vtable = {};
+    vtable.send = test_send;
+    vtable.recv = test_recv;
+    canmat_iface_t cif = {};
+    cif.vtable = &vtable;
+    for( size_t i = 0; i < N_NODE; i++ ) {
+        bus.value[i].resize( canmat_dict402.length );
+        canmat_sdo_server_init( &bus.node[i], (uint8_t)(i + 1), &canmat_dict402,
+                                bus.value[i].data(), test_answer, NULL );
+        bus.node[i].written = test_written;
+        bus.node[i].written_cx = &bus.cob[i];
+        value( i, 0x6041, 0 )->scalar.u16 = (uint16_t)(0x201 + i);
+        value( i, 0x1800, 1 )->scalar.u32 = (uint32_t)(0x181 + i);
+    }
+    canmat_dispatch d;
+    canmat_dispatch_init( &d, &cif );
+
+    // every node's first request goes out before any answer
+    std::vector< task<canmat_status_t> > t;
+    for( uint8_t node = 1; node <= N_NODE; node++ ) t.push_back( configure( d, node ) );
+    assert( N_NODE == bus.n_sent && N_NODE == d.pending );
+    assert( CANMAT_OK == run( d, t ) );
+    for( size_t i = 0; i < N_NODE; i++ ) {
+        assert( CANMAT_OK == t[i].get() );
+        assert( 0x0f == value( i, 0x6040, 0 )->scalar.u16 );
+        assert( 2 == value( i, 0x1A00, 0 )->scalar.u8 );
+        assert( 0x60410010 == value( i, 0x1A00, 1 )->scalar.u32 );
+        assert( 0x60780010 == value( i, 0x1A00, 2 )->scalar.u32 );
+        assert( 1 == value( i, 0x1800, 2 )->scalar.u8 );
+        // invalid while remapped
+        assert( 2 == bus.cob[i].size() );
+        assert( (0x181 + i) == (bus.cob[i][0] & ~CANMAT_COBID_PDO_MASK_VALID) );
+        assert( bus.cob[i][0] & CANMAT_COBID_PDO_MASK_VALID );
+        assert( 0x181 + i == bus.cob[i][1] );
+    }
+
+    // node aborts
+    std::vector< task< result<uint32_t> > > m;
+    m.push_back( missing( d, 1 ) );
+    assert( CANMAT_OK == run( d, m ) );
+    result<uint32_t> r = m[0].get();
+    assert( CANMAT_ERR_ABORT == r.status && 0 != r.abort );
+
+    // nobody answers node 9
+    m.clear();
+    m.push_back( missing( d, 9 ) );
+    assert( CANMAT_ERR_UNDERFLOW == run( d, m ) );
+    canmat_dispatch_cancel( &d, CANMAT_ERR_TIMEOUT );
+    assert( m[0].done() && CANMAT_ERR_TIMEOUT == m[0].get().status );
+
+    // waiting on something else
+    std::vector< task<void> > s;
+    s.push_back( stuck() );
+    assert( CANMAT_ERR_PARAM == run( d, s ) );
+
+    return 0;
+}
+
+/* Local Variables:                          */
+/* mode: c++                                 */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
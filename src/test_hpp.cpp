@@ -0,0 +1,140 @@
+/* -*- mode: C++; c-basic-offset: 4 -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2008-2013, Georgia Tech Research Corporation
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@gatech.edu>
+ * Georgia Tech Humanoid Robotics Lab
+ * Under Direction of Prof. Mike Stilman <mstilman@cc.gatech.edu>
+ *
+ *
+ * This file is provided under the following "BSD-style" License:
+ *
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Checks socanmatic.hpp and the generated socanmatic/dict402.hpp
+ * against the C PDO codec.  Built with -DTEST_HPP_NARROWING it must
+ * fail to compile, see check-local in Makefile.am. */
+
+#include <cassert>
+#include <cstring>
+
+#include "socanmatic.h"
+#include "socanmatic/dict402.h"
+#include "socanmatic/dict402.hpp"
+#include "socanmatic/pdo402.h"
+
+using namespace socanmatic;
+
+typedef object<0x2000, 0, CANMAT_DATA_TYPE_REAL32> test_real;
+typedef object<0x2001, 0, CANMAT_DATA_TYPE_INTEGER8> test_i8;
+typedef pdo<test_i8, test_real, canmat_402::controlword> test_pdo;
+
+// layouts are known when compiled
+static_assert( 8 == canmat_402::pdo_user::length && 4 == canmat_402::pdo_user::offset(1) );
+static_assert( CANMAT_402_PDO_STAT_CUR_LENGTH == canmat_402::pdo_stat_cur::length );
+static_assert( CANMAT_402_PDO_STAT_CUR_COUNT == canmat_402::pdo_stat_cur::count );
+static_assert( 7 == test_pdo::length && 5 == test_pdo::offset(2) );
+static_assert( std::is_same_v< test_pdo::tuple, std::tuple<int8_t, float, uint16_t> > );
+
+// download<> and sdo_dl<> refuse values that do not fit
+static_assert( detail::non_narrowing<uint16_t, uint8_t>::value );
+static_assert( detail::non_narrowing<int32_t, int16_t>::value );
+static_assert( !detail::non_narrowing<uint16_t, int32_t>::value );
+static_assert( !detail::non_narrowing<uint32_t, int32_t>::value );
+static_assert( !detail::non_narrowing<int8_t, double>::value );
+
+#ifdef TEST_HPP_NARROWING
+void narrowing( canmat_iface_t *cif ) {
+    int32_t v = 0x10000;
+    sdo(cif).download<canmat_402::controlword>( 1, v );
+}
+#endif
+
+static void pdo_user( void ) {
+    struct canmat_402_pdo_user c = { -123456, 0x7fedcba9 };
+    uint8_t want[8], data[8];
+    canmat_402_pdo_user_pack( &c, want );
+    canmat_402::pdo_user::pack( { c.position_actual_value, c.velocity_actual_value }, data );
+    assert( 0 == memcmp( want, data, sizeof(data) ) );
+
+    auto [pos, vel] = canmat_402::pdo_user::unpack( want );
+    assert( c.position_actual_value == pos && c.velocity_actual_value == vel );
+}
+
+static void pdo_stat_cur( void ) {
+    const uint8_t data[4] = { 0x37, 0x16, 0x18, 0xfc };
+    struct canmat_402_pdo_stat_cur c;
+    canmat_402_pdo_stat_cur_unpack( &c, data );
+    auto [status, current] = canmat_402::pdo_stat_cur::unpack( data );
+    assert( 0x1637 == status && c.statusword == status );
+    assert( -1000 == current && c.current_actual_value == current );
+
+    uint8_t out[4];
+    canmat_402::pdo_stat_cur::pack( { status, current }, out );
+    assert( 0 == memcmp( data, out, sizeof(out) ) );
+}
+
+static void pdo_mixed( void ) {
+    uint8_t data[test_pdo::length];
+    test_pdo::pack( { -2, 1.5f, 0x0f }, data );
+    assert( 0 == memcmp( data, "\xfe" "\x00\x00\xc0\x3f" "\x0f\x00", sizeof(data) ) );
+    assert( std::make_tuple( int8_t(-2), 1.5f, uint16_t(0x0f) ) == test_pdo::unpack( data ) );
+}
+
+static void pdo_objs( void ) {
+    auto objs = canmat_402::pdo_user::c_objs();
+    const canmat_obj_t *want[] = { CANMAT_402_OBJ_POSITION_ACTUAL_VALUE,
+                                   CANMAT_402_OBJ_VELOCITY_ACTUAL_VALUE };
+    for( size_t i = 0; i < objs.size(); i++ ) {
+        assert( want[i]->index == objs[i].index && want[i]->subindex == objs[i].subindex );
+        assert( want[i]->data_type == objs[i].data_type );
+        assert( canmat_obj_bitsize( want[i] ) == canmat_obj_bitsize( &objs[i] ) );
+    }
+}
+
+int main( int argc, char **argv ) {
+    (void) argc; (void) argv;
+
+    pdo_user();
+    pdo_stat_cur();
+    pdo_mixed();
+    pdo_objs();
+
+    return 0;
+}
+
+/* Local Variables:                          */
+/* mode: c++                                 */
+/* c-basic-offset: 4                         */
+/* indent-tabs-mode:  nil                    */
+/* End:                                      */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
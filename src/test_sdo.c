@@ -42,9 +42,14 @@
 
 
 #include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "socanmatic.h"
 #include "socanmatic_private.h"
+#include "socanmatic/dict402.h"
+#include "socanmatic/pdo402.h"
 
 
 
@@ -174,6 +179,1461 @@ static void sdo_data(void) {
     /* assert( -42 == canmat_sdo_get_data_i16( &sdo ) ); */
 }
 
+static void dict_index(void) {
+    const canmat_dict_t *dict = &canmat_dict402;
+
+    // generated hash
+    assert( dict->index_hash );
+    for( size_t i = 0; i < dict->length; i++ ) {
+        canmat_obj_t *obj = dict->obj + i;
+        canmat_obj_t *r = canmat_dict_search_index(dict, obj->index, obj->subindex);
+        assert( r && r->index == obj->index && r->subindex == obj->subindex );
+    }
+    assert( NULL == canmat_dict_search_index(dict, 0x5fff, 0xff) );
+    assert( CANMAT_402_OBJ_CONTROLWORD == canmat_dict_search_index(dict, 0x6040, 0) );
+
+    // runtime hash, arrays and their sub0 share a key
+    uint32_t *keys = (uint32_t*)calloc( dict->length, sizeof(keys[0]) );
+    size_t n = 0;
+    for( size_t i = 0; i < dict->length; i++ ) {
+        uint32_t k = CANMAT_DICT_INDEX_KEY( dict->obj[i].index, dict->obj[i].subindex );
+        if( 0 == n || keys[n-1] != k ) keys[n++] = k;
+    }
+    struct canmat_dict_hash *h = canmat_dict_hash_build( keys, n );
+    assert( h );
+    for( size_t i = 0; i < n; i++ ) {
+        assert( i == canmat_dict_hash_lookup(h, keys[i]) );
+    }
+    free(h);
+
+    // duplicate keys
+    keys[1] = keys[0];
+    assert( NULL == canmat_dict_hash_build( keys, n ) );
+    free(keys);
+
+    // binary search fallback
+    canmat_dict_t nohash = *dict;
+    nohash.index_hash = NULL;
+    assert( CANMAT_402_OBJ_CONTROLWORD == canmat_dict_search_index(&nohash, 0x6040, 0) );
+    assert( NULL == canmat_dict_search_index(&nohash, 0x5fff, 0xff) );
+}
+
+static void dict_name(void) {
+    const canmat_dict_t *dict = &canmat_dict402;
+
+    assert( dict->name_hash );
+    for( size_t i = 0; i < dict->length; i++ ) {
+        canmat_obj_t *obj = dict->obj + i;
+        assert( obj == canmat_dict_search_name(dict, obj->parameter_name) );
+    }
+    assert( CANMAT_402_OBJ_CONTROLWORD == canmat_dict_search_name(dict, "controlword") );
+    assert( CANMAT_402_OBJ_CONTROLWORD == canmat_dict_search_name(dict, "CONTROLWORD") );
+    assert( NULL == canmat_dict_search_name(dict, "controlwor") );
+    assert( NULL == canmat_dict_search_name(dict, "") );
+    assert( canmat_dict_name_hash("Statusword") == canmat_dict_name_hash("STATUSword") );
+
+    // handles
+    assert( 0x6040 == dict->obj[CANMAT_402_OBJI_CONTROLWORD].index );
+
+    // binary search fallback
+    canmat_dict_t nohash = *dict;
+    nohash.name_hash = NULL;
+    assert( CANMAT_402_OBJ_CONTROLWORD == canmat_dict_search_name(&nohash, "controlword") );
+    assert( NULL == canmat_dict_search_name(&nohash, "controlwor") );
+}
+
+static void dict_load(void) {
+    const char *srcdir = getenv("srcdir");
+    char f301[1024], f402[1024];
+    snprintf( f301, sizeof(f301), "%s/eds/dsp301.eds", srcdir ? srcdir : "." );
+    snprintf( f402, sizeof(f402), "%s/eds/dsp402.eds", srcdir ? srcdir : "." );
+    const char *files[] = {f301, f402};
+
+    struct canmat_dict *dict = NULL;
+    struct canmat_eds_error err;
+    canmat_status_t r = canmat_dict_load_eds( 2, files, &dict, &err );
+    assert( CANMAT_OK == r );
+
+    // same objects as the generated dictionary
+    for( size_t i = 0; i < dict->length; i++ ) {
+        const canmat_obj_t *a = dict->obj + i;
+        const canmat_obj_t *b = canmat_dict_search_name( &canmat_dict402, a->parameter_name );
+        assert( b );
+        assert( a->index == b->index && a->subindex == b->subindex );
+        assert( a->data_type == b->data_type );
+        assert( a->object_type == b->object_type );
+        assert( a->access_type == b->access_type );
+        assert( a->pdo_mapping == b->pdo_mapping );
+        assert( !a->mask_descriptor == !b->mask_descriptor );
+        assert( !a->value_descriptor == !b->value_descriptor );
+        assert( a == canmat_dict_search_name( dict, a->parameter_name ) );
+    }
+
+    const canmat_obj_t *cw = canmat_dict_search_index( dict, 0x6040, 0 );
+    assert( cw && 0 == strcmp( "Controlword", cw->parameter_name ) );
+    assert( cw->mask_descriptor );
+    assert( 0 == strcmp( "switch_on", cw->mask_descriptor[0].name ) );
+    assert( 1 == cw->mask_descriptor[0].value );
+    free( dict );
+
+    // layers override keys
+    char overlay[] = "/tmp/test_sdo_XXXXXX";
+    int fd = mkstemp( overlay );
+    assert( fd >= 0 );
+    FILE *fp = fdopen( fd, "w" );
+    fputs( "[6040]\nAccessType=RO\n[603f]\nParameterName=Error code\n", fp );
+    fclose( fp );
+    const char *layers[] = {f301, f402, overlay};
+    assert( CANMAT_OK == canmat_dict_load_eds( 3, layers, &dict, &err ) );
+    unlink( overlay );
+    cw = canmat_dict_search_index( dict, 0x6040, 0 );
+    assert( cw && CANMAT_ACCESS_RO == cw->access_type );
+    assert( CANMAT_DATA_TYPE_UNSIGNED16 == cw->data_type );
+    assert( cw->mask_descriptor );
+    assert( canmat_dict_search_index( dict, 0x603F, 0 ) == canmat_dict_search_name( dict, "Error code" ) );
+    free( dict );
+
+    // errors
+    const char *missing[] = {"/nonexistent.eds"};
+    assert( CANMAT_ERR_OS == canmat_dict_load_eds( 1, missing, &dict, &err ) );
+    assert( missing[0] == err.file );
+}
+
+/* img has the same objects as dict */
+static void check_image( const canmat_dict_image_t *img, const canmat_dict_t *dict ) {
+    assert( img->hdr->n_obj == dict->length );
+    for( size_t i = 0; i < dict->length; i++ ) {
+        const canmat_obj_t *a = dict->obj + i;
+        const struct canmat_dict_image_obj *o = canmat_dict_image_search_name( img, a->parameter_name );
+        assert( o );
+        assert( o == canmat_dict_image_search_index( img, o->index, o->subindex ) ||
+                CANMAT_OBJECT_TYPE_VAR != o->object_type );
+        canmat_obj_t b = {0};
+        canmat_dict_image_get_obj( img, o, &b );
+        assert( 0 == strcmp( a->parameter_name, b.parameter_name ) );
+        assert( a->index == b.index && a->subindex == b.subindex );
+        assert( a->data_type == b.data_type );
+        assert( a->object_type == b.object_type );
+        assert( a->access_type == b.access_type );
+        assert( a->pdo_mapping == b.pdo_mapping );
+        assert( !a->mask_descriptor == !o->mask_desc );
+        if( a->mask_descriptor ) {
+            const struct canmat_dict_image_desc *d = canmat_dict_image_desc( img, o->mask_desc );
+            size_t n = 0;
+            for( ; d[n].name; n++ ) {
+                size_t k;
+                for( k = 0; a->mask_descriptor[k].name &&
+                         strcmp( a->mask_descriptor[k].name, canmat_dict_image_str(img, d[n].name) ); k++ );
+                assert( a->mask_descriptor[k].name );
+                assert( a->mask_descriptor[k].value == d[n].value );
+            }
+            assert( NULL == a->mask_descriptor[n].name );
+        }
+    }
+    assert( NULL == canmat_dict_image_search_index( img, 0x5fff, 0xff ) );
+    assert( NULL == canmat_dict_image_search_name( img, "controlwor" ) );
+}
+
+static void dict_image(void) {
+    void *buf;
+    size_t size;
+    canmat_dict_image_t img;
+
+    // built in memory
+    assert( CANMAT_OK == canmat_dict_image_build( &canmat_dict402, &buf, &size ) );
+    assert( CANMAT_OK == canmat_dict_image_init( &img, buf, size ) );
+    check_image( &img, &canmat_dict402 );
+    assert( CANMAT_ERR_PARAM == canmat_dict_image_init( &img, buf, size - 1 ) );
+    ((uint8_t*)buf)[0] = 'X';
+    assert( CANMAT_ERR_PARAM == canmat_dict_image_init( &img, buf, size ) );
+    free( buf );
+
+    // written by canmatc
+    if( CANMAT_OK == canmat_dict_image_open( &img, "dict402.cdi" ) ) {
+        check_image( &img, &canmat_dict402 );
+        canmat_dict_image_close( &img );
+    }
+}
+
+static void pdo_codec(void) {
+    uint8_t data[8];
+
+    struct canmat_402_pdo_user user = { .position_actual_value = -2,
+                                        .velocity_actual_value = 0x44332211 };
+    canmat_402_pdo_user_pack( &user, data );
+    assert( 0xFE == data[0] && 0xFF == data[3] );
+    assert( 0x11 == data[4] && 0x44 == data[7] );
+    struct canmat_402_pdo_user user2;
+    canmat_402_pdo_user_unpack( &user2, data );
+    assert( -2 == user2.position_actual_value );
+    assert( 0x44332211 == user2.velocity_actual_value );
+
+    struct canmat_402_pdo_stat_cur stat = { .statusword = 0x1637,
+                                            .current_actual_value = -100 };
+    canmat_402_pdo_stat_cur_pack( &stat, data );
+    struct canmat_402_pdo_stat_cur stat2;
+    canmat_402_pdo_stat_cur_unpack( &stat2, data );
+    assert( 0x1637 == stat2.statusword );
+    assert( -100 == stat2.current_actual_value );
+
+    // lengths must agree with the dictionary
+    assert( 2 == CANMAT_402_PDO_STAT_CUR_COUNT );
+    assert( 8*CANMAT_402_PDO_STAT_CUR_LENGTH ==
+            canmat_obj_bitsize( CANMAT_402_OBJ_STATUSWORD ) +
+            canmat_obj_bitsize( CANMAT_402_OBJ_CURRENT_ACTUAL_VALUE ) );
+    assert( 8*CANMAT_402_PDO_USER_LENGTH ==
+            canmat_obj_bitsize( CANMAT_402_OBJ_POSITION_ACTUAL_VALUE ) +
+            canmat_obj_bitsize( CANMAT_402_OBJ_VELOCITY_ACTUAL_VALUE ) );
+}
+
+/* Interface that records sent frames */
+static struct can_frame test_sent[16];
+static size_t test_n_sent;
+
+static canmat_status_t test_send( struct canmat_iface *cif, const struct can_frame *can ) {
+    (void)cif;
+    assert( test_n_sent < sizeof(test_sent)/sizeof(test_sent[0]) );
+    test_sent[test_n_sent++] = *can;
+    return CANMAT_OK;
+}
+
+static struct canmat_iface_vtable test_vtable = { .send = test_send };
+static canmat_iface_t test_cif = { .vtable = &test_vtable };
+
+static void test_done( struct canmat_sdo_req *req ) {
+    (*(int*)req->cx)++;
+}
+
+static void dispatch(void) {
+    struct canmat_dispatch d;
+    struct can_frame can;
+    int done = 0;
+    canmat_dispatch_init( &d, &test_cif );
+    test_n_sent = 0;
+
+    struct canmat_sdo_req a = { .msg = { .index = 0x6041, .node = 1,
+                                         .data_type = CANMAT_DATA_TYPE_UNSIGNED16 },
+                                .done = test_done, .cx = &done };
+    struct canmat_sdo_req b = { .msg = { .index = 0x6064, .node = 1,
+                                         .data_type = CANMAT_DATA_TYPE_INTEGER32 },
+                                .done = test_done, .cx = &done };
+    struct canmat_sdo_req c = { .msg = { .index = 0x6041, .node = 2,
+                                         .data_type = CANMAT_DATA_TYPE_UNSIGNED16 },
+                                .done = test_done, .cx = &done };
+
+    // b waits behind a
+    assert( CANMAT_OK == canmat_dispatch_sdo_ul( &d, &a ) );
+    assert( CANMAT_OK == canmat_dispatch_sdo_ul( &d, &b ) );
+    assert( CANMAT_OK == canmat_dispatch_sdo_ul( &d, &c ) );
+    assert( 3 == d.pending );
+    assert( 2 == test_n_sent );
+    assert( CANMAT_SDO_REQ_ID(1) == test_sent[0].can_id );
+    assert( CANMAT_SDO_REQ_ID(2) == test_sent[1].can_id );
+
+    // out of order responses
+    canmat_sdo_msg_t resp = { .index = 0x6041, .node = 2, .cmd_spec = CANMAT_SCS_EX_UL,
+                              .data_type = CANMAT_DATA_TYPE_UNSIGNED16, .length = 2,
+                              .data.u16 = 0x237 };
+    assert( CANMAT_OK == canmat_sdo2can( &can, &resp, 1 ) );
+    assert( 1 == canmat_dispatch_frame( &d, &can ) );
+    assert( 1 == done && CANMAT_OK == c.status && 0x237 == c.resp.data.u16 );
+    assert( 0 == canmat_dispatch_frame( &d, &can ) );
+
+    resp.node = 1;
+    resp.data.u16 = 0x1637;
+    assert( CANMAT_OK == canmat_sdo2can( &can, &resp, 1 ) );
+    assert( 1 == canmat_dispatch_frame( &d, &can ) );
+    assert( 2 == done && CANMAT_OK == a.status && 0x1637 == a.resp.data.u16 );
+    assert( 3 == test_n_sent );
+    assert( 0x6064 == canmat_can2sdo_index( &test_sent[2] ) );
+
+    // abort
+    can.can_id = CANMAT_SDO_RESP_ID(1);
+    can.data[0] = CANMAT_SDO_CMD_ABORT;
+    canmat_byte_stle16( can.data+1, 0x6064 );
+    can.data[3] = 0;
+    canmat_byte_stle32( can.data+4, CANMAT_ABORT_OBJ_EXIST );
+    assert( 1 == canmat_dispatch_frame( &d, &can ) );
+    assert( 3 == done && CANMAT_ERR_ABORT == b.status );
+    assert( CANMAT_ABORT_OBJ_EXIST == b.resp.data.u32 );
+    assert( 0 == d.pending );
+
+    // deadline
+    assert( CANMAT_OK == canmat_dispatch_sdo_ul( &d, &a ) );
+    assert( CANMAT_OK == canmat_dispatch_sdo_ul( &d, &b ) );
+    assert( CANMAT_OK == canmat_dispatch_sdo_ul( &d, &c ) );
+    canmat_dispatch_cancel( &d, CANMAT_ERR_TIMEOUT );
+    assert( 6 == done && 0 == d.pending && NULL == d.head[1] );
+    assert( CANMAT_ERR_TIMEOUT == a.status && CANMAT_ERR_TIMEOUT == b.status &&
+            CANMAT_ERR_TIMEOUT == c.status );
+    assert( 0 == canmat_dispatch_frame( &d, &can ) );
+
+    c.msg.node = 0;
+    assert( CANMAT_ERR_PARAM == canmat_dispatch_sdo_ul( &d, &c ) );
+}
+
+static canmat_status_t test_client_send( void *cx, const struct can_frame *can ) {
+    return test_send( (struct canmat_iface*)cx, can );
+}
+
+/* Feed the client a server frame */
+static enum canmat_sdo_client_event
+test_server( struct canmat_sdo_client *c, uint8_t cmd, const char *data, size_t n ) {
+    struct can_frame can = { .can_id = CANMAT_SDO_RESP_ID(c->node), .can_dlc = 8 };
+    can.data[0] = cmd;
+    memcpy( can.data+1, data, n );
+    return canmat_sdo_client_frame( c, &can, 0 );
+}
+
+static enum canmat_sdo_client_event
+test_server_mux( struct canmat_sdo_client *c, uint8_t cmd, uint32_t val ) {
+    struct can_frame can = { .can_id = CANMAT_SDO_RESP_ID(c->node), .can_dlc = 8 };
+    can.data[0] = cmd;
+    canmat_byte_stle16( can.data+1, c->index );
+    can.data[3] = c->subindex;
+    canmat_byte_stle32( can.data+4, val );
+    return canmat_sdo_client_frame( c, &can, 0 );
+}
+
+static void sdo_client(void) {
+    struct canmat_sdo_client c;
+    const char *msg = "0123456789abcdefghij";
+    char buf[32];
+    canmat_sdo_client_init( &c, 3, test_client_send, &test_cif );
+
+    assert( 0x31C3 == canmat_sdo_crc( 0, (const uint8_t*)"123456789", 9 ) );
+
+    // segmented upload
+    test_n_sent = 0;
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x1008, 0, buf, sizeof(buf), 0, 0 ) );
+    assert( 0x40 == test_sent[0].data[0] && CANMAT_SDO_REQ_ID(3) == test_sent[0].can_id );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server_mux( &c, 0x41, 10 ) );
+    assert( 0x60 == test_sent[1].data[0] );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server( &c, 0x00, msg, 7 ) );
+    assert( 0x70 == test_sent[2].data[0] );
+    assert( CANMAT_SDO_CLIENT_DONE == test_server( &c, 0x10 | (4<<1) | 1, msg+7, 3 ) );
+    assert( CANMAT_OK == c.status && 10 == c.length && 0 == memcmp( buf, msg, 10 ) );
+
+    // segmented download
+    test_n_sent = 0;
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x1008, 0, msg, 10, 0, 0 ) );
+    assert( 0x21 == test_sent[0].data[0] && 10 == canmat_byte_ldle32( test_sent[0].data+4 ) );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server_mux( &c, 0x60, 0 ) );
+    assert( 0x00 == test_sent[1].data[0] && 0 == memcmp( test_sent[1].data+1, msg, 7 ) );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server( &c, 0x20, NULL, 0 ) );
+    assert( (0x10 | (4<<1) | 1) == test_sent[2].data[0] );
+    assert( CANMAT_SDO_CLIENT_DONE == test_server( &c, 0x30, NULL, 0 ) );
+    assert( CANMAT_OK == c.status && 10 == c.length );
+
+    // block download, server drops a segment
+    test_n_sent = 0;
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x1F50, 1, msg, 20, 1, 0 ) );
+    assert( 0xC6 == test_sent[0].data[0] );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server_mux( &c, 0xA4, 2 ) );
+    assert( 3 == test_n_sent && 0x01 == test_sent[1].data[0] && 0x02 == test_sent[2].data[0] );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server( &c, 0xA2, "\x01\x03", 2 ) );
+    assert( 5 == test_n_sent && 0x01 == test_sent[3].data[0] && 0x82 == test_sent[4].data[0] );
+    assert( 0 == memcmp( test_sent[3].data+1, msg+7, 7 ) );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server( &c, 0xA2, "\x02\x03", 2 ) );
+    assert( (0xC1 | (1<<2)) == test_sent[5].data[0] );
+    assert( canmat_sdo_crc( 0, (const uint8_t*)msg, 20 ) == canmat_byte_ldle16( test_sent[5].data+1 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == test_server( &c, 0xA1, NULL, 0 ) );
+    assert( CANMAT_OK == c.status && 20 == c.length );
+
+    // block upload
+    test_n_sent = 0;
+    memset( buf, 0, sizeof(buf) );
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x1F50, 1, buf, sizeof(buf), 1, 0 ) );
+    assert( 0xA4 == test_sent[0].data[0] );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server_mux( &c, 0xC6, 9 ) );
+    assert( 0xA3 == test_sent[1].data[0] );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server( &c, 0x01, msg, 7 ) );
+    assert( CANMAT_SDO_CLIENT_PENDING == test_server( &c, 0x82, msg+7, 7 ) );
+    assert( 0xA2 == test_sent[2].data[0] && 2 == test_sent[2].data[1] );
+    uint8_t crc[2];
+    canmat_byte_stle16( crc, canmat_sdo_crc( 0, (const uint8_t*)msg, 9 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == test_server( &c, 0xC1 | (5<<2), (const char*)crc, 2 ) );
+    assert( 0xA1 == test_sent[3].data[0] );
+    assert( CANMAT_OK == c.status && 9 == c.length && 0 == memcmp( buf, msg, 9 ) );
+
+    // expedited, server abort
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x1000, 0, buf, 4, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == test_server_mux( &c, 0x80, CANMAT_ABORT_OBJ_EXIST ) );
+    assert( CANMAT_ERR_ABORT == c.status && CANMAT_ABORT_OBJ_EXIST == c.abort );
+
+    // expedited overflows a small buffer
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x1000, 0, buf, 2, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == test_server_mux( &c, 0x43, 0x44332211 ) );
+    assert( CANMAT_ERR_OVERFLOW == c.status );
+
+    // timeout
+    test_n_sent = 0;
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6040, 0, "\x06\x00", 2, 0, 100 ) );
+    assert( 0x2B == test_sent[0].data[0] );
+    assert( CANMAT_SDO_CLIENT_PENDING == canmat_sdo_client_timeout( &c, 99 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == canmat_sdo_client_timeout( &c, 100 + c.timeout_ns ) );
+    assert( CANMAT_ERR_TIMEOUT == c.status && 0x80 == test_sent[1].data[0] );
+    assert( CANMAT_SDO_CLIENT_IGNORED == test_server_mux( &c, 0x60, 0 ) );
+}
+
+/* Frames between a client and server, delivered in order */
+static struct can_frame loop_q[256];
+static size_t loop_head, loop_tail;
+
+static canmat_status_t loop_send( void *cx, const struct can_frame *can ) {
+    (void)cx;
+    loop_q[loop_tail++ % 256] = *can;
+    return CANMAT_OK;
+}
+
+/* Hands a looped frame to the client side, returns 1 if it was taken */
+typedef int loop_client_fun( void *cx, const struct can_frame *can, int64_t now );
+
+/* Deliver looped frames at time now until quiet, first to the client
+ * side, then to each of n simulated nodes */
+static void loop_drain( loop_client_fun *client, void *cx,
+                        struct canmat_sdo_server *s, size_t n, int64_t now ) {
+    while( loop_head != loop_tail ) {
+        struct can_frame can = loop_q[loop_head++ % 256];
+        if( client( cx, &can, now ) ) continue;
+        for( size_t i = 0; i < n; i++ ) canmat_sdo_server_frame( &s[i], &can );
+    }
+}
+
+/* Simulated node serving dict over the loop from an empty value store */
+static void test_node_init( struct canmat_sdo_server *s, uint8_t node, const canmat_dict_t *dict ) {
+    struct canmat_sdo_value *v = (struct canmat_sdo_value*) calloc( dict->length, sizeof(*v) );
+    assert( v );
+    canmat_sdo_server_init( s, node, dict, v, loop_send, NULL );
+}
+
+static void test_node_destroy( struct canmat_sdo_server *s ) {
+    free( s->value );
+}
+
+/* Dictionary of dsp301 extended by the objects in EDS text */
+static struct canmat_dict *test_dict_load( const char *text ) {
+    const char *srcdir = getenv("srcdir");
+    char f301[1024];
+    snprintf( f301, sizeof(f301), "%s/eds/dsp301.eds", srcdir ? srcdir : "." );
+    char eds[] = "/tmp/test_sdo_XXXXXX";
+    int fd = mkstemp( eds );
+    assert( fd >= 0 );
+    FILE *fp = fdopen( fd, "w" );
+    fputs( text, fp );
+    fclose( fp );
+    const char *files[] = {f301, eds};
+    struct canmat_dict *dict = NULL;
+    struct canmat_eds_error err;
+    assert( CANMAT_OK == canmat_dict_load_eds( 2, files, &dict, &err ) );
+    unlink( eds );
+    return dict;
+}
+
+/* Interface to simulated nodes, for the blocking helpers: sent frames
+ * go to the nodes, whose answers are read back through a pipe */
+static struct canmat_sdo_server *pipe_node;
+static size_t pipe_n_node;
+static int pipe_fd[2];
+static unsigned pipe_refuse;    ///< if nonzero, every pipe_refuse'th send finds the queue full
+static unsigned pipe_rate;      ///< if nonzero, frames the queue takes each millisecond
+static unsigned pipe_n_send, pipe_n_refused;
+static int64_t pipe_ms;         ///< millisecond of the last accepted send
+static unsigned pipe_n_ms;      ///< sends accepted in pipe_ms
+
+static canmat_status_t pipe_send( struct canmat_iface *cif, const struct can_frame *can ) {
+    int64_t ms = canmat_now_ns() / 1000000;
+    if( ms != pipe_ms ) {
+        pipe_ms = ms;
+        pipe_n_ms = 0;
+    }
+    if( (pipe_refuse && 0 == ++pipe_n_send % pipe_refuse) ||
+        (pipe_rate && pipe_n_ms >= pipe_rate) )
+    {
+        pipe_n_refused++;
+        cif->err = ENOBUFS;
+        return CANMAT_ERR_OS;
+    }
+    pipe_n_ms++;
+    for( size_t i = 0; i < pipe_n_node; i++ ) canmat_sdo_server_frame( &pipe_node[i], can );
+    while( loop_head != loop_tail ) {
+        struct can_frame *a = &loop_q[loop_head++ % 256];
+        assert( (ssize_t)sizeof(*a) == write( pipe_fd[1], a, sizeof(*a) ) );
+    }
+    return CANMAT_OK;
+}
+
+static canmat_status_t pipe_recv( struct canmat_iface *cif, struct can_frame *can ) {
+    assert( (ssize_t)sizeof(*can) == read( cif->fd, can, sizeof(*can) ) );
+    return CANMAT_OK;
+}
+
+static struct canmat_iface_vtable pipe_vtable = { .send = pipe_send, .recv = pipe_recv };
+
+static void pipe_open( canmat_iface_t *cif, struct canmat_sdo_server *s, size_t n ) {
+    assert( 0 == pipe( pipe_fd ) );
+    pipe_node = s;
+    pipe_n_node = n;
+    pipe_refuse = pipe_rate = pipe_n_send = pipe_n_refused = 0;
+    loop_head = loop_tail = 0;
+    cif->vtable = &pipe_vtable;
+    cif->fd = pipe_fd[0];
+}
+
+static void pipe_close( canmat_iface_t *cif ) {
+    close( pipe_fd[0] );
+    close( pipe_fd[1] );
+    cif->fd = -1;
+}
+
+struct loop_client {
+    struct canmat_sdo_client *c;
+    enum canmat_sdo_client_event e;   ///< last event of c
+};
+
+static int loop_client_frame( void *cx, const struct can_frame *can, int64_t now ) {
+    struct loop_client *l = (struct loop_client*)cx;
+    enum canmat_sdo_client_event e = canmat_sdo_client_frame( l->c, can, now );
+    if( CANMAT_SDO_CLIENT_IGNORED == e ) return 0;
+    l->e = e;
+    return 1;
+}
+
+static enum canmat_sdo_client_event
+loop_run( struct canmat_sdo_client *c, struct canmat_sdo_server *s ) {
+    struct loop_client l = { c, CANMAT_SDO_CLIENT_PENDING };
+    loop_drain( loop_client_frame, &l, s, 1, 0 );
+    return l.e;
+}
+
+static size_t test_n_written;
+static void test_written( void *cx, const canmat_obj_t *obj, struct canmat_sdo_value *val ) {
+    (void)cx; (void)obj; (void)val;
+    test_n_written++;
+}
+
+static void sdo_server(void) {
+    struct canmat_sdo_client c;
+    struct canmat_sdo_server s;
+    const char *msg = "0123456789abcdefghijklmnopqrstuvwxyz";
+    char name[] = "socanmatic test";
+    uint8_t catalog[64];
+    char buf[64];
+
+    canmat_sdo_client_init( &c, 5, loop_send, NULL );
+    test_node_init( &s, 5, &canmat_dict402 );
+    s.blksize = 2;
+    s.written = test_written;
+
+    struct canmat_sdo_value *vname = canmat_sdo_server_value( &s, CANMAT_402_OBJ_MANUFACTURER_DEVICE_NAME );
+    vname->data = (uint8_t*)name;
+    vname->size = strlen(name);
+    const canmat_obj_t *ocat = canmat_dict_search_index( &canmat_dict402, 0x6403, 0 );
+    struct canmat_sdo_value *vcat = canmat_sdo_server_value( &s, ocat );
+    vcat->data = catalog;
+    vcat->capacity = sizeof(catalog);
+    canmat_sdo_server_value( &s, CANMAT_402_OBJ_STATUSWORD )->scalar.u16 = 0x237;
+
+    // expedited
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x6041, 0, buf, 4, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_OK == c.status && 2 == c.length && 0x237 == canmat_byte_ldle16( buf ) );
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6040, 0, "\x0f\x00", 2, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) && CANMAT_OK == c.status );
+    assert( 0x0f == canmat_sdo_server_value( &s, CANMAT_402_OBJ_CONTROLWORD )->scalar.u16 );
+    assert( 1 == test_n_written );
+
+    // access, size, and missing objects
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6041, 0, "\x00\x00", 2, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_ERR_ABORT == c.status && CANMAT_ABORT_READ_ONLY == c.abort );
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6040, 0, "\x00\x00\x00", 3, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_ERR_ABORT == c.status && CANMAT_ABORT_DATA_TOO_HI == c.abort );
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x5FFF, 0, buf, 4, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_ERR_ABORT == c.status && CANMAT_ABORT_OBJ_EXIST == c.abort );
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x6041, 9, buf, 4, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_ERR_ABORT == c.status && CANMAT_ABORT_SUBINDEX_EXIST == c.abort );
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6403, 0, msg, 65, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_ERR_ABORT == c.status && CANMAT_ABORT_DATA_TOO_HI == c.abort );
+    assert( 1 == test_n_written );
+
+    // segmented
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x1008, 0, buf, sizeof(buf), 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_OK == c.status && strlen(name) == c.length && 0 == memcmp( buf, name, c.length ) );
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6403, 0, msg, 20, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) && CANMAT_OK == c.status );
+    assert( 20 == vcat->size && 0 == memcmp( catalog, msg, 20 ) );
+
+    // block, over several server blocks
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6403, 0, msg, 36, 1, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) && CANMAT_OK == c.status );
+    assert( 36 == vcat->size && 0 == memcmp( catalog, msg, 36 ) );
+    memset( buf, 0, sizeof(buf) );
+    assert( CANMAT_OK == canmat_sdo_client_ul( &c, 0x6403, 0, buf, sizeof(buf), 1, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_OK == c.status && 36 == c.length && 0 == memcmp( buf, msg, 36 ) );
+    assert( CANMAT_SDO_SERVER_IDLE == s.state );
+    assert( 3 == test_n_written );
+
+    // an aborted download leaves a staged domain alone
+    uint8_t stage[40];
+    s.stage = stage;
+    s.stage_capacity = sizeof(stage);
+    loop_head = loop_tail = 0;
+    struct can_frame req = { .can_id = 0x605, .can_dlc = 8, .data = {0x21, 0x03, 0x64, 0x00, 14} };
+    assert( 1 == canmat_sdo_server_frame( &s, &req ) );
+    req.data[0] = 0x00;
+    memcpy( req.data+1, "ZZZZZZZ", 7 );
+    assert( 1 == canmat_sdo_server_frame( &s, &req ) );
+    assert( 1 == canmat_sdo_server_frame( &s, &req ) );
+    assert( 3 == loop_tail - loop_head );
+    assert( CANMAT_SDO_CMD_ABORT == loop_q[(loop_tail-1) % 256].data[0] );
+    assert( 36 == vcat->size && 0 == memcmp( catalog, msg, 36 ) && 3 == test_n_written );
+    loop_head = loop_tail;
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6403, 0, msg + 10, 20, 1, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) && CANMAT_OK == c.status );
+    assert( 20 == vcat->size && 0 == memcmp( catalog, msg + 10, 20 ) && 4 == test_n_written );
+    // and bounds downloads
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x6403, 0, catalog, 41, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) );
+    assert( CANMAT_ERR_ABORT == c.status && CANMAT_ABORT_DATA_TOO_HI == c.abort );
+
+    test_node_destroy( &s );
+}
+
+static void pdo_slave(void) {
+    struct canmat_pdo_slave p;
+    struct canmat_sdo_server s;
+    test_node_init( &s, 5, &canmat_dict402 );
+    struct canmat_sdo_value *v = s.value;
+#define STORE( idx, sub ) (v + (canmat_dict_search_index( &canmat_dict402, idx, sub ) - canmat_dict402.obj))
+    // RPDO 1: controlword, TPDO 1: statusword and position every 2 SYNCs,
+    // TPDO 2: statusword on change, 1ms inhibit, 5ms event timer
+    STORE(0x1400,1)->scalar.u32 = 0x205;
+    STORE(0x1400,2)->scalar.u8 = 0xFF;
+    STORE(0x1600,0)->scalar.u8 = 1;
+    STORE(0x1600,1)->scalar.u32 = 0x60400010;
+    STORE(0x1800,1)->scalar.u32 = 0x185;
+    STORE(0x1800,2)->scalar.u8 = 2;
+    STORE(0x1A00,0)->scalar.u8 = 2;
+    STORE(0x1A00,1)->scalar.u32 = 0x60410010;
+    STORE(0x1A00,2)->scalar.u32 = 0x60640020;
+    STORE(0x1801,1)->scalar.u32 = 0x285;
+    STORE(0x1801,2)->scalar.u8 = 0xFF;
+    STORE(0x1801,3)->scalar.u16 = 10;
+    STORE(0x1801,5)->scalar.u16 = 5;
+    STORE(0x1A01,0)->scalar.u8 = 1;
+    STORE(0x1A01,1)->scalar.u32 = 0x60410010;
+    for( uint16_t i = 2; i < CANMAT_PDO_SLAVE_MAX; i++ ) {
+        const canmat_obj_t *obj = canmat_dict_search_index( &canmat_dict402, 0x1400 + i, 1 );
+        if( obj ) v[obj - canmat_dict402.obj].scalar.u32 = CANMAT_COBID_PDO_MASK_VALID;
+        obj = canmat_dict_search_index( &canmat_dict402, 0x1800 + i, 1 );
+        if( obj ) v[obj - canmat_dict402.obj].scalar.u32 = CANMAT_COBID_PDO_MASK_VALID;
+    }
+    STORE(0x1401,1)->scalar.u32 = CANMAT_COBID_PDO_MASK_VALID;
+    STORE(0x6041,0)->scalar.u16 = 0x237;
+    STORE(0x6064,0)->scalar.i32 = -2;
+
+    loop_head = loop_tail = 0;
+    assert( CANMAT_OK == canmat_pdo_slave_init( &p, 5, &canmat_dict402, v, loop_send, NULL ) );
+    assert( p.rpdo[0].valid && p.tpdo[0].valid && p.tpdo[1].valid && !p.rpdo[1].valid );
+    assert( 6 == p.tpdo[0].length && 2 == p.tpdo[0].entry[1].offset );
+
+    // RPDO
+    struct can_frame can = { .can_id = 0x205, .can_dlc = 2, .data = {0x0F, 0x00} };
+    assert( 1 == canmat_pdo_slave_frame( &p, &can, 0 ) );
+    assert( 0x0F == STORE(0x6040,0)->scalar.u16 );
+    can.can_id = 0x206;
+    assert( 0 == canmat_pdo_slave_frame( &p, &can, 0 ) );
+
+    // synchronous TPDO
+    struct can_frame sync = { .can_id = 0x80, .can_dlc = 0 };
+    assert( 1 == canmat_pdo_slave_frame( &p, &sync, 0 ) );
+    assert( loop_head == loop_tail );
+    assert( 1 == canmat_pdo_slave_frame( &p, &sync, 0 ) );
+    assert( 1 == loop_tail - loop_head );
+    can = loop_q[loop_head++ % 256];
+    assert( 0x185 == can.can_id && 6 == can.can_dlc );
+    assert( 0x237 == canmat_byte_ldle16( can.data ) && -2 == (int32_t)canmat_byte_ldle32( can.data+2 ) );
+
+    // change of state, inhibit time, event timer
+    int64_t ms = 1000000;
+    assert( CANMAT_OK == canmat_pdo_slave_step( &p, 0 ) );
+    assert( 1 == loop_tail - loop_head && 0x285 == loop_q[loop_head++ % 256].can_id );
+    STORE(0x6041,0)->scalar.u16 = 0x233;
+    assert( CANMAT_OK == canmat_pdo_slave_step( &p, ms/2 ) );
+    assert( loop_head == loop_tail );
+    assert( ms == canmat_pdo_slave_deadline( &p ) );
+    assert( CANMAT_OK == canmat_pdo_slave_step( &p, ms ) );
+    assert( 1 == loop_tail - loop_head );
+    assert( 0x233 == canmat_byte_ldle16( loop_q[loop_head++ % 256].data ) );
+    assert( 6*ms == canmat_pdo_slave_deadline( &p ) );
+    assert( CANMAT_OK == canmat_pdo_slave_step( &p, 6*ms ) );
+    assert( 1 == loop_tail - loop_head );
+    loop_head++;
+
+    // remap through the SDO server, other PDOs keep their state
+    struct canmat_sdo_client c;
+    s.written = canmat_pdo_slave_written;
+    s.written_cx = &p;
+    canmat_sdo_client_init( &c, 5, loop_send, NULL );
+    STORE(0x6041,0)->scalar.u16 = 0x237;
+    assert( CANMAT_OK == canmat_pdo_slave_step( &p, 6*ms + ms/2 ) );
+    assert( loop_head == loop_tail && p.tpdo[1].pending );
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x1400, 2, "\x01", 1, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) && CANMAT_OK == c.status );
+    can = (struct can_frame){ .can_id = 0x205, .can_dlc = 2, .data = {0x06, 0x00} };
+    assert( 1 == canmat_pdo_slave_frame( &p, &can, 6*ms + ms/2 ) );
+    assert( p.rpdo[0].latched && 0x0F == STORE(0x6040,0)->scalar.u16 );
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x1A00, 0, "\x01", 1, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) && CANMAT_OK == c.status );
+    assert( 2 == p.tpdo[0].length && p.rpdo[0].latched && p.tpdo[1].pending );
+    assert( 7*ms == canmat_pdo_slave_deadline( &p ) );
+    assert( CANMAT_OK == canmat_pdo_slave_step( &p, 7*ms - 1 ) );
+    assert( loop_head == loop_tail );
+    assert( CANMAT_OK == canmat_pdo_slave_step( &p, 7*ms ) );
+    assert( 1 == loop_tail - loop_head );
+    can = loop_q[loop_head++ % 256];
+    assert( 0x285 == can.can_id && 0x237 == canmat_byte_ldle16( can.data ) );
+    assert( 1 == canmat_pdo_slave_frame( &p, &sync, 7*ms ) );
+    assert( 0x06 == STORE(0x6040,0)->scalar.u16 && loop_head == loop_tail );
+
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x1A01, 0, "\x00", 1, 0, 0 ) );
+    assert( CANMAT_SDO_CLIENT_DONE == loop_run( &c, &s ) && CANMAT_OK == c.status );
+    assert( !p.tpdo[1].valid && p.tpdo[0].valid );
+
+    test_node_destroy( &s );
+#undef STORE
+}
+
+/* Interface whose driver stamps each sent frame 5ms later and hands
+ * the stamps over only when released; every third send fails */
+static struct timespec stamp_q[16];
+static size_t stamp_n, stamp_read, stamp_avail;
+static unsigned stamp_n_send;
+
+static canmat_status_t stamp_send( struct canmat_iface *cif, const struct can_frame *can ) {
+    (void)can;
+    if( 0 == ++stamp_n_send % 3 ) {
+        cif->err = ENOBUFS;
+        return CANMAT_ERR_OS;
+    }
+    assert( stamp_n < sizeof(stamp_q)/sizeof(stamp_q[0]) );
+    clock_gettime( CLOCK_REALTIME, &stamp_q[stamp_n] );
+    stamp_q[stamp_n].tv_nsec += 5000000;
+    if( stamp_q[stamp_n].tv_nsec >= 1000000000 ) {
+        stamp_q[stamp_n].tv_sec++;
+        stamp_q[stamp_n].tv_nsec -= 1000000000;
+    }
+    stamp_n++;
+    return CANMAT_OK;
+}
+
+static canmat_status_t stamp_enable( struct canmat_iface *cif ) {
+    (void)cif;
+    return CANMAT_OK;
+}
+
+static canmat_status_t stamp_get( struct canmat_iface *cif, struct timespec *ts ) {
+    (void)cif;
+    if( stamp_read == stamp_avail ) return CANMAT_ERR_UNDERFLOW;
+    *ts = stamp_q[stamp_read++];
+    return CANMAT_OK;
+}
+
+static struct canmat_iface_vtable stamp_vtable =
+    { .send = stamp_send, .tx_stamp_enable = stamp_enable, .tx_stamp = stamp_get };
+
+static void sync_producer(void) {
+    struct canmat_sync_producer p;
+    assert( CANMAT_ERR_PARAM == canmat_sync_producer_init( &p, &test_cif, 100000, 1 ) );
+    assert( CANMAT_OK == canmat_sync_producer_init( &p, &test_cif, 100000, 3 ) );
+    canmat_sync_producer_start( &p );
+    assert( !p.tx_stamp );
+    test_n_sent = 0;
+    for( int i = 0; i < 4; i++ ) {
+        assert( CANMAT_OK == canmat_sync_producer_step( &p ) );
+    }
+    assert( 4 == test_n_sent && 4 == p.sent && 4 == p.hist_send.count );
+    assert( 0x80 == test_sent[0].can_id && 1 == test_sent[0].can_dlc );
+    assert( 1 == test_sent[0].data[0] && 3 == test_sent[2].data[0] && 1 == test_sent[3].data[0] );
+
+    // 1005h must have the generate bit
+    struct canmat_sdo_value *v = (struct canmat_sdo_value*) calloc( canmat_dict402.length, sizeof(*v) );
+    struct canmat_sdo_value *cob = v + (canmat_dict_search_index( &canmat_dict402, 0x1005, 0 ) - canmat_dict402.obj);
+    cob->scalar.u32 = 0x81;
+    assert( CANMAT_ERR_PARAM == canmat_sync_producer_load( &p, &canmat_dict402, v ) );
+    cob->scalar.u32 = CANMAT_COBID_SYNC_MASK_GEN | 0x81;
+    assert( CANMAT_OK == canmat_sync_producer_load( &p, &canmat_dict402, v ) );
+    assert( 0x81 == p.cob_id );
+    free( v );
+
+    // stamps arrive in bursts and failed sends get none, yet each
+    // stamp is charged to its own SYNC
+    canmat_iface_t scif = { .vtable = &stamp_vtable };
+    assert( CANMAT_OK == canmat_sync_producer_init( &p, &scif, 1000000, 0 ) );
+    canmat_sync_producer_start( &p );
+    assert( p.tx_stamp );
+    for( int i = 0; i < 10; i++ ) {
+        canmat_status_t r = canmat_sync_producer_step( &p );
+        assert( (2 == i % 3) ? CANMAT_ERR_OS == r : CANMAT_OK == r );
+        if( 2 == i % 3 ) stamp_avail = stamp_n;
+    }
+    stamp_avail = stamp_n;
+    assert( CANMAT_OK == canmat_sync_producer_step( &p ) );
+    assert( 8 == p.sent && 7 == p.hist_tx.count && 1 == p.stamp_n );
+    assert( p.hist_tx.min >= 5000000 );
+}
+
+static uint8_t nmt_node[8];
+static enum canmat_nmt_event nmt_event[8];
+static size_t nmt_n;
+
+static void test_nmt_fun( void *cx, uint8_t node, enum canmat_nmt_event event, uint8_t state ) {
+    (void)cx; (void)state;
+    nmt_node[nmt_n] = node;
+    nmt_event[nmt_n++] = event;
+}
+
+static void nmt_master(void) {
+    struct canmat_nmt_master m;
+    int64_t ms = 1000000;
+    canmat_nmt_master_init( &m, ms, 0, test_nmt_fun, NULL );
+    assert( CANMAT_OK == canmat_nmt_master_consumer( &m, 3, 100 ) );
+    assert( CANMAT_OK == canmat_nmt_master_consumer( &m, 4, 500 ) );
+    assert( CANMAT_ERR_PARAM == canmat_nmt_master_consumer( &m, 0, 100 ) );
+    assert( CANMAT_NMT_STATE_UNKNOWN == canmat_nmt_master_state( &m, 3 ) );
+
+    struct can_frame can = { .can_id = 0x703, .can_dlc = 1, .data = {CANMAT_NMT_ERR_BOOT} };
+    assert( 1 == canmat_nmt_master_frame( &m, &can, 0 ) );
+    can.data[0] = CANMAT_NMT_ERR_PRE_OP;
+    assert( 1 == canmat_nmt_master_frame( &m, &can, 10*ms + 1 ) );
+    assert( 1 == canmat_nmt_master_frame( &m, &can, 20*ms ) );
+    can.can_id = 0x704;
+    assert( 1 == canmat_nmt_master_frame( &m, &can, 20*ms ) );
+    can.can_id = 0x183;
+    assert( 0 == canmat_nmt_master_frame( &m, &can, 20*ms ) );
+    assert( 3 == nmt_n && 3 == nmt_node[0] && CANMAT_NMT_EVENT_BOOT == nmt_event[0] );
+    assert( CANMAT_NMT_EVENT_STATE == nmt_event[1] && 4 == nmt_node[2] );
+    assert( CANMAT_NMT_ERR_PRE_OP == canmat_nmt_master_state( &m, 3 ) );
+
+    // node 3 is due at 120ms, node 4 at 520ms, a later turn of the wheel
+    canmat_nmt_master_tick( &m, 119*ms );
+    assert( 3 == nmt_n );
+    canmat_nmt_master_tick( &m, 121*ms );
+    assert( 4 == nmt_n && 3 == nmt_node[3] && CANMAT_NMT_EVENT_TIMEOUT == nmt_event[3] );
+    canmat_nmt_master_tick( &m, 519*ms );
+    assert( 4 == nmt_n );
+    canmat_nmt_master_tick( &m, 600*ms );
+    assert( 5 == nmt_n && 4 == nmt_node[4] && CANMAT_NMT_EVENT_TIMEOUT == nmt_event[4] );
+
+    can.can_id = 0x703;
+    assert( 1 == canmat_nmt_master_frame( &m, &can, 700*ms ) );
+    assert( 6 == nmt_n && CANMAT_NMT_EVENT_RESUMED == nmt_event[5] );
+    canmat_nmt_master_tick( &m, 799*ms );
+    assert( 6 == nmt_n );
+}
+
+static size_t emcy_n;
+static void test_emcy_fun( void *cx, uint8_t node, const struct canmat_emcy_entry *entry ) {
+    (void)cx;
+    assert( 2 == node && canmat_emcy_class_match( CANMAT_EMCY_CODE_CURRENT, entry->code ) );
+    emcy_n++;
+}
+
+static void emcy(void) {
+    static struct canmat_emcy e;
+    struct canmat_emcy_entry out[CANMAT_EMCY_HIST];
+    canmat_emcy_init( &e );
+
+    assert( canmat_emcy_class_match( CANMAT_EMCY_CODE_CURRENT, 0x2310 ) );
+    assert( canmat_emcy_class_match( CANMAT_EMCY_CODE_CURRENT_OUTPUT, 0x2310 ) );
+    assert( !canmat_emcy_class_match( CANMAT_EMCY_CODE_CURRENT_INPUT, 0x2310 ) );
+    assert( canmat_emcy_class_match( CANMAT_EMCY_CODE_CLASS_NO_ERROR, 0x0000 ) );
+
+    int h = canmat_emcy_subscribe( &e, 0, CANMAT_EMCY_CODE_CURRENT, test_emcy_fun, NULL );
+    assert( h >= 0 );
+
+    // through the dispatcher's recv hook
+    struct canmat_dispatch d;
+    canmat_dispatch_init( &d, &test_cif );
+    d.recv = canmat_emcy_recv;
+    d.recv_cx = &e;
+    struct can_frame can = { .can_id = CANMAT_EMCY_COBID(2), .can_dlc = 8,
+                             .data = {0x10, 0x23, 0x03, 1, 2, 3, 4, 5} };
+    assert( 0 == canmat_dispatch_frame( &d, &can ) );
+    assert( 1 == emcy_n );
+
+    uint64_t seq = 0;
+    assert( 1 == canmat_emcy_read( &e, 2, &seq, out, CANMAT_EMCY_HIST ) && 1 == seq );
+    assert( 0x2310 == out[0].code && 0x03 == out[0].reg && 5 == out[0].msef[4] );
+
+    // the ring keeps the newest messages
+    for( uint16_t i = 0; i < 20; i++ ) {
+        canmat_byte_stle16( can.data, (uint16_t)(0x3000 + i) );
+        assert( 1 == canmat_emcy_frame( &e, &can, i ) );
+    }
+    assert( 1 == emcy_n );
+    assert( CANMAT_EMCY_HIST == canmat_emcy_read( &e, 2, &seq, out, CANMAT_EMCY_HIST ) );
+    assert( 21 == seq && 0x3000 + 20 - CANMAT_EMCY_HIST == out[0].code && 0x3013 == out[CANMAT_EMCY_HIST-1].code );
+    assert( 0 == canmat_emcy_read( &e, 2, &seq, out, CANMAT_EMCY_HIST ) );
+
+    // SYNC is not EMCY
+    struct can_frame sync = { .can_id = 0x80, .can_dlc = 0 };
+    assert( 0 == canmat_emcy_frame( &e, &sync, 0 ) );
+    canmat_emcy_unsubscribe( &e, h );
+    canmat_byte_stle16( can.data, 0x2310 );
+    canmat_emcy_frame( &e, &can, 0 );
+    assert( 1 == emcy_n );
+}
+
+/* LSS slave for fast scan and node-ID, CiA 305 */
+struct test_lss_slave {
+    uint32_t id[4];
+    uint8_t pos;
+    uint8_t node;
+    int config;
+};
+
+static int test_lss_slave_frame( struct test_lss_slave *sl, const struct can_frame *can, struct can_frame *resp ) {
+    memset( resp, 0, sizeof(*resp) );
+    resp->can_id = CANMAT_LSS_SLAVE_ID;
+    resp->can_dlc = 8;
+    switch( can->data[0] ) {
+    case CANMAT_LSS_SWITCH_GLOBAL:
+        sl->config = can->data[1];
+        return 0;
+    case CANMAT_LSS_CONFIG_NODE_ID:
+        if( !sl->config ) return 0;
+        sl->node = can->data[1];
+        resp->data[0] = CANMAT_LSS_CONFIG_NODE_ID;
+        return 1;
+    case CANMAT_LSS_INQUIRE_SERIAL:
+        if( !sl->config ) return 0;
+        resp->data[0] = CANMAT_LSS_INQUIRE_SERIAL;
+        canmat_byte_stle32( resp->data+1, sl->id[3] );
+        return 1;
+    case CANMAT_LSS_FASTSCAN: {
+        uint32_t idn = canmat_byte_ldle32( can->data+1 );
+        uint8_t bit = can->data[5], sub = can->data[6], next = can->data[7];
+        if( sl->config || CANMAT_LSS_NODE_UNCONFIGURED != sl->node ) return 0;
+        resp->data[0] = CANMAT_LSS_IDENTIFY_SLAVE;
+        if( 0x80 == bit ) {
+            sl->pos = 0;
+            return 1;
+        }
+        if( sub != sl->pos || ((sl->id[sub] ^ idn) >> bit) ) return 0;
+        sl->pos = next;
+        if( 0 == bit && next < sub ) sl->config = 1;
+        return 1;
+    }
+    }
+    return 0;
+}
+
+/* Run the LSS master against slaves until it is done, counting frames.
+ * Slave i answers a request i * spread ns after it, in its own frame. */
+static size_t test_lss_run( struct canmat_lss_master *m, struct test_lss_slave *sl, size_t n,
+                            int64_t spread ) {
+    struct { struct can_frame can; int64_t at; } pend[16];
+    size_t n_pend = 0, frames = 0;
+    int64_t now = 0;
+    for(;;) {
+        while( loop_head != loop_tail ) {
+            struct can_frame can = loop_q[loop_head++ % 256], r;
+            frames++;
+            for( size_t i = 0; i < n; i++ ) {
+                if( test_lss_slave_frame( &sl[i], &can, &r ) ) {
+                    assert( n_pend < sizeof(pend)/sizeof(pend[0]) );
+                    pend[n_pend].can = r;
+                    pend[n_pend++].at = now + (int64_t)i * spread;
+                }
+            }
+        }
+        int idle = CANMAT_LSS_MASTER_IDLE == m->state;
+        if( idle && 0 == n_pend ) return frames;
+
+        // the next answer, unless the master's deadline comes first
+        size_t k = 0;
+        for( size_t i = 1; i < n_pend; i++ ) if( pend[i].at < pend[k].at ) k = i;
+        if( n_pend && (idle || pend[k].at < canmat_lss_master_deadline( m )) ) {
+            struct can_frame can = pend[k].can;
+            if( pend[k].at > now ) now = pend[k].at;
+            pend[k] = pend[--n_pend];
+            frames++;
+            canmat_lss_master_frame( m, &can, now );
+        } else {
+            now = canmat_lss_master_deadline( m );
+            canmat_lss_master_timeout( m, now );
+        }
+    }
+}
+
+static void lss(void) {
+    struct test_lss_slave sl[2] = {
+        { .id = {0x0000029A, 0x00030001, 0x00010000, 0x12345678}, .node = CANMAT_LSS_NODE_UNCONFIGURED },
+        { .id = {0x0000029A, 0x00030001, 0x00010000, 0x12345600}, .node = CANMAT_LSS_NODE_UNCONFIGURED } };
+    struct canmat_lss_master m;
+    canmat_lss_master_init( &m, loop_send, NULL );
+    loop_head = loop_tail = 0;
+
+    assert( 3 == canmat_lss_bit_timing_index( 250 ) && -1 == canmat_lss_bit_timing_index( 0 ) );
+
+    // the lower serial number is found first, though both slaves
+    // answer most queries, the second one late in the window
+    int64_t spread = m.timeout_ns / 2;
+    assert( CANMAT_OK == canmat_lss_master_fastscan( &m, 0 ) );
+    size_t frames = test_lss_run( &m, sl, 2, spread );
+    assert( CANMAT_OK == m.status && 0 == memcmp( m.identity, sl[1].id, sizeof(m.identity) ) );
+    assert( frames <= 3 * 133 && sl[1].config && !sl[0].config );
+
+    assert( CANMAT_OK == canmat_lss_master_inquire( &m, CANMAT_LSS_INQUIRE_SERIAL, 0 ) );
+    test_lss_run( &m, sl, 2, spread );
+    assert( CANMAT_OK == m.status && 0x12345600 == m.value );
+    assert( CANMAT_OK == canmat_lss_master_node_id( &m, 5, 0 ) );
+    test_lss_run( &m, sl, 2, spread );
+    assert( CANMAT_OK == m.status && 5 == sl[1].node );
+    assert( CANMAT_OK == canmat_lss_master_switch_global( &m, CANMAT_LSS_MODE_WAITING ) );
+
+    assert( CANMAT_OK == canmat_lss_master_fastscan( &m, 0 ) );
+    test_lss_run( &m, sl, 2, spread );
+    assert( CANMAT_OK == m.status && 0 == memcmp( m.identity, sl[0].id, sizeof(m.identity) ) );
+    assert( CANMAT_OK == canmat_lss_master_node_id( &m, 6, 0 ) );
+    test_lss_run( &m, sl, 2, spread );
+    assert( CANMAT_OK == canmat_lss_master_switch_global( &m, CANMAT_LSS_MODE_WAITING ) );
+
+    // nothing left
+    assert( CANMAT_OK == canmat_lss_master_fastscan( &m, 0 ) );
+    assert( 2 == test_lss_run( &m, sl, 2, spread ) );
+    assert( CANMAT_ERR_TIMEOUT == m.status );
+}
+
+static int loop_snapshot( void *cx, const struct can_frame *can, int64_t now ) {
+    return canmat_snapshot_job_frame( (struct canmat_snapshot_job*)cx, can, now );
+}
+
+static void test_snapshot_map( struct canmat_sdo_server *s, uint8_t n, uint32_t map1, uint32_t map2 ) {
+    canmat_sdo_server_value( s, canmat_dict_search_index( &canmat_dict402, 0x1600, 0 ) )->scalar.u8 = n;
+    canmat_sdo_server_value( s, canmat_dict_search_index( &canmat_dict402, 0x1600, 1 ) )->scalar.u32 = map1;
+    canmat_sdo_server_value( s, canmat_dict_search_index( &canmat_dict402, 0x1600, 2 ) )->scalar.u32 = map2;
+}
+
+/* Wraps a client side for a node that, like CiA 301 devices, refuses
+ * to change a valid PDO other than by setting bit 31 of its COB-ID */
+struct test_strict {
+    loop_client_fun *client;
+    void *cx;
+    struct canmat_sdo_server *s;
+    size_t n_refused;
+};
+
+static int loop_strict( void *cx, const struct can_frame *can, int64_t now ) {
+    struct test_strict *t = (struct test_strict*)cx;
+    if( t->client( t->cx, can, now ) ) return 1;
+    // expedited initiate download
+    if( CANMAT_SDO_REQ_ID( t->s->node ) != can->can_id || 1 != can->data[0] >> 5 ) return 0;
+    uint16_t index = canmat_byte_ldle16( can->data+1 );
+    uint16_t comm = 0;
+    if( (index >= 0x1400 && index <= 0x15FF) || (index >= 0x1800 && index <= 0x19FF) ) comm = index;
+    else if( (index >= 0x1600 && index <= 0x17FF) || (index >= 0x1A00 && index <= 0x1BFF) ) comm = (uint16_t)(index - 0x200);
+    if( !comm ) return 0;
+    const canmat_obj_t *ocob = canmat_dict_search_index( t->s->dict, comm, 1 );
+    uint32_t cob = canmat_sdo_server_value( t->s, ocob )->scalar.u32;
+    if( cob & CANMAT_COBID_PDO_MASK_VALID ) return 0;
+    if( comm == index && 1 == can->data[3] &&
+        0 == ((canmat_byte_ldle32( can->data+4 ) ^ cob) & ~(uint32_t)CANMAT_COBID_PDO_MASK_VALID) ) {
+        return 0;
+    }
+    struct can_frame refuse = { .can_id = CANMAT_SDO_RESP_ID( t->s->node ), .can_dlc = 8,
+                                .data = { 0x80, can->data[1], can->data[2], can->data[3] } };
+    canmat_byte_stle32( refuse.data+4, CANMAT_ABORT_STORE_DEV_STATE );
+    loop_send( NULL, &refuse );
+    t->n_refused++;
+    return 1;
+}
+
+static void snapshot(void) {
+    struct canmat_sdo_server s1, s2;
+    char name[] = "socanmatic test";
+    struct canmat_snapshot snap, copy;
+    struct canmat_snapshot_job j;
+    loop_head = loop_tail = 0;
+
+    test_node_init( &s1, 5, &canmat_dict402 );
+    test_node_init( &s2, 6, &canmat_dict402 );
+    struct canmat_sdo_value *vname = canmat_sdo_server_value( &s1, CANMAT_402_OBJ_MANUFACTURER_DEVICE_NAME );
+    vname->data = (uint8_t*)name;
+    vname->size = strlen(name);
+    canmat_sdo_server_value( &s1, CANMAT_402_OBJ_CONTROLWORD )->scalar.u16 = 0x0f;
+    test_snapshot_map( &s1, 2, 0x60400010, 0x607A0020 );
+    test_snapshot_map( &s2, 1, 0x60410010, 0 );
+    const canmat_obj_t *ocob = canmat_dict_search_index( &canmat_dict402, 0x1400, 1 );
+    canmat_sdo_server_value( &s1, ocob )->scalar.u32 = 0x205;
+    canmat_sdo_server_value( &s2, ocob )->scalar.u32 = 0x206;
+
+    // read, segmented where needed
+    canmat_snapshot_init( &snap, 5 );
+    canmat_snapshot_job_init( &j, 5, loop_send, NULL );
+    assert( CANMAT_OK == canmat_snapshot_job_read( &j, &canmat_dict402, &snap, 0 ) );
+    loop_drain( loop_snapshot, &j, &s1, 1, 0 );
+    assert( !canmat_snapshot_job_busy( &j ) && CANMAT_OK == j.status && 0 == j.n_failed );
+    assert( snap.n > 100 );
+    int found = 0;
+    for( size_t i = 0; i < snap.n; i++ ) {
+        const struct canmat_snapshot_entry *e = &snap.entry[i];
+        if( 0x1008 == e->index ) {
+            assert( strlen(name) == e->length && 0 == memcmp( name, canmat_snapshot_data( &snap, e ), e->length ) );
+            found++;
+        } else if( 0x6040 == e->index ) {
+            assert( 2 == e->length && 0x0f == canmat_byte_ldle16( canmat_snapshot_data( &snap, e ) ) );
+            found++;
+        }
+    }
+    assert( 2 == found );
+
+    // file round trip
+    FILE *f = tmpfile();
+    assert( CANMAT_OK == canmat_snapshot_write( f, &snap ) );
+    rewind( f );
+    canmat_snapshot_init( &copy, 0 );
+    assert( CANMAT_OK == canmat_snapshot_read( f, &copy ) );
+    assert( 5 == copy.node && snap.n == copy.n && snap.size == copy.size );
+    assert( 0 == memcmp( snap.data, copy.data, snap.size ) );
+    assert( CANMAT_ERR_UNDERFLOW == canmat_snapshot_read( f, &copy ) );
+    fclose( f );
+
+    // the node refuses changes to a valid PDO
+    struct canmat_sdo_client c;
+    struct loop_client l = { &c, CANMAT_SDO_CLIENT_PENDING };
+    struct test_strict strict = { loop_client_frame, &l, &s2, 0 };
+    canmat_sdo_client_init( &c, 6, loop_send, NULL );
+    assert( CANMAT_OK == canmat_sdo_client_dl( &c, 0x1600, 0, "\x00", 1, 0, 0 ) );
+    loop_drain( loop_strict, &strict, &s2, 1, 0 );
+    assert( CANMAT_ERR_ABORT == c.status && CANMAT_ABORT_STORE_DEV_STATE == c.abort );
+    assert( 1 == strict.n_refused );
+
+    // restore to another node, making the PDO invalid and clearing the
+    // mapping while it changes
+    canmat_snapshot_job_init( &j, 6, loop_send, NULL );
+    strict = (struct test_strict){ loop_snapshot, &j, &s2, 0 };
+    assert( CANMAT_OK == canmat_snapshot_job_restore( &j, &canmat_dict402, &copy, 0 ) );
+    loop_drain( loop_strict, &strict, &s2, 1, 0 );
+    assert( !canmat_snapshot_job_busy( &j ) && CANMAT_OK == j.status );
+    assert( 0 == strict.n_refused );
+    assert( 5 == j.n_written && 0 == j.n_failed && j.n_same > 100 );
+    assert( 0x205 == canmat_sdo_server_value( &s2, ocob )->scalar.u32 );
+    assert( 0x0f == canmat_sdo_server_value( &s2, CANMAT_402_OBJ_CONTROLWORD )->scalar.u16 );
+    assert( 2 == canmat_sdo_server_value( &s2, canmat_dict_search_index( &canmat_dict402, 0x1600, 0 ) )->scalar.u8 );
+    assert( 0x607A0020 == canmat_sdo_server_value( &s2, canmat_dict_search_index( &canmat_dict402, 0x1600, 2 ) )->scalar.u32 );
+
+    // nothing left to write
+    assert( CANMAT_OK == canmat_snapshot_job_restore( &j, &canmat_dict402, &copy, 0 ) );
+    loop_drain( loop_snapshot, &j, &s2, 1, 0 );
+    assert( CANMAT_OK == j.status && 0 == j.n_written );
+
+    // absent node
+    canmat_snapshot_job_init( &j, 7, loop_send, NULL );
+    canmat_snapshot_destroy( &snap );
+    assert( CANMAT_OK == canmat_snapshot_job_read( &j, &canmat_dict402, &snap, 0 ) );
+    loop_drain( loop_snapshot, &j, &s1, 1, 0 );
+    assert( canmat_snapshot_job_busy( &j ) );
+    canmat_snapshot_job_timeout( &j, CANMAT_SDO_CLIENT_TIMEOUT_NS );
+    assert( !canmat_snapshot_job_busy( &j ) && CANMAT_ERR_TIMEOUT == j.status && 0 == snap.n );
+    loop_head = loop_tail;
+
+    canmat_snapshot_destroy( &snap );
+    canmat_snapshot_destroy( &copy );
+    test_node_destroy( &s1 );
+    test_node_destroy( &s2 );
+}
+
+static void cdcf(void) {
+    struct canmat_cdcf c;
+    canmat_cdcf_init( &c );
+
+    canmat_scalar_t cw = { .u16 = 0x0f };
+    assert( CANMAT_OK == canmat_cdcf_add_obj( &c, CANMAT_402_OBJ_CONTROLWORD, &cw ) );
+    assert( 13 == c.size && 1 == c.n );
+    assert( 0 == memcmp( c.data, "\x01\0\0\0" "\x40\x60\0" "\x02\0\0\0" "\x0f\0", 13 ) );
+    assert( CANMAT_ERR_PARAM == canmat_cdcf_add_obj( &c, CANMAT_402_OBJ_MANUFACTURER_DEVICE_NAME, &cw ) );
+    canmat_cdcf_destroy( &c );
+
+    char dcf[] = "/tmp/test_sdo_XXXXXX";
+    int fd = mkstemp( dcf );
+    assert( fd >= 0 );
+    FILE *fp = fdopen( fd, "w" );
+    fputs( "[1008]\nParameterValue=read only\n"
+           "[1400sub1]\nParameterValue=$NODEID+0x200\n"
+           "[1400sub2]\nParameterValue=0xfe\n"
+           "[1600sub1]\nParameterValue=0x60400010\n"
+           "[1600sub0]\nParameterValue=1\n"
+           "[6040]\nParameterValue=0x0f\n"
+           "[6403]\nParameterValue=catalog\n", fp );
+    fclose( fp );
+    const char *files[] = {dcf};
+    struct canmat_eds_error err;
+    assert( CANMAT_OK == canmat_cdcf_load_dcf( &c, 1, files, &canmat_dict402, 5, &err ) );
+    unlink( dcf );
+
+    // PDO invalid while its mapping is cleared and rewritten, read-only skipped
+    assert( 8 == c.n && 8 == canmat_byte_ldle32( c.data ) );
+    const struct { uint16_t index; uint8_t subindex; uint32_t size; uint32_t val; } want[] = {
+        {0x1400, 1, 4, 0x80000205}, {0x1400, 2, 1, 0xfe}, {0x1600, 0, 1, 0},
+        {0x1600, 1, 4, 0x60400010}, {0x1600, 0, 1, 1}, {0x1400, 1, 4, 0x205},
+        {0x6040, 0, 2, 0x0f}, {0x6403, 0, 7, 0} };
+    const uint8_t *e = c.data + 4;
+    for( size_t i = 0; i < sizeof(want)/sizeof(want[0]); i++ ) {
+        assert( want[i].index == canmat_byte_ldle16( e ) && want[i].subindex == e[2] );
+        uint32_t size = canmat_byte_ldle32( e+3 );
+        assert( want[i].size == size );
+        if( 1 == size ) assert( want[i].val == e[7] );
+        else if( 2 == size ) assert( want[i].val == canmat_byte_ldle16( e+7 ) );
+        else if( 4 == size ) assert( want[i].val == canmat_byte_ldle32( e+7 ) );
+        else assert( 0 == memcmp( e+7, "catalog", size ) );
+        e += 7 + size;
+    }
+    assert( e == c.data + c.size );
+
+    // block download to a node's 1F22h
+    struct canmat_dict *dict = test_dict_load(
+           "[1f22]\nParameterName=Concise DCF\nObjectType=ARRAY\nDataType=DOMAIN\n"
+           "[1f22sub5]\nParameterName=Concise DCF/Node 5\nDataType=DOMAIN\nAccessType=RW\n" );
+    struct canmat_sdo_server s;
+    test_node_init( &s, 5, dict );
+    uint8_t stored[256];
+    struct canmat_sdo_value *v =
+        canmat_sdo_server_value( &s, canmat_dict_search_index( dict, CANMAT_CDCF_INDEX, 5 ) );
+    v->data = stored;
+    v->capacity = sizeof(stored);
+    canmat_iface_t cif;
+    pipe_open( &cif, &s, 1 );
+    uint32_t abort = 0;
+    assert( CANMAT_OK == canmat_cdcf_dl( &cif, 5, CANMAT_CDCF_INDEX, 5, &c, &abort ) );
+    assert( c.size == v->size && 0 == memcmp( c.data, stored, c.size ) );
+
+    // node has no room for it
+    v->capacity = c.size - 1;
+    assert( CANMAT_ERR_ABORT == canmat_cdcf_dl( &cif, 5, CANMAT_CDCF_INDEX, 5, &c, &abort ) );
+    assert( 0 != abort );
+    pipe_close( &cif );
+    test_node_destroy( &s );
+    free( dict );
+    canmat_cdcf_destroy( &c );
+
+    // bad values
+    fd = mkstemp( strcpy( dcf, "/tmp/test_sdo_XXXXXX" ) );
+    fp = fdopen( fd, "w" );
+    fputs( "[6040]\nParameterValue=0x0f\n\n[6060]\nParameterValue=0x1000\n", fp );
+    fclose( fp );
+    assert( CANMAT_ERR_PARAM == canmat_cdcf_load_dcf( &c, 1, files, &canmat_dict402, 5, &err ) );
+    assert( 5 == err.line );
+    unlink( dcf );
+    canmat_cdcf_destroy( &c );
+}
+
+static int loop_fanout( void *cx, const struct can_frame *can, int64_t now ) {
+    return canmat_fanout_frame( (struct canmat_fanout*)cx, can, now );
+}
+
+static void fanout(void) {
+    struct canmat_sdo_server s[3];
+    uint8_t catalog[2][32];
+    const char *msg = "catalog 0123456789";
+    loop_head = loop_tail = 0;
+    for( size_t i = 0; i < 3; i++ ) {
+        test_node_init( &s[i], (uint8_t)(5+i), &canmat_dict402 );
+        // the last node has a read-only catalog number
+        if( i < 2 ) {
+            const canmat_obj_t *ocat = canmat_dict_search_index( &canmat_dict402, 0x6403, 0 );
+            canmat_sdo_server_value( &s[i], ocat )->data = catalog[i];
+            canmat_sdo_server_value( &s[i], ocat )->capacity = sizeof(catalog[i]);
+        }
+    }
+
+    struct canmat_cdcf c;
+    canmat_cdcf_init( &c );
+    canmat_scalar_t cw = { .u16 = 0x0f }, mode = { .i8 = 3 };
+    assert( CANMAT_OK == canmat_cdcf_add_obj( &c, CANMAT_402_OBJ_CONTROLWORD, &cw ) );
+    assert( CANMAT_OK == canmat_cdcf_add( &c, 0x6403, 0, msg, strlen(msg) ) );
+    assert( CANMAT_OK == canmat_cdcf_add_obj( &c, CANMAT_402_OBJ_MODES_OF_OPERATION, &mode ) );
+
+    struct canmat_fanout f;
+    struct canmat_fanout_node n[3];
+    canmat_fanout_init( &f, n, 3, loop_send, NULL );
+    for( size_t i = 0; i < 3; i++ ) canmat_fanout_node_set( &f, i, (uint8_t)(5+i), &c );
+
+    // one request in flight per node
+    canmat_fanout_start( &f, 0 );
+    assert( 3 == loop_tail - loop_head && 3 == canmat_fanout_busy( &f ) );
+    assert( CANMAT_SDO_CLIENT_TIMEOUT_NS == canmat_fanout_deadline( &f ) );
+    loop_drain( loop_fanout, &f, s, 3, 1000 );
+    assert( 0 == canmat_fanout_busy( &f ) && INT64_MAX == canmat_fanout_deadline( &f ) );
+    for( size_t i = 0; i < 2; i++ ) {
+        assert( CANMAT_OK == n[i].status && 3 == n[i].written );
+        assert( 0x0f == canmat_sdo_server_value( &s[i], CANMAT_402_OBJ_CONTROLWORD )->scalar.u16 );
+        assert( 3 == canmat_sdo_server_value( &s[i], CANMAT_402_OBJ_MODES_OF_OPERATION )->scalar.i8 );
+        assert( 0 == memcmp( catalog[i], msg, strlen(msg) ) );
+    }
+    assert( CANMAT_ERR_ABORT == n[2].status && 1 == n[2].written );
+    assert( CANMAT_ABORT_READ_ONLY == n[2].abort && 0x6403 == n[2].client.index );
+
+    // segmented catalog number is 4 frames each way, the rest 1
+    assert( 2*(2*(1+4+1) + 1+1) == f.frames );
+    assert( 1000 == f.end && f.bits > f.frames * 100 );
+    // 1000 ns at 1 Mbit/s is 1 bit
+    double load = canmat_fanout_load( &f, 1000 );
+    assert( (uint64_t)(load + 0.5) == f.bits );
+
+    canmat_cdcf_destroy( &c );
+    for( size_t i = 0; i < 3; i++ ) test_node_destroy( &s[i] );
+}
+
+static int loop_flash( void *cx, const struct can_frame *can, int64_t now ) {
+    return canmat_flash_frame( (struct canmat_flash*)cx, can, now );
+}
+
+/* Program control commands the simulated node received */
+static uint8_t test_ctl[8];
+static size_t test_n_ctl;
+static void test_ctl_written( void *cx, const canmat_obj_t *obj, struct canmat_sdo_value *val ) {
+    (void)cx;
+    if( CANMAT_FLASH_CONTROL == obj->index ) test_ctl[test_n_ctl++] = val->scalar.u8;
+}
+
+static void flash(void) {
+    struct canmat_dict *dict = test_dict_load(
+           "[1f50]\nParameterName=Program data\nObjectType=ARRAY\nDataType=DOMAIN\n"
+           "[1f50sub1]\nParameterName=Program data/Program 1\nDataType=DOMAIN\nAccessType=RW\n"
+           "[1f51]\nParameterName=Program control\nObjectType=ARRAY\nDataType=UNSIGNED8\n"
+           "[1f51sub1]\nParameterName=Program control/Program 1\nDataType=UNSIGNED8\nAccessType=RW\n"
+           "[1f57]\nParameterName=Flash status\nObjectType=ARRAY\nDataType=UNSIGNED32\n"
+           "[1f57sub1]\nParameterName=Flash status/Program 1\nDataType=UNSIGNED32\nAccessType=RO\n" );
+
+    struct canmat_sdo_server s;
+    test_node_init( &s, 5, dict );
+    s.written = test_ctl_written;
+    uint8_t image[1000], program[sizeof(image)];
+    for( size_t i = 0; i < sizeof(image); i++ ) image[i] = (uint8_t)(i * 7);
+    struct canmat_sdo_value *vdata =
+        canmat_sdo_server_value( &s, canmat_dict_search_index( dict, CANMAT_FLASH_DATA, 1 ) );
+    vdata->data = program;
+    vdata->capacity = sizeof(program);
+    struct canmat_sdo_value *vstatus =
+        canmat_sdo_server_value( &s, canmat_dict_search_index( dict, CANMAT_FLASH_STATUS, 1 ) );
+
+    // stop, clear, download over two blocks, start
+    struct canmat_flash f;
+    test_n_ctl = 0;
+    loop_head = loop_tail = 0;
+    canmat_flash_init( &f, 5, 1, loop_send, NULL );
+    assert( CANMAT_OK == canmat_flash_start( &f, image, sizeof(image), 100 ) );
+    assert( canmat_flash_busy( &f ) && 0 == canmat_flash_sent( &f ) );
+    assert( CANMAT_ERR_PARAM == canmat_flash_start( &f, image, sizeof(image), 100 ) );
+    loop_drain( loop_flash, &f, &s, 1, 200 );
+    assert( !canmat_flash_busy( &f ) && CANMAT_OK == f.status );
+    assert( 3 == test_n_ctl && 0 == test_ctl[0] && 3 == test_ctl[1] && 1 == test_ctl[2] );
+    assert( sizeof(image) == vdata->size && 0 == memcmp( image, program, sizeof(image) ) );
+    assert( sizeof(image) == canmat_flash_sent( &f ) );
+    assert( 100 == f.start && 200 == f.download_start && 200 == f.download_end && 200 == f.end );
+
+    // node programs for a while
+    vstatus->scalar.u32 = CANMAT_FLASH_STATUS_BUSY;
+    test_n_ctl = 0;
+    assert( CANMAT_OK == canmat_flash_start( &f, image, 10, 0 ) );
+    loop_drain( loop_flash, &f, &s, 1, 0 );
+    assert( CANMAT_FLASH_WAIT == f.state && CANMAT_FLASH_POLL_NS == canmat_flash_deadline( &f ) );
+    canmat_flash_timeout( &f, 1 );
+    assert( loop_head == loop_tail );
+    vstatus->scalar.u32 = 0;
+    canmat_flash_timeout( &f, CANMAT_FLASH_POLL_NS );
+    loop_drain( loop_flash, &f, &s, 1, CANMAT_FLASH_POLL_NS );
+    assert( CANMAT_OK == f.status && 3 == test_n_ctl && 1 == test_ctl[2] );
+
+    // programming failed, not started
+    vstatus->scalar.u32 = 5 << 1;
+    test_n_ctl = 0;
+    assert( CANMAT_OK == canmat_flash_start( &f, image, 10, 0 ) );
+    loop_drain( loop_flash, &f, &s, 1, 0 );
+    assert( CANMAT_ERR_DEV == f.status && 5 == CANMAT_FLASH_STATUS_ERROR( f.flash_status ) );
+    assert( 2 == test_n_ctl );
+
+    // image larger than the program
+    vstatus->scalar.u32 = 0;
+    test_n_ctl = 0;
+    vdata->capacity = 10;
+    assert( CANMAT_OK == canmat_flash_start( &f, image, sizeof(image), 0 ) );
+    loop_drain( loop_flash, &f, &s, 1, 0 );
+    assert( CANMAT_ERR_ABORT == f.status && 0 != f.abort && 0 == canmat_flash_sent( &f ) );
+
+    // two nodes at once through a transmit queue that keeps filling
+    struct canmat_sdo_server s2[2];
+    struct canmat_flash f2[2];
+    uint8_t program2[2][sizeof(image)];
+    int64_t now = canmat_now_ns();
+    for( size_t i = 0; i < 2; i++ ) {
+        test_node_init( &s2[i], (uint8_t)(6 + i), dict );
+        struct canmat_sdo_value *v =
+            canmat_sdo_server_value( &s2[i], canmat_dict_search_index( dict, CANMAT_FLASH_DATA, 1 ) );
+        v->data = program2[i];
+        v->capacity = sizeof(program2[i]);
+        canmat_flash_init( &f2[i], (uint8_t)(6 + i), 1, canmat_flash_queue, &f2[i] );
+    }
+    canmat_iface_t cif;
+    pipe_open( &cif, s2, 2 );
+    pipe_refuse = 7;
+    for( size_t i = 0; i < 2; i++ ) {
+        assert( CANMAT_OK == canmat_flash_start( &f2[i], image, sizeof(image), now ) );
+        assert( 1 == f2[i].tx_n );
+    }
+    assert( CANMAT_OK == canmat_flash_run( &cif, f2, 2, NULL, NULL ) );
+    assert( pipe_n_refused > 0 );
+    for( size_t i = 0; i < 2; i++ ) {
+        assert( CANMAT_OK == f2[i].status && 0 == f2[i].tx_n );
+        assert( 0 == memcmp( image, program2[i], sizeof(image) ) );
+        test_node_destroy( &s2[i] );
+    }
+    pipe_close( &cif );
+
+    // four nodes through a bus taking fewer frames per retry than
+    // there are nodes: each block takes several SDO timeouts to drain,
+    // but every frame is answered in time
+    struct canmat_sdo_server s4[4];
+    struct canmat_flash f4[4];
+    uint8_t program4[4][sizeof(image)];
+    for( size_t i = 0; i < 4; i++ ) {
+        test_node_init( &s4[i], (uint8_t)(6 + i), dict );
+        struct canmat_sdo_value *v =
+            canmat_sdo_server_value( &s4[i], canmat_dict_search_index( dict, CANMAT_FLASH_DATA, 1 ) );
+        v->data = program4[i];
+        v->capacity = sizeof(program4[i]);
+        canmat_flash_init( &f4[i], (uint8_t)(6 + i), 1, canmat_flash_queue, &f4[i] );
+        f4[i].client.timeout_ns = 50000000;
+    }
+    pipe_open( &cif, s4, 4 );
+    pipe_rate = 2;
+    now = canmat_now_ns();
+    for( size_t i = 0; i < 4; i++ ) {
+        assert( CANMAT_OK == canmat_flash_start( &f4[i], image, sizeof(image), now ) );
+    }
+    assert( CANMAT_OK == canmat_flash_run( &cif, f4, 4, NULL, NULL ) );
+    assert( pipe_n_refused > 0 );
+    for( size_t i = 0; i < 4; i++ ) {
+        assert( CANMAT_OK == f4[i].status && 0 == f4[i].tx_n );
+        assert( f4[i].download_end - f4[i].download_start > 3 * f4[i].client.timeout_ns );
+        assert( 0 == memcmp( image, program4[i], sizeof(image) ) );
+        test_node_destroy( &s4[i] );
+    }
+    pipe_close( &cif );
+
+    test_node_destroy( &s );
+    free( dict );
+}
+
 int main( int argc, char **argv ) {
     (void) argc; (void) argv;
 
@@ -181,6 +1641,23 @@ int main( int argc, char **argv ) {
     sdo_data();
 
     check_sdo_dl( );
+    dict_index();
+    dict_name();
+    dict_load();
+    dict_image();
+    pdo_codec();
+    dispatch();
+    sdo_client();
+    sdo_server();
+    pdo_slave();
+    sync_producer();
+    nmt_master();
+    emcy();
+    lss();
+    snapshot();
+    cdcf();
+    fanout();
+    flash();
 
     return 0;
 }